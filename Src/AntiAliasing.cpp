@@ -0,0 +1,278 @@
+#include <assert.h>
+#include <immintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+
+#include "Avx2Iterations.h"
+#include "Mandelbrot.h"
+
+extern "C" uint64_t GetTimeStampCounter();
+
+// Same tiles as TiledRender.cpp, the edges are found and the samples are packed per tile.
+static const size_t TileWidth   = 64;
+static const size_t TileHeight  = 8;
+static const size_t MaxGridSize = 8;
+
+struct AntiAliasedTile;
+
+struct AntiAliasedFrame
+{
+    uint8_t*                      pixels;
+    const uint16_t*               iterations;
+    const MandelbrotView*         view;
+    const MandelbrotPalette*      palette;
+    const MandelbrotAntiAliasing* antiAliasing;
+
+    size_t                        numberOfTilesX;
+    // scratch of every thread of the scheduler, a tile is too big for the stack
+    AntiAliasedTile*              tiles;
+
+    std::atomic<uint64_t>         vectorIterations;
+    std::atomic<uint64_t>         skippedIterations;
+    std::atomic<uint64_t>         refinedPixels;
+};
+
+// Refined pixels of a tile and the sums of the colors of their samples.
+struct AntiAliasedTile
+{
+    int             pixelsX[TileWidth * TileHeight];
+    int             pixelsY[TileWidth * TileHeight];
+    uint32_t        colorSums[TileWidth * TileHeight][3];
+    size_t          numberOfPixels;
+
+    MandelbrotStats stats;
+};
+
+static void     AntiAliasTile       (size_t tileIndex, size_t threadIndex, void* context);
+static bool     IsEdgePixel         (const uint16_t* iterations, const MandelbrotView* view,
+                                     const size_t pixelX, const size_t pixelY,
+                                     const size_t threshold);
+static void     CalculateSamples    (AntiAliasedTile* tile, const MandelbrotView* view,
+                                     const MandelbrotPalette* palette, const size_t gridSize);
+static void     GetSampleOffset     (const size_t pixelX, const size_t pixelY,
+                                     const size_t sample, const size_t gridSize,
+                                     float* outOffsetX, float* outOffsetY);
+static uint32_t HashSample          (uint32_t value);
+
+uint64_t AntiAliasMandelbrot(uint8_t* pixels, const uint16_t* iterations,
+                             const MandelbrotView* view, const MandelbrotPalette* palette,
+                             const MandelbrotAntiAliasing* antiAliasing,
+                             TileScheduler* scheduler, MandelbrotStats* stats)
+{
+    assert(pixels);
+    assert(iterations);
+    assert(view);
+    assert(palette);
+    assert(palette->maxNumberOfIterations == view->maxNumberOfIterations);
+    assert(antiAliasing);
+    assert(antiAliasing->gridSize >= 2 && antiAliasing->gridSize <= MaxGridSize);
+    assert(scheduler);
+
+#ifdef TIME_MEASURE
+    uint64_t startTime = GetTimeStampCounter();
+#endif
+
+    AntiAliasedFrame frame = {};
+    frame.pixels       = pixels;
+    frame.iterations   = iterations;
+    frame.view         = view;
+    frame.palette      = palette;
+    frame.antiAliasing = antiAliasing;
+
+    frame.numberOfTilesX = (view->width  + TileWidth  - 1) / TileWidth;
+    size_t numberOfTiles = (view->height + TileHeight - 1) / TileHeight * frame.numberOfTilesX;
+
+    frame.tiles = (AntiAliasedTile*)calloc(scheduler->numberOfThreads, sizeof(AntiAliasedTile));
+
+    TileSchedulerRun(scheduler, numberOfTiles, AntiAliasTile, &frame);
+
+    free(frame.tiles);
+
+    if (stats)
+    {
+        stats->vectorIterations  = frame.vectorIterations;
+        stats->skippedIterations = frame.skippedIterations;
+        stats->refinedPixels     = frame.refinedPixels;
+    }
+
+#ifdef TIME_MEASURE
+    uint64_t timeSpent = GetTimeStampCounter() - startTime;
+    printf("refinedPixels - %llu\n", (unsigned long long)frame.refinedPixels.load());
+    return timeSpent;
+#else
+    return 0;
+#endif
+}
+
+static void AntiAliasTile(size_t tileIndex, size_t threadIndex, void* context)
+{
+    assert(context);
+
+    AntiAliasedFrame*     frame = (AntiAliasedFrame*)context;
+    const MandelbrotView* view  = frame->view;
+
+    const size_t gridSize        = frame->antiAliasing->gridSize;
+    const size_t numberOfSamples = gridSize * gridSize;
+
+    const size_t xBegin = tileIndex % frame->numberOfTilesX * TileWidth;
+    const size_t yBegin = tileIndex / frame->numberOfTilesX * TileHeight;
+    const size_t xEnd   = xBegin + TileWidth  < view->width  ? xBegin + TileWidth  : view->width;
+    const size_t yEnd   = yBegin + TileHeight < view->height ? yBegin + TileHeight : view->height;
+
+    AntiAliasedTile* tile = &frame->tiles[threadIndex];
+
+    tile->numberOfPixels = 0;
+    tile->stats          = {};
+
+    for (size_t pixelY = yBegin; pixelY < yEnd; ++pixelY)
+    {
+        for (size_t pixelX = xBegin; pixelX < xEnd; ++pixelX)
+        {
+            if (!IsEdgePixel(frame->iterations, view, pixelX, pixelY,
+                             frame->antiAliasing->threshold))
+                continue;
+
+            tile->pixelsX[tile->numberOfPixels] = (int)pixelX;
+            tile->pixelsY[tile->numberOfPixels] = (int)pixelY;
+            tile->numberOfPixels++;
+        }
+    }
+
+    if (!tile->numberOfPixels)
+        return;
+
+    CalculateSamples(tile, view, frame->palette, gridSize);
+
+    for (size_t i = 0; i < tile->numberOfPixels; ++i)
+    {
+        uint8_t* pixel = frame->pixels + ((size_t)tile->pixelsX[i] +
+                                          (size_t)tile->pixelsY[i] * view->width) * 4;
+
+        for (size_t channel = 0; channel < 3; ++channel)
+            pixel[channel] = (uint8_t)((tile->colorSums[i][channel] + numberOfSamples / 2) /
+                                       numberOfSamples);
+        pixel[3] = 255;
+    }
+
+    frame->vectorIterations  += tile->stats.vectorIterations;
+    frame->skippedIterations += tile->stats.skippedIterations;
+    frame->refinedPixels     += tile->numberOfPixels;
+}
+
+static bool IsEdgePixel(const uint16_t* iterations, const MandelbrotView* view,
+                        const size_t pixelX, const size_t pixelY, const size_t threshold)
+{
+    assert(iterations);
+    assert(view);
+
+    const uint16_t* pixel = iterations + pixelX + pixelY * view->width;
+    const int       count = *pixel;
+
+    const int left  = pixelX > 0                ? pixel[-1]                      : count;
+    const int right = pixelX + 1 < view->width  ? pixel[1]                       : count;
+    const int up    = pixelY > 0                ? pixel[-(ptrdiff_t)view->width] : count;
+    const int down  = pixelY + 1 < view->height ? pixel[view->width]             : count;
+
+    const int maxDifference = (int)threshold;
+
+    return abs(left - count) > maxDifference || abs(right - count) > maxDifference ||
+           abs(up   - count) > maxDifference || abs(down  - count) > maxDifference;
+}
+
+// Sample s of pixel p is the number p * numberOfSamples + s of the tile, every 8 of them are
+// iterated together, so lanes are not left empty when a pixel has fewer samples than lanes.
+static void CalculateSamples(AntiAliasedTile* tile, const MandelbrotView* view,
+                             const MandelbrotPalette* palette, const size_t gridSize)
+{
+    assert(tile);
+    assert(view);
+    assert(palette);
+
+    const size_t numberOfSamples    = gridSize * gridSize;
+    const size_t numberOfAllSamples = tile->numberOfPixels * numberOfSamples;
+
+    const __m256 x0BeginAvx = _mm256_set1_ps(view->x0Begin);
+    const __m256 y0BeginAvx = _mm256_set1_ps(view->y0Begin);
+    const __m256 dxAvx      = _mm256_set1_ps(view->dx);
+    const __m256 dyAvx      = _mm256_set1_ps(view->dy);
+
+    for (size_t i = 0; i < tile->numberOfPixels; ++i)
+        tile->colorSums[i][0] = tile->colorSums[i][1] = tile->colorSums[i][2] = 0;
+
+    for (size_t i = 0; i < numberOfAllSamples; i += 8)
+    {
+        const size_t numberOfLanes = numberOfAllSamples - i < 8 ? numberOfAllSamples - i : 8;
+
+        // the last group is padded with its last sample
+        alignas(32) float samplesX[8] = {};
+        alignas(32) float samplesY[8] = {};
+        for (size_t lane = 0; lane < 8; ++lane)
+        {
+            const size_t sample = i + (lane < numberOfLanes ? lane : numberOfLanes - 1);
+            const size_t pixel  = sample / numberOfSamples;
+
+            const size_t pixelX = (size_t)tile->pixelsX[pixel];
+            const size_t pixelY = (size_t)tile->pixelsY[pixel];
+
+            float offsetX = 0;
+            float offsetY = 0;
+            GetSampleOffset(pixelX, pixelY, sample % numberOfSamples, gridSize,
+                            &offsetX, &offsetY);
+
+            samplesX[lane] = (float)pixelX + offsetX;
+            samplesY[lane] = (float)pixelY + offsetY;
+        }
+
+        __m256 x0 = _mm256_add_ps(x0BeginAvx, _mm256_mul_ps(_mm256_load_ps(samplesX), dxAvx));
+        __m256 y0 = _mm256_add_ps(y0BeginAvx, _mm256_mul_ps(_mm256_load_ps(samplesY), dyAvx));
+
+        alignas(32) int numberOfIterationsArray[8] = {};
+        _mm256_store_si256((__m256i*)numberOfIterationsArray,
+                           CalculateIterationsAvx2(x0, y0, view->maxNumberOfIterations,
+                                                   &tile->stats));
+
+        for (size_t lane = 0; lane < numberOfLanes; ++lane)
+        {
+            uint32_t*      sums  = tile->colorSums[(i + lane) / numberOfSamples];
+            const uint8_t* color = (const uint8_t*)&palette->colors[numberOfIterationsArray[lane]];
+
+            sums[0] += color[0];
+            sums[1] += color[1];
+            sums[2] += color[2];
+        }
+    }
+}
+
+// Offset of the sample from the pixel point in pixels, in [-1/2, 1/2): the cell of the sample
+// in the grid over the pixel and a jitter inside of it. Jitter is a hash of the pixel and the
+// sample, so the picture is the same on every run and with any tiling.
+static void GetSampleOffset(const size_t pixelX, const size_t pixelY, const size_t sample,
+                            const size_t gridSize, float* outOffsetX, float* outOffsetY)
+{
+    assert(gridSize > 0);
+    assert(outOffsetX);
+    assert(outOffsetY);
+
+    const uint32_t hash = HashSample((uint32_t)pixelX * 73856093u ^
+                                     (uint32_t)pixelY * 19349663u ^
+                                     (uint32_t)sample * 83492791u);
+
+    const float jitterX = (float)(hash & 0xffff) / 65536.f;
+    const float jitterY = (float)(hash >> 16)    / 65536.f;
+
+    *outOffsetX = ((float)(sample % gridSize) + jitterX) / (float)gridSize - 0.5f;
+    *outOffsetY = ((float)(sample / gridSize) + jitterY) / (float)gridSize - 0.5f;
+}
+
+// lowbias32 of the hash prospector, every input bit changes about half of the output bits.
+static uint32_t HashSample(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+
+    return value;
+}
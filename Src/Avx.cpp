@@ -1,28 +1,76 @@
 #include <assert.h>
 #include <math.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <SFML/Graphics.hpp>
-#include <immintrin.h>
+
+#include "KernelDispatch.h"
+#include "Mandelbrot.h"
+#include "ProgressiveRender.h"
+#include "QualityGovernor.h"
 
 extern "C" uint64_t GetTimeStampCounter();
 
+// Longest wait for a picture of the render thread before the events are polled again, it
+// is added to the input latency.
+static const uint64_t FrameWaitTimeNs = 1000000;
+
+// The view is moving if a key changed it this recently, then frames are calculated to the
+// quality the governor chooses. After that the frame is refined to the full quality.
+static const uint64_t MovingTimeNs    = 250000000;
+
+static const double   DefaultFrameBudgetMs = 16;
+
+// 64 MB hold the tiles of ~50 frames 800x600
+static const size_t   DefaultTileCacheMb   = 64;
+
+// Cycles spent on every stage of a frame, summed over the frames that had it. The render
+// thread calculates a frame once and colorizes it after every pass.
+struct StageTimes
+{
+    uint64_t compute;
+    uint64_t colorize;
+    uint64_t upload;
+
+    size_t   numberOfComputes;
+    size_t   numberOfColorizes;
+    size_t   numberOfUploads;
+};
+
+// Time from a key that changes the view to the first picture of the new view on the
+// screen. Keys pressed before the picture of the previous one are counted from the first.
+struct InputLatencies
+{
+    uint64_t sumNs;
+    uint64_t maxNs;
+    size_t   numberOfInputs;
+};
+
 void     CreateWindow           (const size_t width, const size_t height, 
                                  sf::RenderWindow* outWindow, const char* windowName);
 
-uint64_t CalculateMandelbrotSet (sf::Uint8* pixels, const size_t width, const size_t height,
-                                 const float imageXShift, const float imageYShift, 
-                                 const float scale, const float dxPerPixel, const float dyPerPixel);
-
-void     DrawPixels             (sf::RenderWindow* window, sf::Uint8* pixels, 
-                                 const size_t width, const size_t height);
+void     DrawPixels             (sf::RenderWindow* window, sf::Sprite* sprite);
 
 void     ClearWindow            (sf::RenderWindow* window);
 
 void     PollEvents             (sf::RenderWindow* window, 
-                                 float* imageXShift, float* imageYShift, float* scale,
-                                 const float dxPerPixel, const float dyPerPixel);
+                                 double* imageXShift, double* imageYShift, long* zoomLevel,
+                                 const float dxPerPixel, const float dyPerPixel,
+                                 MandelbrotPaletteType* paletteType, uint64_t* inputTime,
+                                 uint64_t* lastInputTime);
+
+float    GetScale               (const long zoomLevel, const float dxPerPixel);
+
+void     PrintStageTimes        (const StageTimes* times);
+void     PrintInputLatencies    (const InputLatencies* latencies);
+void     PrintTileCacheStats    (const TileCacheStats* stats);
+
+uint64_t GetTimeNs              ();
 
-int main()
+int main(int argc, char* argv[])
 {
     static const size_t width  = 800;
     static const size_t height = 600;
@@ -30,167 +78,270 @@ int main()
     static const float dxPerPixel = 1.f / (float)width;
     static const float dyPerPixel = dxPerPixel;
 
-    sf::RenderWindow window;
-    CreateWindow(width, height, &window, "Mandelbrot");
- 
-    sf::Uint8* pixels = (sf::Uint8*)calloc(width * height * 4, sizeof(*pixels));
+    size_t      numberOfThreads       = GetDefaultNumberOfThreads();
+    const char* kernelName            = nullptr;
+    bool        useSubdivision        = true;
+    size_t      maxNumberOfIterations = DefaultMaxNumberOfIterations;
+    double      frameBudgetMs         = DefaultFrameBudgetMs;
+    bool        isGovernorLogged      = false;
+    size_t      tileCacheMb           = DefaultTileCacheMb;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            numberOfThreads = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+            kernelName = argv[++i];
+        else if (strcmp(argv[i], "--subdivision") == 0 && i + 1 < argc)
+            useSubdivision = strcmp(argv[++i], "off") != 0;
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            maxNumberOfIterations = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc)
+            frameBudgetMs = strtod(argv[++i], nullptr);
+        else if (strcmp(argv[i], "--governor-log") == 0 && i + 1 < argc)
+            isGovernorLogged = strcmp(argv[++i], "on") == 0;
+        else if (strcmp(argv[i], "--tile-cache") == 0 && i + 1 < argc)
+            tileCacheMb = strtoul(argv[++i], nullptr, 10);
+    }
 
-    float imageXShift = 0.f;
-    float imageYShift = 0.f;
-    float scale       = 1.f;
+    if (numberOfThreads == 0)
+        numberOfThreads = 1;
 
-    uint64_t time         = 0;
-    uint64_t numberOfRuns = 0;
-    while (window.isOpen())
+    if (maxNumberOfIterations == 0 || maxNumberOfIterations > MaxNumberOfIterationsLimit)
     {
-        time += CalculateMandelbrotSet(pixels, width, height, imageXShift, 
-                                       imageYShift, scale, dxPerPixel, dyPerPixel);
+        printf("Number of iterations has to be in [1, %zu]\n", MaxNumberOfIterationsLimit);
+        return 1;
+    }
 
-#ifndef TIME_MEASURE
-        DrawPixels(&window, pixels, width, height);
-#else
-        numberOfRuns++;
+    const MandelbrotKernelInfo* kernel = SelectMandelbrotKernel(kernelName);
+    if (!kernel)
+        return 1;
 
-        if (numberOfRuns == 1000)
-            window.close();
-#endif
+    // subdivision is built on the avx2 kernel whatever kernel is selected
+    const MandelbrotKernelInfo* avx2Kernel = FindMandelbrotKernel("avx2");
+    if (useSubdivision && !(avx2Kernel && IsKernelSupported(avx2Kernel)))
+    {
+        printf("Subdivision needs avx2, every pixel is calculated\n");
+        useSubdivision = false;
+    }
 
-        PollEvents(&window, &imageXShift, &imageYShift, &scale, dxPerPixel, dyPerPixel);
+    // whole frames are calculated in passes, subdivision is used for the strips of a pan
+    if (useSubdivision)
+        printf("Kernel - %s, avx2 with subdivision after a pan, threads - %zu\n",
+               kernel->name, numberOfThreads);
+    else
+        printf("Kernel - %s, threads - %zu\n", kernel->name, numberOfThreads);
+
+    TileScheduler scheduler = {};
+    TileSchedulerCtor(&scheduler, numberOfThreads);
+
+    // 0 MB turns the cache off
+    TileCache tileCache = {};
+    if (tileCacheMb > 0)
+    {
+        TileCacheCtor(&tileCache, tileCacheMb << 20);
+        printf("Tile cache - %zu MB\n", tileCacheMb);
     }
 
+    // frames are calculated and colorized on the render thread, this one only handles the
+    // input and shows the pictures
+    ProgressiveRenderer renderer = {};
+    ProgressiveRendererCtor(&renderer, width, height, &scheduler, kernel, useSubdivision,
+                            tileCacheMb > 0 ? &tileCache : nullptr);
+
+    // budget 0 turns the governor off, every frame is of the full quality
+    bool isGoverned = frameBudgetMs > 0;
 #ifdef TIME_MEASURE
-    printf("Runs - %zu, Time spent on one run - %zu\n", numberOfRuns, time / numberOfRuns);
-#endif 
+    // every frame is measured at the same quality
+    isGoverned = false;
+#endif
 
-    window.clear();
-    free(pixels);
-}
+    QualityGovernor governor = {};
+    if (isGoverned)
+    {
+        QualityGovernorCtor(&governor, frameBudgetMs, MeasureCyclesPerMs(),
+                            maxNumberOfIterations, isGovernorLogged);
+        printf("Frame budget - %.1f ms while moving\n", frameBudgetMs);
+    }
 
-void CreateWindow(const size_t width, const size_t height, 
-                  sf::RenderWindow* outWindow, const char* windowName)
-{
-    outWindow->create(sf::VideoMode(width, height), windowName);
-}
+    const FrameQuality fullQuality = { 0, 1, maxNumberOfIterations };
 
-uint64_t CalculateMandelbrotSet(sf::Uint8* pixels, const size_t width, const size_t height,
-                                const float imageXShift, const float imageYShift, 
-                                const float scale, const float dxPerPixel, const float dyPerPixel)
-{   
-    static const float  centerX = -1.35f;
-    static const float  centerY = 0.f;
-    
-    static const __m256 maxRadiusSquare = _mm256_set1_ps(100.f);
+    sf::RenderWindow window;
+    CreateWindow(width, height, &window, "Mandelbrot");
 
-    static const size_t maxNumberOfIterations = 256;
-    static const __m256 colorsCalculatingDivider = 
-                                _mm256_set1_ps((float)maxNumberOfIterations / 255.f);
+    // the texture lives as long as the window, every picture only updates its pixels
+    sf::Texture texture;
+    texture.create(width, height);
+    sf::Sprite sprite(texture);
 
-#ifdef TIME_MEASURE
-    uint64_t startTime            = GetTimeStampCounter();
-    uint64_t allIterationsCounter = 0;
-#endif
+    MandelbrotPaletteType paletteType = PALETTE_GREEN;
 
-    const float dx = dxPerPixel / scale;
-    const float dy = dyPerPixel / scale;
+    StageTimes     stageTimes = {};
+    InputLatencies latencies  = {};
 
-    const __m256 pointsDeltas = _mm256_mul_ps(_mm256_set_ps(7.f, 6.f, 5.f, 4.f,
-                                                            3.f, 2.f, 1.f, 0.f), 
-                                              _mm256_set1_ps(dx));
-                                              
-          float y0Begin = -(float)height / 2 * dy + centerY + imageYShift;
-    const float x0Begin = -(float)width  / 2 * dx + centerX + imageXShift;
-    
-    __m256 y0Avx = _mm256_set1_ps(y0Begin);
-    __m256 dyAvx = _mm256_set1_ps(dy);
-    for (size_t pixelY = 0; pixelY < height; ++pixelY, y0Avx = _mm256_add_ps(y0Avx, dyAvx))
+    // shifts are double, so a deep zoom can be placed more precisely than float allows.
+    // Zoom is a whole number of steps, so coming back to a scale gives exactly the same
+    // pixel step and the tiles of the cache
+    double imageXShift = 0;
+    double imageYShift = 0;
+    long   zoomLevel   = 0;
+
+    MandelbrotView        postedView        = {};
+    MandelbrotPaletteType postedPaletteType = paletteType;
+    FrameQuality          postedQuality     = fullQuality;
+    size_t                postedRequest     = 0;
+    uint64_t              postedTime        = 0;
+
+    // the posted frame is chosen by the governor and it hasn't learnt its time yet
+    bool isPostedGoverned = false;
+
+    // of the first key that is not on the screen yet, 0 if there is none
+    uint64_t inputTime     = 0;
+    uint64_t lastInputTime = 0;
+
+    size_t numberOfRuns = 0;
+    while (window.isOpen())
     {
-        float x0 = x0Begin;
+        const bool isMoving = isGoverned && lastInputTime != 0 &&
+                              GetTimeNs() - lastInputTime < MovingTimeNs;
+
+        FrameQuality quality = fullQuality;
+        if (isMoving)
+            QualityGovernorGetQuality(&governor, &quality);
+
+        MandelbrotView view = {};
+        MandelbrotViewCtor(&view, width, height, imageXShift, imageYShift,
+                           GetScale(zoomLevel, dxPerPixel), dxPerPixel, dyPerPixel,
+                           quality.maxNumberOfIterations);
+
+        // a request cancels the frame in progress, so it is posted only if something changed
+        bool isChanged = postedRequest == 0 || paletteType != postedPaletteType ||
+                         quality.step != postedQuality.step ||
+                         memcmp(&view, &postedView, sizeof(view)) != 0;
+    #ifdef TIME_MEASURE
+        // every frame is measured in full
+        isChanged = true;
+    #endif
+
+        if (isChanged)
+        {
+            const uint64_t postTime = GetTimeStampCounter();
+
+            // the frame didn't make it to the screen in time for the next input
+            if (isPostedGoverned)
+                QualityGovernorAddCancelled(&governor, &postedQuality, postTime - postedTime);
+
+            postedRequest     = ProgressiveRendererPost(&renderer, &view, paletteType,
+                                                        quality.step);
+            postedView        = view;
+            postedPaletteType = paletteType;
+            postedQuality     = quality;
+            postedTime        = postTime;
+            isPostedGoverned  = isMoving;
+        }
+
+        ProgressiveFrame frame = {};
+        bool hasFrame = ProgressiveRendererTakeFrame(&renderer, FrameWaitTimeNs, &frame);
+    #ifdef TIME_MEASURE
+        // the next frame is posted when this one is calculated to the last pass
+        while (!hasFrame || frame.requestNumber != postedRequest || !frame.isComplete)
+            hasFrame = ProgressiveRendererTakeFrame(&renderer, FrameWaitTimeNs, &frame);
+    #endif
 
-        for (size_t pixelX = 0; pixelX < width; pixelX += 8, x0 += 8 * dx)
+        if (hasFrame && isPostedGoverned && frame.requestNumber == postedRequest &&
+            frame.isComplete)
         {
-            __m256i numberOfIterations = _mm256_setzero_si256();
+            QualityGovernorAddFrame(&governor, &postedQuality, frame.computeTime,
+                                    frame.colorizeTime);
+            isPostedGoverned = false;
+        }
 
-            __m256 x0Avx = _mm256_add_ps(_mm256_set1_ps(x0), pointsDeltas);
+        if (hasFrame)
+        {
+            const uint64_t stageStart = GetTimeStampCounter();
+            texture.update(frame.pixels);
+            stageTimes.upload += GetTimeStampCounter() - stageStart;
+            stageTimes.numberOfUploads++;
+        }
 
-            __m256 x = x0Avx;
-            __m256 y = y0Avx;
-            
-            size_t iterationNumber = 0;
-            for (iterationNumber = 0; iterationNumber < maxNumberOfIterations;
-                 ++iterationNumber)
-            {
-                __m256 xSquare = _mm256_mul_ps(x, x);
-                __m256 ySquare = _mm256_mul_ps(y, y); 
-                __m256 xMulY   = _mm256_mul_ps(x, y); 
+#ifndef TIME_MEASURE
+        DrawPixels(&window, &sprite);
 
-                __m256 radiusSquare = _mm256_add_ps(xSquare, ySquare);
+        // pictures of the cancelled requests don't count, the key is not on them
+        if (hasFrame && inputTime != 0 && frame.requestNumber == postedRequest)
+        {
+            const uint64_t latency = GetTimeNs() - inputTime;
 
-                __m256 cmpRadius = _mm256_cmp_ps(radiusSquare, maxRadiusSquare, _CMP_LT_OQ);
-                int mask = _mm256_movemask_ps(cmpRadius);
+            latencies.sumNs += latency;
+            latencies.maxNs  = latency > latencies.maxNs ? latency : latencies.maxNs;
+            latencies.numberOfInputs++;
 
-                if (!mask) break;
+            inputTime = 0;
+        }
+#else
+        numberOfRuns++;
 
-                // calculating number of iterations per each dx shift 
-                numberOfIterations = _mm256_sub_epi32(numberOfIterations, 
-                                                      _mm256_castps_si256(cmpRadius));
+        if (numberOfRuns == 1000)
+            window.close();
+#endif
 
-                x = _mm256_add_ps(_mm256_sub_ps(xSquare, ySquare), x0Avx);
-                y = _mm256_add_ps(_mm256_add_ps(xMulY  , xMulY),   y0Avx);
-            }
-        
-        #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
-            __m256 colors = _mm256_div_ps(_mm256_cvtepi32_ps(numberOfIterations), 
-                                          colorsCalculatingDivider);
+        PollEvents(&window, &imageXShift, &imageYShift, &zoomLevel, dxPerPixel, dyPerPixel,
+                   &paletteType, &inputTime, &lastInputTime);
+    }
 
-            size_t pixelPos = (pixelX + pixelY * width) * 4;
+    ProgressiveRenderStats renderStats = {};
+    ProgressiveRendererGetStats(&renderer, &renderStats);
+    ProgressiveRendererDtor(&renderer);
 
-            int*   numberOfIterationsArray = (int*)(&numberOfIterations);
-            float* colorsArray             = (float*)(&colors);
-            for (size_t i = 0; i < 8; ++i, pixelPos += 4)
-            {
-                uint8_t color = (uint8_t)colorsArray[i];
+    // the render thread is stopped, the cache is not used anymore
+    if (tileCacheMb > 0)
+    {
+        TileCacheStats tileCacheStats = {};
+        TileCacheGetStats(&tileCache, &tileCacheStats);
+        TileCacheDtor(&tileCache);
 
-                color = numberOfIterationsArray[i] == maxNumberOfIterations ? 0 : color;
-                pixels[pixelPos]     = color > 122 ? color : 0;
-                pixels[pixelPos + 1] = color > 122 ? 1     : color;
-                pixels[pixelPos + 2] = color > 122 ? color : 0;
-                pixels[pixelPos + 3] = 255;
-            }
-        #endif
-        #if TIME_MEASURE_EXTRA_VAR
-            allIterationsCounter += iterationNumber;
-        #endif
-        }
+        PrintTileCacheStats(&tileCacheStats);
     }
 
 #ifdef TIME_MEASURE
-    uint64_t timeSpent = GetTimeStampCounter() - startTime;
-    printf("allIterationsCounter - %llu\n", allIterationsCounter);
-    return timeSpent;
-#else
-    return 0;
-#endif
+    printf("Runs - %zu, Time spent on one run - %llu\n", numberOfRuns,
+           (unsigned long long)(renderStats.computeTime / numberOfRuns));
+#endif 
+
+    stageTimes.compute           = renderStats.computeTime;
+    stageTimes.numberOfComputes  = renderStats.numberOfFrames + renderStats.numberOfCancelledFrames;
+    stageTimes.colorize          = renderStats.colorizeTime;
+    stageTimes.numberOfColorizes = renderStats.numberOfColorizes;
+
+    printf("Frames - %zu, cancelled - %zu\n", renderStats.numberOfFrames,
+           renderStats.numberOfCancelledFrames);
+    PrintStageTimes(&stageTimes);
+    PrintInputLatencies(&latencies);
+
+    window.clear();
+
+    TileSchedulerDtor(&scheduler);
 }
 
-void DrawPixels (sf::RenderWindow* window, sf::Uint8* pixels, 
-                 const size_t width, const size_t height)
+void CreateWindow(const size_t width, const size_t height, 
+                  sf::RenderWindow* outWindow, const char* windowName)
 {
-    sf::Texture texture;
-    texture.create(width, height);
-    sf::Sprite sprite;
-    
-    texture.update(pixels);
-    sprite.setTexture(texture);
+    outWindow->create(sf::VideoMode(width, height), windowName);
+}
 
-    window->draw(sprite);
+void DrawPixels (sf::RenderWindow* window, sf::Sprite* sprite)
+{
+    window->draw(*sprite);
 
     window->display();
 }
 
 void PollEvents(sf::RenderWindow* window, 
-                float* imageXShift, float* imageYShift, float* scale,
-                const float dxPerPixel, const float dyPerPixel)
+                double* imageXShift, double* imageYShift, long* zoomLevel,
+                const float dxPerPixel, const float dyPerPixel,
+                MandelbrotPaletteType* paletteType, uint64_t* inputTime,
+                uint64_t* lastInputTime)
 {
+
     sf::Event event;
     while (window->pollEvent(event))
     {
@@ -202,41 +353,115 @@ void PollEvents(sf::RenderWindow* window,
             
             case sf::Event::KeyReleased:
             {
+                const float scale = GetScale(*zoomLevel, dxPerPixel);
+
+                bool isViewKey = true;
                 switch(event.key.code)
                 {
+                    // 10 pixels at any scale, so the previous frame can be reused
                     case sf::Keyboard::Right:
-                        *imageXShift += dxPerPixel * 10.f;
+                        *imageXShift += (double)dxPerPixel * 10 / scale;
                         break;
                     case sf::Keyboard::Left:
-                        *imageXShift -= dxPerPixel * 10.f;
+                        *imageXShift -= (double)dxPerPixel * 10 / scale;
                         break;
                     case sf::Keyboard::Up:
-                        *imageYShift -= dyPerPixel * 10.f;
+                        *imageYShift -= (double)dyPerPixel * 10 / scale;
                         break;
                     case sf::Keyboard::Down:
-                        *imageYShift += dyPerPixel * 10.f;
+                        *imageYShift += (double)dyPerPixel * 10 / scale;
                         break;
                     case sf::Keyboard::Hyphen: // -
-                        *scale -= dxPerPixel * 10.f;
+                        --*zoomLevel;
                         break;
                     case sf::Keyboard::Equal: // equal on the same pos as +
-                        *scale += dxPerPixel * 10.f;
+                        ++*zoomLevel;
+                        break;
+                    case sf::Keyboard::P:
+                        *paletteType = (MandelbrotPaletteType)((*paletteType + 1) %
+                                                               NUMBER_OF_PALETTES);
                         break;
 
                     default:
+                        isViewKey = false;
                         break;
                 
                 }
+
+                if (!isViewKey)
+                    break;
+
+                const uint64_t time = GetTimeNs();
+                if (*inputTime == 0)
+                    *inputTime = time;
+
+                // another palette doesn't move the view
+                if (event.key.code != sf::Keyboard::P)
+                    *lastInputTime = time;
             }
         }
     }
 }
 
+// Every level adds dxPerPixel * 10 to the scale.
+float GetScale(const long zoomLevel, const float dxPerPixel)
+{
+    return 1.f + (float)zoomLevel * dxPerPixel * 10.f;
+}
+
 void ClearWindow(sf::RenderWindow* window)
 {
     window->clear();
 }
 
+void PrintStageTimes(const StageTimes* times)
+{
+    assert(times);
+
+    // frames that reused everything have no stages to count
+    const size_t computes  = times->numberOfComputes  ? times->numberOfComputes  : 1;
+    const size_t colorizes = times->numberOfColorizes ? times->numberOfColorizes : 1;
+    const size_t uploads   = times->numberOfUploads   ? times->numberOfUploads   : 1;
+
+    printf("Cycles per frame: compute - %llu (%zu frames), colorize - %llu (%zu frames), "
+           "upload - %llu (%zu frames)\n",
+           (unsigned long long)(times->compute  / computes),  times->numberOfComputes,
+           (unsigned long long)(times->colorize / colorizes), times->numberOfColorizes,
+           (unsigned long long)(times->upload   / uploads),   times->numberOfUploads);
+}
+
+void PrintInputLatencies(const InputLatencies* latencies)
+{
+    assert(latencies);
+
+    if (latencies->numberOfInputs == 0)
+        return;
+
+    printf("Input to the first picture: mean - %.2f ms, max - %.2f ms (%zu inputs)\n",
+           (double)latencies->sumNs / (double)latencies->numberOfInputs / 1e6,
+           (double)latencies->maxNs / 1e6, latencies->numberOfInputs);
+}
+
+void PrintTileCacheStats(const TileCacheStats* stats)
+{
+    assert(stats);
+
+    printf("Tile cache: hits - %.1f%% of %llu tiles, evictions - %llu, "
+           "tiles - %zu of %zu, memory - %.1f of %.1f MB\n",
+           stats->lookups ? (double)stats->hits * 100 / (double)stats->lookups : 0.,
+           (unsigned long long)stats->lookups, (unsigned long long)stats->evictions,
+           stats->numberOfTiles, stats->maxNumberOfTiles,
+           (double)stats->bytes / (1 << 20), (double)stats->budgetBytes / (1 << 20));
+}
+
+uint64_t GetTimeNs()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
+
 
 // 1193243
 // 52355494
@@ -0,0 +1,117 @@
+#include <assert.h>
+#include <immintrin.h>
+
+#include "Avx2Iterations.h"
+#include "Mandelbrot.h"
+
+// Same loop as the float AVX2 kernel on 4 lanes of double. Lanes are twice as expensive, so
+// it is used only when IsFloatPrecisionEnough says no. Here mul + add are fused explicitly,
+// the picture is not compared with the float kernels anyway.
+void CalculateMandelbrotTileAvx2Double(uint16_t* iterations, const MandelbrotView* view,
+                                       const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    const __m256d maxRadiusSquare = _mm256_set1_pd(100.);
+
+    const size_t  maxNumberOfIterations    = view->maxNumberOfIterations;
+    const __m256i maxNumberOfIterationsAvx = _mm256_set1_epi64x((long long)maxNumberOfIterations);
+
+    uint64_t vectorIterations  = 0;
+    uint64_t skippedIterations = 0;
+
+    const __m256d laneNumbers = _mm256_set_pd(3, 2, 1, 0);
+    const __m256d x0BeginAvx  = _mm256_set1_pd(view->x0BeginDouble);
+    const __m256d dxAvx       = _mm256_set1_pd(view->dxDouble);
+
+    for (size_t pixelY = tile->yBegin; pixelY < tile->yEnd; ++pixelY)
+    {
+        __m256d y0Avx = _mm256_set1_pd(view->y0BeginDouble + (double)pixelY * view->dyDouble);
+
+        for (size_t pixelX = tile->xBegin; pixelX < tile->xEnd; pixelX += 4)
+        {
+            __m256i numberOfIterations = _mm256_setzero_si256();
+
+            __m256d pixelsX = _mm256_add_pd(_mm256_set1_pd((double)pixelX), laneNumbers);
+            __m256d x0Avx   = _mm256_fmadd_pd(pixelsX, dxAvx, x0BeginAvx);
+
+            __m256d x = x0Avx;
+            __m256d y = y0Avx;
+
+            // cardioid and bulb formulas are in Avx2Iterations.h
+            __m256d isInterior = IsInMainCardioidOrBulb(x0Avx, y0Avx);
+
+            __m256d savedX = x;
+            __m256d savedY = y;
+            size_t nextSaveIteration = 1;
+
+            size_t iterationNumber = 0;
+            for (iterationNumber = 0; iterationNumber < maxNumberOfIterations;
+                 ++iterationNumber)
+            {
+                __m256d ySquare      = _mm256_mul_pd(y, y);
+                __m256d radiusSquare = _mm256_fmadd_pd(x, x, ySquare);
+
+                __m256d cmpRadius = _mm256_cmp_pd(radiusSquare, maxRadiusSquare, _CMP_LT_OQ);
+                __m256d isCounted = _mm256_andnot_pd(isInterior, cmpRadius);
+
+                if (!_mm256_movemask_pd(isCounted)) break;
+
+                numberOfIterations = _mm256_sub_epi64(numberOfIterations,
+                                                      _mm256_castpd_si256(isCounted));
+
+                // x^2 - y^2 + x0 and 2xy + y0
+                __m256d newX = _mm256_fmadd_pd(x, x, _mm256_sub_pd(x0Avx, ySquare));
+                y = _mm256_fmadd_pd(_mm256_add_pd(x, x), y, y0Avx);
+                x = newX;
+
+                __m256d isBack = _mm256_and_pd(_mm256_cmp_pd(x, savedX, _CMP_EQ_OQ),
+                                               _mm256_cmp_pd(y, savedY, _CMP_EQ_OQ));
+                isInterior = _mm256_or_pd(isInterior, _mm256_and_pd(isBack, isCounted));
+
+                if (iterationNumber + 1 == nextSaveIteration)
+                {
+                    savedX = x;
+                    savedY = y;
+                    nextSaveIteration *= 2;
+                }
+            }
+
+            if (_mm256_movemask_pd(isInterior))
+            {
+                __m256i isInteriorInt = _mm256_castpd_si256(isInterior);
+
+                alignas(32) long long skippedIterationsArray[4] = {};
+                _mm256_store_si256((__m256i*)skippedIterationsArray,
+                                   _mm256_and_si256(isInteriorInt,
+                                                    _mm256_sub_epi64(maxNumberOfIterationsAvx,
+                                                                     numberOfIterations)));
+                for (size_t i = 0; i < 4; ++i)
+                    skippedIterations += (uint64_t)skippedIterationsArray[i];
+
+                numberOfIterations = _mm256_blendv_epi8(numberOfIterations,
+                                                        maxNumberOfIterationsAvx, isInteriorInt);
+            }
+
+        #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+            alignas(32) long long numberOfIterationsArray[4] = {};
+            _mm256_store_si256((__m256i*)numberOfIterationsArray, numberOfIterations);
+
+            const size_t numberOfPixels = tile->xEnd - pixelX < 4 ? tile->xEnd - pixelX : 4;
+
+            uint16_t* iterationsPos = iterations + pixelX + pixelY * view->width;
+            for (size_t i = 0; i < numberOfPixels; ++i)
+                iterationsPos[i] = (uint16_t)numberOfIterationsArray[i];
+        #endif
+
+            // the last check that broke the loop is executed too
+            vectorIterations += iterationNumber + (iterationNumber < maxNumberOfIterations);
+        }
+    }
+
+    stats->vectorIterations  += vectorIterations;
+    stats->skippedIterations += skippedIterations;
+}
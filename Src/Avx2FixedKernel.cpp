@@ -0,0 +1,261 @@
+#include <assert.h>
+#include <immintrin.h>
+
+#include "Avx2Iterations.h"
+#include "Mandelbrot.h"
+
+// 16 pixels in the int16 lanes of a ymm register, numbers have Fixed16FractionBits bits after
+// the point. The orbit is iterated in fixed point until |z| reaches 2, so nothing but the
+// escaped lanes can overflow. The float kernels count up to |z| = 10, lanes go from 2 to 10
+// in float, that takes a few iterations, and get the same counts as the float kernels
+// wherever the fixed point orbit stays close to the float one.
+static const float  FixedOne           = (float)(1 << Fixed16FractionBits);
+// |z|^2 = 4
+static const short  FixedEscapeSquare  = (short)(4 << Fixed16FractionBits);
+
+static inline __m256i ToFixed16      (const __m256 low, const __m256 high);
+static inline __m256i PackMasks16    (const __m256 low, const __m256 high);
+static inline __m256  ToFloat        (const __m128i fixed);
+static inline __m256i FinishEscape   (__m256 x, __m256 y, const __m256 x0, const __m256 y0,
+                                      const __m128i numberOfIterations16,
+                                      const __m128i isEscaped16,
+                                      const size_t maxNumberOfIterations,
+                                      MandelbrotStats* stats);
+
+void CalculateMandelbrotTileAvx2Fixed16(uint16_t* iterations, const MandelbrotView* view,
+                                        const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    const size_t maxNumberOfIterations = view->maxNumberOfIterations;
+
+    // counters stay in registers, stats may be aliased by the iterations
+    MandelbrotStats tileStats = {};
+
+    // coordinates are calculated in float as in the avx2 kernel and rounded to fixed point
+    const __m256i laneNumbers = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256  x0BeginAvx  = _mm256_set1_ps(view->x0Begin);
+    const __m256  dxAvx       = _mm256_set1_ps(view->dx);
+
+    const __m256i maxNumberOfIterationsAvx = _mm256_set1_epi16((short)maxNumberOfIterations);
+    const __m256i escapeSquare             = _mm256_set1_epi16(FixedEscapeSquare - 1);
+
+    for (size_t pixelY = tile->yBegin; pixelY < tile->yEnd; ++pixelY)
+    {
+        const __m256  y0Avx   = _mm256_set1_ps(view->y0Begin + (float)pixelY * view->dy);
+        const __m256i y0Fixed = ToFixed16(y0Avx, y0Avx);
+
+        for (size_t pixelX = tile->xBegin; pixelX < tile->xEnd; pixelX += 16)
+        {
+            __m256i pixelsX = _mm256_add_epi32(_mm256_set1_epi32((int)pixelX), laneNumbers);
+
+            const __m256 x0Low  = _mm256_add_ps(x0BeginAvx,
+                                                _mm256_mul_ps(_mm256_cvtepi32_ps(pixelsX),
+                                                              dxAvx));
+            pixelsX = _mm256_add_epi32(pixelsX, _mm256_set1_epi32(8));
+            const __m256 x0High = _mm256_add_ps(x0BeginAvx,
+                                                _mm256_mul_ps(_mm256_cvtepi32_ps(pixelsX),
+                                                              dxAvx));
+
+            const __m256i x0Fixed = ToFixed16(x0Low, x0High);
+
+            __m256i x = x0Fixed;
+            __m256i y = y0Fixed;
+
+            // lanes that escaped or are known to be inside of the set stop counting for good,
+            // the escaped ones go on with garbage
+            __m256i isInterior = PackMasks16(IsInMainCardioidOrBulb(x0Low,  y0Avx),
+                                             IsInMainCardioidOrBulb(x0High, y0Avx));
+            __m256i isCounted  = _mm256_xor_si256(isInterior, _mm256_set1_epi32(-1));
+            __m256i isEscaped  = _mm256_setzero_si256();
+
+            // z of every lane at the check it escaped at
+            __m256i escapeX = _mm256_setzero_si256();
+            __m256i escapeY = _mm256_setzero_si256();
+
+            // a fixed point orbit inside of the set comes back to a point exactly in a few
+            // periods, Brent's cycle detection as in the avx2 kernel catches it
+            __m256i savedX = x;
+            __m256i savedY = y;
+            size_t  nextSaveIteration = 1;
+
+            __m256i numberOfIterations = _mm256_setzero_si256();
+
+            size_t iterationNumber = 0;
+            for (iterationNumber = 0; iterationNumber < maxNumberOfIterations; ++iterationNumber)
+            {
+                // saturated for |x| >= 2, then the square is at least 4 and the lane escapes.
+                // Absolute values saturate to 32767, -32768 * -32768 overflows in mulhrs.
+                const __m256i absX2 = _mm256_adds_epi16(_mm256_abs_epi16(x), _mm256_abs_epi16(x));
+                const __m256i absX4 = _mm256_adds_epi16(absX2, absX2);
+                const __m256i absY2 = _mm256_adds_epi16(_mm256_abs_epi16(y), _mm256_abs_epi16(y));
+                const __m256i absY4 = _mm256_adds_epi16(absY2, absY2);
+
+                // mulhrs gives a * b / 2^15 rounded, 4a * 2b / 2^15 is the product with the
+                // same fraction bits
+                const __m256i xSquare = _mm256_mulhrs_epi16(absX4, absX2);
+                const __m256i ySquare = _mm256_mulhrs_epi16(absY4, absY2);
+                const __m256i xMulY2  = _mm256_mulhrs_epi16(_mm256_sign_epi16(absX4, x),
+                                                            _mm256_sign_epi16(absY4, y));
+
+                const __m256i radiusSquare = _mm256_adds_epi16(xSquare, ySquare);
+
+                const __m256i isEscaping = _mm256_and_si256(_mm256_cmpgt_epi16(radiusSquare,
+                                                                               escapeSquare),
+                                                            isCounted);
+                if (!_mm256_testz_si256(isEscaping, isEscaping))
+                {
+                    escapeX   = _mm256_blendv_epi8(escapeX, x, isEscaping);
+                    escapeY   = _mm256_blendv_epi8(escapeY, y, isEscaping);
+                    isEscaped = _mm256_or_si256(isEscaped, isEscaping);
+                    isCounted = _mm256_andnot_si256(isEscaping, isCounted);
+                }
+
+                if (_mm256_testz_si256(isCounted, isCounted)) break;
+
+                numberOfIterations = _mm256_sub_epi16(numberOfIterations, isCounted);
+
+                x = _mm256_add_epi16(_mm256_sub_epi16(xSquare, ySquare), x0Fixed);
+                y = _mm256_add_epi16(xMulY2, y0Fixed);
+
+                const __m256i isBack = _mm256_and_si256(_mm256_cmpeq_epi16(x, savedX),
+                                                        _mm256_cmpeq_epi16(y, savedY));
+                const __m256i isPeriodic = _mm256_and_si256(isBack, isCounted);
+                isInterior = _mm256_or_si256(isInterior, isPeriodic);
+                isCounted  = _mm256_andnot_si256(isPeriodic, isCounted);
+
+                if (iterationNumber + 1 == nextSaveIteration)
+                {
+                    savedX = x;
+                    savedY = y;
+                    nextSaveIteration *= 2;
+                }
+            }
+
+            // the last check that broke the loop is executed too
+            tileStats.vectorIterations += iterationNumber +
+                                          (iterationNumber < maxNumberOfIterations);
+
+            if (!_mm256_testz_si256(isInterior, isInterior))
+            {
+                alignas(32) uint16_t skippedIterationsArray[16] = {};
+                _mm256_store_si256((__m256i*)skippedIterationsArray,
+                                   _mm256_and_si256(isInterior,
+                                                    _mm256_sub_epi16(maxNumberOfIterationsAvx,
+                                                                     numberOfIterations)));
+                for (size_t i = 0; i < 16; ++i)
+                    tileStats.skippedIterations += skippedIterationsArray[i];
+
+                numberOfIterations = _mm256_blendv_epi8(numberOfIterations,
+                                                        maxNumberOfIterationsAvx, isInterior);
+            }
+
+            if (!_mm256_testz_si256(isEscaped, isEscaped))
+            {
+                // int16 lanes 0-7 and 8-15 go to the two float halves
+                const __m256i low  = FinishEscape(ToFloat(_mm256_castsi256_si128(escapeX)),
+                                                  ToFloat(_mm256_castsi256_si128(escapeY)),
+                                                  x0Low, y0Avx,
+                                                  _mm256_castsi256_si128(numberOfIterations),
+                                                  _mm256_castsi256_si128(isEscaped),
+                                                  maxNumberOfIterations, &tileStats);
+                const __m256i high = FinishEscape(ToFloat(_mm256_extracti128_si256(escapeX, 1)),
+                                                  ToFloat(_mm256_extracti128_si256(escapeY, 1)),
+                                                  x0High, y0Avx,
+                                                  _mm256_extracti128_si256(numberOfIterations, 1),
+                                                  _mm256_extracti128_si256(isEscaped, 1),
+                                                  maxNumberOfIterations, &tileStats);
+
+                // packus keeps the 128 bit halves apart, the permute puts them in order
+                numberOfIterations = _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high),
+                                                              0xd8);
+            }
+
+            uint16_t* iterationsPos = iterations + pixelX + pixelY * view->width;
+
+            // last group in a row may stick out of the image
+            if (tile->xEnd - pixelX >= 16)
+            {
+                _mm256_storeu_si256((__m256i*)iterationsPos, numberOfIterations);
+            }
+            else
+            {
+                alignas(32) uint16_t numberOfIterationsArray[16] = {};
+                _mm256_store_si256((__m256i*)numberOfIterationsArray, numberOfIterations);
+
+                for (size_t i = 0; i < tile->xEnd - pixelX; ++i)
+                    iterationsPos[i] = numberOfIterationsArray[i];
+            }
+        }
+    }
+
+    stats->vectorIterations  += tileStats.vectorIterations;
+    stats->skippedIterations += tileStats.skippedIterations;
+}
+
+// Rounds two groups of 8 floats to the 16 int16 lanes, lanes 0-7 are low.
+static inline __m256i ToFixed16(const __m256 low, const __m256 high)
+{
+    const __m256 fixedOne = _mm256_set1_ps(FixedOne);
+
+    const __m256i lowFixed  = _mm256_cvtps_epi32(_mm256_mul_ps(low,  fixedOne));
+    const __m256i highFixed = _mm256_cvtps_epi32(_mm256_mul_ps(high, fixedOne));
+
+    // packs works in 128 bit halves, the permute puts the 64 bit quarters in order
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(lowFixed, highFixed), 0xd8);
+}
+
+static inline __m256i PackMasks16(const __m256 low, const __m256 high)
+{
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_castps_si256(low),
+                                                       _mm256_castps_si256(high)), 0xd8);
+}
+
+static inline __m256 ToFloat(const __m128i fixed)
+{
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(fixed)),
+                         _mm256_set1_ps(1.f / FixedOne));
+}
+
+// Iterates 8 escaped lanes in float from the z they escaped with until |z|^2 reaches 100,
+// like the float kernels, and adds the iterations to their counts. Gives the counts of all
+// 8 lanes as int32.
+static inline __m256i FinishEscape(__m256 x, __m256 y, const __m256 x0, const __m256 y0,
+                                   const __m128i numberOfIterations16,
+                                   const __m128i isEscaped16,
+                                   const size_t maxNumberOfIterations, MandelbrotStats* stats)
+{
+    assert(stats);
+
+    const __m256  maxRadiusSquare          = _mm256_set1_ps(100.f);
+    const __m256i maxNumberOfIterationsAvx = _mm256_set1_epi32((int)maxNumberOfIterations);
+
+    __m256i numberOfIterations = _mm256_cvtepu16_epi32(numberOfIterations16);
+    __m256i isCounted          = _mm256_cvtepi16_epi32(isEscaped16);
+    while (!_mm256_testz_si256(isCounted, isCounted))
+    {
+        const __m256 xSquare = _mm256_mul_ps(x, x);
+        const __m256 ySquare = _mm256_mul_ps(y, y);
+        const __m256 xMulY   = _mm256_mul_ps(x, y);
+
+        const __m256 radiusSquare = _mm256_add_ps(xSquare, ySquare);
+
+        isCounted = _mm256_and_si256(isCounted, _mm256_castps_si256(
+                                                    _mm256_cmp_ps(radiusSquare, maxRadiusSquare,
+                                                                  _CMP_LT_OQ)));
+        isCounted = _mm256_and_si256(isCounted, _mm256_cmpgt_epi32(maxNumberOfIterationsAvx,
+                                                                   numberOfIterations));
+
+        numberOfIterations = _mm256_sub_epi32(numberOfIterations, isCounted);
+
+        x = _mm256_add_ps(_mm256_sub_ps(xSquare, ySquare), x0);
+        y = _mm256_add_ps(_mm256_add_ps(xMulY  , xMulY),   y0);
+
+        stats->vectorIterations++;
+    }
+
+    return numberOfIterations;
+}
@@ -0,0 +1,248 @@
+#include <assert.h>
+#include <immintrin.h>
+
+#include "Avx2Iterations.h"
+#include "Mandelbrot.h"
+
+static const size_t NumberOfLanes = 8;
+
+// A group of 8 pixels of a tile that a chain takes when its previous group is done.
+struct InterleavedGroup
+{
+    __m256 x0;
+    __m256 y0;
+    size_t pixelX;
+    size_t pixelY;
+};
+
+static inline bool GetNextGroup(InterleavedGroup* group, const MandelbrotView* view,
+                                const MandelbrotTile* tile, size_t* nextGroup,
+                                const size_t numberOfGroupsX, const size_t numberOfGroups);
+static inline void WriteGroup  (uint16_t* iterations, const MandelbrotView* view,
+                                const MandelbrotTile* tile, const InterleavedGroup* group,
+                                const __m256i counts, const __m256 isInterior,
+                                uint64_t* skippedIterations);
+
+// The loop of the avx2 kernel for NumberOfChains groups at once: one iteration of a group is
+// a chain of dependent operations, the chains of the other groups fill the time the core
+// waits for their results. A chain that is done writes its group and takes the next one of the
+// tile, so the chains stay busy until the tile runs out of groups. x^2 - y^2 + x0 and
+// 2xy + y0 are fused into fmsub and fmadd, so the numbers of iterations may differ from the
+// kernels without FMA where the orbit is chaotic.
+template <size_t NumberOfChains>
+void CalculateMandelbrotTileAvx2Interleaved(uint16_t* iterations, const MandelbrotView* view,
+                                            const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    const __m256 maxRadiusSquare       = _mm256_set1_ps(100.f);
+    const size_t maxNumberOfIterations = view->maxNumberOfIterations;
+
+    uint64_t vectorIterations  = 0;
+    uint64_t skippedIterations = 0;
+
+    const size_t numberOfGroupsX = (tile->xEnd - tile->xBegin + NumberOfLanes - 1) /
+                                   NumberOfLanes;
+    const size_t numberOfGroups  = numberOfGroupsX * (tile->yEnd - tile->yBegin);
+    size_t       nextGroup       = 0;
+
+    // the arrays are indexed by constants only, so they stay in registers
+    InterleavedGroup groups           [NumberOfChains] = {};
+    bool             hasGroup         [NumberOfChains] = {};
+    __m256           x                [NumberOfChains] = {};
+    __m256           y                [NumberOfChains] = {};
+    __m256           savedX           [NumberOfChains] = {};
+    __m256           savedY           [NumberOfChains] = {};
+    __m256           isInterior       [NumberOfChains] = {};
+    __m256i          counts           [NumberOfChains] = {};
+    size_t           iterationNumber  [NumberOfChains] = {};
+    size_t           nextSaveIteration[NumberOfChains] = {};
+
+    __m256           isCounted        [NumberOfChains] = {};
+    bool             isDone           [NumberOfChains] = {};
+
+    // chains start done without a group
+    for (size_t chain = 0; chain < NumberOfChains; ++chain)
+        isDone[chain] = true;
+
+    size_t numberOfBusyChains = 0;
+    bool   isAnyDone          = true;
+    for (;;)
+    {
+        if (isAnyDone)
+        {
+            // a done chain writes its group and takes the next one, until it gets a group
+            // that is not done at once or the tile is over
+            #pragma GCC unroll 4
+            for (size_t chain = 0; chain < NumberOfChains; ++chain)
+            {
+                while (isDone[chain])
+                {
+                    if (hasGroup[chain])
+                    {
+                        WriteGroup(iterations, view, tile, &groups[chain], counts[chain],
+                                   isInterior[chain], &skippedIterations);
+                        numberOfBusyChains--;
+                    }
+
+                    hasGroup[chain] = GetNextGroup(&groups[chain], view, tile, &nextGroup,
+                                                   numberOfGroupsX, numberOfGroups);
+                    if (!hasGroup[chain])
+                    {
+                        // an idle chain iterates a point that is never counted
+                        x[chain]          = _mm256_setzero_ps();
+                        y[chain]          = _mm256_setzero_ps();
+                        isInterior[chain] = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                        isCounted[chain]  = _mm256_setzero_ps();
+                        isDone[chain]     = false;
+                        break;
+                    }
+
+                    numberOfBusyChains++;
+                    x[chain]                 = groups[chain].x0;
+                    y[chain]                 = groups[chain].y0;
+                    savedX[chain]            = groups[chain].x0;
+                    savedY[chain]            = groups[chain].y0;
+                    isInterior[chain]        = IsInMainCardioidOrBulb(groups[chain].x0,
+                                                                      groups[chain].y0);
+                    counts[chain]            = _mm256_setzero_si256();
+                    iterationNumber[chain]   = 0;
+                    nextSaveIteration[chain] = 1;
+
+                    const __m256 radiusSquare = _mm256_fmadd_ps(x[chain], x[chain],
+                                                                _mm256_mul_ps(y[chain], y[chain]));
+                    isCounted[chain] = _mm256_andnot_ps(isInterior[chain],
+                                                        _mm256_cmp_ps(radiusSquare,
+                                                                      maxRadiusSquare,
+                                                                      _CMP_LT_OQ));
+                    isDone[chain]    = !_mm256_movemask_ps(isCounted[chain]) ||
+                                       maxNumberOfIterations == 0;
+                    vectorIterations++;
+                }
+            }
+
+            if (numberOfBusyChains == 0)
+                break;
+        }
+
+        // an iteration of every chain, the busy ones are counted and checked for the next
+        isAnyDone = false;
+
+        #pragma GCC unroll 4
+        for (size_t chain = 0; chain < NumberOfChains; ++chain)
+        {
+            counts[chain] = _mm256_sub_epi32(counts[chain], _mm256_castps_si256(isCounted[chain]));
+
+            // x * x - (y * y - x0) and (x + x) * y + y0
+            const __m256 newX = _mm256_fmsub_ps(x[chain], x[chain],
+                                                _mm256_fmsub_ps(y[chain], y[chain],
+                                                                groups[chain].x0));
+            y[chain] = _mm256_fmadd_ps(_mm256_add_ps(x[chain], x[chain]), y[chain],
+                                       groups[chain].y0);
+            x[chain] = newX;
+
+            const __m256 isBack = _mm256_and_ps(_mm256_cmp_ps(x[chain], savedX[chain],
+                                                              _CMP_EQ_OQ),
+                                                _mm256_cmp_ps(y[chain], savedY[chain],
+                                                              _CMP_EQ_OQ));
+            isInterior[chain] = _mm256_or_ps(isInterior[chain],
+                                             _mm256_and_ps(isBack, isCounted[chain]));
+
+            if (++iterationNumber[chain] == nextSaveIteration[chain])
+            {
+                savedX[chain] = x[chain];
+                savedY[chain] = y[chain];
+                nextSaveIteration[chain] *= 2;
+            }
+
+            const __m256 radiusSquare = _mm256_fmadd_ps(x[chain], x[chain],
+                                                        _mm256_mul_ps(y[chain], y[chain]));
+            isCounted[chain] = _mm256_andnot_ps(isInterior[chain],
+                                                _mm256_cmp_ps(radiusSquare, maxRadiusSquare,
+                                                              _CMP_LT_OQ));
+            isDone[chain]    = hasGroup[chain] &&
+                               (!_mm256_movemask_ps(isCounted[chain]) ||
+                                iterationNumber[chain] == maxNumberOfIterations);
+            isAnyDone       |= isDone[chain];
+        }
+
+        vectorIterations += numberOfBusyChains;
+    }
+
+    stats->vectorIterations  += vectorIterations;
+    stats->skippedIterations += skippedIterations;
+}
+
+static inline bool GetNextGroup(InterleavedGroup* group, const MandelbrotView* view,
+                                const MandelbrotTile* tile, size_t* nextGroup,
+                                const size_t numberOfGroupsX, const size_t numberOfGroups)
+{
+    assert(group);
+    assert(nextGroup);
+
+    if (*nextGroup == numberOfGroups)
+        return false;
+
+    group->pixelX = tile->xBegin + *nextGroup % numberOfGroupsX * NumberOfLanes;
+    group->pixelY = tile->yBegin + *nextGroup / numberOfGroupsX;
+    (*nextGroup)++;
+
+    // coordinates are the ones of the avx2 kernel
+    const __m256i pixelsX = _mm256_add_epi32(_mm256_set1_epi32((int)group->pixelX),
+                                             _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+
+    group->x0 = _mm256_add_ps(_mm256_set1_ps(view->x0Begin),
+                              _mm256_mul_ps(_mm256_cvtepi32_ps(pixelsX),
+                                            _mm256_set1_ps(view->dx)));
+    group->y0 = _mm256_set1_ps(view->y0Begin + (float)group->pixelY * view->dy);
+
+    return true;
+}
+
+static inline void WriteGroup(uint16_t* iterations, const MandelbrotView* view,
+                              const MandelbrotTile* tile, const InterleavedGroup* group,
+                              const __m256i counts, const __m256 isInterior,
+                              uint64_t* skippedIterations)
+{
+    assert(group);
+    assert(skippedIterations);
+
+    const __m256i maxNumberOfIterations = _mm256_set1_epi32((int)view->maxNumberOfIterations);
+    const __m256i isInteriorMask        = _mm256_castps_si256(isInterior);
+
+    alignas(32) int skippedIterationsArray[NumberOfLanes] = {};
+    _mm256_store_si256((__m256i*)skippedIterationsArray,
+                       _mm256_and_si256(isInteriorMask,
+                                        _mm256_sub_epi32(maxNumberOfIterations, counts)));
+    for (size_t i = 0; i < NumberOfLanes; ++i)
+        *skippedIterations += (uint64_t)skippedIterationsArray[i];
+
+#if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+    alignas(32) int countsArray[NumberOfLanes] = {};
+    _mm256_store_si256((__m256i*)countsArray,
+                       _mm256_blendv_epi8(counts, maxNumberOfIterations, isInteriorMask));
+
+    const size_t numberOfPixels = tile->xEnd - group->pixelX < NumberOfLanes ?
+                                  tile->xEnd - group->pixelX : NumberOfLanes;
+
+    uint16_t* iterationsPos = iterations + group->pixelX + group->pixelY * view->width;
+    for (size_t i = 0; i < numberOfPixels; ++i)
+        iterationsPos[i] = (uint16_t)countsArray[i];
+#else
+    (void)iterations;
+    (void)tile;
+#endif
+}
+
+// interleave factors of the kernel table, see KernelDispatch.cpp
+template void CalculateMandelbrotTileAvx2Interleaved<1>(uint16_t*, const MandelbrotView*,
+                                                        const MandelbrotTile*, MandelbrotStats*);
+template void CalculateMandelbrotTileAvx2Interleaved<2>(uint16_t*, const MandelbrotView*,
+                                                        const MandelbrotTile*, MandelbrotStats*);
+template void CalculateMandelbrotTileAvx2Interleaved<3>(uint16_t*, const MandelbrotView*,
+                                                        const MandelbrotTile*, MandelbrotStats*);
+template void CalculateMandelbrotTileAvx2Interleaved<4>(uint16_t*, const MandelbrotView*,
+                                                        const MandelbrotTile*, MandelbrotStats*);
@@ -0,0 +1,164 @@
+#ifndef AVX2_ITERATIONS_H
+#define AVX2_ITERATIONS_H
+
+#include <assert.h>
+#include <immintrin.h>
+#include <math.h>
+
+#include "Mandelbrot.h"
+#include "Telemetry.h"
+
+// Iteration loop of the AVX2 kernels, needs -mavx2 -mfma.
+
+// Main cardioid: q * (q + (x - 1/4)) <= y^2 / 4, where q = (x - 1/4)^2 + y^2.
+// Period-2 bulb: (x + 1)^2 + y^2 <= 1/16.
+static inline __m256 IsInMainCardioidOrBulb(const __m256 x, const __m256 y)
+{
+    const __m256 quarter   = _mm256_set1_ps(0.25f);
+    const __m256 one       = _mm256_set1_ps(1.f);
+    const __m256 sixteenth = _mm256_set1_ps(1.f / 16);
+
+    __m256 ySquare = _mm256_mul_ps(y, y);
+
+    __m256 xShifted = _mm256_sub_ps(x, quarter);
+    __m256 q        = _mm256_add_ps(_mm256_mul_ps(xShifted, xShifted), ySquare);
+
+    __m256 isInCardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, xShifted)),
+                                        _mm256_mul_ps(ySquare, quarter), _CMP_LE_OQ);
+
+    __m256 xPlusOne = _mm256_add_ps(x, one);
+    __m256 isInBulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(xPlusOne, xPlusOne), ySquare),
+                                    sixteenth, _CMP_LE_OQ);
+
+    return _mm256_or_ps(isInCardioid, isInBulb);
+}
+
+// The same check for double lanes, mul + add are fused as in the double kernels.
+static inline __m256d IsInMainCardioidOrBulb(const __m256d x, const __m256d y)
+{
+    const __m256d quarter   = _mm256_set1_pd(0.25);
+    const __m256d one       = _mm256_set1_pd(1.);
+    const __m256d sixteenth = _mm256_set1_pd(1. / 16);
+
+    __m256d ySquare = _mm256_mul_pd(y, y);
+
+    __m256d xShifted = _mm256_sub_pd(x, quarter);
+    __m256d q        = _mm256_fmadd_pd(xShifted, xShifted, ySquare);
+
+    __m256d isInCardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xShifted)),
+                                         _mm256_mul_pd(ySquare, quarter), _CMP_LE_OQ);
+
+    __m256d xPlusOne = _mm256_add_pd(x, one);
+    __m256d isInBulb = _mm256_cmp_pd(_mm256_fmadd_pd(xPlusOne, xPlusOne, ySquare),
+                                     sixteenth, _CMP_LE_OQ);
+
+    return _mm256_or_pd(isInCardioid, isInBulb);
+}
+
+// Iterates 8 points until each of them escapes, turns out to be inside the set or reaches
+// maxNumberOfIterations, gives the number of iterations of every lane. outRadiusSquare gets
+// |z|^2 of every lane at the check it escaped at, for smooth coloring.
+static inline __m256i CalculateIterationsAvx2(const __m256 x0, const __m256 y0,
+                                              const size_t maxNumberOfIterations,
+                                              MandelbrotStats* stats, __m256* outRadiusSquare)
+{
+    assert(outRadiusSquare);
+
+    const __m256  maxRadiusSquare          = _mm256_set1_ps(100.f);
+    const __m256i maxNumberOfIterationsAvx = _mm256_set1_epi32((int)maxNumberOfIterations);
+
+    __m256i numberOfIterations = _mm256_setzero_si256();
+
+    __m256 x = x0;
+    __m256 y = y0;
+
+    // lanes known to be inside the set are not iterated anymore, in the end they
+    // get maxNumberOfIterations
+    __m256 isInterior = IsInMainCardioidOrBulb(x0, y0);
+
+    // Brent's cycle detection: the orbit is saved at iterations 1, 2, 4, 8...
+    // and a lane that comes back to the saved point exactly will never escape
+    __m256 savedX = x;
+    __m256 savedY = y;
+    size_t nextSaveIteration = 1;
+
+    // |z|^2 only grows after it gets over 100 (for |c| < 90), so the radius a lane escaped with
+    // is the least one over 100 it had, no branch on the mask at every escape. Smaller ones are
+    // made NaN by the mask of the check, min gives the second operand for NaN, so they and
+    // lanes that got to inf - inf are not taken.
+    __m256 escapeRadiusSquare = _mm256_set1_ps(INFINITY);
+
+    size_t iterationNumber = 0;
+    for (iterationNumber = 0; iterationNumber < maxNumberOfIterations; ++iterationNumber)
+    {
+        __m256 xSquare = _mm256_mul_ps(x, x);
+        __m256 ySquare = _mm256_mul_ps(y, y);
+        __m256 xMulY   = _mm256_mul_ps(x, y);
+
+        __m256 radiusSquare = _mm256_add_ps(xSquare, ySquare);
+
+        __m256 cmpRadius = _mm256_cmp_ps(radiusSquare, maxRadiusSquare, _CMP_LT_OQ);
+        __m256 isCounted = _mm256_andnot_ps(isInterior, cmpRadius);
+        int mask = _mm256_movemask_ps(isCounted);
+
+        escapeRadiusSquare = _mm256_min_ps(_mm256_or_ps(radiusSquare, cmpRadius),
+                                           escapeRadiusSquare);
+
+        TelemetryAddStep(iterationNumber, mask);
+
+        if (!mask) break;
+
+        // calculating number of iterations per each dx shift
+        numberOfIterations = _mm256_sub_epi32(numberOfIterations,
+                                              _mm256_castps_si256(isCounted));
+
+        x = _mm256_add_ps(_mm256_sub_ps(xSquare, ySquare), x0);
+        y = _mm256_add_ps(_mm256_add_ps(xMulY  , xMulY),   y0);
+
+        // only lanes that are still inside, escaped ones may sit at the saved infinity
+        __m256 isBack     = _mm256_and_ps(_mm256_cmp_ps(x, savedX, _CMP_EQ_OQ),
+                                          _mm256_cmp_ps(y, savedY, _CMP_EQ_OQ));
+        __m256 isPeriodic = _mm256_and_ps(isBack, isCounted);
+        isInterior = _mm256_or_ps(isInterior, isPeriodic);
+
+        if (iterationNumber + 1 == nextSaveIteration)
+        {
+            savedX = x;
+            savedY = y;
+            nextSaveIteration *= 2;
+        }
+    }
+
+    if (_mm256_movemask_ps(isInterior))
+    {
+        __m256i isInteriorInt = _mm256_castps_si256(isInterior);
+
+        alignas(32) int skippedIterationsArray[8] = {};
+        _mm256_store_si256((__m256i*)skippedIterationsArray,
+                           _mm256_and_si256(isInteriorInt,
+                                            _mm256_sub_epi32(maxNumberOfIterationsAvx,
+                                                             numberOfIterations)));
+        for (size_t i = 0; i < 8; ++i)
+            stats->skippedIterations += (uint64_t)skippedIterationsArray[i];
+
+        numberOfIterations = _mm256_blendv_epi8(numberOfIterations,
+                                                maxNumberOfIterationsAvx, isInteriorInt);
+    }
+
+    // the last check that broke the loop is executed too
+    stats->vectorIterations += iterationNumber + (iterationNumber < maxNumberOfIterations);
+
+    *outRadiusSquare = escapeRadiusSquare;
+    return numberOfIterations;
+}
+
+// The radius is not kept, the compiler drops its min.
+static inline __m256i CalculateIterationsAvx2(const __m256 x0, const __m256 y0,
+                                              const size_t maxNumberOfIterations,
+                                              MandelbrotStats* stats)
+{
+    __m256 radiusSquare = _mm256_setzero_ps();
+    return CalculateIterationsAvx2(x0, y0, maxNumberOfIterations, stats, &radiusSquare);
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include <assert.h>
+#include <immintrin.h>
+
+#include "Avx2Iterations.h"
+#include "Mandelbrot.h"
+#include "Telemetry.h"
+
+void CalculateMandelbrotTileAvx2(uint16_t* iterations, const MandelbrotView* view,
+                                 const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    const size_t maxNumberOfIterations = view->maxNumberOfIterations;
+
+    // counters stay in registers, stats may be aliased by the iterations
+    MandelbrotStats tileStats = {};
+
+    // every coordinate is calculated from the frame origin as x0Begin + pixelX * dx,
+    // so all kernels and tilings give the same picture
+    const __m256i laneNumbers = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256  x0BeginAvx  = _mm256_set1_ps(view->x0Begin);
+    const __m256  dxAvx       = _mm256_set1_ps(view->dx);
+
+    for (size_t pixelY = tile->yBegin; pixelY < tile->yEnd; ++pixelY)
+    {
+        __m256 y0Avx = _mm256_set1_ps(view->y0Begin + (float)pixelY * view->dy);
+
+        for (size_t pixelX = tile->xBegin; pixelX < tile->xEnd; pixelX += 8)
+        {
+            __m256i pixelsX = _mm256_add_epi32(_mm256_set1_epi32((int)pixelX), laneNumbers);
+            __m256  x0Avx   = _mm256_add_ps(x0BeginAvx,
+                                            _mm256_mul_ps(_mm256_cvtepi32_ps(pixelsX), dxAvx));
+
+        #ifdef MANDELBROT_TELEMETRY
+            const MandelbrotStats groupStart = tileStats;
+        #endif
+
+            __m256i numberOfIterations = CalculateIterationsAvx2(x0Avx, y0Avx,
+                                                                 maxNumberOfIterations,
+                                                                 &tileStats);
+
+        #ifdef MANDELBROT_TELEMETRY
+            alignas(32) int32_t counts[8] = {};
+            _mm256_store_si256((__m256i*)counts, numberOfIterations);
+            TelemetryAddGroup(pixelX, pixelY, counts, tile->xEnd - pixelX < 8 ?
+                                                      tile->xEnd - pixelX : 8, 8,
+                              tileStats.vectorIterations  - groupStart.vectorIterations,
+                              tileStats.skippedIterations - groupStart.skippedIterations);
+        #endif
+
+        #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+            // counts are not above UINT16_MAX, so saturation doesn't change them
+            __m128i numberOfIterations16 = _mm_packus_epi32(
+                                               _mm256_castsi256_si128(numberOfIterations),
+                                               _mm256_extracti128_si256(numberOfIterations, 1));
+
+            uint16_t* iterationsPos = iterations + pixelX + pixelY * view->width;
+
+            // last group in a row may stick out of the image
+            if (tile->xEnd - pixelX >= 8)
+            {
+                _mm_storeu_si128((__m128i*)iterationsPos, numberOfIterations16);
+            }
+            else
+            {
+                alignas(16) uint16_t numberOfIterationsArray[8] = {};
+                _mm_store_si128((__m128i*)numberOfIterationsArray, numberOfIterations16);
+
+                for (size_t i = 0; i < tile->xEnd - pixelX; ++i)
+                    iterationsPos[i] = numberOfIterationsArray[i];
+            }
+        #else
+            (void)numberOfIterations;
+        #endif
+        }
+    }
+
+    stats->vectorIterations  += tileStats.vectorIterations;
+    stats->skippedIterations += tileStats.skippedIterations;
+}
@@ -0,0 +1,245 @@
+#include <assert.h>
+#include <immintrin.h>
+
+#include "Mandelbrot.h"
+
+static const size_t NumberOfLanes   = 8;
+static const int    AllLanesMask    = 0xFF;
+
+// Spilling and reloading the registers is not free, so finished lanes wait
+// until there are this many of them.
+static const size_t RefillThreshold = 4;
+
+// Lanes live in ymm registers while they iterate and are spilled to these arrays only
+// when finished ones have to be written out and reloaded.
+struct RecyclingLanes
+{
+    alignas(32) float x0[NumberOfLanes];
+    alignas(32) float y0[NumberOfLanes];
+    alignas(32) float x [NumberOfLanes];
+    alignas(32) float y [NumberOfLanes];
+
+    // orbit points for cycle detection, see Avx2Iterations.h
+    alignas(32) float savedX[NumberOfLanes];
+    alignas(32) float savedY[NumberOfLanes];
+
+    alignas(32) int   numberOfIterations[NumberOfLanes];
+    alignas(32) int   isActive          [NumberOfLanes];
+
+    bool              hasPixel          [NumberOfLanes];
+    size_t            pixelIndex        [NumberOfLanes];
+};
+
+// Pixels of the tile that are not taken by the lanes yet.
+struct RecyclingQueue
+{
+    uint16_t*             iterations;
+    const MandelbrotView* view;
+    const MandelbrotTile* tile;
+
+    size_t                numberOfPixels;
+    size_t                nextPixel;
+
+    uint64_t              skippedIterations;
+};
+
+static void LoadNextPixel         (RecyclingLanes* lanes, const size_t lane,
+                                   RecyclingQueue* queue);
+static bool IsInMainCardioidOrBulb(const float x, const float y);
+
+void CalculateMandelbrotTileAvx2Recycling(uint16_t* iterations, const MandelbrotView* view,
+                                          const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    const __m256  maxRadiusSquare       = _mm256_set1_ps(100.f);
+    const size_t  maxNumberOfIterations = view->maxNumberOfIterations;
+    const __m256i maxNumberOfIterationsAvx = _mm256_set1_epi32((int)maxNumberOfIterations);
+    const __m256i ones                  = _mm256_set1_epi32(1);
+
+    uint64_t vectorIterations = 0;
+
+    RecyclingQueue queue = {};
+    queue.iterations     = iterations;
+    queue.view           = view;
+    queue.tile           = tile;
+    queue.numberOfPixels = (tile->xEnd - tile->xBegin) * (tile->yEnd - tile->yBegin);
+
+    RecyclingLanes lanes = {};
+    for (size_t lane = 0; lane < NumberOfLanes; ++lane)
+        LoadNextPixel(&lanes, lane, &queue);
+
+    __m256  x0       = _mm256_load_ps(lanes.x0);
+    __m256  y0       = _mm256_load_ps(lanes.y0);
+    __m256  x        = _mm256_load_ps(lanes.x);
+    __m256  y        = _mm256_load_ps(lanes.y);
+    __m256  savedX   = _mm256_load_ps(lanes.savedX);
+    __m256  savedY   = _mm256_load_ps(lanes.savedY);
+    __m256i numberOfIterations = _mm256_load_si256((const __m256i*)lanes.numberOfIterations);
+    __m256  isActive = _mm256_castsi256_ps(_mm256_load_si256((const __m256i*)lanes.isActive));
+
+    int activeMask = _mm256_movemask_ps(isActive);
+
+    while (activeMask)
+    {
+        __m256 xSquare = _mm256_mul_ps(x, x);
+        __m256 ySquare = _mm256_mul_ps(y, y);
+        __m256 xMulY   = _mm256_mul_ps(x, y);
+
+        __m256 radiusSquare = _mm256_add_ps(xSquare, ySquare);
+
+        // finished and idle lanes keep iterating, they must not be counted
+        __m256 cmpRadius = _mm256_cmp_ps(radiusSquare, maxRadiusSquare, _CMP_LT_OQ);
+        __m256 isCounted = _mm256_and_ps(cmpRadius, isActive);
+
+        numberOfIterations = _mm256_sub_epi32(numberOfIterations,
+                                              _mm256_castps_si256(isCounted));
+
+        x = _mm256_add_ps(_mm256_sub_ps(xSquare, ySquare), x0);
+        y = _mm256_add_ps(_mm256_add_ps(xMulY  , xMulY),   y0);
+
+        vectorIterations++;
+
+        __m256 isBack     = _mm256_and_ps(_mm256_cmp_ps(x, savedX, _CMP_EQ_OQ),
+                                          _mm256_cmp_ps(y, savedY, _CMP_EQ_OQ));
+        __m256 isPeriodic = _mm256_and_ps(isBack, isCounted);
+
+        if (_mm256_movemask_ps(isPeriodic))
+        {
+            __m256i isPeriodicInt = _mm256_castps_si256(isPeriodic);
+
+            alignas(32) int skippedIterationsArray[NumberOfLanes] = {};
+            _mm256_store_si256((__m256i*)skippedIterationsArray,
+                               _mm256_and_si256(isPeriodicInt,
+                                                _mm256_sub_epi32(maxNumberOfIterationsAvx,
+                                                                 numberOfIterations)));
+            for (size_t i = 0; i < NumberOfLanes; ++i)
+                queue.skippedIterations += (uint64_t)skippedIterationsArray[i];
+
+            // they are finished below together with the ones that reached the maximum
+            numberOfIterations = _mm256_blendv_epi8(numberOfIterations,
+                                                    maxNumberOfIterationsAvx, isPeriodicInt);
+        }
+
+        // lanes start at different times, so each one saves its orbit when its own
+        // number of iterations is a power of two
+        __m256i iterationsMinusOne = _mm256_sub_epi32(numberOfIterations, ones);
+        __m256i isPowerOfTwo = _mm256_cmpeq_epi32(_mm256_and_si256(numberOfIterations,
+                                                                   iterationsMinusOne),
+                                                  _mm256_setzero_si256());
+        __m256  isSavePoint  = _mm256_and_ps(_mm256_castsi256_ps(isPowerOfTwo), isCounted);
+
+        savedX = _mm256_blendv_ps(savedX, x, isSavePoint);
+        savedY = _mm256_blendv_ps(savedY, y, isSavePoint);
+
+        __m256 hasReachedMax = _mm256_castsi256_ps(_mm256_cmpeq_epi32(numberOfIterations,
+                                                                      maxNumberOfIterationsAvx));
+        isActive   = _mm256_andnot_ps(hasReachedMax, isCounted);
+        activeMask = _mm256_movemask_ps(isActive);
+
+        const int freeMask = ~activeMask & AllLanesMask;
+        if (activeMask && ((size_t)__builtin_popcount((unsigned)freeMask) < RefillThreshold ||
+                           queue.nextPixel >= queue.numberOfPixels))
+            continue;
+
+        _mm256_store_ps(lanes.x0, x0);
+        _mm256_store_ps(lanes.y0, y0);
+        _mm256_store_ps(lanes.x,  x);
+        _mm256_store_ps(lanes.y,  y);
+        _mm256_store_ps(lanes.savedX, savedX);
+        _mm256_store_ps(lanes.savedY, savedY);
+        _mm256_store_si256((__m256i*)lanes.numberOfIterations, numberOfIterations);
+        _mm256_store_si256((__m256i*)lanes.isActive, _mm256_castps_si256(isActive));
+
+        for (size_t lane = 0; lane < NumberOfLanes; ++lane)
+        {
+            if (!(freeMask & (1 << lane))) continue;
+
+            if (lanes.hasPixel[lane])
+                iterations[lanes.pixelIndex[lane]] = (uint16_t)lanes.numberOfIterations[lane];
+
+            LoadNextPixel(&lanes, lane, &queue);
+        }
+
+        x0       = _mm256_load_ps(lanes.x0);
+        y0       = _mm256_load_ps(lanes.y0);
+        x        = _mm256_load_ps(lanes.x);
+        y        = _mm256_load_ps(lanes.y);
+        savedX   = _mm256_load_ps(lanes.savedX);
+        savedY   = _mm256_load_ps(lanes.savedY);
+        numberOfIterations = _mm256_load_si256((const __m256i*)lanes.numberOfIterations);
+        isActive = _mm256_castsi256_ps(_mm256_load_si256((const __m256i*)lanes.isActive));
+
+        activeMask = _mm256_movemask_ps(isActive);
+    }
+
+    stats->vectorIterations  += vectorIterations;
+    stats->skippedIterations += queue.skippedIterations;
+}
+
+// Puts the next pixel of the tile (row by row) into the lane, or makes the lane idle
+// if there are no pixels left. Pixels inside the main cardioid or the bulb are written
+// right away and never take a lane.
+static void LoadNextPixel(RecyclingLanes* lanes, const size_t lane, RecyclingQueue* queue)
+{
+    assert(lanes);
+    assert(queue);
+
+    const MandelbrotView* view = queue->view;
+    const MandelbrotTile* tile = queue->tile;
+
+    const size_t tileWidth = tile->xEnd - tile->xBegin;
+
+    lanes->numberOfIterations[lane] = 0;
+
+    while (queue->nextPixel < queue->numberOfPixels)
+    {
+        const size_t pixelX = tile->xBegin + queue->nextPixel % tileWidth;
+        const size_t pixelY = tile->yBegin + queue->nextPixel / tileWidth;
+        queue->nextPixel++;
+
+        // same coordinates as in the other kernels, so the picture is the same
+        const float x0 = view->x0Begin + (float)pixelX * view->dx;
+        const float y0 = view->y0Begin + (float)pixelY * view->dy;
+
+        const size_t pixelIndex = pixelX + pixelY * view->width;
+
+        if (IsInMainCardioidOrBulb(x0, y0))
+        {
+            queue->iterations[pixelIndex] = (uint16_t)view->maxNumberOfIterations;
+            queue->skippedIterations += view->maxNumberOfIterations;
+            continue;
+        }
+
+        lanes->x0[lane] = lanes->x[lane] = lanes->savedX[lane] = x0;
+        lanes->y0[lane] = lanes->y[lane] = lanes->savedY[lane] = y0;
+
+        lanes->isActive[lane] = -1;
+        lanes->hasPixel[lane] = true;
+        lanes->pixelIndex[lane] = pixelIndex;
+        return;
+    }
+
+    lanes->x0[lane] = lanes->y0[lane] = lanes->x[lane] = lanes->y[lane] = 0;
+    lanes->savedX[lane] = lanes->savedY[lane] = 0;
+    lanes->isActive[lane] = 0;
+    lanes->hasPixel[lane] = false;
+}
+
+// Scalar version of the check in Avx2Iterations.h, the operations are the same so
+// the result is too.
+static bool IsInMainCardioidOrBulb(const float x, const float y)
+{
+    const float ySquare  = y * y;
+
+    const float xShifted = x - 0.25f;
+    const float q        = xShifted * xShifted + ySquare;
+
+    const float xPlusOne = x + 1.f;
+
+    return q * (q + xShifted) <= ySquare * 0.25f ||
+           xPlusOne * xPlusOne + ySquare <= 1.f / 16;
+}
@@ -0,0 +1,304 @@
+#include <assert.h>
+#include <immintrin.h>
+
+#include "Avx2Iterations.h"
+#include "Mandelbrot.h"
+
+// Operations of the unrolled kernel on 8 float lanes. They are the ones of the avx2 kernel in
+// the same order, so the counts are the same.
+struct Avx2FloatLanes
+{
+    typedef __m256 Value;
+
+    static const size_t NumberOfLanes = 8;
+
+    static inline Value GetX0(const MandelbrotView* view, const size_t pixelX)
+    {
+        const __m256i pixelsX = _mm256_add_epi32(_mm256_set1_epi32((int)pixelX),
+                                                 _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+
+        return _mm256_add_ps(_mm256_set1_ps(view->x0Begin),
+                             _mm256_mul_ps(_mm256_cvtepi32_ps(pixelsX), _mm256_set1_ps(view->dx)));
+    }
+
+    static inline Value GetY0(const MandelbrotView* view, const size_t pixelY)
+    {
+        return _mm256_set1_ps(view->y0Begin + (float)pixelY * view->dy);
+    }
+
+    static inline void Iterate(Value* x, Value* y, const Value x0, const Value y0)
+    {
+        const Value xSquare = _mm256_mul_ps(*x, *x);
+        const Value ySquare = _mm256_mul_ps(*y, *y);
+        const Value xMulY   = _mm256_mul_ps(*x, *y);
+
+        *x = _mm256_add_ps(_mm256_sub_ps(xSquare, ySquare), x0);
+        *y = _mm256_add_ps(_mm256_add_ps(xMulY,   xMulY),   y0);
+    }
+
+    static inline Value IsInside(const Value x, const Value y, const Value radiusSquare)
+    {
+        const Value pointRadiusSquare = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+        return _mm256_cmp_ps(pointRadiusSquare, radiusSquare, _CMP_LT_OQ);
+    }
+
+    static inline Value IsSame(const Value x, const Value y, const Value otherX, const Value otherY)
+    {
+        return _mm256_and_ps(_mm256_cmp_ps(x, otherX, _CMP_EQ_OQ),
+                             _mm256_cmp_ps(y, otherY, _CMP_EQ_OQ));
+    }
+
+    static inline Value Set1       (const double value)       { return _mm256_set1_ps((float)value); }
+    static inline Value And        (const Value a, const Value b) { return _mm256_and_ps(a, b);    }
+    static inline Value AndNot     (const Value a, const Value b) { return _mm256_andnot_ps(a, b); }
+    static inline Value Or         (const Value a, const Value b) { return _mm256_or_ps(a, b);     }
+    static inline int   GetMask    (const Value mask)             { return _mm256_movemask_ps(mask); }
+
+    static inline Value IsInterior (const Value x0, const Value y0)
+    {
+        return IsInMainCardioidOrBulb(x0, y0);
+    }
+
+    // counts are 32 bit integers in the lanes
+    static inline __m256i AddToCounts(const __m256i counts, const Value mask, const size_t number)
+    {
+        return _mm256_add_epi32(counts, _mm256_and_si256(_mm256_castps_si256(mask),
+                                                         _mm256_set1_epi32((int)number)));
+    }
+
+    static inline void GetCounts(uint64_t* outCounts, const __m256i counts)
+    {
+        alignas(32) int countsArray[NumberOfLanes] = {};
+        _mm256_store_si256((__m256i*)countsArray, counts);
+
+        for (size_t i = 0; i < NumberOfLanes; ++i)
+            outCounts[i] = (uint64_t)countsArray[i];
+    }
+};
+
+// 4 double lanes with the fused operations of the avx2-double kernel.
+struct Avx2DoubleLanes
+{
+    typedef __m256d Value;
+
+    static const size_t NumberOfLanes = 4;
+
+    static inline Value GetX0(const MandelbrotView* view, const size_t pixelX)
+    {
+        const Value pixelsX = _mm256_add_pd(_mm256_set1_pd((double)pixelX),
+                                            _mm256_set_pd(3, 2, 1, 0));
+
+        return _mm256_fmadd_pd(pixelsX, _mm256_set1_pd(view->dxDouble),
+                               _mm256_set1_pd(view->x0BeginDouble));
+    }
+
+    static inline Value GetY0(const MandelbrotView* view, const size_t pixelY)
+    {
+        return _mm256_set1_pd(view->y0BeginDouble + (double)pixelY * view->dyDouble);
+    }
+
+    static inline void Iterate(Value* x, Value* y, const Value x0, const Value y0)
+    {
+        const Value ySquare = _mm256_mul_pd(*y, *y);
+        const Value newX    = _mm256_fmadd_pd(*x, *x, _mm256_sub_pd(x0, ySquare));
+
+        *y = _mm256_fmadd_pd(_mm256_add_pd(*x, *x), *y, y0);
+        *x = newX;
+    }
+
+    static inline Value IsInside(const Value x, const Value y, const Value radiusSquare)
+    {
+        const Value pointRadiusSquare = _mm256_fmadd_pd(x, x, _mm256_mul_pd(y, y));
+        return _mm256_cmp_pd(pointRadiusSquare, radiusSquare, _CMP_LT_OQ);
+    }
+
+    static inline Value IsSame(const Value x, const Value y, const Value otherX, const Value otherY)
+    {
+        return _mm256_and_pd(_mm256_cmp_pd(x, otherX, _CMP_EQ_OQ),
+                             _mm256_cmp_pd(y, otherY, _CMP_EQ_OQ));
+    }
+
+    static inline Value Set1       (const double value)       { return _mm256_set1_pd(value);   }
+    static inline Value And        (const Value a, const Value b) { return _mm256_and_pd(a, b);    }
+    static inline Value AndNot     (const Value a, const Value b) { return _mm256_andnot_pd(a, b); }
+    static inline Value Or         (const Value a, const Value b) { return _mm256_or_pd(a, b);     }
+    static inline int   GetMask    (const Value mask)             { return _mm256_movemask_pd(mask); }
+
+    static inline Value IsInterior (const Value x0, const Value y0)
+    {
+        return IsInMainCardioidOrBulb(x0, y0);
+    }
+
+    // counts are 64 bit integers in the lanes
+    static inline __m256i AddToCounts(const __m256i counts, const Value mask, const size_t number)
+    {
+        return _mm256_add_epi64(counts, _mm256_and_si256(_mm256_castpd_si256(mask),
+                                                         _mm256_set1_epi64x((long long)number)));
+    }
+
+    static inline void GetCounts(uint64_t* outCounts, const __m256i counts)
+    {
+        _mm256_storeu_si256((__m256i*)outCounts, counts);
+    }
+};
+
+// CheckInterval iterations go without looking at the radius, the loop over them has a
+// constant number of steps and is unrolled. Every lane that was inside at the start of the
+// group and is inside at its end was inside all the time: with the radius at least 2 a point
+// that is outside only moves farther away. Otherwise the group is repeated from its start
+// one iteration at a time with the checks, that is the rollback. Cycles are looked for at
+// the ends of the groups only.
+template <typename Lanes, size_t CheckInterval, size_t MaxNumberOfIterations, size_t RadiusSquare>
+void CalculateMandelbrotTileUnrolled(uint16_t* iterations, const MandelbrotView* view,
+                                     const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    static_assert(CheckInterval > 0, "The escape has to be checked");
+    static_assert(RadiusSquare >= 4, "Points inside the radius 2 may come back");
+
+    typedef typename Lanes::Value Value;
+    static const size_t NumberOfLanes = Lanes::NumberOfLanes;
+
+    assert(iterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    // the variant of this cap is only for the views with it
+    if (MaxNumberOfIterations != 0 && view->maxNumberOfIterations != MaxNumberOfIterations)
+    {
+        CalculateMandelbrotTileUnrolled<Lanes, CheckInterval, 0, RadiusSquare>(iterations, view,
+                                                                               tile, stats);
+        return;
+    }
+
+    const size_t maxNumberOfIterations = MaxNumberOfIterations != 0 ? MaxNumberOfIterations :
+                                         view->maxNumberOfIterations;
+
+    const Value maxRadiusSquare = Lanes::Set1((double)RadiusSquare);
+
+    uint64_t vectorIterations  = 0;
+    uint64_t skippedIterations = 0;
+
+    for (size_t pixelY = tile->yBegin; pixelY < tile->yEnd; ++pixelY)
+    {
+        const Value y0 = Lanes::GetY0(view, pixelY);
+
+        for (size_t pixelX = tile->xBegin; pixelX < tile->xEnd; pixelX += NumberOfLanes)
+        {
+            const Value x0 = Lanes::GetX0(view, pixelX);
+
+            Value x = x0;
+            Value y = y0;
+
+            // lanes that are inside the radius and not known to be in the set, the number of
+            // iterations of every one of them is counted up
+            Value   isInterior = Lanes::IsInterior(x0, y0);
+            Value   isCounted  = Lanes::AndNot(isInterior, Lanes::IsInside(x, y, maxRadiusSquare));
+            __m256i counts     = _mm256_setzero_si256();
+
+            Value  savedX            = x;
+            Value  savedY            = y;
+            size_t nextSaveIteration = CheckInterval;
+
+            size_t iterationNumber = 0;
+            while (Lanes::GetMask(isCounted) &&
+                   iterationNumber + CheckInterval <= maxNumberOfIterations)
+            {
+                const Value groupX = x;
+                const Value groupY = y;
+
+                for (size_t i = 0; i < CheckInterval; ++i)
+                    Lanes::Iterate(&x, &y, x0, y0);
+
+                const Value isStillCounted = Lanes::And(isCounted,
+                                                        Lanes::IsInside(x, y, maxRadiusSquare));
+
+                if (Lanes::GetMask(isStillCounted) == Lanes::GetMask(isCounted))
+                    counts = Lanes::AddToCounts(counts, isCounted, CheckInterval);
+                else
+                {
+                    x = groupX;
+                    y = groupY;
+
+                    for (size_t i = 0; i < CheckInterval; ++i)
+                    {
+                        Lanes::Iterate(&x, &y, x0, y0);
+
+                        counts    = Lanes::AddToCounts(counts, isCounted, 1);
+                        isCounted = Lanes::And(isCounted, Lanes::IsInside(x, y, maxRadiusSquare));
+                    }
+
+                    vectorIterations += CheckInterval;
+                }
+
+                vectorIterations += CheckInterval;
+                iterationNumber  += CheckInterval;
+
+                const Value isPeriodic = Lanes::And(isCounted,
+                                                    Lanes::IsSame(x, y, savedX, savedY));
+                isInterior = Lanes::Or    (isInterior, isPeriodic);
+                isCounted  = Lanes::AndNot(isPeriodic, isCounted);
+
+                if (iterationNumber == nextSaveIteration)
+                {
+                    savedX = x;
+                    savedY = y;
+                    nextSaveIteration *= 2;
+                }
+            }
+
+            // the rest of the cap that is less than a group
+            for (; Lanes::GetMask(isCounted) && iterationNumber < maxNumberOfIterations;
+                 ++iterationNumber)
+            {
+                Lanes::Iterate(&x, &y, x0, y0);
+
+                counts    = Lanes::AddToCounts(counts, isCounted, 1);
+                isCounted = Lanes::And(isCounted, Lanes::IsInside(x, y, maxRadiusSquare));
+
+                vectorIterations++;
+            }
+
+            uint64_t countsArray[NumberOfLanes] = {};
+            Lanes::GetCounts(countsArray, counts);
+
+            const int interiorMask = Lanes::GetMask(isInterior);
+            for (size_t i = 0; i < NumberOfLanes; ++i)
+            {
+                if (interiorMask & (1 << i))
+                {
+                    skippedIterations += maxNumberOfIterations - countsArray[i];
+                    countsArray[i]     = maxNumberOfIterations;
+                }
+            }
+
+        #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+            const size_t numberOfPixels = tile->xEnd - pixelX < NumberOfLanes ?
+                                          tile->xEnd - pixelX : NumberOfLanes;
+
+            uint16_t* iterationsPos = iterations + pixelX + pixelY * view->width;
+            for (size_t i = 0; i < numberOfPixels; ++i)
+                iterationsPos[i] = (uint16_t)countsArray[i];
+        #endif
+        }
+    }
+
+    stats->vectorIterations  += vectorIterations;
+    stats->skippedIterations += skippedIterations;
+}
+
+// variants of the kernel table, see KernelDispatch.cpp
+template void CalculateMandelbrotTileUnrolled<Avx2FloatLanes,  2,  0,   100>(
+    uint16_t*, const MandelbrotView*, const MandelbrotTile*, MandelbrotStats*);
+template void CalculateMandelbrotTileUnrolled<Avx2FloatLanes,  4,  0,   100>(
+    uint16_t*, const MandelbrotView*, const MandelbrotTile*, MandelbrotStats*);
+template void CalculateMandelbrotTileUnrolled<Avx2FloatLanes,  8,  0,   100>(
+    uint16_t*, const MandelbrotView*, const MandelbrotTile*, MandelbrotStats*);
+template void CalculateMandelbrotTileUnrolled<Avx2FloatLanes,  16, 0,   100>(
+    uint16_t*, const MandelbrotView*, const MandelbrotTile*, MandelbrotStats*);
+template void CalculateMandelbrotTileUnrolled<Avx2FloatLanes,  8,  256, 100>(
+    uint16_t*, const MandelbrotView*, const MandelbrotTile*, MandelbrotStats*);
+template void CalculateMandelbrotTileUnrolled<Avx2FloatLanes,  8,  0,   4>(
+    uint16_t*, const MandelbrotView*, const MandelbrotTile*, MandelbrotStats*);
+template void CalculateMandelbrotTileUnrolled<Avx2DoubleLanes, 4,  0,   100>(
+    uint16_t*, const MandelbrotView*, const MandelbrotTile*, MandelbrotStats*);
@@ -0,0 +1,143 @@
+#include <assert.h>
+#include <immintrin.h>
+
+#include "Mandelbrot.h"
+
+static inline __mmask16 IsInMainCardioidOrBulb(const __m512 x, const __m512 y);
+
+// 16 lanes. Comparison gives a mask register, so the counters of lanes that are still inside
+// are incremented with a masked add instead of the movemask + sub_epi32 trick. Interior
+// checks are the same as in Avx2Iterations.h.
+void CalculateMandelbrotTileAvx512(uint16_t* iterations, const MandelbrotView* view,
+                                   const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    const __m512  maxRadiusSquare = _mm512_set1_ps(100.f);
+    const __m512i ones            = _mm512_set1_epi32(1);
+
+    const size_t  maxNumberOfIterations    = view->maxNumberOfIterations;
+    const __m512i maxNumberOfIterationsAvx = _mm512_set1_epi32((int)maxNumberOfIterations);
+
+    uint64_t vectorIterations  = 0;
+    uint64_t skippedIterations = 0;
+
+    const __m512i laneNumbers = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8,
+                                                  7,  6,  5,  4,  3,  2, 1, 0);
+    const __m512  x0BeginAvx  = _mm512_set1_ps(view->x0Begin);
+    const __m512  dxAvx       = _mm512_set1_ps(view->dx);
+
+    for (size_t pixelY = tile->yBegin; pixelY < tile->yEnd; ++pixelY)
+    {
+        __m512 y0Avx = _mm512_set1_ps(view->y0Begin + (float)pixelY * view->dy);
+
+        for (size_t pixelX = tile->xBegin; pixelX < tile->xEnd; pixelX += 16)
+        {
+            __m512i numberOfIterations = _mm512_setzero_si512();
+
+            // the zero masked conversion, the plain one leaves gcc an undefined source to
+            // warn about
+            __m512i pixelsX = _mm512_add_epi32(_mm512_set1_epi32((int)pixelX), laneNumbers);
+            __m512  x0Avx   = _mm512_add_ps(x0BeginAvx,
+                                            _mm512_mul_ps(_mm512_maskz_cvtepi32_ps(0xffff,
+                                                                                   pixelsX),
+                                                          dxAvx));
+
+            __m512 x = x0Avx;
+            __m512 y = y0Avx;
+
+            __mmask16 isInterior = IsInMainCardioidOrBulb(x0Avx, y0Avx);
+
+            __m512 savedX = x;
+            __m512 savedY = y;
+            size_t nextSaveIteration = 1;
+
+            size_t iterationNumber = 0;
+            for (iterationNumber = 0; iterationNumber < maxNumberOfIterations;
+                 ++iterationNumber)
+            {
+                __m512 xSquare = _mm512_mul_ps(x, x);
+                __m512 ySquare = _mm512_mul_ps(y, y);
+                __m512 xMulY   = _mm512_mul_ps(x, y);
+
+                __m512 radiusSquare = _mm512_add_ps(xSquare, ySquare);
+
+                __mmask16 isCounted = _mm512_mask_cmp_ps_mask((__mmask16)~isInterior,
+                                                              radiusSquare, maxRadiusSquare,
+                                                              _CMP_LT_OQ);
+                if (!isCounted) break;
+
+                numberOfIterations = _mm512_mask_add_epi32(numberOfIterations, isCounted,
+                                                           numberOfIterations, ones);
+
+                x = _mm512_add_ps(_mm512_sub_ps(xSquare, ySquare), x0Avx);
+                y = _mm512_add_ps(_mm512_add_ps(xMulY  , xMulY),   y0Avx);
+
+                __mmask16 isPeriodic = _mm512_mask_cmp_ps_mask(isCounted, x, savedX, _CMP_EQ_OQ) &
+                                       _mm512_mask_cmp_ps_mask(isCounted, y, savedY, _CMP_EQ_OQ);
+                isInterior |= isPeriodic;
+
+                if (iterationNumber + 1 == nextSaveIteration)
+                {
+                    savedX = x;
+                    savedY = y;
+                    nextSaveIteration *= 2;
+                }
+            }
+
+            if (isInterior)
+            {
+                alignas(64) int skippedIterationsArray[16] = {};
+                _mm512_store_si512(skippedIterationsArray,
+                                   _mm512_maskz_sub_epi32(isInterior, maxNumberOfIterationsAvx,
+                                                          numberOfIterations));
+                for (size_t i = 0; i < 16; ++i)
+                    skippedIterations += (uint64_t)skippedIterationsArray[i];
+
+                numberOfIterations = _mm512_mask_mov_epi32(numberOfIterations, isInterior,
+                                                           maxNumberOfIterationsAvx);
+            }
+
+        #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+            const size_t numberOfPixels = tile->xEnd - pixelX < 16 ? tile->xEnd - pixelX : 16;
+
+            // narrowed to 16 bits on the way, lanes past the end of the tile are not stored
+            _mm512_mask_cvtepi32_storeu_epi16(iterations + pixelX + pixelY * view->width,
+                                              (__mmask16)((1u << numberOfPixels) - 1),
+                                              numberOfIterations);
+        #endif
+
+            // the last check that broke the loop is executed too
+            vectorIterations += iterationNumber + (iterationNumber < maxNumberOfIterations);
+        }
+    }
+
+    stats->vectorIterations  += vectorIterations;
+    stats->skippedIterations += skippedIterations;
+}
+
+// Mask of lanes inside the main cardioid or the period-2 bulb, see Avx2Iterations.h.
+static inline __mmask16 IsInMainCardioidOrBulb(const __m512 x, const __m512 y)
+{
+    const __m512 quarter   = _mm512_set1_ps(0.25f);
+    const __m512 one       = _mm512_set1_ps(1.f);
+    const __m512 sixteenth = _mm512_set1_ps(1.f / 16);
+
+    __m512 ySquare = _mm512_mul_ps(y, y);
+
+    __m512 xShifted = _mm512_sub_ps(x, quarter);
+    __m512 q        = _mm512_add_ps(_mm512_mul_ps(xShifted, xShifted), ySquare);
+
+    __mmask16 isInCardioid = _mm512_cmp_ps_mask(_mm512_mul_ps(q, _mm512_add_ps(q, xShifted)),
+                                                _mm512_mul_ps(ySquare, quarter), _CMP_LE_OQ);
+
+    __m512 xPlusOne = _mm512_add_ps(x, one);
+    __mmask16 isInBulb = _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(xPlusOne, xPlusOne),
+                                                          ySquare),
+                                            sixteenth, _CMP_LE_OQ);
+
+    return isInCardioid | isInBulb;
+}
@@ -0,0 +1,1377 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "KernelDispatch.h"
+#include "Mandelbrot.h"
+#include "PerfCounters.h"
+#include "Telemetry.h"
+#include "TileCache.h"
+
+typedef uint64_t (*BenchKernel)(uint8_t* pixels, const MandelbrotView* view);
+
+// Either a whole frame kernel, one of the dispatched tile kernels, the subdivision render
+// on top of the avx2 one, the perturbation render or the smooth avx2 kernel. Frame kernels write
+// RGBA pixels, the others numbers of iterations that are colorized outside of the measured time.
+struct BenchKernelInfo
+{
+    const char*                 name;
+    BenchKernel                 kernel;
+    const MandelbrotKernelInfo* tiledKernel;
+    bool                        isSubdivided;
+    bool                        isPerturbed;
+    bool                        isSmooth;
+};
+
+struct BenchArgs
+{
+    const char* kernelName;
+    const char* outputFileName;
+    // the table goes to stderr when the json goes to stdout
+    FILE*       logStream;
+
+    size_t width;
+    size_t height;
+
+    double centerX;
+    double centerY;
+    double scale;
+
+    // the same center with all the digits given, for the perturbation render
+    FixedPoint centerXFixed;
+    FixedPoint centerYFixed;
+
+    size_t maxNumberOfIterations;
+    size_t numberOfRepeats;
+    size_t numberOfWarmups;
+    size_t numberOfThreads;
+
+    // compare every kernel with a full render
+    bool   verify;
+
+    // the process runs on cpus [firstCpu, firstCpu + numberOfThreads)
+    bool   shouldPin;
+    size_t firstCpu;
+
+    // perf_event_open counters, only the serialized tsc if off
+    bool   useCounters;
+
+    // gridSize 0 doesn't measure the anti-aliasing
+    MandelbrotAntiAliasing antiAliasing;
+
+    // levels of the zoom in and back out that are measured with and without the tile
+    // cache, 0 for none
+    size_t zoomPathLevels;
+    size_t tileCacheMb;
+
+#ifdef MANDELBROT_TELEMETRY
+    // files of the telemetry of an avx2 frame start with it, nullptr for none
+    const char* telemetryPrefix;
+#endif
+};
+
+struct BenchStats
+{
+    double min;
+    double median;
+    double p99;
+    double mean;
+    double stddev;
+};
+
+struct BenchResult
+{
+    const char* kernelName;
+
+    BenchStats  ns;
+    BenchStats  cycles;     // serialized tsc
+
+    // medians of the perf counters over the repeats, for the counters that are there
+    bool        hasCounters[NUMBER_OF_PERF_COUNTERS];
+    double      counters   [NUMBER_OF_PERF_COUNTERS];
+
+    double      cyclesPerPixelIteration;
+
+    // only for tiled kernels, 0 otherwise
+    uint64_t    vectorIterations;
+    uint64_t    skippedIterations;
+    uint64_t    filledPixels;
+    uint64_t    rebases;
+    uint64_t    refinedPixels;
+    double      laneOccupancy;
+
+    // only with --verify on
+    bool        isVerified;
+    uint64_t    numberOfDifferentPixels;
+
+    // only for the zoom path through the tile cache
+    bool           hasTileCacheStats;
+    TileCacheStats tileCacheStats;
+};
+
+static const BenchKernelInfo FrameKernels[] =
+{
+    { "noavx",  CalculateMandelbrotSetNoAvx,       nullptr, false, false, false },
+    { "arrays", CalculateMandelbrotSetNoAvxArrays, nullptr, false, false, false },
+};
+
+static const char* const SubdividedKernelName = "avx2-subdivision";
+static const size_t      DefaultAntiAliasingThreshold = 1;
+static const char* const PerturbedKernelName  = "avx2-perturbation";
+static const char* const SmoothKernelName     = "avx2-smooth";
+static const size_t      DefaultTileCacheMb   = 64;
+
+// Values of every repeat of a measurement.
+struct BenchSamples
+{
+    size_t  numberOfRepeats;
+
+    double* ns;
+    double* cycles;
+    double* counters[NUMBER_OF_PERF_COUNTERS];
+};
+
+static const size_t NumberOfFrameKernels    = sizeof(FrameKernels) / sizeof(*FrameKernels);
+// subdivision, perturbation and smooth
+static const size_t NumberOfRenderKernels   = 3;
+// colorize, smooth colorize, anti-aliasing and the zoom path without and with the cache
+static const size_t NumberOfExtraResults    = 5;
+
+static size_t   GetBenchKernels      (const char* kernelName, BenchKernelInfo* outKernels);
+static bool     GetSubdividedKernel  (BenchKernelInfo* outKernel);
+static bool     GetPerturbedKernel   (BenchKernelInfo* outKernel);
+static bool     GetSmoothKernel      (BenchKernelInfo* outKernel);
+
+static bool     ParseArgs            (int argc, char* argv[], BenchArgs* args);
+static void     PrintUsage           (const char* programName);
+static void     PrintKernelNames     ();
+static size_t   PrintKernelName      (const char* name, size_t lineLength);
+
+static void     RunKernel            (const BenchKernelInfo* kernelInfo, const BenchArgs* args,
+                                      const MandelbrotView* view, TileScheduler* scheduler,
+                                      PerfCounters* counters, uint8_t* pixels,
+                                      uint16_t* iterations, float* smoothIterations,
+                                      const uint64_t pixelIterations, BenchResult* outResult);
+static void     RunKernelOnce        (const BenchKernelInfo* kernelInfo, const BenchArgs* args,
+                                      const MandelbrotView* view, TileScheduler* scheduler,
+                                      uint8_t* pixels, uint16_t* iterations,
+                                      float* smoothIterations, MandelbrotStats* outStats);
+static void     RunColorize          (const BenchArgs* args, PerfCounters* counters,
+                                      uint8_t* pixels, const uint16_t* iterations,
+                                      const float* smoothIterations,
+                                      const MandelbrotPalette* palette, BenchResult* outResult);
+static void     RunAntiAliasing      (const BenchArgs* args, const MandelbrotView* view,
+                                      TileScheduler* scheduler, PerfCounters* counters,
+                                      uint8_t* pixels, const uint16_t* iterations,
+                                      const MandelbrotPalette* palette, BenchResult* outResult);
+static void     RunZoomPath          (const BenchArgs* args, TileScheduler* scheduler,
+                                      PerfCounters* counters, uint16_t* iterations,
+                                      const bool useTileCache, BenchResult* outResult);
+static void     GetZoomPathView      (const BenchArgs* args, const size_t frame,
+                                      MandelbrotView* outView);
+static uint64_t CountPixelIterations (const MandelbrotView* view);
+static void     RenderReference      (const MandelbrotView* view, TileScheduler* scheduler,
+                                      uint16_t* iterations, const MandelbrotPalette* palette,
+                                      uint8_t* outPixels);
+static uint64_t CountDifferentPixels (const uint8_t* pixels, const uint8_t* referencePixels,
+                                      const size_t numberOfPixels);
+static uint64_t GetTimeNs            ();
+#ifdef MANDELBROT_TELEMETRY
+static bool     WriteTelemetry       (const BenchArgs* args, const MandelbrotView* view,
+                                      TileScheduler* scheduler, uint8_t* pixels,
+                                      uint16_t* iterations);
+#endif
+
+static void     BenchSamplesCtor     (BenchSamples* samples, const size_t numberOfRepeats);
+static void     BenchSamplesDtor     (BenchSamples* samples);
+static void     AddSample            (BenchSamples* samples, const size_t repeat,
+                                      const uint64_t ns, const PerfSample* sample);
+static void     GetSamplesStats      (BenchSamples* samples, const PerfCounters* counters,
+                                      BenchResult* outResult);
+
+static void     CalculateStats       (double* values, const size_t numberOfValues,
+                                      BenchStats* outStats);
+static int      CompareDoubles       (const void* a, const void* b);
+
+static void     PrintResult          (FILE* logStream, const BenchResult* result,
+                                      const size_t numberOfPixels);
+static bool     WriteJson            (const char* fileName, const BenchArgs* args,
+                                      const uint64_t pixelIterations,
+                                      const BenchResult* results, const size_t numberOfResults);
+static void     PrintCounters        (FILE* logStream, const BenchResult* result);
+static void     WriteJsonStats       (FILE* outStream, const char* name, const BenchStats* stats);
+static void     WriteJsonCounters    (FILE* outStream, const BenchResult* result);
+
+int main(int argc, char* argv[])
+{
+    BenchArgs args = {};
+    if (!ParseArgs(argc, argv, &args))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    MandelbrotView view = {};
+    const float dxPerPixel = 1.f / (float)args.width;
+    MandelbrotViewCtor(&view, args.width, args.height, args.centerX - CenterX,
+                       args.centerY - CenterY, args.scale, dxPerPixel, dxPerPixel,
+                       args.maxNumberOfIterations);
+
+    if (!IsFloatPrecisionEnough(&view))
+        fprintf(args.logStream,
+                "Pixels are too close for float, float kernels draw blocks on this view\n");
+
+    // workers get the cpus and the counters of the main thread, so both go before them
+    if (args.shouldPin)
+    {
+        if (!PinToCpus(args.firstCpu, args.numberOfThreads))
+        {
+            fprintf(stderr, "Can't pin to cpus %zu-%zu\n", args.firstCpu,
+                    args.firstCpu + args.numberOfThreads - 1);
+            return 1;
+        }
+
+        fprintf(args.logStream, "Pinned to cpus %zu-%zu\n", args.firstCpu,
+                args.firstCpu + args.numberOfThreads - 1);
+    }
+
+    PerfCounters counters = {};
+    PerfCountersCtor(&counters);
+    if (!args.useCounters)
+        PerfCountersDtor(&counters);
+    else if (!counters.hasAnyCounter)
+        fprintf(args.logStream, "No perf counters (%s), only the serialized tsc is measured\n",
+                strerror(counters.openError));
+
+    TileScheduler scheduler = {};
+    TileSchedulerCtor(&scheduler, args.numberOfThreads);
+
+    const uint64_t pixelIterations = CountPixelIterations(&view);
+    const size_t   numberOfPixels  = args.width * args.height;
+
+    // the colorizer needs 32 bytes aligned pixels, a whole frame is a multiple of 32 bytes
+    // only for an even number of pixels
+    const size_t pixelsSize = (numberOfPixels * 4 + 31) / 32 * 32;
+    uint8_t*  pixels     = (uint8_t*)aligned_alloc(32, pixelsSize);
+    uint16_t* iterations = (uint16_t*)calloc(numberOfPixels, sizeof(*iterations));
+    float*    smoothIterations = (float*)calloc(numberOfPixels, sizeof(*smoothIterations));
+
+    // same colors as the frame kernels give, so every picture can be compared
+    MandelbrotPalette palette = {};
+    MandelbrotPaletteCtor(&palette, args.maxNumberOfIterations, PALETTE_GREEN);
+
+    uint8_t* referencePixels = nullptr;
+    if (args.verify)
+    {
+        referencePixels = (uint8_t*)aligned_alloc(32, pixelsSize);
+        RenderReference(&view, &scheduler, iterations, &palette, referencePixels);
+    }
+
+#ifdef MANDELBROT_TELEMETRY
+    // before the measured runs, they are not counted
+    if (args.telemetryPrefix &&
+        !WriteTelemetry(&args, &view, &scheduler, pixels, iterations))
+        fprintf(stderr, "Can't write the telemetry to \"%s-*\"\n", args.telemetryPrefix);
+#endif
+
+    size_t numberOfTiledKernels = 0;
+    GetMandelbrotKernels(&numberOfTiledKernels);
+    const size_t maxNumberOfKernels = NumberOfFrameKernels + numberOfTiledKernels +
+                                      NumberOfRenderKernels;
+
+    BenchKernelInfo* kernels = (BenchKernelInfo*)calloc(maxNumberOfKernels, sizeof(*kernels));
+    const size_t numberOfResults = GetBenchKernels(args.kernelName, kernels);
+    assert(numberOfResults <= maxNumberOfKernels);
+
+    BenchResult* results = (BenchResult*)calloc(maxNumberOfKernels + NumberOfExtraResults,
+                                                sizeof(*results));
+    bool        hasSmoothKernel = false;
+    for (size_t i = 0; i < numberOfResults; ++i)
+    {
+        RunKernel(&kernels[i], &args, &view, &scheduler, &counters, pixels, iterations,
+                  smoothIterations, pixelIterations, &results[i]);
+
+        if (kernels[i].isSmooth)
+            ColorizeMandelbrotSmooth(pixels, smoothIterations, numberOfPixels, &palette);
+        else if (kernels[i].tiledKernel)
+            ColorizeMandelbrot(pixels, iterations, numberOfPixels, &palette);
+
+        hasSmoothKernel = hasSmoothKernel || kernels[i].isSmooth;
+
+        if (referencePixels)
+        {
+            results[i].isVerified = true;
+            results[i].numberOfDifferentPixels = CountDifferentPixels(pixels, referencePixels,
+                                                                      numberOfPixels);
+        }
+
+        PrintResult(args.logStream, &results[i], numberOfPixels);
+    }
+
+    // iterations of the last kernel are colorized, the time doesn't depend on them
+    size_t numberOfAllResults = numberOfResults;
+    if (numberOfResults > 0)
+    {
+        RunColorize(&args, &counters, pixels, iterations, nullptr, &palette,
+                    &results[numberOfAllResults]);
+        PrintResult(args.logStream, &results[numberOfAllResults], numberOfPixels);
+        numberOfAllResults++;
+    }
+
+    if (hasSmoothKernel)
+    {
+        RunColorize(&args, &counters, pixels, iterations, smoothIterations, &palette,
+                    &results[numberOfAllResults]);
+        PrintResult(args.logStream, &results[numberOfAllResults], numberOfPixels);
+        numberOfAllResults++;
+    }
+
+    // on top of the same colorized frame
+    if (numberOfResults > 0 && args.antiAliasing.gridSize > 0)
+    {
+        const MandelbrotKernelInfo* avx2Kernel = FindMandelbrotKernel("avx2");
+        if (avx2Kernel && IsKernelSupported(avx2Kernel))
+        {
+            RunAntiAliasing(&args, &view, &scheduler, &counters, pixels, iterations, &palette,
+                            &results[numberOfAllResults]);
+            PrintResult(args.logStream, &results[numberOfAllResults], numberOfPixels);
+            numberOfAllResults++;
+        }
+        else
+            fprintf(args.logStream, "Anti-aliasing needs avx2, it is not measured\n");
+    }
+
+    if (numberOfResults > 0 && args.zoomPathLevels > 0)
+    {
+        for (size_t i = 0; i < 2; ++i)
+        {
+            RunZoomPath(&args, &scheduler, &counters, iterations, i == 1,
+                        &results[numberOfAllResults]);
+            PrintResult(args.logStream, &results[numberOfAllResults], numberOfPixels);
+            numberOfAllResults++;
+        }
+    }
+
+    MandelbrotPaletteDtor(&palette);
+    free(referencePixels);
+    free(smoothIterations);
+    free(iterations);
+    free(pixels);
+    TileSchedulerDtor(&scheduler);
+    PerfCountersDtor(&counters);
+
+    const bool isWritten = numberOfResults > 0 &&
+                           WriteJson(args.outputFileName, &args, pixelIterations, results,
+                                     numberOfAllResults);
+
+    free(results);
+    free(kernels);
+
+    return !isWritten;
+}
+
+// "all" gives every kernel that can run on this cpu. outKernels has room for the frame kernels,
+// the dispatch table and the render kernels.
+static size_t GetBenchKernels(const char* kernelName, BenchKernelInfo* outKernels)
+{
+    assert(kernelName);
+    assert(outKernels);
+
+    const bool allKernels = strcmp(kernelName, "all") == 0;
+
+    size_t numberOfKernels = 0;
+    for (size_t i = 0; i < NumberOfFrameKernels; ++i)
+    {
+        if (allKernels || strcmp(kernelName, FrameKernels[i].name) == 0)
+            outKernels[numberOfKernels++] = FrameKernels[i];
+    }
+
+    if (!allKernels && numberOfKernels > 0)
+        return numberOfKernels;
+
+    if (!allKernels && strcmp(kernelName, SubdividedKernelName) == 0)
+        return GetSubdividedKernel(&outKernels[0]) ? 1 : 0;
+
+    if (!allKernels && strcmp(kernelName, PerturbedKernelName) == 0)
+        return GetPerturbedKernel(&outKernels[0]) ? 1 : 0;
+
+    if (!allKernels && strcmp(kernelName, SmoothKernelName) == 0)
+        return GetSmoothKernel(&outKernels[0]) ? 1 : 0;
+
+    if (!allKernels)
+    {
+        const MandelbrotKernelInfo* tiledKernel = SelectMandelbrotKernel(kernelName);
+        if (!tiledKernel)
+            return 0;
+
+        outKernels[0] = { tiledKernel->name, nullptr, tiledKernel, false, false, false };
+        return 1;
+    }
+
+    size_t numberOfTiledKernels = 0;
+    const MandelbrotKernelInfo* tiledKernels = GetMandelbrotKernels(&numberOfTiledKernels);
+
+    for (size_t i = 0; i < numberOfTiledKernels; ++i)
+    {
+        if (IsKernelSupported(&tiledKernels[i]))
+            outKernels[numberOfKernels++] = { tiledKernels[i].name, nullptr, &tiledKernels[i],
+                                              false, false, false };
+    }
+
+    if (GetSubdividedKernel(&outKernels[numberOfKernels]))
+        numberOfKernels++;
+
+    if (GetPerturbedKernel(&outKernels[numberOfKernels]))
+        numberOfKernels++;
+
+    if (GetSmoothKernel(&outKernels[numberOfKernels]))
+        numberOfKernels++;
+
+    return numberOfKernels;
+}
+
+static bool GetSubdividedKernel(BenchKernelInfo* outKernel)
+{
+    assert(outKernel);
+
+    const MandelbrotKernelInfo* avx2Kernel = FindMandelbrotKernel("avx2");
+    if (!avx2Kernel || !IsKernelSupported(avx2Kernel))
+        return false;
+
+    *outKernel = { SubdividedKernelName, nullptr, avx2Kernel, true, false, false };
+    return true;
+}
+
+// Pixels of the perturbation render are iterated like in the avx2-double kernel
+static bool GetPerturbedKernel(BenchKernelInfo* outKernel)
+{
+    assert(outKernel);
+
+    const MandelbrotKernelInfo* doubleKernel = FindMandelbrotKernel("avx2-double");
+    if (!doubleKernel || !IsKernelSupported(doubleKernel))
+        return false;
+
+    *outKernel = { PerturbedKernelName, nullptr, doubleKernel, false, true, false };
+    return true;
+}
+
+// Smooth colors are not the ones of the reference, verify counts the pixels they changed.
+static bool GetSmoothKernel(BenchKernelInfo* outKernel)
+{
+    assert(outKernel);
+
+    const MandelbrotKernelInfo* avx2Kernel = FindMandelbrotKernel("avx2");
+    if (!avx2Kernel || !IsKernelSupported(avx2Kernel))
+        return false;
+
+    *outKernel = { SmoothKernelName, nullptr, avx2Kernel, false, false, true };
+    return true;
+}
+
+static bool ParseArgs(int argc, char* argv[], BenchArgs* args)
+{
+    assert(argv);
+    assert(args);
+
+    args->kernelName     = "all";
+    args->outputFileName = "bench.json";
+
+    args->width   = 800;
+    args->height  = 600;
+    args->centerX = CenterX;
+    args->centerY = CenterY;
+    args->scale   = 1;
+
+    const char* centerXText = nullptr;
+    const char* centerYText = nullptr;
+
+    args->maxNumberOfIterations = DefaultMaxNumberOfIterations;
+    args->numberOfRepeats       = 100;
+    args->numberOfWarmups       = 3;
+    args->numberOfThreads       = 1;
+    args->useCounters           = true;
+
+    args->antiAliasing.threshold = DefaultAntiAliasingThreshold;
+    args->tileCacheMb            = DefaultTileCacheMb;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        const char* option = argv[i];
+        const char* value  = argv[++i];
+
+        if      (strcmp(option, "--kernel")     == 0) args->kernelName            = value;
+        else if (strcmp(option, "--output")     == 0) args->outputFileName        = value;
+        else if (strcmp(option, "--width")      == 0) args->width                 = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--height")     == 0) args->height                = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--center-x")   == 0) centerXText                 = value;
+        else if (strcmp(option, "--center-y")   == 0) centerYText                 = value;
+        else if (strcmp(option, "--scale")      == 0) args->scale                 = strtod (value, nullptr);
+        else if (strcmp(option, "--iterations") == 0) args->maxNumberOfIterations = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--repeats")    == 0) args->numberOfRepeats       = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--warmup")     == 0) args->numberOfWarmups       = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--threads")    == 0) args->numberOfThreads       = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--verify")     == 0) args->verify                = strcmp(value, "on") == 0;
+        else if (strcmp(option, "--counters")   == 0) args->useCounters           = strcmp(value, "off") != 0;
+        else if (strcmp(option, "--aa")         == 0) args->antiAliasing.gridSize = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--aa-threshold") == 0)
+            args->antiAliasing.threshold = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--zoom-path")  == 0) args->zoomPathLevels        = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--tile-cache") == 0) args->tileCacheMb           = strtoul(value, nullptr, 10);
+    #ifdef MANDELBROT_TELEMETRY
+        else if (strcmp(option, "--telemetry")  == 0) args->telemetryPrefix       = value;
+    #endif
+        else if (strcmp(option, "--pin-cpu")    == 0)
+        {
+            args->shouldPin = true;
+            args->firstCpu  = strtoul(value, nullptr, 10);
+        }
+        else
+            return false;
+    }
+
+    if (centerXText)
+    {
+        if (!FixedPointFromString(&args->centerXFixed, centerXText))
+            return false;
+        args->centerX = FixedPointToDouble(&args->centerXFixed);
+    }
+    else
+        FixedPointFromDouble(&args->centerXFixed, args->centerX);
+
+    if (centerYText)
+    {
+        if (!FixedPointFromString(&args->centerYFixed, centerYText))
+            return false;
+        args->centerY = FixedPointToDouble(&args->centerYFixed);
+    }
+    else
+        FixedPointFromDouble(&args->centerYFixed, args->centerY);
+
+    args->logStream = strcmp(args->outputFileName, "-") == 0 ? stderr : stdout;
+
+    return args->width > 0 && args->height > 0 && args->scale > 0 &&
+           args->maxNumberOfIterations > 0 &&
+           args->maxNumberOfIterations <= MaxNumberOfIterationsLimit &&
+           args->numberOfRepeats > 0 && args->numberOfThreads > 0 &&
+           (args->antiAliasing.gridSize == 0 ||
+            (args->antiAliasing.gridSize >= 2 && args->antiAliasing.gridSize <= 8)) &&
+           args->tileCacheMb > 0;
+}
+
+static void PrintUsage(const char* programName)
+{
+    fprintf(stderr,
+            "Usage: %s [--kernel name] [--width N] [--height N]\n"
+            "          [--center-x X] [--center-y Y] [--scale S] [--iterations N]\n"
+            "          [--repeats N] [--warmup N] [--threads N] [--output file.json]\n"
+            "          [--verify on|off] [--counters on|off] [--pin-cpu N]\n"
+            "          [--aa 2..8] [--aa-threshold N] [--zoom-path N] [--tile-cache MB]\n"
+            "Output \"-\" writes json to stdout and the table to stderr. Verify compares the\n"
+            "picture of every kernel with a full render by the widest tile kernel. Iterations\n"
+            "are at most %zu, colorizing of the numbers of iterations is measured as\n"
+            "\"colorize\".\n"
+            "Centers are decimal numbers, the perturbation render uses all their digits.\n"
+            "Cycles are the serialized tsc, counters are of perf_event_open if the kernel\n"
+            "allows them. Pin runs the threads on cpus N to N + threads - 1.\n"
+            "Aa measures anti-aliasing of the last frame with N x N samples in the pixels whose\n"
+            "iterations differ from a neighbour's by more than the threshold (%zu by default).\n"
+            "Zoom path renders N zoom levels of the viewer in and back out, every frame once,\n"
+            "without and with a tile cache of the given size (%zu MB by default). Verify\n"
+            "compares every cached frame with the one of an empty cache and gives the worst.\n",
+            programName, MaxNumberOfIterationsLimit, DefaultAntiAliasingThreshold,
+            DefaultTileCacheMb);
+#ifdef MANDELBROT_TELEMETRY
+    fprintf(stderr,
+            "          [--telemetry prefix]\n"
+            "Telemetry of one avx2 frame goes to prefix-tiles.csv, prefix-steps.csv and\n"
+            "prefix-heatmap.ppm.\n");
+#endif
+
+    PrintKernelNames();
+}
+
+// Names --kernel takes, "all" and then the order the kernels are measured in.
+static void PrintKernelNames()
+{
+    size_t lineLength = (size_t)fprintf(stderr, "Kernels: all");
+
+    for (size_t i = 0; i < NumberOfFrameKernels; ++i)
+        lineLength = PrintKernelName(FrameKernels[i].name, lineLength);
+
+    size_t numberOfTiledKernels = 0;
+    const MandelbrotKernelInfo* tiledKernels = GetMandelbrotKernels(&numberOfTiledKernels);
+    for (size_t i = 0; i < numberOfTiledKernels; ++i)
+        lineLength = PrintKernelName(tiledKernels[i].name, lineLength);
+
+    lineLength = PrintKernelName(SubdividedKernelName, lineLength);
+    lineLength = PrintKernelName(PerturbedKernelName,  lineLength);
+    PrintKernelName(SmoothKernelName, lineLength);
+
+    fprintf(stderr, "\n");
+}
+
+// Gives the length of the line after the name, names don't go past 80 columns.
+static size_t PrintKernelName(const char* name, size_t lineLength)
+{
+    assert(name);
+
+    static const size_t MaxLineLength = 80;
+    static const char   Indent[]      = "         ";
+
+    if (lineLength + 2 + strlen(name) > MaxLineLength)
+    {
+        fprintf(stderr, ",\n%s%s", Indent, name);
+        return strlen(Indent) + strlen(name);
+    }
+
+    fprintf(stderr, ", %s", name);
+    return lineLength + 2 + strlen(name);
+}
+
+static void RunKernel(const BenchKernelInfo* kernelInfo, const BenchArgs* args,
+                      const MandelbrotView* view, TileScheduler* scheduler,
+                      PerfCounters* counters, uint8_t* pixels, uint16_t* iterations,
+                      float* smoothIterations, const uint64_t pixelIterations,
+                      BenchResult* outResult)
+{
+    assert(kernelInfo);
+    assert(args);
+    assert(view);
+    assert(counters);
+    assert(outResult);
+
+    MandelbrotStats stats = {};
+
+    for (size_t i = 0; i < args->numberOfWarmups; ++i)
+        RunKernelOnce(kernelInfo, args, view, scheduler, pixels, iterations, smoothIterations,
+                      &stats);
+
+    BenchSamples samples = {};
+    BenchSamplesCtor(&samples, args->numberOfRepeats);
+
+    for (size_t i = 0; i < args->numberOfRepeats; ++i)
+    {
+        PerfSample sample  = {};
+        uint64_t   startNs = GetTimeNs();
+        PerfCountersStart(counters);
+
+        RunKernelOnce(kernelInfo, args, view, scheduler, pixels, iterations, smoothIterations,
+                      &stats);
+
+        PerfCountersStop(counters, &sample);
+        uint64_t   endNs   = GetTimeNs();
+
+        AddSample(&samples, i, endNs - startNs, &sample);
+    }
+
+    outResult->kernelName = kernelInfo->name;
+    GetSamplesStats(&samples, counters, outResult);
+    BenchSamplesDtor(&samples);
+
+    outResult->cyclesPerPixelIteration =
+        pixelIterations ? outResult->cycles.median / (double)pixelIterations : 0;
+
+    outResult->vectorIterations  = stats.vectorIterations;
+    outResult->skippedIterations = stats.skippedIterations;
+    outResult->filledPixels      = stats.filledPixels;
+    outResult->rebases           = stats.rebases;
+
+    // skipped iterations are not executed by any lane, filled pixels are not known
+    if (kernelInfo->tiledKernel && !kernelInfo->isSubdivided && !kernelInfo->isPerturbed &&
+        stats.vectorIterations)
+    {
+        outResult->laneOccupancy = ((double)pixelIterations - (double)stats.skippedIterations) /
+                                   ((double)stats.vectorIterations *
+                                    (double)kernelInfo->tiledKernel->numberOfLanes);
+    }
+}
+
+static void RunKernelOnce(const BenchKernelInfo* kernelInfo, const BenchArgs* args,
+                          const MandelbrotView* view, TileScheduler* scheduler,
+                          uint8_t* pixels, uint16_t* iterations, float* smoothIterations,
+                          MandelbrotStats* outStats)
+{
+    assert(kernelInfo);
+    assert(args);
+
+    if (kernelInfo->isSmooth)
+        CalculateMandelbrotSetSmooth(smoothIterations, view, scheduler, outStats);
+    else if (kernelInfo->isPerturbed)
+        CalculateMandelbrotSetPerturbed(iterations, view, &args->centerXFixed,
+                                        &args->centerYFixed, scheduler, outStats);
+    else if (kernelInfo->isSubdivided)
+        CalculateMandelbrotSetSubdivided(iterations, view, scheduler, outStats);
+    else if (kernelInfo->tiledKernel)
+        CalculateMandelbrotSetTiled(iterations, view, scheduler,
+                                    kernelInfo->tiledKernel->tileKernel, outStats);
+    else
+        kernelInfo->kernel(pixels, view);
+}
+
+// Palette lookup of the whole frame, the stage that follows any tile kernel. With
+// smoothIterations it is the smooth coloring of them instead.
+static void RunColorize(const BenchArgs* args, PerfCounters* counters, uint8_t* pixels,
+                        const uint16_t* iterations, const float* smoothIterations,
+                        const MandelbrotPalette* palette, BenchResult* outResult)
+{
+    assert(args);
+    assert(counters);
+    assert(outResult);
+
+    const size_t numberOfPixels = args->width * args->height;
+
+    for (size_t i = 0; i < args->numberOfWarmups; ++i)
+    {
+        if (smoothIterations)
+            ColorizeMandelbrotSmooth(pixels, smoothIterations, numberOfPixels, palette);
+        else
+            ColorizeMandelbrot(pixels, iterations, numberOfPixels, palette);
+    }
+
+    BenchSamples samples = {};
+    BenchSamplesCtor(&samples, args->numberOfRepeats);
+
+    for (size_t i = 0; i < args->numberOfRepeats; ++i)
+    {
+        PerfSample sample  = {};
+        uint64_t   startNs = GetTimeNs();
+        PerfCountersStart(counters);
+
+        if (smoothIterations)
+            ColorizeMandelbrotSmooth(pixels, smoothIterations, numberOfPixels, palette);
+        else
+            ColorizeMandelbrot(pixels, iterations, numberOfPixels, palette);
+
+        PerfCountersStop(counters, &sample);
+        uint64_t   endNs   = GetTimeNs();
+
+        AddSample(&samples, i, endNs - startNs, &sample);
+    }
+
+    outResult->kernelName = smoothIterations ? "colorize-smooth" : "colorize";
+    GetSamplesStats(&samples, counters, outResult);
+    BenchSamplesDtor(&samples);
+}
+
+// Colors of the frame are the same before every repeat, anti-aliasing recolors the same pixels
+// with the same samples.
+static void RunAntiAliasing(const BenchArgs* args, const MandelbrotView* view,
+                            TileScheduler* scheduler, PerfCounters* counters, uint8_t* pixels,
+                            const uint16_t* iterations, const MandelbrotPalette* palette,
+                            BenchResult* outResult)
+{
+    assert(args);
+    assert(view);
+    assert(counters);
+    assert(outResult);
+
+    MandelbrotStats stats = {};
+
+    for (size_t i = 0; i < args->numberOfWarmups; ++i)
+        AntiAliasMandelbrot(pixels, iterations, view, palette, &args->antiAliasing, scheduler,
+                            &stats);
+
+    BenchSamples samples = {};
+    BenchSamplesCtor(&samples, args->numberOfRepeats);
+
+    for (size_t i = 0; i < args->numberOfRepeats; ++i)
+    {
+        PerfSample sample  = {};
+        uint64_t   startNs = GetTimeNs();
+        PerfCountersStart(counters);
+
+        AntiAliasMandelbrot(pixels, iterations, view, palette, &args->antiAliasing, scheduler,
+                            &stats);
+
+        PerfCountersStop(counters, &sample);
+        uint64_t   endNs   = GetTimeNs();
+
+        AddSample(&samples, i, endNs - startNs, &sample);
+    }
+
+    outResult->kernelName = "antialias";
+    GetSamplesStats(&samples, counters, outResult);
+    BenchSamplesDtor(&samples);
+
+    outResult->vectorIterations  = stats.vectorIterations;
+    outResult->skippedIterations = stats.skippedIterations;
+    outResult->refinedPixels     = stats.refinedPixels;
+}
+
+// Every frame of the path is a sample, there are no warmups: the frames that come back to
+// a level are the point of the cache. Frames are calculated by the widest kernel like in
+// the viewer, with the cache the missing tiles are calculated whole.
+static void RunZoomPath(const BenchArgs* args, TileScheduler* scheduler, PerfCounters* counters,
+                        uint16_t* iterations, const bool useTileCache, BenchResult* outResult)
+{
+    assert(args);
+    assert(args->zoomPathLevels > 0);
+    assert(scheduler);
+    assert(counters);
+    assert(iterations);
+    assert(outResult);
+
+    const MandelbrotKernelInfo* kernel = SelectMandelbrotKernel(nullptr);
+    assert(kernel);
+
+    TileCache tileCache = {};
+    if (useTileCache)
+        TileCacheCtor(&tileCache, args->tileCacheMb << 20);
+
+    // a frame of the cache has to be the same whichever frames filled the cache before it,
+    // verify calculates it again from an empty cache and counts the pixels that differ
+    const bool   shouldVerify   = useTileCache && args->verify;
+    const size_t numberOfPixels = args->width * args->height;
+
+    uint16_t* directIterations = shouldVerify ?
+                                 (uint16_t*)calloc(numberOfPixels, sizeof(*directIterations)) :
+                                 nullptr;
+    uint64_t  maxNumberOfDifferentPixels = 0;
+
+    const size_t numberOfFrames = 2 * args->zoomPathLevels + 1;
+
+    BenchSamples samples = {};
+    BenchSamplesCtor(&samples, numberOfFrames);
+
+    for (size_t frame = 0; frame < numberOfFrames; ++frame)
+    {
+        MandelbrotView view = {};
+        GetZoomPathView(args, frame, &view);
+
+        const MandelbrotKernelInfo* frameKernel = SelectMandelbrotKernelForView(kernel, &view);
+
+        PerfSample sample  = {};
+        uint64_t   startNs = GetTimeNs();
+        PerfCountersStart(counters);
+
+        size_t numberOfHits = 0;
+        bool   isCached     = useTileCache &&
+                              TileCacheFindFrame(&tileCache, &view, frameKernel->tileKernel,
+                                                 &numberOfHits) > 0 &&
+                              CalculateMandelbrotSetCached(iterations, &view, &tileCache,
+                                                           scheduler, frameKernel->tileKernel,
+                                                           nullptr, nullptr);
+        if (!isCached)
+            CalculateMandelbrotSetTiled(iterations, &view, scheduler, frameKernel->tileKernel,
+                                        nullptr);
+
+        PerfCountersStop(counters, &sample);
+        uint64_t   endNs   = GetTimeNs();
+
+        AddSample(&samples, frame, endNs - startNs, &sample);
+
+        if (shouldVerify)
+        {
+            TileCache emptyCache = {};
+            TileCacheCtor(&emptyCache, args->tileCacheMb << 20);
+
+            if (!CalculateMandelbrotSetCached(directIterations, &view, &emptyCache, scheduler,
+                                              frameKernel->tileKernel, nullptr, nullptr))
+                CalculateMandelbrotSetTiled(directIterations, &view, scheduler,
+                                            frameKernel->tileKernel, nullptr);
+
+            TileCacheDtor(&emptyCache);
+
+            uint64_t numberOfDifferentPixels = 0;
+            for (size_t i = 0; i < numberOfPixels; ++i)
+                numberOfDifferentPixels += iterations[i] != directIterations[i];
+
+            if (numberOfDifferentPixels > maxNumberOfDifferentPixels)
+                maxNumberOfDifferentPixels = numberOfDifferentPixels;
+        }
+    }
+
+    outResult->kernelName = useTileCache ? "zoom-path-cached" : "zoom-path";
+    GetSamplesStats(&samples, counters, outResult);
+    BenchSamplesDtor(&samples);
+
+    // the worst frame of the path
+    outResult->isVerified              = shouldVerify;
+    outResult->numberOfDifferentPixels = maxNumberOfDifferentPixels;
+    free(directIterations);
+
+    if (useTileCache)
+    {
+        outResult->hasTileCacheStats = true;
+        TileCacheGetStats(&tileCache, &outResult->tileCacheStats);
+        TileCacheDtor(&tileCache);
+    }
+}
+
+// Levels 0, 1, ..., N, N - 1, ..., 0 over the scale of the args, a level is a press of the
+// zoom key of the viewer. Views are on the grid of the cache in both runs, so they are the
+// same views.
+static void GetZoomPathView(const BenchArgs* args, const size_t frame, MandelbrotView* outView)
+{
+    assert(args);
+    assert(outView);
+
+    const size_t level = frame <= args->zoomPathLevels ? frame :
+                                                         2 * args->zoomPathLevels - frame;
+
+    const float dxPerPixel = 1.f / (float)args->width;
+    const float scale      = (float)args->scale + (float)level * dxPerPixel * 10.f;
+
+    MandelbrotViewCtor(outView, args->width, args->height, args->centerX - CenterX,
+                       args->centerY - CenterY, scale, dxPerPixel, dxPerPixel,
+                       args->maxNumberOfIterations);
+    SnapViewToTileGrid(outView);
+}
+
+// Amount of work in the frame - sum of escape iterations over all pixels. It doesn't depend
+// on the kernel, so cycles per pixel-iteration can be compared between kernels and views.
+static uint64_t CountPixelIterations(const MandelbrotView* view)
+{
+    assert(view);
+
+    static const float maxRadiusSquare = 10 * 10.f;
+
+    uint64_t pixelIterations = 0;
+    for (size_t pixelY = 0; pixelY < view->height; ++pixelY)
+    {
+        const float y0 = view->y0Begin + (float)pixelY * view->dy;
+
+        for (size_t pixelX = 0; pixelX < view->width; ++pixelX)
+        {
+            const float x0 = view->x0Begin + (float)pixelX * view->dx;
+
+            float x = x0;
+            float y = y0;
+
+            size_t iterationNumber = 0;
+            for (; iterationNumber < view->maxNumberOfIterations; ++iterationNumber)
+            {
+                const float xSquare = x * x;
+                const float ySquare = y * y;
+                const float xMulY   = x * y;
+
+                if (xSquare + ySquare >= maxRadiusSquare) break;
+
+                x = xSquare - ySquare + x0;
+                y = xMulY   + xMulY   + y0;
+            }
+
+            pixelIterations += iterationNumber;
+        }
+    }
+
+    return pixelIterations;
+}
+
+// Full render by the widest supported tile kernel, all float ones give the same picture.
+// Double precision kernel is taken if float is not enough for the view.
+static void RenderReference(const MandelbrotView* view, TileScheduler* scheduler,
+                            uint16_t* iterations, const MandelbrotPalette* palette,
+                            uint8_t* outPixels)
+{
+    assert(view);
+    assert(scheduler);
+    assert(iterations);
+    assert(outPixels);
+
+    size_t numberOfTiledKernels = 0;
+    const MandelbrotKernelInfo* tiledKernels = GetMandelbrotKernels(&numberOfTiledKernels);
+
+    for (size_t i = 0; i < numberOfTiledKernels; ++i)
+    {
+        if (!IsKernelSupported(&tiledKernels[i])) continue;
+
+        const MandelbrotKernelInfo* kernel = SelectMandelbrotKernelForView(&tiledKernels[i], view);
+        CalculateMandelbrotSetTiled(iterations, view, scheduler, kernel->tileKernel, nullptr);
+        ColorizeMandelbrot(outPixels, iterations, view->width * view->height, palette);
+        return;
+    }
+}
+
+static uint64_t CountDifferentPixels(const uint8_t* pixels, const uint8_t* referencePixels,
+                                     const size_t numberOfPixels)
+{
+    assert(pixels);
+    assert(referencePixels);
+
+    uint64_t numberOfDifferentPixels = 0;
+    for (size_t i = 0; i < numberOfPixels; ++i)
+        numberOfDifferentPixels += memcmp(pixels + i * 4, referencePixels + i * 4, 4) != 0;
+
+    return numberOfDifferentPixels;
+}
+
+static uint64_t GetTimeNs()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
+
+#ifdef MANDELBROT_TELEMETRY
+// One frame of the avx2 kernel with the kernels reporting to a telemetry. Not inlined: the file
+// names would stay on the stack of main for the whole run.
+__attribute__((noinline))
+static bool WriteTelemetry(const BenchArgs* args, const MandelbrotView* view,
+                           TileScheduler* scheduler, uint8_t* pixels, uint16_t* iterations)
+{
+    assert(args);
+    assert(args->telemetryPrefix);
+    assert(view);
+
+    static const size_t MaxFileNameLength = 512;
+
+    char tilesFileName  [MaxFileNameLength] = "";
+    char stepsFileName  [MaxFileNameLength] = "";
+    char heatMapFileName[MaxFileNameLength] = "";
+
+    const char* prefix = args->telemetryPrefix;
+    if ((size_t)snprintf(tilesFileName,   MaxFileNameLength, "%s-tiles.csv",   prefix) >=
+        MaxFileNameLength ||
+        (size_t)snprintf(stepsFileName,   MaxFileNameLength, "%s-steps.csv",   prefix) >=
+        MaxFileNameLength ||
+        (size_t)snprintf(heatMapFileName, MaxFileNameLength, "%s-heatmap.ppm", prefix) >=
+        MaxFileNameLength)
+        return false;
+
+    const MandelbrotKernelInfo* avx2Kernel = FindMandelbrotKernel("avx2");
+    if (!avx2Kernel || !IsKernelSupported(avx2Kernel))
+        return false;
+
+    const BenchKernelInfo kernelInfo = { avx2Kernel->name, nullptr, avx2Kernel, false, false,
+                                         false };
+
+    MandelbrotTelemetry telemetry = {};
+    MandelbrotTelemetryCtor(&telemetry, view->width, view->height, view->maxNumberOfIterations);
+
+    SetKernelTelemetry(&telemetry);
+    MandelbrotStats stats = {};
+    RunKernelOnce(&kernelInfo, args, view, scheduler, pixels, iterations, nullptr, &stats);
+    SetKernelTelemetry(nullptr);
+
+    const bool isWritten = WriteTelemetryCsv(&telemetry, tilesFileName, stepsFileName) &&
+                           WriteTelemetryHeatMap(&telemetry, heatMapFileName);
+
+    MandelbrotTelemetryDtor(&telemetry);
+
+    if (isWritten)
+        fprintf(args->logStream, "Telemetry is written to %s, %s and %s\n", tilesFileName,
+                stepsFileName, heatMapFileName);
+
+    return isWritten;
+}
+#endif
+
+static void BenchSamplesCtor(BenchSamples* samples, const size_t numberOfRepeats)
+{
+    assert(samples);
+    assert(numberOfRepeats > 0);
+
+    samples->numberOfRepeats = numberOfRepeats;
+    samples->ns              = (double*)calloc(numberOfRepeats, sizeof(*samples->ns));
+    samples->cycles          = (double*)calloc(numberOfRepeats, sizeof(*samples->cycles));
+
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+        samples->counters[i] = (double*)calloc(numberOfRepeats, sizeof(*samples->counters[i]));
+}
+
+static void BenchSamplesDtor(BenchSamples* samples)
+{
+    assert(samples);
+
+    free(samples->ns);
+    free(samples->cycles);
+
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+        free(samples->counters[i]);
+
+    *samples = {};
+}
+
+static void AddSample(BenchSamples* samples, const size_t repeat, const uint64_t ns,
+                      const PerfSample* sample)
+{
+    assert(samples);
+    assert(repeat < samples->numberOfRepeats);
+    assert(sample);
+
+    samples->ns    [repeat] = (double)ns;
+    samples->cycles[repeat] = (double)sample->tsc;
+
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+        samples->counters[i][repeat] = (double)sample->values[i];
+}
+
+static void GetSamplesStats(BenchSamples* samples, const PerfCounters* counters,
+                            BenchResult* outResult)
+{
+    assert(samples);
+    assert(counters);
+    assert(outResult);
+
+    CalculateStats(samples->ns,     samples->numberOfRepeats, &outResult->ns);
+    CalculateStats(samples->cycles, samples->numberOfRepeats, &outResult->cycles);
+
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+    {
+        outResult->hasCounters[i] = IsPerfCounterAvailable(counters, (PerfCounter)i);
+        if (!outResult->hasCounters[i])
+            continue;
+
+        BenchStats counterStats = {};
+        CalculateStats(samples->counters[i], samples->numberOfRepeats, &counterStats);
+        outResult->counters[i] = counterStats.median;
+    }
+}
+
+static void CalculateStats(double* values, const size_t numberOfValues, BenchStats* outStats)
+{
+    assert(values);
+    assert(numberOfValues > 0);
+    assert(outStats);
+
+    qsort(values, numberOfValues, sizeof(*values), CompareDoubles);
+
+    double sum = 0;
+    for (size_t i = 0; i < numberOfValues; ++i)
+        sum += values[i];
+
+    const double mean = sum / (double)numberOfValues;
+
+    double squaresSum = 0;
+    for (size_t i = 0; i < numberOfValues; ++i)
+        squaresSum += (values[i] - mean) * (values[i] - mean);
+
+    outStats->min    = values[0];
+    outStats->median = numberOfValues % 2 ? values[numberOfValues / 2] :
+                       (values[numberOfValues / 2 - 1] + values[numberOfValues / 2]) / 2;
+
+    // nearest rank
+    size_t p99Rank = (size_t)ceil(0.99 * (double)numberOfValues);
+    outStats->p99  = values[p99Rank > 0 ? p99Rank - 1 : 0];
+
+    outStats->mean   = mean;
+    outStats->stddev = numberOfValues > 1 ? sqrt(squaresSum / (double)(numberOfValues - 1)) : 0;
+}
+
+static int CompareDoubles(const void* a, const void* b)
+{
+    double first  = *(const double*)a;
+    double second = *(const double*)b;
+
+    return (first > second) - (first < second);
+}
+
+static void PrintResult(FILE* logStream, const BenchResult* result, const size_t numberOfPixels)
+{
+    assert(logStream);
+    assert(result);
+
+    fprintf(logStream,
+            "%-8s ns:     min %12.0f median %12.0f p99 %12.0f stddev %10.0f\n"
+            "         cycles: min %12.0f median %12.0f p99 %12.0f stddev %10.0f\n"
+            "         cycles per pixel-iteration: %.3f\n",
+            result->kernelName,
+            result->ns.min,     result->ns.median,     result->ns.p99,     result->ns.stddev,
+            result->cycles.min, result->cycles.median, result->cycles.p99, result->cycles.stddev,
+            result->cyclesPerPixelIteration);
+
+    PrintCounters(logStream, result);
+
+    if (result->laneOccupancy > 0)
+        fprintf(logStream, "         vector iterations: %llu, lane occupancy: %.1f%%\n",
+                (unsigned long long)result->vectorIterations, result->laneOccupancy * 100);
+    else if (result->vectorIterations)
+        fprintf(logStream, "         vector iterations: %llu\n",
+                (unsigned long long)result->vectorIterations);
+
+    if (result->skippedIterations)
+        fprintf(logStream, "         skipped iterations (interior checks): %llu\n",
+                (unsigned long long)result->skippedIterations);
+
+    if (result->filledPixels)
+        fprintf(logStream, "         filled pixels (subdivision): %llu, %.1f%%\n",
+                (unsigned long long)result->filledPixels,
+                (double)result->filledPixels * 100 / (double)numberOfPixels);
+
+    if (result->rebases)
+        fprintf(logStream, "         rebases (perturbation): %llu\n",
+                (unsigned long long)result->rebases);
+
+    if (result->refinedPixels)
+        fprintf(logStream, "         refined pixels (anti-aliasing): %llu, %.1f%%\n",
+                (unsigned long long)result->refinedPixels,
+                (double)result->refinedPixels * 100 / (double)numberOfPixels);
+
+    if (result->hasTileCacheStats)
+    {
+        const TileCacheStats* stats = &result->tileCacheStats;
+        fprintf(logStream, "         tile cache: hits %.1f%% of %llu tiles, evictions %llu, "
+                "memory %.1f of %.1f MB\n",
+                stats->lookups ? (double)stats->hits * 100 / (double)stats->lookups : 0.,
+                (unsigned long long)stats->lookups, (unsigned long long)stats->evictions,
+                (double)stats->bytes / (1 << 20), (double)stats->budgetBytes / (1 << 20));
+    }
+
+    if (result->isVerified)
+        fprintf(logStream, "         different pixels: %llu, %.4f%%\n",
+                (unsigned long long)result->numberOfDifferentPixels,
+                (double)result->numberOfDifferentPixels * 100 / (double)numberOfPixels);
+}
+
+// Medians of the counters that are there, IPC if both cycles and instructions are.
+static void PrintCounters(FILE* logStream, const BenchResult* result)
+{
+    assert(logStream);
+    assert(result);
+
+    bool hasAnyCounter = false;
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+    {
+        if (!result->hasCounters[i])
+            continue;
+
+        fprintf(logStream, "%s%s %.0f", hasAnyCounter ? ", " : "         ",
+                GetPerfCounterName((PerfCounter)i), result->counters[i]);
+        hasAnyCounter = true;
+    }
+
+    if (!hasAnyCounter)
+        return;
+
+    if (result->hasCounters[PERF_CYCLES] && result->hasCounters[PERF_INSTRUCTIONS] &&
+        result->counters[PERF_CYCLES] > 0)
+        fprintf(logStream, ", IPC %.2f",
+                result->counters[PERF_INSTRUCTIONS] / result->counters[PERF_CYCLES]);
+
+    fprintf(logStream, "\n");
+}
+
+static bool WriteJson(const char* fileName, const BenchArgs* args,
+                      const uint64_t pixelIterations,
+                      const BenchResult* results, const size_t numberOfResults)
+{
+    assert(fileName);
+    assert(args);
+    assert(results);
+
+    FILE* outStream = strcmp(fileName, "-") == 0 ? stdout : fopen(fileName, "w");
+    if (!outStream)
+    {
+        perror(fileName);
+        return false;
+    }
+
+    fprintf(outStream,
+            "{\n"
+            "    \"width\": %zu,\n"
+            "    \"height\": %zu,\n"
+            "    \"centerX\": %.17g,\n"
+            "    \"centerY\": %.17g,\n"
+            "    \"scale\": %.9g,\n"
+            "    \"maxIterations\": %zu,\n"
+            "    \"repeats\": %zu,\n"
+            "    \"warmup\": %zu,\n"
+            "    \"threads\": %zu,\n"
+            "    \"pixelIterations\": %llu,\n"
+            "    \"kernels\": [\n",
+            args->width, args->height, args->centerX, args->centerY,
+            args->scale, args->maxNumberOfIterations, args->numberOfRepeats,
+            args->numberOfWarmups, args->numberOfThreads, (unsigned long long)pixelIterations);
+
+    for (size_t i = 0; i < numberOfResults; ++i)
+    {
+        fprintf(outStream, "        {\n            \"name\": \"%s\",\n", results[i].kernelName);
+        WriteJsonStats(outStream, "ns",     &results[i].ns);
+        WriteJsonStats(outStream, "cycles", &results[i].cycles);
+        WriteJsonCounters(outStream, &results[i]);
+
+        if (results[i].vectorIterations)
+            fprintf(outStream,
+                    "            \"vectorIterations\": %llu,\n"
+                    "            \"skippedIterations\": %llu,\n"
+                    "            \"filledPixels\": %llu,\n"
+                    "            \"laneOccupancy\": %.6f,\n",
+                    (unsigned long long)results[i].vectorIterations,
+                    (unsigned long long)results[i].skippedIterations,
+                    (unsigned long long)results[i].filledPixels, results[i].laneOccupancy);
+
+        if (results[i].rebases)
+            fprintf(outStream, "            \"rebases\": %llu,\n",
+                    (unsigned long long)results[i].rebases);
+
+        if (results[i].refinedPixels)
+            fprintf(outStream,
+                    "            \"refinedPixels\": %llu,\n"
+                    "            \"refinedFraction\": %.6f,\n",
+                    (unsigned long long)results[i].refinedPixels,
+                    (double)results[i].refinedPixels / (double)(args->width * args->height));
+
+        if (results[i].hasTileCacheStats)
+            fprintf(outStream,
+                    "            \"tileCacheLookups\": %llu,\n"
+                    "            \"tileCacheHits\": %llu,\n"
+                    "            \"tileCacheEvictions\": %llu,\n"
+                    "            \"tileCacheBytes\": %zu,\n",
+                    (unsigned long long)results[i].tileCacheStats.lookups,
+                    (unsigned long long)results[i].tileCacheStats.hits,
+                    (unsigned long long)results[i].tileCacheStats.evictions,
+                    results[i].tileCacheStats.bytes);
+
+        if (results[i].isVerified)
+            fprintf(outStream, "            \"differentPixels\": %llu,\n",
+                    (unsigned long long)results[i].numberOfDifferentPixels);
+
+        fprintf(outStream, "            \"cyclesPerPixelIteration\": %.6f\n        }%s\n",
+                results[i].cyclesPerPixelIteration, i + 1 < numberOfResults ? "," : "");
+    }
+
+    fprintf(outStream, "    ]\n}\n");
+
+    if (outStream != stdout)
+        fclose(outStream);
+
+    return true;
+}
+
+static void WriteJsonStats(FILE* outStream, const char* name, const BenchStats* stats)
+{
+    assert(outStream);
+    assert(name);
+    assert(stats);
+
+    fprintf(outStream,
+            "            \"%s\": { \"min\": %.0f, \"median\": %.0f, \"p99\": %.0f, "
+            "\"mean\": %.1f, \"stddev\": %.1f },\n",
+            name, stats->min, stats->median, stats->p99, stats->mean, stats->stddev);
+}
+
+// "counters": { "cycles": ..., "ipc": ... }, only if there are counters
+static void WriteJsonCounters(FILE* outStream, const BenchResult* result)
+{
+    assert(outStream);
+    assert(result);
+
+    bool hasAnyCounter = false;
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+    {
+        if (!result->hasCounters[i])
+            continue;
+
+        fprintf(outStream, "%s\"%s\": %.0f", hasAnyCounter ? ", " : "            \"counters\": { ",
+                GetPerfCounterName((PerfCounter)i), result->counters[i]);
+        hasAnyCounter = true;
+    }
+
+    if (!hasAnyCounter)
+        return;
+
+    if (result->hasCounters[PERF_CYCLES] && result->hasCounters[PERF_INSTRUCTIONS] &&
+        result->counters[PERF_CYCLES] > 0)
+        fprintf(outStream, ", \"ipc\": %.4f",
+                result->counters[PERF_INSTRUCTIONS] / result->counters[PERF_CYCLES]);
+
+    fprintf(outStream, " },\n");
+}
@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "KernelDispatch.h"
+#include "Mandelbrot.h"
+
+static uint8_t  ClampColor  (const float color);
+static uint8_t  MixChannel  (const uint32_t color, const uint32_t nextColor, const size_t shift,
+                             const float fraction);
+static uint32_t MakeRgba    (const uint8_t red, const uint8_t green, const uint8_t blue);
+
+void MandelbrotPaletteCtor(MandelbrotPalette* palette, const size_t maxNumberOfIterations,
+                           const MandelbrotPaletteType type)
+{
+    assert(palette);
+    assert(maxNumberOfIterations > 0 && maxNumberOfIterations <= MaxNumberOfIterationsLimit);
+
+    palette->colors = (uint32_t*)calloc(maxNumberOfIterations + 1, sizeof(*palette->colors));
+    palette->maxNumberOfIterations = maxNumberOfIterations;
+
+    for (size_t i = 0; i <= maxNumberOfIterations; ++i)
+    {
+        // 0 to 3 over the whole range, every color channel takes one third of it
+        const float t = (float)i / (float)maxNumberOfIterations * 3.f;
+
+        uint32_t color = 0;
+        switch (type)
+        {
+            case PALETTE_GREEN:
+                SetPixelColor((uint8_t*)&color, i, maxNumberOfIterations);
+                break;
+            case PALETTE_FIRE:
+                color = MakeRgba(ClampColor(t * 255.f), ClampColor((t - 1.f) * 255.f),
+                                 ClampColor((t - 2.f) * 255.f));
+                break;
+            case PALETTE_GRAY:
+                color = MakeRgba(ClampColor(t * 85.f), ClampColor(t * 85.f),
+                                 ClampColor(t * 85.f));
+                break;
+
+            case NUMBER_OF_PALETTES:
+            default:
+                assert(0 && "Unknown palette");
+                break;
+        }
+
+        palette->colors[i] = color;
+    }
+
+    // points of the set are black in every palette
+    palette->colors[maxNumberOfIterations] = MakeRgba(0, 0, 0);
+}
+
+void MandelbrotPaletteDtor(MandelbrotPalette* palette)
+{
+    assert(palette);
+
+    free(palette->colors);
+    palette->colors                = nullptr;
+    palette->maxNumberOfIterations = 0;
+}
+
+void ColorizeMandelbrot(uint8_t* pixels, const uint16_t* iterations,
+                        const size_t numberOfPixels, const MandelbrotPalette* palette)
+{
+    assert(pixels);
+    assert(iterations);
+    assert(palette);
+    assert((uintptr_t)pixels % 32 == 0);
+
+    static const bool hasAvx2 = (GetCpuFeatures() & CPU_FEATURE_AVX2) != 0;
+
+    if (hasAvx2)
+    {
+        ColorizeMandelbrotAvx2(pixels, iterations, numberOfPixels, palette);
+        return;
+    }
+
+    for (size_t i = 0; i < numberOfPixels; ++i)
+    {
+        assert(iterations[i] <= palette->maxNumberOfIterations);
+        memcpy(pixels + i * 4, &palette->colors[iterations[i]], 4);
+    }
+}
+
+void ColorizeMandelbrotSmooth(uint8_t* pixels, const float* smoothIterations,
+                              const size_t numberOfPixels, const MandelbrotPalette* palette)
+{
+    assert(pixels);
+    assert(smoothIterations);
+    assert(palette);
+    assert(palette->maxNumberOfIterations > 0);
+    assert((uintptr_t)pixels % 32 == 0);
+
+    static const bool hasAvx2 = (GetCpuFeatures() & CPU_FEATURE_AVX2) != 0;
+
+    // the avx2 version does whole groups of 8, the tail is left to the loop of the same rounding
+    size_t i = 0;
+    if (hasAvx2)
+    {
+        i = numberOfPixels / 8 * 8;
+        ColorizeMandelbrotSmoothAvx2(pixels, smoothIterations, i, palette);
+    }
+
+    const size_t maxNumberOfIterations = palette->maxNumberOfIterations;
+
+    for (; i < numberOfPixels; ++i)
+    {
+        assert(smoothIterations[i] >= 0 &&
+               smoothIterations[i] <= (float)maxNumberOfIterations);
+
+        // escaped pixels blend towards the last escaped color, not the black of the set
+        const size_t index = (size_t)smoothIterations[i];
+        const size_t next  = index + 1 < maxNumberOfIterations ? index + 1 :
+                                                                 maxNumberOfIterations - 1;
+        const float fraction = smoothIterations[i] - (float)index;
+
+        const uint32_t color     = palette->colors[index];
+        const uint32_t nextColor = palette->colors[next];
+
+        const uint32_t mixed = MakeRgba(MixChannel(color, nextColor, 0,  fraction),
+                                        MixChannel(color, nextColor, 8,  fraction),
+                                        MixChannel(color, nextColor, 16, fraction));
+        memcpy(pixels + i * 4, &mixed, 4);
+    }
+}
+
+// Same rounding as the avx2 version: color + (next - color) * fraction + 1/2, truncated.
+static uint8_t MixChannel(const uint32_t color, const uint32_t nextColor, const size_t shift,
+                          const float fraction)
+{
+    const float channel     = (float)(color     >> shift & 0xff);
+    const float nextChannel = (float)(nextColor >> shift & 0xff);
+
+    return (uint8_t)(channel + (nextChannel - channel) * fraction + 0.5f);
+}
+
+static uint8_t ClampColor(const float color)
+{
+    return color <= 0.f ? 0 : color >= 255.f ? 255 : (uint8_t)color;
+}
+
+// Bytes in memory are R, G, B, A as SFML wants them.
+static uint32_t MakeRgba(const uint8_t red, const uint8_t green, const uint8_t blue)
+{
+    return (uint32_t)red | (uint32_t)green << 8 | (uint32_t)blue << 16 | 255u << 24;
+}
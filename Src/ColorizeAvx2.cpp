@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <immintrin.h>
+#include <string.h>
+
+#include "Mandelbrot.h"
+
+// 8 pixels at a time: numbers of iterations are widened to 32 bits and used as indices of
+// the palette gather. The frame is written once and read by the texture upload, not by this
+// thread, so streaming stores go around the cache.
+void ColorizeMandelbrotAvx2(uint8_t* pixels, const uint16_t* iterations,
+                            const size_t numberOfPixels, const MandelbrotPalette* palette)
+{
+    assert(pixels);
+    assert(iterations);
+    assert(palette);
+    assert((uintptr_t)pixels % 32 == 0);
+
+    const int* colors = (const int*)palette->colors;
+
+    size_t i = 0;
+    for (; i + 8 <= numberOfPixels; i += 8)
+    {
+        __m256i numberOfIterations = _mm256_cvtepu16_epi32(
+                                         _mm_loadu_si128((const __m128i*)(iterations + i)));
+
+        _mm256_stream_si256((__m256i*)(pixels + i * 4),
+                            _mm256_i32gather_epi32(colors, numberOfIterations, 4));
+    }
+
+    for (; i < numberOfPixels; ++i)
+        memcpy(pixels + i * 4, &palette->colors[iterations[i]], 4);
+
+    // streaming stores are weakly ordered, they have to be visible to whoever reads
+    // the pixels next
+    _mm_sfence();
+}
+
+// The palette colors of the whole part and of the next count are gathered, every channel is
+// mixed in float and packed back. Only whole groups of 8, ColorizeMandelbrotSmooth does the
+// rest.
+void ColorizeMandelbrotSmoothAvx2(uint8_t* pixels, const float* smoothIterations,
+                                  const size_t numberOfPixels, const MandelbrotPalette* palette)
+{
+    assert(pixels);
+    assert(smoothIterations);
+    assert(palette);
+    assert(palette->maxNumberOfIterations > 0);
+    assert((uintptr_t)pixels % 32 == 0);
+    assert(numberOfPixels % 8 == 0);
+
+    const int* colors = (const int*)palette->colors;
+
+    const __m256i lastEscaped = _mm256_set1_epi32((int)palette->maxNumberOfIterations - 1);
+    const __m256i one         = _mm256_set1_epi32(1);
+    const __m256i channelMask = _mm256_set1_epi32(0xff);
+    const __m256i alpha       = _mm256_set1_epi32((int)0xff000000);
+    const __m256  half        = _mm256_set1_ps(0.5f);
+
+    for (size_t i = 0; i < numberOfPixels; i += 8)
+    {
+        __m256  smooth   = _mm256_loadu_ps(smoothIterations + i);
+        __m256i index    = _mm256_cvttps_epi32(smooth);
+        __m256i next     = _mm256_min_epi32(_mm256_add_epi32(index, one), lastEscaped);
+        __m256  fraction = _mm256_sub_ps(smooth, _mm256_cvtepi32_ps(index));
+
+        __m256i color     = _mm256_i32gather_epi32(colors, index, 4);
+        __m256i nextColor = _mm256_i32gather_epi32(colors, next,  4);
+
+        __m256i mixed = alpha;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            __m256 channel     = _mm256_cvtepi32_ps(_mm256_and_si256(
+                                                        _mm256_srli_epi32(color, shift),
+                                                        channelMask));
+            __m256 nextChannel = _mm256_cvtepi32_ps(_mm256_and_si256(
+                                                        _mm256_srli_epi32(nextColor, shift),
+                                                        channelMask));
+
+            __m256 mixedChannel = _mm256_add_ps(_mm256_add_ps(channel,
+                                                              _mm256_mul_ps(_mm256_sub_ps(
+                                                                                nextChannel,
+                                                                                channel),
+                                                                            fraction)),
+                                                half);
+            mixed = _mm256_or_si256(mixed, _mm256_slli_epi32(_mm256_cvttps_epi32(mixedChannel),
+                                                             shift));
+        }
+
+        _mm256_stream_si256((__m256i*)(pixels + i * 4), mixed);
+    }
+
+    _mm_sfence();
+}
@@ -0,0 +1,225 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "Distributed.h"
+#include "KernelDispatch.h"
+
+// State of a frame in the coordinator. Tiles to give are a stack, the lost ones are pushed
+// back on top of it and go first.
+struct DistributedFrame
+{
+    RenderTransport*      transport;
+    const MandelbrotView* view;
+    uint64_t              frameNumber;
+    size_t                kernelIndex;
+    size_t                tileSize;
+    size_t                numberOfTilesX;
+
+    size_t*               pendingTiles;
+    size_t                numberOfPendingTiles;
+
+    // tiles of the worker w are tilesInFlight[w * maxTilesInFlight ...]
+    size_t*               tilesInFlight;
+    size_t*               numberOfTilesInFlight;
+    size_t                maxTilesInFlight;
+    bool*                 isWorkerAlive;
+    size_t                numberOfAliveWorkers;
+
+    DistributedStats      stats;
+};
+
+static void GiveTiles  (DistributedFrame* frame, const size_t worker);
+static bool FinishTile (DistributedFrame* frame, const size_t worker, const size_t tileIndex);
+static void LoseWorker (DistributedFrame* frame, const size_t worker);
+
+void CalculateTileMessage(uint16_t* frame, const TileMessage* message)
+{
+    assert(frame);
+    assert(message);
+
+    size_t numberOfKernels = 0;
+    const MandelbrotKernelInfo* kernels = GetMandelbrotKernels(&numberOfKernels);
+    assert(message->kernelIndex < numberOfKernels);
+
+    MandelbrotStats stats = {};
+    kernels[message->kernelIndex].tileKernel(frame, &message->view, &message->tile, &stats);
+}
+
+bool CalculateMandelbrotSetDistributed(RenderTransport* transport, const size_t numberOfWorkers,
+                                       const MandelbrotView* view, const size_t kernelIndex,
+                                       const size_t tileSize, const size_t tilesInFlight,
+                                       DistributedStats* stats)
+{
+    assert(transport);
+    assert(transport->ops);
+    assert(numberOfWorkers > 0 && numberOfWorkers <= transport->maxNumberOfWorkers);
+    assert(view);
+    assert(view->width * view->height <= transport->maxNumberOfPixels);
+    assert(tileSize > 0);
+    assert(tilesInFlight > 0);
+
+    // results of the tiles of an earlier frame that was given up are told apart by it
+    static uint64_t lastFrameNumber = 0;
+
+    DistributedFrame frame = {};
+    frame.transport        = transport;
+    frame.view             = view;
+    frame.frameNumber      = ++lastFrameNumber;
+    frame.kernelIndex      = kernelIndex;
+    frame.tileSize         = tileSize;
+    frame.numberOfTilesX   = (view->width + tileSize - 1) / tileSize;
+    frame.maxTilesInFlight = tilesInFlight;
+
+    const size_t numberOfTilesY = (view->height + tileSize - 1) / tileSize;
+    const size_t numberOfTiles  = frame.numberOfTilesX * numberOfTilesY;
+
+    // the first tiles are on top
+    frame.pendingTiles         = (size_t*)malloc(numberOfTiles * sizeof(size_t));
+    frame.numberOfPendingTiles = numberOfTiles;
+    for (size_t i = 0; i < numberOfTiles; ++i)
+        frame.pendingTiles[i] = numberOfTiles - 1 - i;
+
+    frame.tilesInFlight         = (size_t*)malloc(numberOfWorkers * tilesInFlight *
+                                                  sizeof(size_t));
+    frame.numberOfTilesInFlight = (size_t*)calloc(numberOfWorkers, sizeof(size_t));
+    frame.isWorkerAlive         = (bool*)calloc(numberOfWorkers, sizeof(bool));
+
+    // workers that are already running are not started again
+    for (size_t worker = 0; worker < numberOfWorkers; ++worker)
+    {
+        frame.isWorkerAlive[worker] = transport->ops->startWorker(transport, worker);
+        frame.numberOfAliveWorkers += frame.isWorkerAlive[worker];
+    }
+
+    frame.stats.numberOfTiles = numberOfTiles;
+
+    size_t numberOfDoneTiles = 0;
+    bool   isFailed          = false;
+
+    while (numberOfDoneTiles < numberOfTiles && !isFailed)
+    {
+        for (size_t worker = 0; worker < numberOfWorkers; ++worker)
+            GiveTiles(&frame, worker);
+
+        if (!frame.numberOfAliveWorkers)
+            break;
+
+        size_t      worker = 0;
+        TileMessage result = {};
+
+        // workers above numberOfWorkers may be left running by an earlier frame, they have
+        // no tiles of this one
+        switch (transport->ops->receive(transport, &worker, &result))
+        {
+            case TRANSPORT_TILE_DONE:
+                if (worker < numberOfWorkers && result.frameNumber == frame.frameNumber &&
+                    FinishTile(&frame, worker, result.tileIndex))
+                    numberOfDoneTiles++;
+                break;
+
+            case TRANSPORT_WORKER_LOST:
+                if (worker < numberOfWorkers)
+                    LoseWorker(&frame, worker);
+                break;
+
+            case TRANSPORT_FAILED:
+                isFailed = true;
+                break;
+
+            default:
+                assert(0 && "Unknown transport event");
+                break;
+        }
+    }
+
+    free(frame.pendingTiles);
+    free(frame.tilesInFlight);
+    free(frame.numberOfTilesInFlight);
+    free(frame.isWorkerAlive);
+
+    if (stats)
+        *stats = frame.stats;
+
+    return numberOfDoneTiles == numberOfTiles;
+}
+
+static void GiveTiles(DistributedFrame* frame, const size_t worker)
+{
+    assert(frame);
+
+    RenderTransport* transport = frame->transport;
+    const size_t     tileSize  = frame->tileSize;
+
+    size_t* tilesInFlight = frame->tilesInFlight + worker * frame->maxTilesInFlight;
+
+    while (frame->isWorkerAlive[worker] && frame->numberOfPendingTiles > 0 &&
+           frame->numberOfTilesInFlight[worker] < frame->maxTilesInFlight)
+    {
+        const size_t tileIndex = frame->pendingTiles[--frame->numberOfPendingTiles];
+
+        TileMessage message = {};
+        message.frameNumber = frame->frameNumber;
+        message.tileIndex   = tileIndex;
+        message.kernelIndex = frame->kernelIndex;
+        message.view        = *frame->view;
+
+        message.tile.xBegin = tileIndex % frame->numberOfTilesX * tileSize;
+        message.tile.yBegin = tileIndex / frame->numberOfTilesX * tileSize;
+        message.tile.xEnd   = message.tile.xBegin + tileSize < frame->view->width ?
+                              message.tile.xBegin + tileSize : frame->view->width;
+        message.tile.yEnd   = message.tile.yBegin + tileSize < frame->view->height ?
+                              message.tile.yBegin + tileSize : frame->view->height;
+
+        tilesInFlight[frame->numberOfTilesInFlight[worker]++] = tileIndex;
+
+        if (!transport->ops->sendTile(transport, worker, &message))
+        {
+            transport->ops->stopWorker(transport, worker);
+            LoseWorker(frame, worker);
+        }
+    }
+}
+
+// False if the tile is not in flight on the worker.
+static bool FinishTile(DistributedFrame* frame, const size_t worker, const size_t tileIndex)
+{
+    assert(frame);
+
+    size_t* tilesInFlight = frame->tilesInFlight + worker * frame->maxTilesInFlight;
+    size_t* numberOfTiles = &frame->numberOfTilesInFlight[worker];
+
+    for (size_t i = 0; i < *numberOfTiles; ++i)
+    {
+        if (tilesInFlight[i] != tileIndex)
+            continue;
+
+        tilesInFlight[i] = tilesInFlight[--*numberOfTiles];
+        return true;
+    }
+
+    return false;
+}
+
+// Tiles of the lost worker go to the top of the stack and the worker is started again. What
+// it has written of them is overwritten by the next worker.
+static void LoseWorker(DistributedFrame* frame, const size_t worker)
+{
+    assert(frame);
+
+    if (!frame->isWorkerAlive[worker])
+        return;
+
+    size_t* tilesInFlight = frame->tilesInFlight + worker * frame->maxTilesInFlight;
+    for (size_t i = 0; i < frame->numberOfTilesInFlight[worker]; ++i)
+        frame->pendingTiles[frame->numberOfPendingTiles++] = tilesInFlight[i];
+
+    frame->stats.reissuedTiles += frame->numberOfTilesInFlight[worker];
+    frame->stats.lostWorkers++;
+    frame->numberOfTilesInFlight[worker] = 0;
+
+    if (!frame->transport->ops->startWorker(frame->transport, worker))
+    {
+        frame->isWorkerAlive[worker] = false;
+        frame->numberOfAliveWorkers--;
+    }
+}
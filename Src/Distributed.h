@@ -0,0 +1,85 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Mandelbrot.h"
+
+// A tile of a frame given to a worker. The kernel is an index in GetMandelbrotKernels, so the
+// message means the same in every process of the same binary, wherever it runs.
+struct TileMessage
+{
+    uint64_t       frameNumber;
+    size_t         tileIndex;
+    size_t         kernelIndex;
+
+    MandelbrotView view;
+    MandelbrotTile tile;
+};
+
+enum TransportEventType
+{
+    TRANSPORT_TILE_DONE,
+    // the worker is gone with its tiles, they have to be given to someone else
+    TRANSPORT_WORKER_LOST,
+    TRANSPORT_FAILED,
+};
+
+struct RenderTransport;
+
+// How the coordinator reaches the workers. Workers are numbered from 0, a transport keeps
+// the tiles they calculate in transport->frame, so the coordinator doesn't know if they are
+// written there in place or received from another machine.
+struct RenderTransportOps
+{
+    // Starts the worker of the slot or a new one in place of the lost one.
+    bool               (*startWorker)(RenderTransport* transport, const size_t worker);
+    void               (*stopWorker) (RenderTransport* transport, const size_t worker);
+
+    bool               (*sendTile)   (RenderTransport* transport, const size_t worker,
+                                      const TileMessage* message);
+    // Waits for the next event of any worker: a calculated tile in outMessage or a lost worker.
+    TransportEventType (*receive)    (RenderTransport* transport, size_t* outWorker,
+                                      TileMessage* outMessage);
+};
+
+struct RenderTransport
+{
+    const RenderTransportOps* ops;
+    void*                     state;
+
+    uint16_t*                 frame;
+    size_t                    maxNumberOfPixels;
+    size_t                    maxNumberOfWorkers;
+};
+
+// Workers are forked processes connected by sockets, the frame is a memfd mapping shared with
+// all of them and they write the iterations into it with no copies. A started worker of the
+// slot 0 kills itself after crashAfterTiles tiles if it is not 0, to test the recovery.
+bool LocalTransportCtor(RenderTransport* transport, const size_t maxNumberOfWorkers,
+                        const size_t maxNumberOfPixels, const size_t crashAfterTiles);
+void LocalTransportDtor(RenderTransport* transport);
+
+// Calculates a tile of the message into frame, which is view->width pixels wide. Used by the
+// workers of every transport.
+void CalculateTileMessage(uint16_t* frame, const TileMessage* message);
+
+struct DistributedStats
+{
+    size_t numberOfTiles;
+    // tiles given again because their worker was lost
+    size_t reissuedTiles;
+    size_t lostWorkers;
+};
+
+// Splits the frame into tiles and gives them to the workers [0, numberOfWorkers), every one
+// has at most tilesInFlight of them at once, so it starts the next one without waiting for
+// the coordinator. Tiles of a lost worker are given to the others and the worker is started
+// again. The frame is in transport->frame. False if no worker is left.
+bool CalculateMandelbrotSetDistributed(RenderTransport* transport, const size_t numberOfWorkers,
+                                       const MandelbrotView* view, const size_t kernelIndex,
+                                       const size_t tileSize, const size_t tilesInFlight,
+                                       DistributedStats* stats);
+
+#endif
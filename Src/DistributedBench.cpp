@@ -0,0 +1,239 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Distributed.h"
+#include "KernelDispatch.h"
+#include "Mandelbrot.h"
+
+static const size_t DefaultTileSize      = 64;
+static const size_t DefaultTilesInFlight = 2;
+static const size_t DefaultRepeats       = 10;
+
+struct DistributedArgs
+{
+    const char* kernelName;
+
+    size_t      width;
+    size_t      height;
+    double      centerX;
+    double      centerY;
+    double      scale;
+    size_t      maxNumberOfIterations;
+
+    size_t      maxNumberOfWorkers;
+    size_t      tileSize;
+    size_t      tilesInFlight;
+    size_t      numberOfRepeats;
+    size_t      crashAfterTiles;
+};
+
+static bool     ParseArgs      (int argc, char* argv[], DistributedArgs* args);
+static void     PrintUsage     (const char* programName);
+static double   GetMedian      (double* values, const size_t numberOfValues);
+static int      CompareDoubles (const void* a, const void* b);
+static uint64_t GetTimeNs      ();
+
+int main(int argc, char* argv[])
+{
+    DistributedArgs args = {};
+    if (!ParseArgs(argc, argv, &args))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const MandelbrotKernelInfo* kernel = SelectMandelbrotKernel(args.kernelName);
+    if (!kernel)
+        return 1;
+
+    MandelbrotView view = {};
+    const float dxPerPixel = 1.f / (float)args.width;
+    MandelbrotViewCtor(&view, args.width, args.height, args.centerX - CenterX,
+                       args.centerY - CenterY, args.scale, dxPerPixel, dxPerPixel,
+                       args.maxNumberOfIterations);
+
+    kernel = SelectMandelbrotKernelForView(kernel, &view);
+
+    size_t numberOfKernels = 0;
+    const size_t kernelIndex = (size_t)(kernel - GetMandelbrotKernels(&numberOfKernels));
+
+    const size_t numberOfPixels = args.width * args.height;
+
+    // the frame of one process is the reference and the time every worker count is compared
+    // with. One thread, so there are no threads yet when the workers are forked.
+    uint16_t* reference = (uint16_t*)calloc(numberOfPixels, sizeof(*reference));
+    double*   times     = (double*)calloc(args.numberOfRepeats, sizeof(*times));
+
+    TileScheduler scheduler = {};
+    TileSchedulerCtor(&scheduler, 1);
+
+    CalculateMandelbrotSetTiled(reference, &view, &scheduler, kernel->tileKernel, nullptr);
+    for (size_t repeat = 0; repeat < args.numberOfRepeats; ++repeat)
+    {
+        const uint64_t startTime = GetTimeNs();
+        CalculateMandelbrotSetTiled(reference, &view, &scheduler, kernel->tileKernel, nullptr);
+        times[repeat] = (double)(GetTimeNs() - startTime) / 1e6;
+    }
+    const double singleProcessTime = GetMedian(times, args.numberOfRepeats);
+
+    TileSchedulerDtor(&scheduler);
+
+    RenderTransport transport = {};
+    if (!LocalTransportCtor(&transport, args.maxNumberOfWorkers, numberOfPixels,
+                            args.crashAfterTiles))
+    {
+        printf("Can't create the shared frame\n");
+        LocalTransportDtor(&transport);
+        free(reference);
+        free(times);
+        return 1;
+    }
+
+    printf("%zu x %zu, kernel - %s, tiles %zu x %zu, %zu in flight per worker\n",
+           args.width, args.height, kernel->name, args.tileSize, args.tileSize,
+           args.tilesInFlight);
+    printf("one process, one thread: median %.3f ms\n", singleProcessTime);
+    printf("%8s %10s %10s %8s %10s %9s %6s %s\n", "workers", "min ms", "median ms", "speedup",
+           "efficiency", "reissued", "lost", "frame");
+
+    bool isFailed = false;
+    for (size_t numberOfWorkers = 1; numberOfWorkers <= args.maxNumberOfWorkers && !isFailed;
+         ++numberOfWorkers)
+    {
+        DistributedStats allStats = {};
+
+        // the first frame starts the new worker and is not measured
+        for (size_t repeat = 0; repeat <= args.numberOfRepeats && !isFailed; ++repeat)
+        {
+            memset(transport.frame, 0, numberOfPixels * sizeof(*transport.frame));
+
+            DistributedStats stats = {};
+
+            const uint64_t startTime = GetTimeNs();
+            isFailed = !CalculateMandelbrotSetDistributed(&transport, numberOfWorkers, &view,
+                                                          kernelIndex, args.tileSize,
+                                                          args.tilesInFlight, &stats);
+            if (repeat > 0)
+                times[repeat - 1] = (double)(GetTimeNs() - startTime) / 1e6;
+
+            allStats.reissuedTiles += stats.reissuedTiles;
+            allStats.lostWorkers   += stats.lostWorkers;
+
+            isFailed = isFailed ||
+                       memcmp(transport.frame, reference, numberOfPixels * sizeof(*reference));
+        }
+
+        if (isFailed)
+        {
+            printf("%8zu failed, the frame is not calculated or differs from the reference\n",
+                   numberOfWorkers);
+            break;
+        }
+
+        const double medianTime = GetMedian(times, args.numberOfRepeats);
+        const double minTime    = times[0];
+        const double speedup    = singleProcessTime / medianTime;
+
+        printf("%8zu %10.3f %10.3f %8.2f %9.0f%% %9zu %6zu %s\n", numberOfWorkers,
+               minTime, medianTime, speedup, 100 * speedup / (double)numberOfWorkers,
+               allStats.reissuedTiles, allStats.lostWorkers, "same");
+    }
+
+    LocalTransportDtor(&transport);
+    free(reference);
+    free(times);
+
+    return isFailed;
+}
+
+static bool ParseArgs(int argc, char* argv[], DistributedArgs* args)
+{
+    assert(argv);
+    assert(args);
+
+    args->kernelName            = nullptr;
+    args->width                 = 800;
+    args->height                = 600;
+    args->centerX               = CenterX;
+    args->centerY               = CenterY;
+    args->scale                 = 1;
+    args->maxNumberOfIterations = DefaultMaxNumberOfIterations;
+    args->maxNumberOfWorkers    = GetDefaultNumberOfThreads();
+    args->tileSize              = DefaultTileSize;
+    args->tilesInFlight         = DefaultTilesInFlight;
+    args->numberOfRepeats       = DefaultRepeats;
+    args->crashAfterTiles       = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        const char* option = argv[i];
+        const char* value  = argv[++i];
+
+        if      (strcmp(option, "--kernel")      == 0) args->kernelName            = value;
+        else if (strcmp(option, "--width")       == 0) args->width                 = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--height")      == 0) args->height                = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--center-x")    == 0) args->centerX               = strtod (value, nullptr);
+        else if (strcmp(option, "--center-y")    == 0) args->centerY               = strtod (value, nullptr);
+        else if (strcmp(option, "--scale")       == 0) args->scale                 = strtod (value, nullptr);
+        else if (strcmp(option, "--iterations")  == 0) args->maxNumberOfIterations = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--workers")     == 0) args->maxNumberOfWorkers    = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--tile-size")   == 0) args->tileSize              = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--in-flight")   == 0) args->tilesInFlight         = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--repeats")     == 0) args->numberOfRepeats       = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--crash-after") == 0) args->crashAfterTiles       = strtoul(value, nullptr, 10);
+        else
+            return false;
+    }
+
+    return args->width > 0 && args->height > 0 && args->scale > 0 &&
+           args->maxNumberOfIterations > 0 &&
+           args->maxNumberOfIterations <= MaxNumberOfIterationsLimit &&
+           args->maxNumberOfWorkers > 0 && args->tileSize > 0 && args->tilesInFlight > 0 &&
+           args->numberOfRepeats > 0;
+}
+
+static void PrintUsage(const char* programName)
+{
+    fprintf(stderr,
+            "Usage: %s [--workers N] [--tile-size N] [--in-flight N] [--repeats N]\n"
+            "          [--crash-after N] [--width N] [--height N] [--center-x X]\n"
+            "          [--center-y Y] [--scale S] [--iterations N] [--kernel name]\n"
+            "Renders the frame by 1 to N worker processes into a shared frame and compares it\n"
+            "with the frame of one process. With --crash-after the first worker kills itself\n"
+            "after N tiles and its tiles are given to the others.\n",
+            programName);
+}
+
+// Sorts the values.
+static double GetMedian(double* values, const size_t numberOfValues)
+{
+    assert(values);
+    assert(numberOfValues > 0);
+
+    qsort(values, numberOfValues, sizeof(*values), CompareDoubles);
+
+    return numberOfValues % 2 ? values[numberOfValues / 2] :
+           (values[numberOfValues / 2 - 1] + values[numberOfValues / 2]) / 2;
+}
+
+static int CompareDoubles(const void* a, const void* b)
+{
+    double first  = *(const double*)a;
+    double second = *(const double*)b;
+
+    return (first > second) - (first < second);
+}
+
+static uint64_t GetTimeNs()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
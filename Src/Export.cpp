@@ -0,0 +1,403 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "ImageWriter.h"
+#include "KernelDispatch.h"
+#include "Mandelbrot.h"
+
+// Bands are calculated into a ring of buffers, the writer thread colorizes and writes them
+// while the next ones are calculated. Memory doesn't depend on the height of the image.
+static const size_t   NumberOfBandBuffers = 4;
+static const size_t   DefaultBandRows     = 64;
+
+static const uint64_t ProgressPeriodNs    = 1000000000;
+
+static const char* const PaletteNames[]   = { "green", "fire", "gray" };
+
+struct ExportArgs
+{
+    const char*           kernelName;
+    const char*           outputFileName;
+    ImageFormat           format;
+    bool                  useMapping;
+
+    size_t                width;
+    size_t                height;
+    size_t                bandRows;
+
+    double                centerX;
+    double                centerY;
+    double                scale;
+
+    size_t                maxNumberOfIterations;
+    MandelbrotPaletteType paletteType;
+    size_t                numberOfThreads;
+    bool                  useSmoothColoring;
+};
+
+// Band b is in the buffer b % NumberOfBandBuffers, the renderer waits until the writer is
+// done with the band that was there before it.
+struct ExportPipeline
+{
+    std::mutex              mutex;
+    std::condition_variable bandCalculated;
+    std::condition_variable bandWritten;
+
+    uint16_t*               iterations[NumberOfBandBuffers];
+    // instead of the iterations if the image is colored smoothly
+    float*                  smoothIterations[NumberOfBandBuffers];
+    size_t                  numberOfCalculatedBands;
+    size_t                  numberOfWrittenBands;
+
+    // used by the writer thread only
+    ImageWriter*            writer;
+    const MandelbrotPalette* palette;
+    uint8_t*                pixels;
+
+    size_t                  width;
+    size_t                  height;
+    size_t                  bandRows;
+    size_t                  numberOfBands;
+
+    uint64_t                rendererWaitNs;
+    uint64_t                writerWaitNs;
+};
+
+static bool     ParseArgs      (int argc, char* argv[], ExportArgs* args);
+static void     PrintUsage     (const char* programName);
+
+static void     WriteBands     (ExportPipeline* pipeline);
+static void     GetBandView    (const MandelbrotView* view, const size_t firstRow,
+                                const size_t numberOfRows, MandelbrotView* outBandView);
+static void     PrintProgress  (const size_t numberOfRows, const size_t height,
+                                const size_t width, const uint64_t timeNs);
+static size_t   GetPeakRssKb   ();
+static uint64_t GetTimeNs      ();
+
+int main(int argc, char* argv[])
+{
+    ExportArgs args = {};
+    if (!ParseArgs(argc, argv, &args))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const MandelbrotKernelInfo* kernel = SelectMandelbrotKernel(args.kernelName);
+    if (!kernel)
+        return 1;
+
+    MandelbrotView view = {};
+    const float dxPerPixel = 1.f / (float)args.width;
+    MandelbrotViewCtor(&view, args.width, args.height, args.centerX - CenterX,
+                       args.centerY - CenterY, args.scale, dxPerPixel, dxPerPixel,
+                       args.maxNumberOfIterations);
+
+    // every band is calculated by the same kernel, so the picture has no seams
+    kernel = SelectMandelbrotKernelForView(kernel, &view);
+
+    // the smooth kernel is the float avx2 one, deeper images are colored by the counts
+    bool isSmooth = false;
+    if (args.useSmoothColoring)
+    {
+        const MandelbrotKernelInfo* avx2Kernel = FindMandelbrotKernel("avx2");
+        if (!avx2Kernel || !IsKernelSupported(avx2Kernel))
+        {
+            printf("Smooth coloring needs the avx2 kernel, it is not supported by this cpu\n");
+            return 1;
+        }
+
+        isSmooth = IsFloatPrecisionEnough(&view);
+        if (!isSmooth)
+            printf("Pixels are too close for float, the image is colored by the counts\n");
+    }
+
+    ImageWriter writer = {};
+    if (!ImageWriterCtor(&writer, args.outputFileName, args.format, args.width, args.height,
+                         args.useMapping))
+    {
+        printf("Can't create %s\n", args.outputFileName);
+        ImageWriterDtor(&writer);
+        return 1;
+    }
+
+    printf("Exporting %zu x %zu to %s, kernel - %s, threads - %zu, bands of %zu rows\n",
+           args.width, args.height, args.outputFileName, isSmooth ? "avx2-smooth" : kernel->name,
+           args.numberOfThreads, args.bandRows);
+
+    TileScheduler scheduler = {};
+    TileSchedulerCtor(&scheduler, args.numberOfThreads);
+
+    MandelbrotPalette palette = {};
+    MandelbrotPaletteCtor(&palette, args.maxNumberOfIterations, args.paletteType);
+
+    const size_t bandPixels = args.width * args.bandRows;
+
+    ExportPipeline pipeline = {};
+    for (size_t i = 0; i < NumberOfBandBuffers; ++i)
+    {
+        if (isSmooth)
+            pipeline.smoothIterations[i] = (float*)calloc(bandPixels,
+                                                          sizeof(*pipeline.smoothIterations[i]));
+        else
+            pipeline.iterations[i] = (uint16_t*)calloc(bandPixels,
+                                                       sizeof(*pipeline.iterations[i]));
+    }
+
+    // the colorizer needs 32 bytes aligned pixels
+    pipeline.pixels        = (uint8_t*)aligned_alloc(32, (bandPixels * 4 + 31) / 32 * 32);
+    pipeline.writer        = &writer;
+    pipeline.palette       = &palette;
+    pipeline.width         = args.width;
+    pipeline.height        = args.height;
+    pipeline.bandRows      = args.bandRows;
+    pipeline.numberOfBands = (args.height + args.bandRows - 1) / args.bandRows;
+
+    const uint64_t startTime = GetTimeNs();
+    std::thread writerThread(WriteBands, &pipeline);
+
+    uint64_t lastProgressTime = startTime;
+    for (size_t band = 0; band < pipeline.numberOfBands; ++band)
+    {
+        size_t numberOfWrittenBands = 0;
+        {
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+
+            const uint64_t waitStart = GetTimeNs();
+            pipeline.bandWritten.wait(lock, [&pipeline, band]
+                                      {
+                                          return band - pipeline.numberOfWrittenBands <
+                                                 NumberOfBandBuffers;
+                                      });
+            pipeline.rendererWaitNs += GetTimeNs() - waitStart;
+
+            numberOfWrittenBands = pipeline.numberOfWrittenBands;
+        }
+
+        const size_t firstRow     = band * args.bandRows;
+        const size_t numberOfRows = firstRow + args.bandRows <= args.height ?
+                                    args.bandRows : args.height - firstRow;
+
+        MandelbrotView bandView = {};
+        GetBandView(&view, firstRow, numberOfRows, &bandView);
+
+        const size_t buffer = band % NumberOfBandBuffers;
+        if (isSmooth)
+            CalculateMandelbrotSetSmooth(pipeline.smoothIterations[buffer], &bandView, &scheduler,
+                                         nullptr);
+        else
+            CalculateMandelbrotSetTiled(pipeline.iterations[buffer], &bandView, &scheduler,
+                                        kernel->tileKernel, nullptr);
+
+        {
+            std::lock_guard<std::mutex> lock(pipeline.mutex);
+            pipeline.numberOfCalculatedBands = band + 1;
+        }
+        pipeline.bandCalculated.notify_one();
+
+        const uint64_t time = GetTimeNs();
+        if (time - lastProgressTime >= ProgressPeriodNs)
+        {
+            const size_t writtenRows = numberOfWrittenBands * args.bandRows;
+            PrintProgress(writtenRows < args.height ? writtenRows : args.height, args.height,
+                          args.width, time - startTime);
+            lastProgressTime = time;
+        }
+    }
+
+    writerThread.join();
+    const bool isWritten = ImageWriterDtor(&writer);
+
+    const uint64_t timeNs = GetTimeNs() - startTime;
+    PrintProgress(args.height, args.height, args.width, timeNs);
+    printf("\n");
+
+    // the side that waits less is the bottleneck
+    printf("Renderer waited for the writer - %.2f s, writer waited for bands - %.2f s, "
+           "peak RSS - %zu MB\n",
+           (double)pipeline.rendererWaitNs / 1e9, (double)pipeline.writerWaitNs / 1e9,
+           GetPeakRssKb() / 1024);
+
+    for (size_t i = 0; i < NumberOfBandBuffers; ++i)
+    {
+        free(pipeline.iterations[i]);
+        free(pipeline.smoothIterations[i]);
+    }
+    free(pipeline.pixels);
+    MandelbrotPaletteDtor(&palette);
+    TileSchedulerDtor(&scheduler);
+
+    if (!isWritten)
+    {
+        printf("Failed to write %s\n", args.outputFileName);
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool ParseArgs(int argc, char* argv[], ExportArgs* args)
+{
+    assert(argv);
+    assert(args);
+
+    args->kernelName     = nullptr;
+    args->outputFileName = "mandelbrot.ppm";
+    args->format         = IMAGE_PPM;
+    args->useMapping     = false;
+
+    args->width    = 16384;
+    args->height   = 12288;
+    args->bandRows = DefaultBandRows;
+    args->centerX  = CenterX;
+    args->centerY  = CenterY;
+    args->scale    = 1;
+
+    args->maxNumberOfIterations = DefaultMaxNumberOfIterations;
+    args->paletteType           = PALETTE_GREEN;
+    args->numberOfThreads       = GetDefaultNumberOfThreads();
+    args->useSmoothColoring     = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        const char* option = argv[i];
+        const char* value  = argv[++i];
+
+        if      (strcmp(option, "--kernel")     == 0) args->kernelName            = value;
+        else if (strcmp(option, "--output")     == 0) args->outputFileName        = value;
+        else if (strcmp(option, "--format")     == 0) args->format                = GetImageFormat(value);
+        else if (strcmp(option, "--mmap")       == 0) args->useMapping            = strcmp(value, "on") == 0;
+        else if (strcmp(option, "--width")      == 0) args->width                 = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--height")     == 0) args->height                = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--band-rows")  == 0) args->bandRows              = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--center-x")   == 0) args->centerX               = strtod (value, nullptr);
+        else if (strcmp(option, "--center-y")   == 0) args->centerY               = strtod (value, nullptr);
+        else if (strcmp(option, "--scale")      == 0) args->scale                 = strtod (value, nullptr);
+        else if (strcmp(option, "--iterations") == 0) args->maxNumberOfIterations = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--threads")    == 0) args->numberOfThreads       = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--smooth")     == 0) args->useSmoothColoring     = strcmp(value, "on") == 0;
+        else if (strcmp(option, "--palette")    == 0)
+        {
+            args->paletteType = NUMBER_OF_PALETTES;
+            for (size_t palette = 0; palette < NUMBER_OF_PALETTES; ++palette)
+            {
+                if (strcmp(value, PaletteNames[palette]) == 0)
+                    args->paletteType = (MandelbrotPaletteType)palette;
+            }
+        }
+        else
+            return false;
+    }
+
+    return args->width > 0 && args->height > 0 && args->bandRows > 0 && args->scale > 0 &&
+           args->format != NUMBER_OF_IMAGE_FORMATS &&
+           args->paletteType != NUMBER_OF_PALETTES &&
+           !(args->useMapping && args->format == IMAGE_PNG) &&
+           args->maxNumberOfIterations > 0 &&
+           args->maxNumberOfIterations <= MaxNumberOfIterationsLimit &&
+           args->numberOfThreads > 0;
+}
+
+static void PrintUsage(const char* programName)
+{
+    fprintf(stderr,
+            "Usage: %s [--output file] [--format ppm|png|raw] [--mmap on|off]\n"
+            "          [--width N] [--height N] [--band-rows N]\n"
+            "          [--center-x X] [--center-y Y] [--scale S] [--iterations N]\n"
+            "          [--palette green|fire|gray] [--kernel name] [--threads N]\n"
+            "          [--smooth on|off]\n"
+            "Renders the image band by band, only %zu bands are in memory at once.\n"
+            "Raw is RGBA rows without a header. Mapping is for ppm and raw only.\n"
+            "Iterations are at most %zu. Smooth coloring has no bands between the counts,\n"
+            "it is calculated by the avx2-smooth kernel while float is precise enough.\n",
+            programName, NumberOfBandBuffers, MaxNumberOfIterationsLimit);
+}
+
+static void WriteBands(ExportPipeline* pipeline)
+{
+    assert(pipeline);
+
+    for (size_t band = 0; band < pipeline->numberOfBands; ++band)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pipeline->mutex);
+
+            const uint64_t waitStart = GetTimeNs();
+            pipeline->bandCalculated.wait(lock, [pipeline, band]
+                                          {
+                                              return pipeline->numberOfCalculatedBands > band;
+                                          });
+            pipeline->writerWaitNs += GetTimeNs() - waitStart;
+        }
+
+        const size_t firstRow     = band * pipeline->bandRows;
+        const size_t numberOfRows = firstRow + pipeline->bandRows <= pipeline->height ?
+                                    pipeline->bandRows : pipeline->height - firstRow;
+
+        const size_t buffer = band % NumberOfBandBuffers;
+        if (pipeline->smoothIterations[buffer])
+            ColorizeMandelbrotSmooth(pipeline->pixels, pipeline->smoothIterations[buffer],
+                                     pipeline->width * numberOfRows, pipeline->palette);
+        else
+            ColorizeMandelbrot(pipeline->pixels, pipeline->iterations[buffer],
+                               pipeline->width * numberOfRows, pipeline->palette);
+        ImageWriterWriteBand(pipeline->writer, pipeline->pixels, numberOfRows);
+
+        {
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            pipeline->numberOfWrittenBands = band + 1;
+        }
+        pipeline->bandWritten.notify_one();
+    }
+}
+
+// Rows [firstRow, firstRow + numberOfRows) of the view as a view of their own.
+static void GetBandView(const MandelbrotView* view, const size_t firstRow,
+                        const size_t numberOfRows, MandelbrotView* outBandView)
+{
+    assert(view);
+    assert(outBandView);
+
+    *outBandView = *view;
+
+    outBandView->height        = numberOfRows;
+    outBandView->y0BeginDouble = view->y0BeginDouble + (double)firstRow * view->dyDouble;
+    outBandView->y0Begin       = (float)outBandView->y0BeginDouble;
+}
+
+static void PrintProgress(const size_t numberOfRows, const size_t height, const size_t width,
+                          const uint64_t timeNs)
+{
+    const double megapixels = (double)(numberOfRows * width) / 1e6;
+
+    printf("\rRows %zu / %zu (%.1f%%), %.1f Mpixel in %.1f s, %.1f Mpixel/s", numberOfRows,
+           height, 100. * (double)numberOfRows / (double)height, megapixels,
+           (double)timeNs / 1e9, megapixels / ((double)timeNs / 1e9));
+    fflush(stdout);
+}
+
+static size_t GetPeakRssKb()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (size_t)usage.ru_maxrss;
+}
+
+static uint64_t GetTimeNs()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
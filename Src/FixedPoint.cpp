@@ -0,0 +1,215 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "FixedPoint.h"
+
+static const size_t IntegerLimb = FixedPointNumberOfLimbs - 1;
+
+static void Negate         (FixedPoint* number);
+static void DivideByTen    (FixedPoint* number);
+
+void FixedPointFromDouble(FixedPoint* number, const double value)
+{
+    assert(number);
+    assert(fabs(value) < 2147483648.);
+
+    memset(number, 0, sizeof(*number));
+
+    double magnitude = fabs(value);
+    double integer   = floor(magnitude);
+
+    number->limbs[IntegerLimb] = (uint32_t)integer;
+
+    // every step moves 32 bits of the fraction into a limb, a double runs out in two
+    double fraction = magnitude - integer;
+    for (size_t i = IntegerLimb; i-- > 0 && fraction > 0;)
+    {
+        fraction *= 4294967296.;
+        const double limb = floor(fraction);
+
+        number->limbs[i] = (uint32_t)limb;
+        fraction -= limb;
+    }
+
+    if (value < 0)
+        Negate(number);
+}
+
+bool FixedPointFromString(FixedPoint* number, const char* text)
+{
+    assert(number);
+    assert(text);
+
+    memset(number, 0, sizeof(*number));
+
+    const bool isNegative = *text == '-';
+    if (*text == '-' || *text == '+')
+        text++;
+
+    uint64_t integer         = 0;
+    size_t   numberOfDigits  = 0;
+    for (; *text >= '0' && *text <= '9'; ++text, ++numberOfDigits)
+    {
+        integer = integer * 10 + (uint64_t)(*text - '0');
+        if (integer > INT32_MAX)
+            return false;
+    }
+
+    const char* fractionBegin = text;
+    const char* fractionEnd   = text;
+    if (*text == '.')
+    {
+        fractionBegin = fractionEnd = text + 1;
+        while (*fractionEnd >= '0' && *fractionEnd <= '9')
+            fractionEnd++;
+
+        numberOfDigits += (size_t)(fractionEnd - fractionBegin);
+        text = fractionEnd;
+    }
+
+    if (numberOfDigits == 0 || *text != '\0')
+        return false;
+
+    // 0.d1d2...dn = (d1 + (d2 + ... (dn + 0) / 10 ...) / 10) / 10
+    for (const char* digit = fractionEnd; digit-- != fractionBegin;)
+    {
+        number->limbs[IntegerLimb] = (uint32_t)(*digit - '0');
+        DivideByTen(number);
+    }
+
+    number->limbs[IntegerLimb] = (uint32_t)integer;
+
+    if (isNegative)
+        Negate(number);
+
+    return true;
+}
+
+double FixedPointToDouble(const FixedPoint* number)
+{
+    assert(number);
+
+    FixedPoint magnitude = *number;
+
+    const bool isNegative = FixedPointIsNegative(number);
+    if (isNegative)
+        Negate(&magnitude);
+
+    // the smallest limbs first, so nothing is lost before it is rounded once
+    double value = 0;
+    for (size_t i = 0; i < FixedPointNumberOfLimbs; ++i)
+        value += ldexp((double)magnitude.limbs[i], 32 * ((int)i - (int)IntegerLimb));
+
+    return isNegative ? -value : value;
+}
+
+bool FixedPointIsNegative(const FixedPoint* number)
+{
+    assert(number);
+
+    return number->limbs[IntegerLimb] >> 31;
+}
+
+void FixedPointAdd(FixedPoint* result, const FixedPoint* a, const FixedPoint* b)
+{
+    assert(result);
+    assert(a);
+    assert(b);
+
+    uint64_t carry = 0;
+    for (size_t i = 0; i < FixedPointNumberOfLimbs; ++i)
+    {
+        const uint64_t sum = (uint64_t)a->limbs[i] + b->limbs[i] + carry;
+
+        result->limbs[i] = (uint32_t)sum;
+        carry            = sum >> 32;
+    }
+}
+
+void FixedPointSub(FixedPoint* result, const FixedPoint* a, const FixedPoint* b)
+{
+    assert(result);
+    assert(a);
+    assert(b);
+
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < FixedPointNumberOfLimbs; ++i)
+    {
+        const uint64_t difference = (uint64_t)a->limbs[i] - b->limbs[i] - borrow;
+
+        result->limbs[i] = (uint32_t)difference;
+        borrow           = (difference >> 32) & 1;
+    }
+}
+
+void FixedPointMul(FixedPoint* result, const FixedPoint* a, const FixedPoint* b)
+{
+    assert(result);
+    assert(a);
+    assert(b);
+
+    FixedPoint aMagnitude = *a;
+    FixedPoint bMagnitude = *b;
+
+    const bool isANegative = FixedPointIsNegative(a);
+    const bool isBNegative = FixedPointIsNegative(b);
+
+    if (isANegative) Negate(&aMagnitude);
+    if (isBNegative) Negate(&bMagnitude);
+
+    // schoolbook product of the limbs as integers, the point is IntegerLimb limbs up
+    uint32_t product[2 * FixedPointNumberOfLimbs] = {};
+    for (size_t i = 0; i < FixedPointNumberOfLimbs; ++i)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < FixedPointNumberOfLimbs; ++j)
+        {
+            const uint64_t sum = (uint64_t)aMagnitude.limbs[i] * bMagnitude.limbs[j] +
+                                 product[i + j] + carry;
+
+            product[i + j] = (uint32_t)sum;
+            carry          = sum >> 32;
+        }
+
+        product[i + FixedPointNumberOfLimbs] = (uint32_t)carry;
+    }
+
+    assert(product[2 * FixedPointNumberOfLimbs - 1] == 0 && "Fixed point overflow");
+
+    memcpy(result->limbs, product + IntegerLimb, sizeof(result->limbs));
+    assert(!FixedPointIsNegative(result) && "Fixed point overflow");
+
+    if (isANegative != isBNegative)
+        Negate(result);
+}
+
+static void Negate(FixedPoint* number)
+{
+    assert(number);
+
+    uint64_t carry = 1;
+    for (size_t i = 0; i < FixedPointNumberOfLimbs; ++i)
+    {
+        const uint64_t sum = (uint64_t)~number->limbs[i] + carry;
+
+        number->limbs[i] = (uint32_t)sum;
+        carry            = sum >> 32;
+    }
+}
+
+// Magnitude only, the number has to be non-negative.
+static void DivideByTen(FixedPoint* number)
+{
+    assert(number);
+
+    uint64_t remainder = 0;
+    for (size_t i = FixedPointNumberOfLimbs; i-- > 0;)
+    {
+        const uint64_t current = remainder << 32 | number->limbs[i];
+
+        number->limbs[i] = (uint32_t)(current / 10);
+        remainder        = current % 10;
+    }
+}
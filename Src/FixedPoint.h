@@ -0,0 +1,32 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// limbs[FixedPointNumberOfLimbs - 1] is the signed integer part, the rest is the fraction,
+// so numbers are in [-2^31, 2^31) with 224 bits after the point.
+static const size_t FixedPointNumberOfLimbs = 8;
+
+// Two's complement number of 32 bit limbs, the least significant limb first. Enough for
+// the center of a view zoomed far beyond double, without any bignum library.
+struct FixedPoint
+{
+    uint32_t limbs[FixedPointNumberOfLimbs];
+};
+
+void   FixedPointFromDouble(FixedPoint* number, const double value);
+// Decimal number like "-0.743643887037158704752191506114774", returns false if the text
+// is not one or the integer part doesn't fit.
+bool   FixedPointFromString(FixedPoint* number, const char* text);
+double FixedPointToDouble  (const FixedPoint* number);
+
+bool   FixedPointIsNegative(const FixedPoint* number);
+
+// result may be the same as a or b
+void   FixedPointAdd       (FixedPoint* result, const FixedPoint* a, const FixedPoint* b);
+void   FixedPointSub       (FixedPoint* result, const FixedPoint* a, const FixedPoint* b);
+// Fraction bits that don't fit are dropped.
+void   FixedPointMul       (FixedPoint* result, const FixedPoint* a, const FixedPoint* b);
+
+#endif
@@ -1,10 +1,29 @@
 section .text
 
 global GetTimeStampCounter
+global GetTimeStampCounterStart
+global GetTimeStampCounterEnd
 
 GetTimeStampCounter:
     rdtsc
     shl rdx, 32
     add rax, rdx
     ret
-    
\ No newline at end of file
+
+; lfence waits for the instructions before it, so the code before the measurement
+; is not counted
+GetTimeStampCounterStart:
+    lfence
+    rdtsc
+    shl rdx, 32
+    add rax, rdx
+    ret
+
+; rdtscp waits for the measured instructions, lfence keeps the code after it from starting
+; before the counter is read
+GetTimeStampCounterEnd:
+    rdtscp
+    lfence
+    shl rdx, 32
+    add rax, rdx
+    ret
@@ -0,0 +1,528 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ImageWriter.h"
+
+static const char* const ImageFormatNames[] = { "ppm", "png", "raw" };
+
+static const uint8_t  PngSignature[]      = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+// zlib header of a stream without compression and with the default window
+static const uint8_t  ZlibHeader[]        = { 0x78, 0x01 };
+static const size_t   MaxStoredBlockSize  = 65535;
+static const uint32_t AdlerModulo         = 65521;
+// the most bytes the sums of adler32 can take without overflowing 32 bits
+static const size_t   MaxAdlerRun         = 5552;
+
+// slicing by 8: CrcTables[k][byte] is the crc of the byte followed by k zero bytes, so 8
+// bytes are done with 8 independent lookups
+static uint32_t CrcTables[8][256] = {};
+
+static void     InitWriter        (ImageWriter* writer, const ImageFormat format,
+                                   const size_t width, const size_t height);
+static size_t   GetBytesPerPixel  (const ImageFormat format);
+static void     WriteHeader       (ImageWriter* writer, uint8_t* header);
+static void     WriteMappedBand   (ImageWriter* writer, const uint8_t* pixels,
+                                   const size_t numberOfRows);
+static uint8_t* GetRowBuffer      (ImageWriter* writer, const size_t size);
+static void     ConvertToRgb      (uint8_t* outRgb, const uint8_t* rgba,
+                                   const size_t numberOfPixels);
+static void     WritePngData      (ImageWriter* writer, const uint8_t* data, const size_t size,
+                                   const bool isLast);
+static void     WritePngChunk     (ImageWriter* writer, const char* type, const uint8_t* data,
+                                   const size_t size);
+static void     WriteChunkPart    (ImageWriter* writer, const void* data, const size_t size,
+                                   uint32_t* crc);
+static void     WriteBytes        (ImageWriter* writer, const void* data, const size_t size);
+static void     SetBigEndian32    (uint8_t* bytes, const uint32_t value);
+static uint32_t ToBigEndian32     (const uint32_t value);
+static bool     FillCrcTable      ();
+static uint32_t UpdateCrc         (uint32_t crc, const uint8_t* data, const size_t size);
+static uint32_t UpdateAdler       (const uint32_t adler, const uint8_t* data, const size_t size);
+
+bool ImageWriterCtor(ImageWriter* writer, const char* fileName, const ImageFormat format,
+                     const size_t width, const size_t height, const bool useMapping)
+{
+    assert(writer);
+    assert(fileName);
+    assert(format < NUMBER_OF_IMAGE_FORMATS);
+    assert(width > 0 && height > 0);
+
+    InitWriter(writer, format, width, height);
+
+    // the size of a PNG file depends on how its data is split into chunks
+    if (useMapping && format == IMAGE_PNG)
+        return false;
+
+    uint8_t header[64] = {};
+    if (!useMapping)
+    {
+        writer->file = fopen(fileName, "wb");
+        if (!writer->file)
+            return false;
+
+        WriteHeader(writer, header);
+        return !writer->isFailed;
+    }
+
+    writer->fileDescriptor = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (writer->fileDescriptor < 0)
+        return false;
+
+    WriteHeader(writer, header);
+
+    const size_t fileSize = writer->headerSize + width * height * GetBytesPerPixel(format);
+    if (ftruncate(writer->fileDescriptor, (off_t)fileSize) != 0)
+        writer->isFailed = true;
+
+    return !writer->isFailed;
+}
+
+bool ImageWriterCtorMemory(ImageWriter* writer, char** outData, size_t* outSize,
+                           const ImageFormat format, const size_t width, const size_t height)
+{
+    assert(writer);
+    assert(outData);
+    assert(outSize);
+    assert(format < NUMBER_OF_IMAGE_FORMATS);
+    assert(width > 0 && height > 0);
+
+    InitWriter(writer, format, width, height);
+
+    writer->file = open_memstream(outData, outSize);
+    if (!writer->file)
+        return false;
+
+    uint8_t header[64] = {};
+    WriteHeader(writer, header);
+
+    return !writer->isFailed;
+}
+
+bool ImageWriterCtorStream(ImageWriter* writer, FILE* file, const ImageFormat format,
+                           const size_t width, const size_t height)
+{
+    assert(writer);
+    assert(file);
+    assert(format < NUMBER_OF_IMAGE_FORMATS);
+    assert(width > 0 && height > 0);
+
+    InitWriter(writer, format, width, height);
+
+    writer->file        = file;
+    writer->isFileOwned = false;
+
+    uint8_t header[64] = {};
+    WriteHeader(writer, header);
+
+    return !writer->isFailed;
+}
+
+bool ImageWriterDtor(ImageWriter* writer)
+{
+    assert(writer);
+
+    if (writer->nextRow != writer->height)
+        writer->isFailed = true;
+
+    if (writer->format == IMAGE_PNG && writer->file)
+        WritePngChunk(writer, "IEND", nullptr, 0);
+
+    if (writer->file && (writer->isFileOwned ? fclose(writer->file) : fflush(writer->file)) != 0)
+        writer->isFailed = true;
+    if (writer->fileDescriptor >= 0 && close(writer->fileDescriptor) != 0)
+        writer->isFailed = true;
+
+    free(writer->rowBuffer);
+
+    writer->file           = nullptr;
+    writer->fileDescriptor = -1;
+    writer->rowBuffer      = nullptr;
+    writer->rowBufferSize  = 0;
+
+    return !writer->isFailed;
+}
+
+void ImageWriterWriteBand(ImageWriter* writer, const uint8_t* pixels, const size_t numberOfRows)
+{
+    assert(writer);
+    assert(pixels);
+    assert(writer->nextRow + numberOfRows <= writer->height);
+
+    const size_t width          = writer->width;
+    const size_t numberOfPixels = width * numberOfRows;
+
+    if (writer->fileDescriptor >= 0)
+        WriteMappedBand(writer, pixels, numberOfRows);
+    else
+    {
+        switch (writer->format)
+        {
+            case IMAGE_RAW:
+                WriteBytes(writer, pixels, numberOfPixels * 4);
+                break;
+
+            case IMAGE_PPM:
+            {
+                uint8_t* rgb = GetRowBuffer(writer, numberOfPixels * 3);
+                ConvertToRgb(rgb, pixels, numberOfPixels);
+                WriteBytes(writer, rgb, numberOfPixels * 3);
+                break;
+            }
+
+            // every row starts with the filter type, 0 is none
+            case IMAGE_PNG:
+            {
+                const size_t rowSize = 1 + width * 3;
+                uint8_t*     rows    = GetRowBuffer(writer, rowSize * numberOfRows);
+                for (size_t row = 0; row < numberOfRows; ++row)
+                {
+                    rows[row * rowSize] = 0;
+                    ConvertToRgb(rows + row * rowSize + 1, pixels + row * width * 4, width);
+                }
+
+                WritePngData(writer, rows, rowSize * numberOfRows,
+                             writer->nextRow + numberOfRows == writer->height);
+                break;
+            }
+
+            case NUMBER_OF_IMAGE_FORMATS:
+            default:
+                assert(0 && "Unknown image format");
+                break;
+        }
+    }
+
+    writer->nextRow += numberOfRows;
+}
+
+ImageFormat GetImageFormat(const char* name)
+{
+    assert(name);
+
+    for (size_t i = 0; i < NUMBER_OF_IMAGE_FORMATS; ++i)
+    {
+        if (strcmp(name, ImageFormatNames[i]) == 0)
+            return (ImageFormat)i;
+    }
+
+    return NUMBER_OF_IMAGE_FORMATS;
+}
+
+static void InitWriter(ImageWriter* writer, const ImageFormat format, const size_t width,
+                       const size_t height)
+{
+    assert(writer);
+
+    writer->format          = format;
+    writer->width           = width;
+    writer->height          = height;
+    writer->nextRow         = 0;
+    writer->file            = nullptr;
+    writer->fileDescriptor  = -1;
+    writer->isFileOwned     = true;
+    writer->headerSize      = 0;
+    writer->rowBuffer       = nullptr;
+    writer->rowBufferSize   = 0;
+    writer->adler           = 1;
+    writer->isStreamStarted = false;
+    writer->isFailed        = false;
+
+    // filled once, writers of the tile server are created on several threads
+    static const bool isCrcTableFilled = FillCrcTable();
+    (void)isCrcTableFilled;
+}
+
+static size_t GetBytesPerPixel(const ImageFormat format)
+{
+    return format == IMAGE_RAW ? 4 : 3;
+}
+
+static void WriteHeader(ImageWriter* writer, uint8_t* header)
+{
+    assert(writer);
+    assert(header);
+
+    switch (writer->format)
+    {
+        case IMAGE_PPM:
+        {
+            const int size = sprintf((char*)header, "P6\n%zu %zu\n255\n", writer->width,
+                                     writer->height);
+            writer->headerSize = (size_t)size;
+            break;
+        }
+
+        case IMAGE_PNG:
+        {
+            WriteBytes(writer, PngSignature, sizeof(PngSignature));
+
+            // 8 bits RGB, deflate, no interlace
+            uint8_t imageHeader[13] = {};
+            SetBigEndian32(imageHeader,     (uint32_t)writer->width);
+            SetBigEndian32(imageHeader + 4, (uint32_t)writer->height);
+            imageHeader[8] = 8;
+            imageHeader[9] = 2;
+
+            WritePngChunk(writer, "IHDR", imageHeader, sizeof(imageHeader));
+            return;
+        }
+
+        case IMAGE_RAW:
+            writer->headerSize = 0;
+            return;
+
+        case NUMBER_OF_IMAGE_FORMATS:
+        default:
+            assert(0 && "Unknown image format");
+            return;
+    }
+
+    if (writer->fileDescriptor < 0)
+        WriteBytes(writer, header, writer->headerSize);
+    else if (pwrite(writer->fileDescriptor, header, writer->headerSize, 0) !=
+             (ssize_t)writer->headerSize)
+        writer->isFailed = true;
+}
+
+// Only the pages of the band are mapped, they leave the memory of the process with munmap
+// and are written back by the kernel.
+static void WriteMappedBand(ImageWriter* writer, const uint8_t* pixels, const size_t numberOfRows)
+{
+    assert(writer);
+    assert(pixels);
+
+    if (writer->isFailed)
+        return;
+
+    static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+    const size_t bytesPerPixel  = GetBytesPerPixel(writer->format);
+    const size_t numberOfPixels = writer->width * numberOfRows;
+    const size_t offset         = writer->headerSize +
+                                  writer->nextRow * writer->width * bytesPerPixel;
+    const size_t mappingOffset  = offset / pageSize * pageSize;
+    const size_t mappingSize    = offset - mappingOffset + numberOfPixels * bytesPerPixel;
+
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         writer->fileDescriptor, (off_t)mappingOffset);
+    if (mapping == MAP_FAILED)
+    {
+        writer->isFailed = true;
+        return;
+    }
+
+    uint8_t* band = (uint8_t*)mapping + (offset - mappingOffset);
+    if (writer->format == IMAGE_RAW)
+        memcpy(band, pixels, numberOfPixels * 4);
+    else
+        ConvertToRgb(band, pixels, numberOfPixels);
+
+    if (munmap(mapping, mappingSize) != 0)
+        writer->isFailed = true;
+}
+
+static uint8_t* GetRowBuffer(ImageWriter* writer, const size_t size)
+{
+    assert(writer);
+
+    if (size > writer->rowBufferSize)
+    {
+        free(writer->rowBuffer);
+        writer->rowBuffer     = (uint8_t*)malloc(size);
+        writer->rowBufferSize = size;
+    }
+
+    return writer->rowBuffer;
+}
+
+static void ConvertToRgb(uint8_t* outRgb, const uint8_t* rgba, const size_t numberOfPixels)
+{
+    assert(outRgb);
+    assert(rgba);
+
+    for (size_t i = 0; i < numberOfPixels; ++i)
+    {
+        outRgb[3 * i]     = rgba[4 * i];
+        outRgb[3 * i + 1] = rgba[4 * i + 1];
+        outRgb[3 * i + 2] = rgba[4 * i + 2];
+    }
+}
+
+// Every band is an IDAT chunk of stored deflate blocks, the zlib stream goes on through all
+// of them.
+static void WritePngData(ImageWriter* writer, const uint8_t* data, const size_t size,
+                         const bool isLast)
+{
+    assert(writer);
+    assert(data);
+    assert(size > 0);
+
+    const size_t numberOfBlocks = (size + MaxStoredBlockSize - 1) / MaxStoredBlockSize;
+    const size_t chunkSize      = (writer->isStreamStarted ? 0 : sizeof(ZlibHeader)) +
+                                  numberOfBlocks * 5 + size + (isLast ? 4 : 0);
+
+    const uint32_t sizeBigEndian = ToBigEndian32((uint32_t)chunkSize);
+    WriteBytes(writer, &sizeBigEndian, sizeof(sizeBigEndian));
+
+    uint32_t crc = 0xffffffff;
+    WriteChunkPart(writer, "IDAT", 4, &crc);
+
+    if (!writer->isStreamStarted)
+    {
+        WriteChunkPart(writer, ZlibHeader, sizeof(ZlibHeader), &crc);
+        writer->isStreamStarted = true;
+    }
+
+    for (size_t begin = 0; begin < size; begin += MaxStoredBlockSize)
+    {
+        const size_t blockSize = size - begin < MaxStoredBlockSize ? size - begin :
+                                                                     MaxStoredBlockSize;
+        const bool   isFinal   = isLast && begin + blockSize == size;
+
+        // BFINAL, BTYPE 00, then the length and its complement, little endian as on x86
+        const uint8_t  blockType    = isFinal;
+        const uint32_t blockLengths = (uint32_t)blockSize | (uint32_t)(~blockSize & 0xffff) << 16;
+
+        WriteChunkPart(writer, &blockType,    sizeof(blockType),    &crc);
+        WriteChunkPart(writer, &blockLengths, sizeof(blockLengths), &crc);
+        WriteChunkPart(writer, data + begin, blockSize, &crc);
+    }
+
+    writer->adler = UpdateAdler(writer->adler, data, size);
+    if (isLast)
+    {
+        const uint32_t adlerBigEndian = ToBigEndian32(writer->adler);
+        WriteChunkPart(writer, &adlerBigEndian, sizeof(adlerBigEndian), &crc);
+    }
+
+    const uint32_t crcBigEndian = ToBigEndian32(~crc);
+    WriteBytes(writer, &crcBigEndian, sizeof(crcBigEndian));
+}
+
+static void WritePngChunk(ImageWriter* writer, const char* type, const uint8_t* data,
+                          const size_t size)
+{
+    assert(writer);
+    assert(type);
+
+    const uint32_t sizeBigEndian = ToBigEndian32((uint32_t)size);
+    WriteBytes(writer, &sizeBigEndian, sizeof(sizeBigEndian));
+
+    uint32_t crc = 0xffffffff;
+    WriteChunkPart(writer, type, 4, &crc);
+    if (size > 0)
+        WriteChunkPart(writer, data, size, &crc);
+
+    const uint32_t crcBigEndian = ToBigEndian32(~crc);
+    WriteBytes(writer, &crcBigEndian, sizeof(crcBigEndian));
+}
+
+static void WriteChunkPart(ImageWriter* writer, const void* data, const size_t size,
+                           uint32_t* crc)
+{
+    assert(crc);
+
+    *crc = UpdateCrc(*crc, (const uint8_t*)data, size);
+    WriteBytes(writer, data, size);
+}
+
+static void WriteBytes(ImageWriter* writer, const void* data, const size_t size)
+{
+    assert(writer);
+    assert(writer->file);
+    assert(data);
+
+    if (fwrite(data, 1, size, writer->file) != size)
+        writer->isFailed = true;
+}
+
+static void SetBigEndian32(uint8_t* bytes, const uint32_t value)
+{
+    assert(bytes);
+
+    bytes[0] = (uint8_t)(value >> 24);
+    bytes[1] = (uint8_t)(value >> 16);
+    bytes[2] = (uint8_t)(value >> 8);
+    bytes[3] = (uint8_t)value;
+}
+
+static uint32_t ToBigEndian32(const uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+
+static bool FillCrcTable()
+{
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t crc = i;
+        for (size_t bit = 0; bit < 8; ++bit)
+            crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+
+        CrcTables[0][i] = crc;
+    }
+
+    for (size_t k = 1; k < 8; ++k)
+    {
+        for (size_t i = 0; i < 256; ++i)
+        {
+            const uint32_t crc = CrcTables[k - 1][i];
+            CrcTables[k][i] = CrcTables[0][crc & 0xff] ^ (crc >> 8);
+        }
+    }
+
+    return true;
+}
+
+static uint32_t UpdateCrc(uint32_t crc, const uint8_t* data, const size_t size)
+{
+    assert(data || size == 0);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        // little endian, the first byte is the lowest one
+        uint32_t low  = 0;
+        uint32_t high = 0;
+        memcpy(&low,  data + i,     sizeof(low));
+        memcpy(&high, data + i + 4, sizeof(high));
+        low ^= crc;
+
+        crc = CrcTables[7][low  & 0xff] ^ CrcTables[6][(low  >> 8) & 0xff] ^
+              CrcTables[5][(low  >> 16) & 0xff] ^ CrcTables[4][low  >> 24] ^
+              CrcTables[3][high & 0xff] ^ CrcTables[2][(high >> 8) & 0xff] ^
+              CrcTables[1][(high >> 16) & 0xff] ^ CrcTables[0][high >> 24];
+    }
+
+    for (; i < size; ++i)
+        crc = CrcTables[0][(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+static uint32_t UpdateAdler(const uint32_t adler, const uint8_t* data, const size_t size)
+{
+    assert(data);
+
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+
+    for (size_t begin = 0; begin < size; begin += MaxAdlerRun)
+    {
+        const size_t end = begin + MaxAdlerRun < size ? begin + MaxAdlerRun : size;
+        for (size_t i = begin; i < end; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+
+        a %= AdlerModulo;
+        b %= AdlerModulo;
+    }
+
+    return (b << 16) | a;
+}
@@ -0,0 +1,66 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum ImageFormat
+{
+    IMAGE_PPM,  // binary P6, RGB
+    IMAGE_PNG,  // RGB, deflate blocks are stored, so the image is never held in memory
+    IMAGE_RAW,  // RGBA rows without a header
+
+    NUMBER_OF_IMAGE_FORMATS,
+};
+
+// Writes an image from top to bottom in bands of rows, so only a band is in memory at once.
+// PPM and raw images can be written through a memory mapping of the file instead of stdio,
+// a band is mapped only while it is written.
+struct ImageWriter
+{
+    ImageFormat format;
+    size_t      width;
+    size_t      height;
+    size_t      nextRow;
+
+    FILE*       file;
+    int         fileDescriptor;     // of the mapped file, -1 if stdio is used
+    bool        isFileOwned;        // false for a stream given to the writer, it stays open
+    size_t      headerSize;
+
+    // RGB rows of a band for stdio, with a filter byte before every row for PNG
+    uint8_t*    rowBuffer;
+    size_t      rowBufferSize;
+
+    // of the PNG data stream
+    uint32_t    adler;
+    bool        isStreamStarted;
+
+    bool        isFailed;
+};
+
+// False if the file can't be created or mapping is asked for PNG.
+bool        ImageWriterCtor      (ImageWriter* writer, const char* fileName,
+                                  const ImageFormat format, const size_t width,
+                                  const size_t height, const bool useMapping);
+// Writes the whole image into a buffer that grows as needed instead of a file, mapping is not
+// used. *outData and *outSize are valid after ImageWriterDtor, the buffer is freed by free().
+bool        ImageWriterCtorMemory(ImageWriter* writer, char** outData, size_t* outSize,
+                                  const ImageFormat format, const size_t width,
+                                  const size_t height);
+// Writes the image into an open stream, for example one image after another into stdout.
+// The stream is flushed and not closed by ImageWriterDtor.
+bool        ImageWriterCtorStream(ImageWriter* writer, FILE* file, const ImageFormat format,
+                                  const size_t width, const size_t height);
+// Finishes the file, false if any write failed.
+bool        ImageWriterDtor      (ImageWriter* writer);
+
+// RGBA pixels of the next numberOfRows rows.
+void        ImageWriterWriteBand (ImageWriter* writer, const uint8_t* pixels,
+                                  const size_t numberOfRows);
+
+// Format by its name, NUMBER_OF_IMAGE_FORMATS if there is none.
+ImageFormat GetImageFormat       (const char* name);
+
+#endif
@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <cpuid.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "KernelDispatch.h"
+
+static const unsigned CpuAvx2Fma = CPU_FEATURE_AVX2 | CPU_FEATURE_FMA;
+
+// SelectMandelbrotKernel takes the first supported one and sse2 is always supported,
+// so kernels after it are only used when asked by name or, for double precision ones,
+// by SelectMandelbrotKernelForView
+static const MandelbrotKernelInfo MandelbrotKernels[] =
+{
+    { "avx512",       CalculateMandelbrotTileAvx512,        CPU_FEATURE_AVX512F, 16, false },
+    { "avx2",         CalculateMandelbrotTileAvx2,          CpuAvx2Fma,          8,  false },
+    { "sse2",         CalculateMandelbrotTileSse2,          CPU_FEATURE_SSE2,    4,  false },
+
+    { "avx2-recycle", CalculateMandelbrotTileAvx2Recycling, CpuAvx2Fma,          8,  false },
+    { "avx2-double",  CalculateMandelbrotTileAvx2Double,    CpuAvx2Fma,          4,  true  },
+    { "vec",          CalculateMandelbrotTileVec,           CPU_FEATURE_AVX2,    8,  false },
+
+    // escape checked every 2 to 16 iterations, with a cap fixed at compile time and, for
+    // comparison only, with the escape radius 2, which gives another picture
+    { "avx2-check2",        CalculateMandelbrotTileUnrolled<Avx2FloatLanes, 2,  0,   100>,
+      CpuAvx2Fma, 8, false },
+    { "avx2-check4",        CalculateMandelbrotTileUnrolled<Avx2FloatLanes, 4,  0,   100>,
+      CpuAvx2Fma, 8, false },
+    { "avx2-check8",        CalculateMandelbrotTileUnrolled<Avx2FloatLanes, 8,  0,   100>,
+      CpuAvx2Fma, 8, false },
+    { "avx2-check16",       CalculateMandelbrotTileUnrolled<Avx2FloatLanes, 16, 0,   100>,
+      CpuAvx2Fma, 8, false },
+    { "avx2-check8-cap256", CalculateMandelbrotTileUnrolled<Avx2FloatLanes, 8,  256, 100>,
+      CpuAvx2Fma, 8, false },
+    { "avx2-check8-r2",     CalculateMandelbrotTileUnrolled<Avx2FloatLanes, 8,  0,   4>,
+      CpuAvx2Fma, 8, false },
+    { "avx2-double-check4", CalculateMandelbrotTileUnrolled<Avx2DoubleLanes, 4, 0,   100>,
+      CpuAvx2Fma, 4, true  },
+
+    // 1 to 4 independent groups of 8 pixels in flight, with FMA
+    { "avx2-fma-x1", CalculateMandelbrotTileAvx2Interleaved<1>, CpuAvx2Fma, 8, false },
+    { "avx2-fma-x2", CalculateMandelbrotTileAvx2Interleaved<2>, CpuAvx2Fma, 8, false },
+    { "avx2-fma-x3", CalculateMandelbrotTileAvx2Interleaved<3>, CpuAvx2Fma, 8, false },
+    { "avx2-fma-x4", CalculateMandelbrotTileAvx2Interleaved<4>, CpuAvx2Fma, 8, false },
+
+    // int16 fixed point with 16 lanes, only for shallow views
+    { "avx2-fixed16", CalculateMandelbrotTileAvx2Fixed16,   CpuAvx2Fma,          16, false, true },
+};
+
+static const size_t NumberOfMandelbrotKernels = sizeof(MandelbrotKernels) /
+                                                sizeof(*MandelbrotKernels);
+
+static uint64_t GetEnabledXStateFeatures();
+
+unsigned GetCpuFeatures()
+{
+    static const unsigned edx1Sse2    = 1u << 26;
+    static const unsigned ecx1Fma     = 1u << 12;
+    static const unsigned ecx1OsXSave = 1u << 27;
+    static const unsigned ecx1Avx     = 1u << 28;
+    static const unsigned ebx7Avx2    = 1u << 5;
+    static const unsigned ebx7Avx512F = 1u << 16;
+
+    // xmm, ymm and zmm registers state has to be saved by the OS to use them
+    static const uint64_t ymmState    = (1u << 1) | (1u << 2);
+    static const uint64_t zmmState    = ymmState | (1u << 5) | (1u << 6) | (1u << 7);
+
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+
+    unsigned features = 0;
+    if (edx & edx1Sse2)
+        features |= CPU_FEATURE_SSE2;
+
+    if (!(ecx & ecx1OsXSave) || !(ecx & ecx1Avx))
+        return features;
+
+    const uint64_t xStateFeatures = GetEnabledXStateFeatures();
+    if ((xStateFeatures & ymmState) != ymmState)
+        return features;
+
+    if (ecx & ecx1Fma)
+        features |= CPU_FEATURE_FMA;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return features;
+
+    if (ebx & ebx7Avx2)
+        features |= CPU_FEATURE_AVX2;
+
+    if ((ebx & ebx7Avx512F) && (xStateFeatures & zmmState) == zmmState)
+        features |= CPU_FEATURE_AVX512F;
+
+    return features;
+}
+
+bool IsKernelSupported(const MandelbrotKernelInfo* kernel)
+{
+    assert(kernel);
+
+    static const unsigned cpuFeatures = GetCpuFeatures();
+
+    return (cpuFeatures & kernel->requiredCpuFeatures) == kernel->requiredCpuFeatures;
+}
+
+const MandelbrotKernelInfo* GetMandelbrotKernels(size_t* outNumberOfKernels)
+{
+    assert(outNumberOfKernels);
+
+    *outNumberOfKernels = NumberOfMandelbrotKernels;
+    return MandelbrotKernels;
+}
+
+const MandelbrotKernelInfo* FindMandelbrotKernel(const char* name)
+{
+    assert(name);
+
+    for (size_t i = 0; i < NumberOfMandelbrotKernels; ++i)
+    {
+        if (strcmp(MandelbrotKernels[i].name, name) == 0)
+            return &MandelbrotKernels[i];
+    }
+
+    return nullptr;
+}
+
+const MandelbrotKernelInfo* SelectMandelbrotKernel(const char* overrideName)
+{
+    const char* kernelName = overrideName ? overrideName : getenv("MANDELBROT_KERNEL");
+
+    if (kernelName)
+    {
+        const MandelbrotKernelInfo* kernel = FindMandelbrotKernel(kernelName);
+
+        if (!kernel)
+        {
+            fprintf(stderr, "Unknown kernel \"%s\"\n", kernelName);
+            return nullptr;
+        }
+
+        if (!IsKernelSupported(kernel))
+        {
+            fprintf(stderr, "Kernel \"%s\" is not supported by this cpu\n", kernelName);
+            return nullptr;
+        }
+
+        return kernel;
+    }
+
+    for (size_t i = 0; i < NumberOfMandelbrotKernels; ++i)
+    {
+        if (IsKernelSupported(&MandelbrotKernels[i]))
+            return &MandelbrotKernels[i];
+    }
+
+    return nullptr;
+}
+
+const MandelbrotKernelInfo* SelectMandelbrotKernelForView(const MandelbrotKernelInfo* kernel,
+                                                          const MandelbrotView* view)
+{
+    assert(kernel);
+    assert(view);
+
+    if (kernel->isFixedPoint && !IsFixedPointPrecisionEnough(view))
+    {
+        for (size_t i = 0; i < NumberOfMandelbrotKernels; ++i)
+        {
+            if (!MandelbrotKernels[i].isFixedPoint && IsKernelSupported(&MandelbrotKernels[i]))
+            {
+                kernel = &MandelbrotKernels[i];
+                break;
+            }
+        }
+    }
+
+    if (kernel->isDoublePrecision || IsFloatPrecisionEnough(view))
+        return kernel;
+
+    for (size_t i = 0; i < NumberOfMandelbrotKernels; ++i)
+    {
+        if (MandelbrotKernels[i].isDoublePrecision && IsKernelSupported(&MandelbrotKernels[i]))
+            return &MandelbrotKernels[i];
+    }
+
+    return kernel;
+}
+
+static uint64_t GetEnabledXStateFeatures()
+{
+    uint32_t eax = 0;
+    uint32_t edx = 0;
+
+    // xgetbv with ecx = 0 reads XCR0, doesn't need -mxsave unlike _xgetbv
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+    return ((uint64_t)edx << 32) | eax;
+}
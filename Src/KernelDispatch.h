@@ -0,0 +1,47 @@
+#ifndef KERNEL_DISPATCH_H
+#define KERNEL_DISPATCH_H
+
+#include "Mandelbrot.h"
+
+enum CpuFeatures
+{
+    CPU_FEATURE_SSE2    = 1 << 0,
+    CPU_FEATURE_AVX2    = 1 << 1,
+    CPU_FEATURE_FMA     = 1 << 2,
+    CPU_FEATURE_AVX512F = 1 << 3,
+};
+
+struct MandelbrotKernelInfo
+{
+    const char*          name;
+    MandelbrotTileKernel tileKernel;
+
+    unsigned             requiredCpuFeatures;
+    size_t               numberOfLanes;
+
+    bool                 isDoublePrecision;
+    // precise enough only for the views IsFixedPointPrecisionEnough accepts
+    bool                 isFixedPoint;
+};
+
+// Features reported by cpuid and enabled by the OS (xgetbv), combination of CpuFeatures.
+unsigned                    GetCpuFeatures         ();
+
+bool                        IsKernelSupported      (const MandelbrotKernelInfo* kernel);
+
+// All kernels compiled into the binary, the widest ones first.
+const MandelbrotKernelInfo* GetMandelbrotKernels   (size_t* outNumberOfKernels);
+const MandelbrotKernelInfo* FindMandelbrotKernel   (const char* name);
+
+// Kernel named by overrideName or, if it is nullptr, by the MANDELBROT_KERNEL environment
+// variable. Without both returns the widest kernel the cpu supports. Prints an error and
+// returns nullptr if the requested kernel is unknown or can't run on this cpu.
+const MandelbrotKernelInfo* SelectMandelbrotKernel (const char* overrideName);
+
+// kernel itself if it is precise enough for the view. Otherwise a fixed point kernel is
+// replaced by the widest supported float one and a float kernel by the first supported double
+// precision one. Without one the float kernel is used anyway.
+const MandelbrotKernelInfo* SelectMandelbrotKernelForView(const MandelbrotKernelInfo* kernel,
+                                                          const MandelbrotView* view);
+
+#endif
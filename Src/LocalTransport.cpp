@@ -0,0 +1,280 @@
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Distributed.h"
+
+struct LocalWorker
+{
+    pid_t pid;
+    int   socket;   // of the coordinator, -1 if the worker is not running
+};
+
+struct LocalTransportState
+{
+    LocalWorker* workers;
+    int          frameFile;
+    size_t       frameBytes;
+
+    size_t       crashAfterTiles;
+    bool         isCrashDone;
+
+    // poll set of the running workers, pollWorkers[i] is the worker of pollFds[i]
+    pollfd*      pollFds;
+    size_t*      pollWorkers;
+    size_t       nextPollIndex;
+};
+
+static bool               StartLocalWorker (RenderTransport* transport, const size_t worker);
+static void               StopLocalWorker  (RenderTransport* transport, const size_t worker);
+static bool               SendLocalTile    (RenderTransport* transport, const size_t worker,
+                                            const TileMessage* message);
+static TransportEventType ReceiveLocalTile (RenderTransport* transport, size_t* outWorker,
+                                            TileMessage* outMessage);
+static void               ServeLocalWorker (int workerSocket, uint16_t* frame,
+                                            const size_t crashAfterTiles);
+
+static const RenderTransportOps LocalTransportOps =
+{
+    StartLocalWorker,
+    StopLocalWorker,
+    SendLocalTile,
+    ReceiveLocalTile,
+};
+
+bool LocalTransportCtor(RenderTransport* transport, const size_t maxNumberOfWorkers,
+                        const size_t maxNumberOfPixels, const size_t crashAfterTiles)
+{
+    assert(transport);
+    assert(maxNumberOfWorkers > 0);
+    assert(maxNumberOfPixels > 0);
+
+    LocalTransportState* state = (LocalTransportState*)calloc(1, sizeof(*state));
+    state->workers         = (LocalWorker*)calloc(maxNumberOfWorkers, sizeof(LocalWorker));
+    state->pollFds         = (pollfd*)calloc(maxNumberOfWorkers, sizeof(pollfd));
+    state->pollWorkers     = (size_t*)calloc(maxNumberOfWorkers, sizeof(size_t));
+    state->frameBytes      = maxNumberOfPixels * sizeof(uint16_t);
+    state->crashAfterTiles = crashAfterTiles;
+
+    for (size_t i = 0; i < maxNumberOfWorkers; ++i)
+        state->workers[i].socket = -1;
+
+    transport->ops                = &LocalTransportOps;
+    transport->state              = state;
+    transport->frame              = nullptr;
+    transport->maxNumberOfPixels  = maxNumberOfPixels;
+    transport->maxNumberOfWorkers = maxNumberOfWorkers;
+
+    // the file has no name, forked workers share its mapping, a worker started by exec would
+    // get the descriptor and map it itself
+    state->frameFile = memfd_create("mandelbrot-frame", MFD_CLOEXEC);
+    if (state->frameFile < 0 || ftruncate(state->frameFile, (off_t)state->frameBytes) != 0)
+        return false;
+
+    void* frame = mmap(nullptr, state->frameBytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       state->frameFile, 0);
+    if (frame == MAP_FAILED)
+        return false;
+
+    transport->frame = (uint16_t*)frame;
+    return true;
+}
+
+void LocalTransportDtor(RenderTransport* transport)
+{
+    assert(transport);
+
+    LocalTransportState* state = (LocalTransportState*)transport->state;
+    if (!state)
+        return;
+
+    for (size_t worker = 0; worker < transport->maxNumberOfWorkers; ++worker)
+        StopLocalWorker(transport, worker);
+
+    if (transport->frame)
+        munmap(transport->frame, state->frameBytes);
+    if (state->frameFile >= 0)
+        close(state->frameFile);
+
+    free(state->workers);
+    free(state->pollFds);
+    free(state->pollWorkers);
+    free(state);
+
+    transport->state = nullptr;
+    transport->frame = nullptr;
+}
+
+// A running worker is not started again.
+static bool StartLocalWorker(RenderTransport* transport, const size_t worker)
+{
+    assert(transport);
+    assert(worker < transport->maxNumberOfWorkers);
+
+    LocalTransportState* state = (LocalTransportState*)transport->state;
+    if (!transport->frame)
+        return false;
+    if (state->workers[worker].socket >= 0)
+        return true;
+
+    // messages keep their boundaries, so a tile is one recv
+    int sockets[2] = {};
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0)
+        return false;
+
+    // only the first worker 0 crashes, the one started in its place finishes the frame
+    const size_t crashAfterTiles = worker == 0 && !state->isCrashDone ?
+                                   state->crashAfterTiles : 0;
+
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(sockets[0]);
+        close(sockets[1]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        // sockets of the other workers would keep them from seeing the end of their stream
+        for (size_t i = 0; i < transport->maxNumberOfWorkers; ++i)
+        {
+            if (state->workers[i].socket >= 0)
+                close(state->workers[i].socket);
+        }
+        close(sockets[0]);
+
+        ServeLocalWorker(sockets[1], transport->frame, crashAfterTiles);
+        _exit(0);
+    }
+
+    close(sockets[1]);
+
+    state->workers[worker].pid    = pid;
+    state->workers[worker].socket = sockets[0];
+    state->isCrashDone            = state->isCrashDone || crashAfterTiles > 0;
+
+    return true;
+}
+
+// The worker sees the end of the stream and exits.
+static void StopLocalWorker(RenderTransport* transport, const size_t worker)
+{
+    assert(transport);
+    assert(worker < transport->maxNumberOfWorkers);
+
+    LocalTransportState* state       = (LocalTransportState*)transport->state;
+    LocalWorker*         localWorker = &state->workers[worker];
+
+    if (localWorker->socket < 0)
+        return;
+
+    close(localWorker->socket);
+    waitpid(localWorker->pid, nullptr, 0);
+
+    localWorker->socket = -1;
+    localWorker->pid    = 0;
+}
+
+static bool SendLocalTile(RenderTransport* transport, const size_t worker,
+                          const TileMessage* message)
+{
+    assert(transport);
+    assert(worker < transport->maxNumberOfWorkers);
+    assert(message);
+
+    LocalTransportState* state = (LocalTransportState*)transport->state;
+
+    const int workerSocket = state->workers[worker].socket;
+    if (workerSocket < 0)
+        return false;
+
+    return send(workerSocket, message, sizeof(*message), MSG_NOSIGNAL) ==
+           (ssize_t)sizeof(*message);
+}
+
+// Workers are polled from the one after the last that answered, so a fast worker doesn't
+// hide the others.
+static TransportEventType ReceiveLocalTile(RenderTransport* transport, size_t* outWorker,
+                                           TileMessage* outMessage)
+{
+    assert(transport);
+    assert(outWorker);
+    assert(outMessage);
+
+    LocalTransportState* state = (LocalTransportState*)transport->state;
+
+    size_t numberOfPollFds = 0;
+    for (size_t worker = 0; worker < transport->maxNumberOfWorkers; ++worker)
+    {
+        if (state->workers[worker].socket < 0)
+            continue;
+
+        state->pollFds[numberOfPollFds].fd      = state->workers[worker].socket;
+        state->pollFds[numberOfPollFds].events  = POLLIN;
+        state->pollFds[numberOfPollFds].revents = 0;
+        state->pollWorkers[numberOfPollFds++]   = worker;
+    }
+
+    if (!numberOfPollFds)
+        return TRANSPORT_FAILED;
+
+    int numberOfReady = 0;
+    do
+        numberOfReady = poll(state->pollFds, numberOfPollFds, -1);
+    while (numberOfReady < 0 && errno == EINTR);
+
+    if (numberOfReady < 0)
+        return TRANSPORT_FAILED;
+
+    for (size_t i = 0; i < numberOfPollFds; ++i)
+    {
+        const size_t pollIndex = (state->nextPollIndex + i) % numberOfPollFds;
+        if (!state->pollFds[pollIndex].revents)
+            continue;
+
+        const size_t worker = state->pollWorkers[pollIndex];
+        state->nextPollIndex = pollIndex + 1;
+        *outWorker = worker;
+
+        const ssize_t received = recv(state->workers[worker].socket, outMessage,
+                                      sizeof(*outMessage), 0);
+        if (received == (ssize_t)sizeof(*outMessage))
+            return TRANSPORT_TILE_DONE;
+
+        // end of the stream or a hang up, the worker is dead or broken
+        StopLocalWorker(transport, worker);
+        return TRANSPORT_WORKER_LOST;
+    }
+
+    return TRANSPORT_FAILED;
+}
+
+// The worker writes the tiles right into the shared frame and answers with the same message.
+static void ServeLocalWorker(int workerSocket, uint16_t* frame, const size_t crashAfterTiles)
+{
+    assert(frame);
+
+    TileMessage message = {};
+    size_t numberOfTiles = 0;
+
+    while (recv(workerSocket, &message, sizeof(message), 0) == (ssize_t)sizeof(message))
+    {
+        CalculateTileMessage(frame, &message);
+
+        if (++numberOfTiles == crashAfterTiles)
+            kill(getpid(), SIGKILL);
+
+        if (send(workerSocket, &message, sizeof(message), MSG_NOSIGNAL) !=
+            (ssize_t)sizeof(message))
+            break;
+    }
+
+    close(workerSocket);
+}
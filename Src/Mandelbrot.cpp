@@ -0,0 +1,76 @@
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+
+#include "Mandelbrot.h"
+
+// Neighbouring pixels have to be at least this many float ulps apart, otherwise the
+// rounding of their coordinates is visible as blocks.
+static const double MinFloatUlpsPerPixel = 8;
+
+// the same for the fixed point kernel, fixed point numbers are 1 / 2^Fixed16FractionBits apart.
+// It only keeps pixels from merging: the rounding of z at every iteration makes the picture
+// differ from the float one by about as much at any distance between the pixels.
+static const double MinFixedPointUlpsPerPixel = 4;
+static const double MaxFixedPointCoordinate   = 4;
+
+static double GetMaxAbs(const double a, const double b);
+
+void MandelbrotViewCtor(MandelbrotView* view, const size_t width, const size_t height,
+                        const double imageXShift, const double imageYShift,
+                        const double scale, const float dxPerPixel, const float dyPerPixel,
+                        const size_t maxNumberOfIterations)
+{
+    assert(view);
+
+    view->width  = width;
+    view->height = height;
+
+    view->dxDouble = (double)dxPerPixel / scale;
+    view->dyDouble = (double)dyPerPixel / scale;
+
+    view->x0BeginDouble = -(double)width  / 2 * view->dxDouble + CenterX + imageXShift;
+    view->y0BeginDouble = -(double)height / 2 * view->dyDouble + CenterY + imageYShift;
+
+    view->dx      = (float)view->dxDouble;
+    view->dy      = (float)view->dyDouble;
+    view->x0Begin = (float)view->x0BeginDouble;
+    view->y0Begin = (float)view->y0BeginDouble;
+
+    view->maxNumberOfIterations = maxNumberOfIterations;
+}
+
+bool IsFloatPrecisionEnough(const MandelbrotView* view)
+{
+    assert(view);
+
+    // ulp of a float is the largest on the edge of the frame that is the farthest from 0
+    const double maxX = GetMaxAbs(view->x0BeginDouble,
+                                  view->x0BeginDouble + (double)view->width  * view->dxDouble);
+    const double maxY = GetMaxAbs(view->y0BeginDouble,
+                                  view->y0BeginDouble + (double)view->height * view->dyDouble);
+
+    return view->dxDouble >= MinFloatUlpsPerPixel * FLT_EPSILON * maxX &&
+           view->dyDouble >= MinFloatUlpsPerPixel * FLT_EPSILON * maxY;
+}
+
+bool IsFixedPointPrecisionEnough(const MandelbrotView* view)
+{
+    assert(view);
+
+    const double maxX = GetMaxAbs(view->x0BeginDouble,
+                                  view->x0BeginDouble + (double)view->width  * view->dxDouble);
+    const double maxY = GetMaxAbs(view->y0BeginDouble,
+                                  view->y0BeginDouble + (double)view->height * view->dyDouble);
+
+    const double fixedPointUlp = 1. / (double)(1u << Fixed16FractionBits);
+
+    return maxX < MaxFixedPointCoordinate && maxY < MaxFixedPointCoordinate &&
+           view->dxDouble >= MinFixedPointUlpsPerPixel * fixedPointUlp &&
+           view->dyDouble >= MinFixedPointUlpsPerPixel * fixedPointUlp;
+}
+
+static double GetMaxAbs(const double a, const double b)
+{
+    return fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+}
@@ -0,0 +1,280 @@
+#ifndef MANDELBROT_H
+#define MANDELBROT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FixedPoint.h"
+#include "TileScheduler.h"
+
+static const float  CenterX = -1.35f;
+static const float  CenterY = 0.f;
+
+static const size_t DefaultMaxNumberOfIterations = 256;
+// numbers of iterations are stored in uint16_t
+static const size_t MaxNumberOfIterationsLimit   = UINT16_MAX;
+
+// Everything a kernel needs to know about the frame. Pixel (pixelX, pixelY) is the point
+// (x0Begin + pixelX * dx, y0Begin + pixelY * dy).
+struct MandelbrotView
+{
+    size_t width;
+    size_t height;
+
+    float  x0Begin;
+    float  y0Begin;
+    float  dx;
+    float  dy;
+
+    // the same origin and step for the double precision kernels, float ones are these
+    // values rounded
+    double x0BeginDouble;
+    double y0BeginDouble;
+    double dxDouble;
+    double dyDouble;
+
+    size_t maxNumberOfIterations;
+};
+
+void     MandelbrotViewCtor                 (MandelbrotView* view,
+                                             const size_t width, const size_t height,
+                                             const double imageXShift, const double imageYShift,
+                                             const double scale,
+                                             const float dxPerPixel, const float dyPerPixel,
+                                             const size_t maxNumberOfIterations);
+
+// False when neighbouring pixels are too few float ulps apart and the float kernels would
+// draw blocks, then a double precision kernel has to be used.
+bool     IsFloatPrecisionEnough             (const MandelbrotView* view);
+
+// Numbers of the fixed point kernel are int16 with this many bits after the point, in [-8, 8).
+static const unsigned Fixed16FractionBits = 12;
+
+// True when the frame is inside of |x|, |y| < 4, so the orbits don't overflow before they
+// escape, and neighbouring pixels are far enough apart in fixed point not to merge into
+// blocks. The picture still differs from the float one, the kernel is only used by name.
+bool     IsFixedPointPrecisionEnough        (const MandelbrotView* view);
+
+// Part of the frame, [xBegin, xEnd) x [yBegin, yEnd): a tile calculated by one call of a tile
+// kernel or a region of the frame to render. Every pixel gets its coordinates from the frame
+// origin, so the picture doesn't depend on the tiling.
+struct MandelbrotTile
+{
+    size_t xBegin;
+    size_t yBegin;
+    size_t xEnd;
+    size_t yEnd;
+};
+
+// Counters gathered by the kernels over a tile or a frame.
+struct MandelbrotStats
+{
+    // executions of the vector loop body, lane occupancy of a kernel is
+    // (sum of iterations over pixels) / (vectorIterations * numberOfLanes)
+    uint64_t vectorIterations;
+
+    // iterations not executed for pixels proven to be inside the set, by the cardioid and
+    // bulb check or by finding a cycle in the orbit
+    uint64_t skippedIterations;
+
+    // pixels the subdivision and the zoom renders filled without calculating them
+    uint64_t filledPixels;
+
+    // times a pixel of the perturbation render moved to the start of the reference orbit
+    uint64_t rebases;
+
+    // pixels the anti-aliasing took extra samples for
+    uint64_t refinedPixels;
+};
+
+// Fills the numbers of iterations of the tile pixels and adds its counters to stats.
+typedef void (*MandelbrotTileKernel)(uint16_t* iterations, const MandelbrotView* view,
+                                     const MandelbrotTile* tile, MandelbrotStats* stats);
+// The same with fractional numbers of iterations for smooth coloring.
+typedef void (*MandelbrotSmoothTileKernel)(float* smoothIterations, const MandelbrotView* view,
+                                           const MandelbrotTile* tile, MandelbrotStats* stats);
+
+// These two fill width * height RGBA pixels. Under TIME_MEASURE they return the number of
+// cycles spent, otherwise 0.
+uint64_t CalculateMandelbrotSetNoAvx        (uint8_t* pixels, const MandelbrotView* view);
+uint64_t CalculateMandelbrotSetNoAvxArrays  (uint8_t* pixels, const MandelbrotView* view);
+
+// The rest fill width * height numbers of iterations, colors are made by ColorizeMandelbrot.
+// stats may be nullptr
+uint64_t CalculateMandelbrotSetTiled        (uint16_t* iterations, const MandelbrotView* view,
+                                             TileScheduler* scheduler,
+                                             MandelbrotTileKernel tileKernel,
+                                             MandelbrotStats* stats);
+// Calculates only the pixels of the region, the rest of the frame is left as it is.
+uint64_t CalculateMandelbrotRegionTiled     (uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* region,
+                                             TileScheduler* scheduler,
+                                             MandelbrotTileKernel tileKernel,
+                                             MandelbrotStats* stats);
+// Fills width * height fractional numbers of iterations by the avx2 smooth kernel, needs the
+// avx2 kernel to be supported. Colors are made by ColorizeMandelbrotSmooth, stats may be
+// nullptr.
+uint64_t CalculateMandelbrotSetSmooth       (float* smoothIterations, const MandelbrotView* view,
+                                             TileScheduler* scheduler, MandelbrotStats* stats);
+// Mariani-Silver subdivision on top of the AVX2 kernel, needs the avx2 kernel to be
+// supported. May differ from the full render where a detail is smaller than a rectangle
+// with the same iterations on its border. stats may be nullptr.
+uint64_t CalculateMandelbrotSetSubdivided   (uint16_t* iterations, const MandelbrotView* view,
+                                             TileScheduler* scheduler,
+                                             MandelbrotStats* stats);
+uint64_t CalculateMandelbrotRegionSubdivided(uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* region,
+                                             TileScheduler* scheduler,
+                                             MandelbrotStats* stats);
+
+// Frame of a zoom path that takes what it can from the previous frame of the path: blocks
+// that were inside of the set there have their border calculated and, if it is inside too,
+// are filled without calculating them. The same approximation as the subdivision, the rest
+// is calculated by tileKernel. previousIterations may be nullptr, stats may be nullptr.
+uint64_t CalculateMandelbrotSetZoomed       (uint16_t* iterations, const MandelbrotView* view,
+                                             const uint16_t* previousIterations,
+                                             const MandelbrotView* previousView,
+                                             TileScheduler* scheduler,
+                                             MandelbrotTileKernel tileKernel,
+                                             MandelbrotStats* stats);
+
+// Deep zoom by perturbation: one reference orbit of the center of the view (pixel
+// (width / 2, height / 2)) is calculated in fixed point, every pixel iterates its double
+// difference from it on AVX2. Only the double fields dx and dy of the view are used, so it
+// works while they are far from the double underflow. Needs AVX2 and FMA, stats may be
+// nullptr.
+uint64_t CalculateMandelbrotSetPerturbed    (uint16_t* iterations, const MandelbrotView* view,
+                                             const FixedPoint* centerX,
+                                             const FixedPoint* centerY,
+                                             TileScheduler* scheduler,
+                                             MandelbrotStats* stats);
+
+// If view is previousView moved by a whole number of pixels, moves the iterations that stay
+// in the frame and gives the strips that are new (up to 2 regions, none if the view is the
+// same). Otherwise gives the whole frame. previousView may be nullptr.
+size_t   PanMandelbrotIterations            (uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotView* previousView,
+                                             MandelbrotTile* outRegions);
+
+void     CalculateMandelbrotTileSse2        (uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* tile, MandelbrotStats* stats);
+void     CalculateMandelbrotTileAvx2        (uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* tile, MandelbrotStats* stats);
+void     CalculateMandelbrotTileAvx512      (uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* tile, MandelbrotStats* stats);
+// The avx2 kernel written with the Vec type of SimdVector.h, gives the same picture.
+void     CalculateMandelbrotTileVec         (uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* tile, MandelbrotStats* stats);
+
+// The avx2 kernel that also keeps |z|^2 at the escape and gives the normalized iteration
+// count, continuous over the frame. Pixels of the set get maxNumberOfIterations.
+void     CalculateMandelbrotTileAvx2Smooth  (float* smoothIterations, const MandelbrotView* view,
+                                             const MandelbrotTile* tile, MandelbrotStats* stats);
+
+// Doesn't wait for the slowest of 8 pixels: lanes that are done are reloaded with the next
+// pixels of the tile.
+void     CalculateMandelbrotTileAvx2Recycling (uint16_t* iterations, const MandelbrotView* view,
+                                               const MandelbrotTile* tile,
+                                               MandelbrotStats* stats);
+// 16 lanes of int16 fixed point for shallow views, see IsFixedPointPrecisionEnough. Escaped
+// lanes are counted on to |z| = 10 in float, so counts are like in the float kernels.
+void     CalculateMandelbrotTileAvx2Fixed16 (uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* tile, MandelbrotStats* stats);
+// 4 lanes of double for deep zoom, uses the double fields of the view.
+void     CalculateMandelbrotTileAvx2Double  (uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* tile, MandelbrotStats* stats);
+
+// AVX2 kernel specialized at compile time, Avx2UnrolledKernel.cpp instantiates the variants
+// of the kernel table. Lanes are Avx2FloatLanes (8 floats, counts of the avx2 kernel) or
+// Avx2DoubleLanes (4 doubles, counts of avx2-double). The escape is checked once in
+// CheckInterval iterations and a group where a lane escaped is repeated with the checks, so
+// counts stay exact. MaxNumberOfIterations 0 takes the cap from the view, otherwise views with
+// another cap are given to the 0 variant. RadiusSquare is 100 in all the other kernels.
+struct Avx2FloatLanes;
+struct Avx2DoubleLanes;
+
+template <typename Lanes, size_t CheckInterval, size_t MaxNumberOfIterations, size_t RadiusSquare>
+void     CalculateMandelbrotTileUnrolled    (uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* tile, MandelbrotStats* stats);
+
+// AVX2 kernel with NumberOfChains groups of 8 pixels iterated together and FMA, so the
+// latency of one group is hidden by the others. Avx2InterleavedKernel.cpp instantiates 1 to 4.
+template <size_t NumberOfChains>
+void     CalculateMandelbrotTileAvx2Interleaved(uint16_t* iterations, const MandelbrotView* view,
+                                                const MandelbrotTile* tile,
+                                                MandelbrotStats* stats);
+
+enum MandelbrotPaletteType
+{
+    PALETTE_GREEN,  // the original one, same as SetPixelColor
+    PALETTE_FIRE,
+    PALETTE_GRAY,
+
+    NUMBER_OF_PALETTES,
+};
+
+// RGBA color of every number of iterations from 0 to maxNumberOfIterations.
+struct MandelbrotPalette
+{
+    uint32_t* colors;
+    size_t    maxNumberOfIterations;
+};
+
+void     MandelbrotPaletteCtor              (MandelbrotPalette* palette,
+                                             const size_t maxNumberOfIterations,
+                                             const MandelbrotPaletteType type);
+void     MandelbrotPaletteDtor              (MandelbrotPalette* palette);
+
+// Adaptive supersampling: only pixels whose number of iterations differs from one of their 4
+// neighbours by more than threshold are refined. A refined pixel gets the average color of
+// gridSize * gridSize samples, one jittered sample in every cell of the grid over the pixel.
+// Samples of many pixels are packed into full vectors of 8.
+struct MandelbrotAntiAliasing
+{
+    size_t gridSize;    // 2 and more, cost of a refined pixel grows as its square
+    size_t threshold;   // lower refines more pixels
+};
+
+// Recolors the refined pixels of a colorized frame in place, colors of the samples come from
+// the palette of the frame. Samples are iterated like in the avx2 kernel, so it needs the avx2
+// kernel to be supported. stats may be nullptr.
+uint64_t AntiAliasMandelbrot                (uint8_t* pixels, const uint16_t* iterations,
+                                             const MandelbrotView* view,
+                                             const MandelbrotPalette* palette,
+                                             const MandelbrotAntiAliasing* antiAliasing,
+                                             TileScheduler* scheduler,
+                                             MandelbrotStats* stats);
+
+// pixels have to be 32 bytes aligned, they are written with streaming stores
+// that don't pollute the cache.
+void     ColorizeMandelbrot                 (uint8_t* pixels, const uint16_t* iterations,
+                                             const size_t numberOfPixels,
+                                             const MandelbrotPalette* palette);
+void     ColorizeMandelbrotAvx2             (uint8_t* pixels, const uint16_t* iterations,
+                                             const size_t numberOfPixels,
+                                             const MandelbrotPalette* palette);
+// Color of a fractional number of iterations is between the palette colors of its whole part
+// and of the next one, so there are no bands between the counts. Same alignment as above.
+void     ColorizeMandelbrotSmooth           (uint8_t* pixels, const float* smoothIterations,
+                                             const size_t numberOfPixels,
+                                             const MandelbrotPalette* palette);
+// Only whole groups of 8 pixels.
+void     ColorizeMandelbrotSmoothAvx2       (uint8_t* pixels, const float* smoothIterations,
+                                             const size_t numberOfPixels,
+                                             const MandelbrotPalette* palette);
+
+static inline void SetPixelColor(uint8_t* pixel, const size_t numberOfIterations,
+                                 const size_t maxNumberOfIterations)
+{
+    const float colorsCalculatingDivider = (float)maxNumberOfIterations / 255.f;
+
+    uint8_t color = (uint8_t)((float)numberOfIterations / colorsCalculatingDivider);
+    color = numberOfIterations == maxNumberOfIterations ? 0 : color;
+
+    pixel[0] = color > 122 ? color : 0;
+    pixel[1] = color > 122 ? 1     : color;
+    pixel[2] = color > 122 ? color : 0;
+    pixel[3] = 255;
+}
+
+#endif
@@ -3,11 +3,10 @@
 #include <stddef.h>
 #include <SFML/Graphics.hpp>
 
+#include "Mandelbrot.h"
+
 void     CreateWindow           (const size_t width, const size_t height, 
                                  sf::RenderWindow* outWindow, const char* windowName);
-uint64_t CalculateMandelbrotSet (sf::Uint8* pixels, const size_t width, const size_t height,
-                                 const float imageXShift, const float imageYShift, 
-                                 const float scale, const float dxPerPixel, const float dyPerPixel);
 void     DrawPixels             (sf::RenderWindow* window, sf::Uint8* pixels, 
                                  const size_t width, const size_t height);
 void     ClearWindow            (sf::RenderWindow* window);
@@ -15,8 +14,6 @@ void     PollEvents             (sf::RenderWindow* window,
                                  float* imageXShift, float* imageYShift, float* scale,
                                  const float dxPerPixel, const float dyPerPixel);
 
-extern "C" uint64_t GetTimeStampCounter();
-
 int main()
 {
     static const size_t width  = 800;
@@ -38,8 +35,11 @@ int main()
     uint64_t numberOfRuns = 0;
     while (window.isOpen())
     {
-        time += CalculateMandelbrotSet(pixels, width, height, imageXShift, 
-                                       imageYShift, scale, dxPerPixel, dyPerPixel);
+        MandelbrotView view = {};
+        MandelbrotViewCtor(&view, width, height, imageXShift, imageYShift, scale, 
+                           dxPerPixel, dyPerPixel, DefaultMaxNumberOfIterations);
+
+        time += CalculateMandelbrotSetNoAvx(pixels, &view);
 
 #ifndef TIME_MEASURE
         DrawPixels(&window, pixels, width, height);
@@ -66,78 +66,6 @@ void CreateWindow(const size_t width, const size_t height,
     outWindow->create(sf::VideoMode(width, height), windowName);
 }
 
-uint64_t CalculateMandelbrotSet(sf::Uint8* pixels, const size_t width, const size_t height,
-                                const float imageXShift, const float imageYShift, 
-                                const float scale, const float dxPerPixel, const float dyPerPixel)
-{
-    static const size_t maxNumberOfIterations = 256;
-    static const float  maxRadiusSquare       = 10 * 10.f;
-    static const float  centerX               = -1.35f;
-    static const float  centerY               = 0.f;
-
-#ifdef TIME_MEASURE
-    uint64_t startTime            = GetTimeStampCounter();
-    uint64_t allIterationsCounter = 0;
-#endif
-
-    const float dx = dxPerPixel / scale;
-    const float dy = dyPerPixel / scale;
-
-    float y0            = -(float)height / 2 * dy + centerY + imageYShift;
-    const float x0Begin = -(float)width  / 2 * dx + centerX + imageXShift;
-
-    for (size_t pixelY = 0; pixelY < height; ++pixelY, y0 += dy)
-    {
-        float x0 = x0Begin;
-
-        for (size_t pixelX = 0; pixelX < width; ++pixelX, x0 += dx)
-        {
-            float x = x0;
-            float y = y0;
-
-            size_t iterationNumber = 0;
-            for (iterationNumber = 0; iterationNumber < maxNumberOfIterations;
-                    ++iterationNumber)
-            {
-                const float xSquare = x * x;
-                const float ySquare = y * y;
-                const float xMulY   = x * y;
-
-                float radiusSquare = xSquare + ySquare;
-
-                if (radiusSquare >= maxRadiusSquare) break;
-
-                x = xSquare - ySquare + x0;
-                y = xMulY   + xMulY   + y0;
-            }
-
-        #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
-            float color = (float)iterationNumber / (float)maxNumberOfIterations * 255.f;
-
-            uint8_t col = iterationNumber == maxNumberOfIterations ? 0 : (uint8_t)color;
-
-            size_t pixelPos = (pixelX + pixelY * width) * 4;
-
-            pixels[pixelPos]     = col > 122 ? col : 0;
-            pixels[pixelPos + 1] = col > 122 ? 1   : col;
-            pixels[pixelPos + 2] = col > 122 ? col : 0;
-            pixels[pixelPos + 3] = 255;
-        #endif
-        #ifdef TIME_MEASURE_EXTRA_VAR
-            allIterationsCounter += iterationNumber;
-        #endif
-        }
-    }
-
-#ifdef TIME_MEASURE
-    uint64_t timeSpent = GetTimeStampCounter() - startTime;
-    printf("allIterationsCounter - %llu\n", allIterationsCounter);
-    return timeSpent;
-#else
-    return 0;
-#endif
-}
-
 void DrawPixels (sf::RenderWindow* window, sf::Uint8* pixels, 
                  const size_t width, const size_t height)
 {
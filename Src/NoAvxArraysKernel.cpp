@@ -0,0 +1,79 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Mandelbrot.h"
+
+extern "C" uint64_t GetTimeStampCounter();
+
+// The experiment of the README with the helpers made into Vec: the frame is calculated by the
+// vec tile kernel, the avx2 kernel written with Vec, a row at a time, and every row is
+// colorized while it is in the cache.
+uint64_t CalculateMandelbrotSetNoAvxArrays(uint8_t* pixels, const MandelbrotView* view)
+{
+    assert(pixels);
+    assert(view);
+
+    const size_t width  = view->width;
+    const size_t height = view->height;
+
+#ifdef TIME_MEASURE
+    uint64_t startTime = GetTimeStampCounter();
+#endif
+#if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+    // RGBA of every number of iterations, a division per number instead of one per pixel
+    const size_t maxNumberOfIterations    = view->maxNumberOfIterations;
+    const float  colorsCalculatingDivider = (float)maxNumberOfIterations / 255.f;
+
+    uint8_t* colors = (uint8_t*)calloc((maxNumberOfIterations + 1) * 4, sizeof(*colors));
+    for (size_t i = 0; i <= maxNumberOfIterations; ++i)
+    {
+        // the set itself is black
+        const uint8_t color = i == maxNumberOfIterations ? 0 :
+                              (uint8_t)((float)i / colorsCalculatingDivider);
+
+        colors[i * 4]     = color > 122 ? color : 0;
+        colors[i * 4 + 1] = color > 122 ? 1     : color;
+        colors[i * 4 + 2] = color > 122 ? color : 0;
+        colors[i * 4 + 3] = 255;
+    }
+#endif
+
+    // the row is calculated as the first one of a view of one row, the kernel gets the same
+    // y0 as for the whole frame
+    MandelbrotView rowView = *view;
+    rowView.height = 1;
+
+    uint16_t* rowIterations = (uint16_t*)calloc(width, sizeof(*rowIterations));
+
+    const MandelbrotTile row   = { 0, 0, width, 1 };
+    MandelbrotStats      stats = {};
+
+    for (size_t pixelY = 0; pixelY < height; ++pixelY)
+    {
+        rowView.y0Begin = view->y0Begin + (float)pixelY * view->dy;
+
+        CalculateMandelbrotTileVec(rowIterations, &rowView, &row, &stats);
+
+    #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+        uint8_t* pixelsPos = pixels + pixelY * width * 4;
+        for (size_t pixelX = 0; pixelX < width; ++pixelX)
+            memcpy(pixelsPos + pixelX * 4, colors + rowIterations[pixelX] * 4, 4);
+    #endif
+    }
+
+    free(rowIterations);
+#if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+    free(colors);
+#endif
+
+#ifdef TIME_MEASURE
+    uint64_t timeSpent = GetTimeStampCounter() - startTime;
+    printf("vectorIterations - %llu\n", (unsigned long long)stats.vectorIterations);
+    printf("skippedIterations - %llu\n", (unsigned long long)stats.skippedIterations);
+    return timeSpent;
+#else
+    return 0;
+#endif
+}
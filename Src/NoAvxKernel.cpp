@@ -0,0 +1,81 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "Mandelbrot.h"
+
+extern "C" uint64_t GetTimeStampCounter();
+
+uint64_t CalculateMandelbrotSetNoAvx(uint8_t* pixels, const MandelbrotView* view)
+{
+    assert(pixels);
+    assert(view);
+
+    static const float  maxRadiusSquare = 10 * 10.f;
+
+    const size_t width                 = view->width;
+    const size_t height                = view->height;
+    const size_t maxNumberOfIterations = view->maxNumberOfIterations;
+
+#ifdef TIME_MEASURE
+    uint64_t startTime            = GetTimeStampCounter();
+    uint64_t allIterationsCounter = 0;
+#endif
+
+    const float dx = view->dx;
+    const float dy = view->dy;
+
+    float y0            = view->y0Begin;
+    const float x0Begin = view->x0Begin;
+
+    for (size_t pixelY = 0; pixelY < height; ++pixelY, y0 += dy)
+    {
+        float x0 = x0Begin;
+
+        for (size_t pixelX = 0; pixelX < width; ++pixelX, x0 += dx)
+        {
+            float x = x0;
+            float y = y0;
+
+            size_t iterationNumber = 0;
+            for (iterationNumber = 0; iterationNumber < maxNumberOfIterations;
+                    ++iterationNumber)
+            {
+                const float xSquare = x * x;
+                const float ySquare = y * y;
+                const float xMulY   = x * y;
+
+                float radiusSquare = xSquare + ySquare;
+
+                if (radiusSquare >= maxRadiusSquare) break;
+
+                x = xSquare - ySquare + x0;
+                y = xMulY   + xMulY   + y0;
+            }
+
+        #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+            float color = (float)iterationNumber / (float)maxNumberOfIterations * 255.f;
+
+            uint8_t col = iterationNumber == maxNumberOfIterations ? 0 : (uint8_t)color;
+
+            size_t pixelPos = (pixelX + pixelY * width) * 4;
+
+            pixels[pixelPos]     = col > 122 ? col : 0;
+            pixels[pixelPos + 1] = col > 122 ? 1   : col;
+            pixels[pixelPos + 2] = col > 122 ? col : 0;
+            pixels[pixelPos + 3] = 255;
+        #endif
+        #ifdef TIME_MEASURE_EXTRA_VAR
+            allIterationsCounter += iterationNumber;
+        #endif
+        }
+    }
+
+#ifdef TIME_MEASURE
+    uint64_t timeSpent = GetTimeStampCounter() - startTime;
+    // printed so the compiler keeps the loop, only in the TIME_MEASURE build of testNoAvx
+    printf("allIterationsCounter - %llu\n", (unsigned long long)allIterationsCounter);
+    return timeSpent;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,127 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "Mandelbrot.h"
+
+// Largest distance from a whole number of pixels that is still treated as a pan. Reused
+// pixels are off by at most this part of a pixel.
+static const double MaxPanError = 0.05;
+
+static bool GetPanShift(const MandelbrotView* view, const MandelbrotView* previousView,
+                        long* outShiftX, long* outShiftY);
+static void ShiftIterations(uint16_t* iterations, const size_t width, const size_t height,
+                            const long shiftX, const long shiftY);
+
+size_t PanMandelbrotIterations(uint16_t* iterations, const MandelbrotView* view,
+                               const MandelbrotView* previousView, MandelbrotTile* outRegions)
+{
+    assert(iterations);
+    assert(view);
+    assert(outRegions);
+
+    const size_t width  = view->width;
+    const size_t height = view->height;
+
+    long shiftX = 0;
+    long shiftY = 0;
+    if (!previousView || !GetPanShift(view, previousView, &shiftX, &shiftY))
+    {
+        outRegions[0] = { 0, 0, width, height };
+        return 1;
+    }
+
+    if (shiftX == 0 && shiftY == 0)
+        return 0;
+
+    ShiftIterations(iterations, width, height, shiftX, shiftY);
+
+    // new pixel (x, y) was (x + shiftX, y + shiftY), columns and rows that were out of
+    // the previous frame have to be calculated
+    const size_t exposedWidth  = (size_t)labs(shiftX);
+    const size_t exposedHeight = (size_t)labs(shiftY);
+
+    const size_t keptXBegin = shiftX > 0 ? 0                    : exposedWidth;
+    const size_t keptXEnd   = shiftX > 0 ? width - exposedWidth : width;
+
+    size_t numberOfRegions = 0;
+
+    if (shiftX > 0)
+        outRegions[numberOfRegions++] = { keptXEnd, 0, width, height };
+    else if (shiftX < 0)
+        outRegions[numberOfRegions++] = { 0, 0, keptXBegin, height };
+
+    // without the corner that is in the column strip already
+    if (shiftY > 0)
+        outRegions[numberOfRegions++] = { keptXBegin, height - exposedHeight, keptXEnd, height };
+    else if (shiftY < 0)
+        outRegions[numberOfRegions++] = { keptXBegin, 0, keptXEnd, exposedHeight };
+
+    return numberOfRegions;
+}
+
+// The view is a pan of the previous one if only the origin has moved, by a whole number
+// of pixels that is less than the frame size.
+static bool GetPanShift(const MandelbrotView* view, const MandelbrotView* previousView,
+                        long* outShiftX, long* outShiftY)
+{
+    assert(view);
+    assert(previousView);
+    assert(outShiftX);
+    assert(outShiftY);
+
+    if (view->width  != previousView->width || view->height != previousView->height ||
+        view->maxNumberOfIterations != previousView->maxNumberOfIterations)
+        return false;
+
+    // double fields, the float ones can't tell a shift from rounding on a deep zoom
+    const double dx = view->dxDouble;
+    const double dy = view->dyDouble;
+
+    // a different step moves pixels on the far side of the frame by a part of a pixel
+    if (fabs(dx - previousView->dxDouble) * (double)view->width  > MaxPanError * dx ||
+        fabs(dy - previousView->dyDouble) * (double)view->height > MaxPanError * dy)
+        return false;
+
+    const double shiftX = (view->x0BeginDouble - previousView->x0BeginDouble) / dx;
+    const double shiftY = (view->y0BeginDouble - previousView->y0BeginDouble) / dy;
+
+    const double roundedShiftX = round(shiftX);
+    const double roundedShiftY = round(shiftY);
+
+    if (fabs(shiftX - roundedShiftX) > MaxPanError ||
+        fabs(shiftY - roundedShiftY) > MaxPanError)
+        return false;
+
+    if (fabs(roundedShiftX) >= (double)view->width || fabs(roundedShiftY) >= (double)view->height)
+        return false;
+
+    *outShiftX = (long)roundedShiftX;
+    *outShiftY = (long)roundedShiftY;
+
+    return true;
+}
+
+static void ShiftIterations(uint16_t* iterations, const size_t width, const size_t height,
+                            const long shiftX, const long shiftY)
+{
+    assert(iterations);
+
+    const size_t keptWidth   = width  - (size_t)labs(shiftX);
+    const size_t keptHeight  = height - (size_t)labs(shiftY);
+
+    const size_t fromXBegin  = shiftX > 0 ? (size_t)shiftX : 0;
+    const size_t toXBegin    = shiftX > 0 ? 0              : (size_t)-shiftX;
+    const size_t fromYBegin  = shiftY > 0 ? (size_t)shiftY : 0;
+    const size_t toYBegin    = shiftY > 0 ? 0              : (size_t)-shiftY;
+
+    // rows are moved in the order that doesn't overwrite the ones not moved yet
+    for (size_t i = 0; i < keptHeight; ++i)
+    {
+        const size_t row = shiftY > 0 ? i : keptHeight - 1 - i;
+
+        memmove(iterations + (toYBegin   + row) * width + toXBegin,
+                iterations + (fromYBegin + row) * width + fromXBegin,
+                keptWidth * sizeof(*iterations));
+    }
+}
@@ -0,0 +1,158 @@
+#include <assert.h>
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "PerfCounters.h"
+
+struct PerfCounterType
+{
+    uint32_t    type;
+    uint64_t    config;
+    const char* name;
+};
+
+static const PerfCounterType PerfCounterTypes[] =
+{
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,       "cycles"        },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,     "instructions"  },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES,   "ref-cycles"    },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,    "branch-misses" },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                          PERF_COUNT_HW_CACHE_RESULT_MISS << 16,  "l1d-misses"    },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,     "llc-misses"    },
+};
+
+static_assert(sizeof(PerfCounterTypes) / sizeof(*PerfCounterTypes) == NUMBER_OF_PERF_COUNTERS,
+              "Every counter needs a type");
+
+static int      OpenCounter  (const PerfCounterType* counterType);
+static uint64_t ReadCounter  (const int fileDescriptor);
+
+void PerfCountersCtor(PerfCounters* counters)
+{
+    assert(counters);
+
+    counters->hasAnyCounter = false;
+    counters->openError     = 0;
+    counters->start         = {};
+
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+    {
+        counters->fileDescriptors[i] = OpenCounter(&PerfCounterTypes[i]);
+
+        if (counters->fileDescriptors[i] >= 0)
+            counters->hasAnyCounter = true;
+        else if (!counters->openError)
+            counters->openError = errno;
+    }
+}
+
+void PerfCountersDtor(PerfCounters* counters)
+{
+    assert(counters);
+
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+    {
+        if (counters->fileDescriptors[i] >= 0)
+            close(counters->fileDescriptors[i]);
+
+        counters->fileDescriptors[i] = -1;
+    }
+
+    counters->hasAnyCounter = false;
+}
+
+void PerfCountersStart(PerfCounters* counters)
+{
+    assert(counters);
+
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+        counters->start.values[i] = ReadCounter(counters->fileDescriptors[i]);
+
+    // the last one, so reading the counters is not measured
+    counters->start.tsc = GetTimeStampCounterStart();
+}
+
+void PerfCountersStop(PerfCounters* counters, PerfSample* outSample)
+{
+    assert(counters);
+    assert(outSample);
+
+    outSample->tsc = GetTimeStampCounterEnd() - counters->start.tsc;
+
+    for (size_t i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+    {
+        const uint64_t value = ReadCounter(counters->fileDescriptors[i]);
+        outSample->values[i] = value > counters->start.values[i] ?
+                               value - counters->start.values[i] : 0;
+    }
+}
+
+bool IsPerfCounterAvailable(const PerfCounters* counters, const PerfCounter counter)
+{
+    assert(counters);
+    assert(counter < NUMBER_OF_PERF_COUNTERS);
+
+    return counters->fileDescriptors[counter] >= 0;
+}
+
+const char* GetPerfCounterName(const PerfCounter counter)
+{
+    assert(counter < NUMBER_OF_PERF_COUNTERS);
+
+    return PerfCounterTypes[counter].name;
+}
+
+bool PinToCpus(const size_t firstCpu, const size_t numberOfCpus)
+{
+    assert(numberOfCpus > 0);
+
+    if (firstCpu + numberOfCpus > CPU_SETSIZE)
+        return false;
+
+    cpu_set_t cpus = {};
+    CPU_ZERO(&cpus);
+    for (size_t i = firstCpu; i < firstCpu + numberOfCpus; ++i)
+        CPU_SET(i, &cpus);
+
+    return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+// User space counts of this thread and of the threads it will create. Paranoid level 2, the
+// default, allows only user space counting of own processes.
+static int OpenCounter(const PerfCounterType* counterType)
+{
+    assert(counterType);
+
+    perf_event_attr attributes = {};
+    attributes.size           = sizeof(attributes);
+    attributes.type           = counterType->type;
+    attributes.config         = counterType->config;
+    attributes.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attributes.inherit        = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv     = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Count scaled by the share of time the counter was on the cpu, 0 if there is no counter.
+static uint64_t ReadCounter(const int fileDescriptor)
+{
+    if (fileDescriptor < 0)
+        return 0;
+
+    // value, time enabled, time running
+    uint64_t values[3] = {};
+    if (read(fileDescriptor, values, sizeof(values)) != (ssize_t)sizeof(values) || !values[2])
+        return 0;
+
+    if (values[1] == values[2])
+        return values[0];
+
+    return (uint64_t)((double)values[0] * (double)values[1] / (double)values[2]);
+}
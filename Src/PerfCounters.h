@@ -0,0 +1,57 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum PerfCounter
+{
+    PERF_CYCLES,            // core cycles, they follow the frequency
+    PERF_INSTRUCTIONS,
+    PERF_REF_CYCLES,        // cycles at the nominal frequency
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,        // L1 data cache read misses
+    PERF_LLC_MISSES,
+
+    NUMBER_OF_PERF_COUNTERS,
+};
+
+// Values of the counters over a measured run. tsc is the serialized time stamp counter, it is
+// there even if perf_event_open is not.
+struct PerfSample
+{
+    uint64_t tsc;
+    uint64_t values[NUMBER_OF_PERF_COUNTERS];
+};
+
+// Counters of perf_event_open for the calling thread and the threads it creates after
+// PerfCountersCtor, so it has to be made before the worker threads. Counters the kernel or the
+// cpu doesn't have are left out, if there are none only the tsc is measured. Counts are scaled
+// if the kernel multiplexed the counters.
+struct PerfCounters
+{
+    int  fileDescriptors[NUMBER_OF_PERF_COUNTERS];  // -1 for the counters that are not there
+    bool hasAnyCounter;
+    int  openError;                                 // errno of the first failed counter
+
+    PerfSample start;
+};
+
+void        PerfCountersCtor     (PerfCounters* counters);
+void        PerfCountersDtor     (PerfCounters* counters);
+
+void        PerfCountersStart    (PerfCounters* counters);
+// Counts since PerfCountersStart.
+void        PerfCountersStop     (PerfCounters* counters, PerfSample* outSample);
+
+bool        IsPerfCounterAvailable(const PerfCounters* counters, const PerfCounter counter);
+const char* GetPerfCounterName   (const PerfCounter counter);
+
+// Pins the calling thread to numberOfCpus cpus from firstCpu, threads created after it run on
+// the same cpus. False if the cpus are not there or not allowed.
+bool        PinToCpus            (const size_t firstCpu, const size_t numberOfCpus);
+
+extern "C" uint64_t GetTimeStampCounterStart();
+extern "C" uint64_t GetTimeStampCounterEnd  ();
+
+#endif
@@ -0,0 +1,305 @@
+#include <assert.h>
+#include <immintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+
+#include "Mandelbrot.h"
+
+extern "C" uint64_t GetTimeStampCounter();
+
+static const size_t TileWidth  = 64;
+static const size_t TileHeight = 8;
+
+// Z_0 = 0, Z_1 = C, ... of the center C rounded to double. The last point is the first
+// one that escaped or Z_maxNumberOfIterations.
+struct ReferenceOrbit
+{
+    double* x;
+    double* y;
+    size_t  length;
+};
+
+struct PerturbedFrame
+{
+    uint16_t*             iterations;
+    const MandelbrotView* view;
+    const ReferenceOrbit* orbit;
+
+    // only for the interior checks, pixels don't need more
+    double                centerX;
+    double                centerY;
+
+    size_t                numberOfTilesX;
+
+    std::atomic<uint64_t> vectorIterations;
+    std::atomic<uint64_t> skippedIterations;
+    std::atomic<uint64_t> rebases;
+};
+
+static void CalculateReferenceOrbit  (ReferenceOrbit* orbit,
+                                      const FixedPoint* centerX, const FixedPoint* centerY,
+                                      const size_t maxNumberOfIterations);
+static void CalculatePerturbedTile   (size_t tileIndex, size_t threadIndex, void* context);
+static inline __m256d IsInMainCardioidOrBulb(const __m256d x, const __m256d y);
+
+uint64_t CalculateMandelbrotSetPerturbed(uint16_t* iterations, const MandelbrotView* view,
+                                         const FixedPoint* centerX, const FixedPoint* centerY,
+                                         TileScheduler* scheduler, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(centerX);
+    assert(centerY);
+    assert(scheduler);
+
+#ifdef TIME_MEASURE
+    uint64_t startTime = GetTimeStampCounter();
+#endif
+
+    ReferenceOrbit orbit = {};
+    orbit.x = (double*)calloc(view->maxNumberOfIterations + 1, sizeof(*orbit.x));
+    orbit.y = (double*)calloc(view->maxNumberOfIterations + 1, sizeof(*orbit.y));
+
+    CalculateReferenceOrbit(&orbit, centerX, centerY, view->maxNumberOfIterations);
+
+    PerturbedFrame frame = {};
+    frame.iterations = iterations;
+    frame.view       = view;
+    frame.orbit      = &orbit;
+    frame.centerX    = FixedPointToDouble(centerX);
+    frame.centerY    = FixedPointToDouble(centerY);
+
+    frame.numberOfTilesX = (view->width  + TileWidth  - 1) / TileWidth;
+    size_t numberOfTiles = (view->height + TileHeight - 1) / TileHeight * frame.numberOfTilesX;
+
+    TileSchedulerRun(scheduler, numberOfTiles, CalculatePerturbedTile, &frame);
+
+    if (stats)
+    {
+        stats->vectorIterations  = frame.vectorIterations;
+        stats->skippedIterations = frame.skippedIterations;
+        stats->rebases           = frame.rebases;
+    }
+
+    free(orbit.x);
+    free(orbit.y);
+
+#ifdef TIME_MEASURE
+    uint64_t timeSpent = GetTimeStampCounter() - startTime;
+    printf("vectorIterations - %llu\n", (unsigned long long)frame.vectorIterations.load());
+    printf("rebases - %llu\n", (unsigned long long)frame.rebases.load());
+    return timeSpent;
+#else
+    return 0;
+#endif
+}
+
+// The only place with fixed point math, maxNumberOfIterations steps of 3 multiplications.
+static void CalculateReferenceOrbit(ReferenceOrbit* orbit,
+                                    const FixedPoint* centerX, const FixedPoint* centerY,
+                                    const size_t maxNumberOfIterations)
+{
+    assert(orbit);
+    assert(centerX);
+    assert(centerY);
+
+    FixedPoint x = {};
+    FixedPoint y = {};
+
+    orbit->x[0]   = 0;
+    orbit->y[0]   = 0;
+    orbit->length = 1;
+
+    for (size_t i = 1; i <= maxNumberOfIterations; ++i)
+    {
+        FixedPoint xSquare = {};
+        FixedPoint ySquare = {};
+        FixedPoint xMulY   = {};
+        FixedPointMul(&xSquare, &x, &x);
+        FixedPointMul(&ySquare, &y, &y);
+        FixedPointMul(&xMulY,   &x, &y);
+
+        FixedPointSub(&x, &xSquare, &ySquare);
+        FixedPointAdd(&x, &x,       centerX);
+        FixedPointAdd(&y, &xMulY,   &xMulY);
+        FixedPointAdd(&y, &y,       centerY);
+
+        orbit->x[i]   = FixedPointToDouble(&x);
+        orbit->y[i]   = FixedPointToDouble(&y);
+        orbit->length = i + 1;
+
+        // one more square of an escaped point could overflow the integer part
+        if (orbit->x[i] * orbit->x[i] + orbit->y[i] * orbit->y[i] >= 100)
+            break;
+    }
+}
+
+// A pixel is z = Z_m + d, where c = C + dc. Then d' = 2 Z_m d + d^2 + dc = (2 Z_m + d) d + dc,
+// everything is small and double is enough. A lane is rebased, d = z and m = 0, when
+// |z| < |d|: the difference stopped being small compared to the orbit and would lose
+// precision (a glitch). It is rebased too when the reference orbit ends before the pixel,
+// so one orbit is enough for the whole frame.
+static void CalculatePerturbedTile(size_t tileIndex, size_t threadIndex, void* context)
+{
+    assert(context);
+    (void)threadIndex;
+
+    PerturbedFrame*       frame = (PerturbedFrame*)context;
+    const MandelbrotView* view  = frame->view;
+    const double*         orbitX = frame->orbit->x;
+    const double*         orbitY = frame->orbit->y;
+
+    const size_t xBegin = tileIndex % frame->numberOfTilesX * TileWidth;
+    const size_t yBegin = tileIndex / frame->numberOfTilesX * TileHeight;
+    const size_t xEnd   = xBegin + TileWidth  < view->width  ? xBegin + TileWidth  : view->width;
+    const size_t yEnd   = yBegin + TileHeight < view->height ? yBegin + TileHeight : view->height;
+
+    const __m256d maxRadiusSquare = _mm256_set1_pd(100.);
+    const __m256d zero            = _mm256_setzero_pd();
+    const __m256i ones            = _mm256_set1_epi64x(1);
+    const __m256i lastOrbitPoint  = _mm256_set1_epi64x((long long)frame->orbit->length - 1);
+
+    const size_t  maxNumberOfIterations    = view->maxNumberOfIterations;
+    const __m256i maxNumberOfIterationsAvx = _mm256_set1_epi64x((long long)maxNumberOfIterations);
+
+    uint64_t vectorIterations  = 0;
+    uint64_t skippedIterations = 0;
+    uint64_t rebases           = 0;
+
+    const __m256d laneNumbers = _mm256_set_pd(3, 2, 1, 0);
+    const __m256d dxAvx       = _mm256_set1_pd(view->dxDouble);
+    const __m256d centerXAvx  = _mm256_set1_pd(frame->centerX);
+    const __m256d centerYAvx  = _mm256_set1_pd(frame->centerY);
+
+    for (size_t pixelY = yBegin; pixelY < yEnd; ++pixelY)
+    {
+        const __m256d dcY = _mm256_set1_pd(((double)pixelY - (double)(view->height / 2)) *
+                                           view->dyDouble);
+
+        for (size_t pixelX = xBegin; pixelX < xEnd; pixelX += 4)
+        {
+            __m256d pixelsX = _mm256_add_pd(_mm256_set1_pd((double)pixelX -
+                                                           (double)(view->width / 2)),
+                                            laneNumbers);
+            __m256d dcX     = _mm256_mul_pd(pixelsX, dxAvx);
+
+            // z_1 = c, so every lane starts at Z_1 with d = dc
+            __m256d dX = dcX;
+            __m256d dY = dcY;
+            __m256i orbitPoint = ones;
+
+            __m256i numberOfIterations = _mm256_setzero_si256();
+
+            __m256d isInterior = IsInMainCardioidOrBulb(_mm256_add_pd(centerXAvx, dcX),
+                                                        _mm256_add_pd(centerYAvx, dcY));
+
+            size_t iterationNumber = 0;
+            for (iterationNumber = 0; iterationNumber < maxNumberOfIterations;
+                 ++iterationNumber)
+            {
+                __m256d referenceX = _mm256_i64gather_pd(orbitX, orbitPoint, 8);
+                __m256d referenceY = _mm256_i64gather_pd(orbitY, orbitPoint, 8);
+
+                __m256d x = _mm256_add_pd(referenceX, dX);
+                __m256d y = _mm256_add_pd(referenceY, dY);
+
+                __m256d radiusSquare = _mm256_fmadd_pd(x, x, _mm256_mul_pd(y, y));
+
+                __m256d cmpRadius = _mm256_cmp_pd(radiusSquare, maxRadiusSquare, _CMP_LT_OQ);
+                __m256d isCounted = _mm256_andnot_pd(isInterior, cmpRadius);
+
+                if (!_mm256_movemask_pd(isCounted)) break;
+
+                numberOfIterations = _mm256_sub_epi64(numberOfIterations,
+                                                      _mm256_castpd_si256(isCounted));
+
+                __m256d differenceSquare = _mm256_fmadd_pd(dX, dX, _mm256_mul_pd(dY, dY));
+                __m256d isGlitch  = _mm256_cmp_pd(radiusSquare, differenceSquare, _CMP_LT_OQ);
+                __m256d isOrbitEnd = _mm256_castsi256_pd(_mm256_cmpeq_epi64(orbitPoint,
+                                                                            lastOrbitPoint));
+                __m256d isRebased = _mm256_or_pd(isGlitch, isOrbitEnd);
+
+                const int rebasedMask = _mm256_movemask_pd(isRebased);
+                if (rebasedMask)
+                {
+                    rebases += (uint64_t)__builtin_popcount((unsigned)(rebasedMask &
+                                                            _mm256_movemask_pd(isCounted)));
+
+                    // Z_0 = 0, so the whole z becomes the difference
+                    dX         = _mm256_blendv_pd(dX, x, isRebased);
+                    dY         = _mm256_blendv_pd(dY, y, isRebased);
+                    referenceX = _mm256_blendv_pd(referenceX, zero, isRebased);
+                    referenceY = _mm256_blendv_pd(referenceY, zero, isRebased);
+                    orbitPoint = _mm256_andnot_si256(_mm256_castpd_si256(isRebased),
+                                                     orbitPoint);
+                }
+
+                __m256d twoZPlusDX = _mm256_add_pd(_mm256_add_pd(referenceX, referenceX), dX);
+                __m256d twoZPlusDY = _mm256_add_pd(_mm256_add_pd(referenceY, referenceY), dY);
+
+                __m256d newDX = _mm256_fmadd_pd(twoZPlusDX, dX,
+                                                _mm256_fnmadd_pd(twoZPlusDY, dY, dcX));
+                dY = _mm256_fmadd_pd(twoZPlusDX, dY, _mm256_fmadd_pd(twoZPlusDY, dX, dcY));
+                dX = newDX;
+
+                orbitPoint = _mm256_add_epi64(orbitPoint, ones);
+            }
+
+            if (_mm256_movemask_pd(isInterior))
+            {
+                __m256i isInteriorInt = _mm256_castpd_si256(isInterior);
+
+                alignas(32) long long skippedIterationsArray[4] = {};
+                _mm256_store_si256((__m256i*)skippedIterationsArray,
+                                   _mm256_and_si256(isInteriorInt,
+                                                    _mm256_sub_epi64(maxNumberOfIterationsAvx,
+                                                                     numberOfIterations)));
+                for (size_t i = 0; i < 4; ++i)
+                    skippedIterations += (uint64_t)skippedIterationsArray[i];
+
+                numberOfIterations = _mm256_blendv_epi8(numberOfIterations,
+                                                        maxNumberOfIterationsAvx, isInteriorInt);
+            }
+
+            alignas(32) long long numberOfIterationsArray[4] = {};
+            _mm256_store_si256((__m256i*)numberOfIterationsArray, numberOfIterations);
+
+            const size_t numberOfPixels = xEnd - pixelX < 4 ? xEnd - pixelX : 4;
+
+            uint16_t* iterationsPos = frame->iterations + pixelX + pixelY * view->width;
+            for (size_t i = 0; i < numberOfPixels; ++i)
+                iterationsPos[i] = (uint16_t)numberOfIterationsArray[i];
+
+            // the last check that broke the loop is executed too
+            vectorIterations += iterationNumber + (iterationNumber < maxNumberOfIterations);
+        }
+    }
+
+    frame->vectorIterations  += vectorIterations;
+    frame->skippedIterations += skippedIterations;
+    frame->rebases           += rebases;
+}
+
+// Same as in Avx2DoubleKernel.cpp, c is known only up to double here but the cardioid and
+// the bulb are far from any deep zoom.
+static inline __m256d IsInMainCardioidOrBulb(const __m256d x, const __m256d y)
+{
+    const __m256d quarter   = _mm256_set1_pd(0.25);
+    const __m256d one       = _mm256_set1_pd(1.);
+    const __m256d sixteenth = _mm256_set1_pd(1. / 16);
+
+    __m256d ySquare = _mm256_mul_pd(y, y);
+
+    __m256d xShifted = _mm256_sub_pd(x, quarter);
+    __m256d q        = _mm256_fmadd_pd(xShifted, xShifted, ySquare);
+
+    __m256d isInCardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xShifted)),
+                                         _mm256_mul_pd(ySquare, quarter), _CMP_LE_OQ);
+
+    __m256d xPlusOne = _mm256_add_pd(x, one);
+    __m256d isInBulb = _mm256_cmp_pd(_mm256_fmadd_pd(xPlusOne, xPlusOne, ySquare),
+                                     sixteenth, _CMP_LE_OQ);
+
+    return _mm256_or_pd(isInCardioid, isInBulb);
+}
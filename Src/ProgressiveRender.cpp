@@ -0,0 +1,691 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "ProgressiveRender.h"
+
+extern "C" uint64_t GetTimeStampCounter();
+
+static const size_t TileWidth  = 64;
+static const size_t TileHeight = 8;
+
+// A pass calculates the pixels with both coordinates multiple of its step that are not on
+// the grid of the pass before it. These are the steps of a full quality frame, a coarser
+// final step replaces the ones below it. Steps are powers of two, so a lattice that starts
+// at the column 0 has exactly the coordinates of the frame pixels it stands for.
+static const size_t PassSteps[]         = { 8, 4, 1 };
+static const size_t NumberOfPasses      = sizeof(PassSteps) / sizeof(*PassSteps);
+
+// rows that are new in the pass and gaps in the rows of the previous pass, for every
+// offset up to the previous step
+static const size_t MaxNumberOfLattices = 8;
+static const size_t MaxNumberOfPasses   = 8;
+// the last pass shown before the tiles of the cache fill the frame
+static const size_t PreviewStep         = PassSteps[NumberOfPasses - 2];
+
+// Frame pixels (offsetX + x * stepX, offsetY + y * stepY). Every row of a lattice is
+// calculated as a view of one row, so its y is the same as in the frame.
+struct Lattice
+{
+    size_t offsetX;
+    size_t offsetY;
+    size_t stepX;
+    size_t stepY;
+
+    size_t width;
+    size_t height;
+
+    size_t numberOfTilesX;
+    size_t firstTile;
+};
+
+struct LatticePass
+{
+    uint16_t*                  iterations;
+    uint16_t*                  rowIterations;
+    const MandelbrotView*      view;
+    MandelbrotTileKernel       tileKernel;
+
+    Lattice                    lattices[MaxNumberOfLattices];
+    size_t                     numberOfLattices;
+
+    const std::atomic<size_t>* postedRequestNumber;
+    size_t                     requestNumber;
+};
+
+// What the render thread keeps between requests.
+struct RenderState
+{
+    MandelbrotView              previousView;
+    const MandelbrotKernelInfo* previousKernel;
+    // iterations of previousView are calculated on the grid of this step, 0 if on none
+    size_t                      knownStep;
+
+    // the last published picture, a refinement doesn't show passes coarser than it
+    MandelbrotView              shownView;
+    size_t                      shownStep;
+
+    MandelbrotPalette           palette;
+    MandelbrotPaletteType       paletteType;
+};
+
+// One request on the render thread.
+struct RenderJob
+{
+    const MandelbrotView*       view;
+    const MandelbrotKernelInfo* kernel;
+    size_t                      requestNumber;
+    size_t                      finalStep;
+
+    uint64_t                    startTime;
+    uint64_t                    colorizeTime;
+};
+
+static void   RenderThread         (ProgressiveRenderer* renderer);
+static void   RenderRequest        (ProgressiveRenderer* renderer, RenderState* state,
+                                    const MandelbrotView* view, const size_t finalStep,
+                                    const size_t requestNumber);
+static size_t RenderPasses         (ProgressiveRenderer* renderer, RenderState* state,
+                                    RenderJob* job, const size_t knownStep,
+                                    const size_t lastStep);
+static size_t GetPassSteps         (const size_t knownStep, const size_t finalStep,
+                                    size_t* outSteps);
+static size_t GetPassLattices      (const size_t step, const size_t previousStep,
+                                    const size_t width, const size_t height,
+                                    Lattice* outLattices);
+static void   GetLatticeRowView    (const MandelbrotView* view, const Lattice* lattice,
+                                    const size_t row, MandelbrotView* outRowView);
+static void   CalculateLatticeTile (size_t tileIndex, size_t threadIndex, void* context);
+static void   FillBlocks           (uint16_t* iterations, const size_t width, const size_t height,
+                                    const size_t step);
+static void   PublishFrame         (ProgressiveRenderer* renderer, RenderState* state,
+                                    RenderJob* job, const size_t step,
+                                    const bool isComplete);
+static bool   IsSamePosition       (const MandelbrotView* view, const MandelbrotView* otherView);
+
+void ProgressiveRendererCtor(ProgressiveRenderer* renderer, const size_t width, const size_t height,
+                             TileScheduler* scheduler, const MandelbrotKernelInfo* kernel,
+                             const bool useSubdivision, TileCache* tileCache)
+{
+    assert(renderer);
+    assert(scheduler);
+    assert(kernel);
+
+    renderer->width          = width;
+    renderer->height         = height;
+    renderer->scheduler      = scheduler;
+    renderer->kernel         = kernel;
+    renderer->useSubdivision = useSubdivision;
+    renderer->tileCache      = tileCache;
+
+    renderer->view           = {};
+    renderer->paletteType    = PALETTE_GREEN;
+    renderer->finalStep      = 1;
+    renderer->requestNumber  = 0;
+    renderer->shouldStop     = false;
+
+    // colorizer writes 32 bytes at once with aligned streaming stores
+    for (size_t i = 0; i < 3; ++i)
+        renderer->pixels[i] = (uint8_t*)aligned_alloc(32, width * height * 4);
+
+    renderer->renderIndex = 0;
+    renderer->readyIndex  = 1;
+    renderer->shownIndex  = 2;
+    renderer->isReadyNew  = false;
+    renderer->readyFrame  = {};
+    renderer->stats       = {};
+
+    renderer->iterations    = (uint16_t*)calloc(width * height, sizeof(*renderer->iterations));
+    renderer->rowIterations = (uint16_t*)calloc(scheduler->numberOfThreads * width,
+                                                sizeof(*renderer->rowIterations));
+
+    renderer->thread = std::thread(RenderThread, renderer);
+}
+
+void ProgressiveRendererDtor(ProgressiveRenderer* renderer)
+{
+    assert(renderer);
+
+    {
+        std::lock_guard<std::mutex> lock(renderer->mutex);
+        renderer->shouldStop = true;
+        // the frame in progress is cancelled too
+        renderer->requestNumber++;
+    }
+    renderer->requestPosted.notify_one();
+
+    renderer->thread.join();
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        free(renderer->pixels[i]);
+        renderer->pixels[i] = nullptr;
+    }
+
+    free(renderer->iterations);
+    free(renderer->rowIterations);
+
+    renderer->iterations    = nullptr;
+    renderer->rowIterations = nullptr;
+}
+
+size_t ProgressiveRendererPost(ProgressiveRenderer* renderer, const MandelbrotView* view,
+                               const MandelbrotPaletteType paletteType, const size_t finalStep)
+{
+    assert(renderer);
+    assert(view);
+    assert(view->width == renderer->width && view->height == renderer->height);
+    assert(finalStep > 0 && (finalStep & (finalStep - 1)) == 0);
+
+    size_t requestNumber = 0;
+    {
+        std::lock_guard<std::mutex> lock(renderer->mutex);
+
+        renderer->view        = *view;
+        renderer->paletteType = paletteType;
+        renderer->finalStep   = finalStep;
+        requestNumber         = ++renderer->requestNumber;
+    }
+    renderer->requestPosted.notify_one();
+
+    return requestNumber;
+}
+
+bool ProgressiveRendererTakeFrame(ProgressiveRenderer* renderer, const uint64_t waitTimeNs,
+                                  ProgressiveFrame* outFrame)
+{
+    assert(renderer);
+    assert(outFrame);
+
+    std::unique_lock<std::mutex> lock(renderer->mutex);
+
+    if (!renderer->framePublished.wait_for(lock, std::chrono::nanoseconds(waitTimeNs),
+                                           [renderer] { return renderer->isReadyNew; }))
+        return false;
+
+    const size_t shownIndex = renderer->readyIndex;
+    renderer->readyIndex    = renderer->shownIndex;
+    renderer->shownIndex    = shownIndex;
+    renderer->isReadyNew    = false;
+
+    *outFrame        = renderer->readyFrame;
+    outFrame->pixels = renderer->pixels[shownIndex];
+
+    return true;
+}
+
+void ProgressiveRendererGetStats(ProgressiveRenderer* renderer, ProgressiveRenderStats* outStats)
+{
+    assert(renderer);
+    assert(outStats);
+
+    std::lock_guard<std::mutex> lock(renderer->mutex);
+    *outStats = renderer->stats;
+}
+
+static void RenderThread(ProgressiveRenderer* renderer)
+{
+    assert(renderer);
+
+    RenderState state = {};
+    state.previousKernel = renderer->kernel;
+
+    size_t lastRequestNumber = 0;
+    while (true)
+    {
+        MandelbrotView        view          = {};
+        MandelbrotPaletteType paletteType   = PALETTE_GREEN;
+        size_t                finalStep     = 1;
+        size_t                requestNumber = 0;
+        {
+            std::unique_lock<std::mutex> lock(renderer->mutex);
+            renderer->requestPosted.wait(lock, [renderer, lastRequestNumber]
+                                         {
+                                             return renderer->shouldStop ||
+                                                    renderer->requestNumber != lastRequestNumber;
+                                         });
+
+            if (renderer->shouldStop)
+                break;
+
+            view          = renderer->view;
+            paletteType   = renderer->paletteType;
+            finalStep     = renderer->finalStep;
+            requestNumber = renderer->requestNumber;
+        }
+
+        lastRequestNumber = requestNumber;
+
+        // tiles of the cache are on the grid of the scale level, so are the frames
+        if (renderer->tileCache)
+            SnapViewToTileGrid(&view);
+
+        if (!state.palette.colors || paletteType != state.paletteType ||
+            view.maxNumberOfIterations != state.palette.maxNumberOfIterations)
+        {
+            MandelbrotPaletteDtor(&state.palette);
+            MandelbrotPaletteCtor(&state.palette, view.maxNumberOfIterations, paletteType);
+            state.paletteType = paletteType;
+        }
+
+        RenderRequest(renderer, &state, &view, finalStep, requestNumber);
+    }
+
+    MandelbrotPaletteDtor(&state.palette);
+}
+
+static void RenderRequest(ProgressiveRenderer* renderer, RenderState* state,
+                          const MandelbrotView* view, const size_t finalStep,
+                          const size_t requestNumber)
+{
+    assert(renderer);
+    assert(state);
+    assert(view);
+
+    RenderJob job = {};
+    job.view          = view;
+    job.requestNumber = requestNumber;
+    job.finalStep     = finalStep;
+
+    // float kernels are twice as wide, double is used only when pixels are too close
+    job.kernel = SelectMandelbrotKernelForView(renderer->kernel, view);
+    if (job.kernel != state->previousKernel)
+        printf("Kernel - %s\n", job.kernel->name);
+
+    // pixels of the other precision are not reused
+    const bool isSameKernel = job.kernel == state->previousKernel;
+
+    // the same view calculated to a coarser step is refined, the same iteration cap is
+    // a part of being the same
+    size_t knownStep = 0;
+    if (isSameKernel && memcmp(view, &state->previousView, sizeof(*view)) == 0)
+        knownStep = state->knownStep;
+
+    TileCache* tileCache = renderer->tileCache;
+#ifdef TIME_MEASURE
+    // every frame is measured in full
+    knownStep = 0;
+    tileCache = nullptr;
+#endif
+
+    // with the cache every full quality frame is made of its tiles, which are calculated
+    // from their own origins on the grid, so a level looks the same at every visit. A pan
+    // is covered by it too, the tiles of the previous frame are cached.
+    const bool useTileCache = tileCache && finalStep == 1 && knownStep != 1;
+
+    // after a pan of a full resolution frame only the new strips are calculated, the rest
+    // is moved
+    const MandelbrotView* panFromView = !useTileCache && knownStep == 0 && isSameKernel &&
+                                        state->knownStep == 1 ? &state->previousView : nullptr;
+
+    job.startTime = GetTimeStampCounter();
+
+    MandelbrotTile regions[2] = {};
+    size_t numberOfRegions = 0;
+    bool   isPan           = false;
+    if (panFromView)
+    {
+        numberOfRegions = PanMandelbrotIterations(renderer->iterations, view, panFromView,
+                                                  regions);
+
+        isPan = !(numberOfRegions == 1 &&
+                  regions[0].xEnd - regions[0].xBegin == view->width &&
+                  regions[0].yEnd - regions[0].yBegin == view->height);
+    }
+
+    // iterations are not of the previous view anymore, and are of this one only as far as
+    // it is calculated before a cancel
+    state->previousView   = *view;
+    state->previousKernel = job.kernel;
+    state->knownStep      = 0;
+
+    size_t calculatedStep = 0;
+    if (useTileCache)
+    {
+        size_t       numberOfHits  = 0;
+        const size_t numberOfTiles = TileCacheFindFrame(tileCache, view, job.kernel->tileKernel,
+                                                        &numberOfHits);
+
+        // the coarse passes are shown while the missing tiles are calculated
+        calculatedStep = knownStep;
+        if (numberOfHits < numberOfTiles && (knownStep == 0 || knownStep > PreviewStep))
+            calculatedStep = RenderPasses(renderer, state, &job, knownStep, PreviewStep);
+
+        const TileCacheCancel cancel      = { &renderer->requestNumber, requestNumber };
+        const bool            isCancelled = renderer->requestNumber.load(
+                                                std::memory_order_relaxed) != requestNumber;
+
+        if (!isCancelled &&
+            CalculateMandelbrotSetCached(renderer->iterations, view, tileCache,
+                                         renderer->scheduler, job.kernel->tileKernel, &cancel,
+                                         nullptr))
+        {
+            PublishFrame(renderer, state, &job, 1, true);
+            calculatedStep = 1;
+        }
+        // the frame has more tiles than the cache holds, it is calculated as without it
+        else if (renderer->requestNumber.load(std::memory_order_relaxed) == requestNumber)
+            calculatedStep = RenderPasses(renderer, state, &job, calculatedStep, finalStep);
+    }
+    else if (isPan)
+    {
+        // strips of a pan are a few pixels wide, they are calculated at once
+        for (size_t i = 0; i < numberOfRegions; ++i)
+        {
+            // subdivision is built on the float avx2 kernel
+            if (renderer->useSubdivision && !job.kernel->isDoublePrecision)
+                CalculateMandelbrotRegionSubdivided(renderer->iterations, view, &regions[i],
+                                                    renderer->scheduler, nullptr);
+            else
+                CalculateMandelbrotRegionTiled(renderer->iterations, view, &regions[i],
+                                               renderer->scheduler, job.kernel->tileKernel,
+                                               nullptr);
+        }
+
+        PublishFrame(renderer, state, &job, 1, true);
+        calculatedStep = 1;
+    }
+    else
+        calculatedStep = RenderPasses(renderer, state, &job, knownStep, finalStep);
+
+    state->knownStep = calculatedStep;
+
+    const bool     isComplete  = calculatedStep != 0 && calculatedStep <= finalStep;
+    const uint64_t computeTime = GetTimeStampCounter() - job.startTime;
+
+    std::lock_guard<std::mutex> lock(renderer->mutex);
+
+    renderer->stats.computeTime += computeTime;
+    if (isComplete)
+        renderer->stats.numberOfFrames++;
+    else
+        renderer->stats.numberOfCancelledFrames++;
+}
+
+// Calculates the passes from the grid of knownStep to lastStep and returns the step of the
+// finest grid that is calculated in full: lastStep or, if a newer request has cancelled the
+// frame, the last step before it. The frame is complete only when lastStep is the final step
+// of the job.
+static size_t RenderPasses(ProgressiveRenderer* renderer, RenderState* state,
+                           RenderJob* job, const size_t knownStep, const size_t lastStep)
+{
+    assert(renderer);
+    assert(state);
+    assert(job);
+
+    const MandelbrotView* view = job->view;
+
+    size_t steps[MaxNumberOfPasses] = {};
+    const size_t numberOfPasses = GetPassSteps(knownStep, lastStep, steps);
+    const bool   isFinal        = lastStep == job->finalStep;
+
+    // nothing to calculate, only a palette to apply
+    if (numberOfPasses == 0)
+    {
+        PublishFrame(renderer, state, job, knownStep, isFinal);
+        return knownStep;
+    }
+
+    LatticePass latticePass = {};
+    latticePass.iterations          = renderer->iterations;
+    latticePass.rowIterations       = renderer->rowIterations;
+    latticePass.view                = view;
+    latticePass.tileKernel          = job->kernel->tileKernel;
+    latticePass.postedRequestNumber = &renderer->requestNumber;
+    latticePass.requestNumber       = job->requestNumber;
+
+    size_t calculatedStep = knownStep;
+    for (size_t pass = 0; pass < numberOfPasses; ++pass)
+    {
+        latticePass.numberOfLattices = GetPassLattices(steps[pass], calculatedStep,
+                                                       view->width, view->height,
+                                                       latticePass.lattices);
+
+        const Lattice* lastLattice   = &latticePass.lattices[latticePass.numberOfLattices - 1];
+        const size_t   numberOfTiles = lastLattice->firstTile +
+                                       (lastLattice->height + TileHeight - 1) / TileHeight *
+                                       lastLattice->numberOfTilesX;
+
+        TileSchedulerRun(renderer->scheduler, numberOfTiles, CalculateLatticeTile, &latticePass);
+
+        if (renderer->requestNumber.load(std::memory_order_relaxed) != job->requestNumber)
+            return calculatedStep;
+
+        calculatedStep = steps[pass];
+
+        // pixels between the calculated ones are shown as blocks until the next pass
+        if (calculatedStep > 1)
+            FillBlocks(renderer->iterations, view->width, view->height, calculatedStep);
+
+        PublishFrame(renderer, state, job, calculatedStep,
+                     isFinal && pass + 1 == numberOfPasses);
+    }
+
+    return calculatedStep;
+}
+
+// Steps of PassSteps between knownStep (0 if nothing is calculated) and finalStep, then
+// finalStep itself.
+static size_t GetPassSteps(const size_t knownStep, const size_t finalStep, size_t* outSteps)
+{
+    assert(finalStep > 0);
+    assert(outSteps);
+
+    size_t numberOfPasses = 0;
+    for (size_t i = 0; i < NumberOfPasses; ++i)
+    {
+        if (PassSteps[i] > finalStep && (knownStep == 0 || PassSteps[i] < knownStep))
+            outSteps[numberOfPasses++] = PassSteps[i];
+    }
+
+    if (knownStep == 0 || finalStep < knownStep)
+        outSteps[numberOfPasses++] = finalStep;
+
+    assert(numberOfPasses <= MaxNumberOfPasses);
+    return numberOfPasses;
+}
+
+// The first pass (previousStep is 0) calculates its whole grid. The next ones calculate
+// the rows of their grid that are not on the previous one, these are contiguous in x for
+// the full resolution pass, and the gaps between the known pixels of the rows that are.
+static size_t GetPassLattices(const size_t step, const size_t previousStep,
+                              const size_t width, const size_t height, Lattice* outLattices)
+{
+    assert(step > 0);
+    assert(outLattices);
+    assert(previousStep % step == 0);
+    assert(2 * (previousStep / step) <= MaxNumberOfLattices);
+
+    size_t numberOfLattices = 0;
+    if (previousStep == 0)
+        outLattices[numberOfLattices++] = { 0, 0, step, step, 0, 0, 0, 0 };
+
+    for (size_t offset = step; offset < previousStep; offset += step)
+        outLattices[numberOfLattices++] = { 0, offset, step, previousStep, 0, 0, 0, 0 };
+
+    for (size_t offset = step; offset < previousStep; offset += step)
+        outLattices[numberOfLattices++] = { offset, 0, previousStep, previousStep, 0, 0, 0, 0 };
+
+    size_t numberOfTiles = 0;
+    for (size_t i = 0; i < numberOfLattices; ++i)
+    {
+        Lattice* lattice = &outLattices[i];
+
+        // a frame smaller than the step may have no pixels of a lattice
+        lattice->width  = width  > lattice->offsetX ?
+                          (width  - lattice->offsetX + lattice->stepX - 1) / lattice->stepX : 0;
+        lattice->height = height > lattice->offsetY ?
+                          (height - lattice->offsetY + lattice->stepY - 1) / lattice->stepY : 0;
+
+        lattice->numberOfTilesX = (lattice->width + TileWidth - 1) / TileWidth;
+        lattice->firstTile      = numberOfTiles;
+
+        numberOfTiles += (lattice->height + TileHeight - 1) / TileHeight * lattice->numberOfTilesX;
+    }
+
+    return numberOfLattices;
+}
+
+static void GetLatticeRowView(const MandelbrotView* view, const Lattice* lattice,
+                              const size_t row, MandelbrotView* outRowView)
+{
+    assert(view);
+    assert(lattice);
+    assert(outRowView);
+
+    const size_t frameY = lattice->offsetY + row * lattice->stepY;
+
+    *outRowView = *view;
+
+    outRowView->width  = lattice->width;
+    outRowView->height = 1;
+
+    // origins are the frame pixels (offsetX, frameY) as the kernels calculate them. The step
+    // is a power of two and multiplies dx exactly, so only offsetX != 0 rounds differently
+    outRowView->x0Begin = view->x0Begin + (float)lattice->offsetX * view->dx;
+    outRowView->y0Begin = view->y0Begin + (float)frameY           * view->dy;
+    outRowView->dx      = view->dx * (float)lattice->stepX;
+
+    outRowView->x0BeginDouble = view->x0BeginDouble + (double)lattice->offsetX * view->dxDouble;
+    outRowView->y0BeginDouble = view->y0BeginDouble + (double)frameY           * view->dyDouble;
+    outRowView->dxDouble      = view->dxDouble * (double)lattice->stepX;
+}
+
+static void CalculateLatticeTile(size_t tileIndex, size_t threadIndex, void* context)
+{
+    assert(context);
+
+    LatticePass* latticePass = (LatticePass*)context;
+
+    size_t latticeIndex = latticePass->numberOfLattices - 1;
+    while (latticePass->lattices[latticeIndex].firstTile > tileIndex)
+        latticeIndex--;
+
+    const Lattice*        lattice     = &latticePass->lattices[latticeIndex];
+    const size_t          latticeTile = tileIndex - lattice->firstTile;
+    const MandelbrotView* view        = latticePass->view;
+
+    MandelbrotTile tile = {};
+    tile.xBegin = latticeTile % lattice->numberOfTilesX * TileWidth;
+    tile.xEnd   = tile.xBegin + TileWidth < lattice->width ? tile.xBegin + TileWidth :
+                                                             lattice->width;
+    tile.yBegin = 0;
+    tile.yEnd   = 1;
+
+    const size_t rowBegin = latticeTile / lattice->numberOfTilesX * TileHeight;
+    const size_t rowEnd   = rowBegin + TileHeight < lattice->height ? rowBegin + TileHeight :
+                                                                      lattice->height;
+
+    const bool isContiguous = lattice->offsetX == 0 && lattice->stepX == 1;
+
+    for (size_t row = rowBegin; row < rowEnd; ++row)
+    {
+        // the rest of a cancelled pass is skipped, so a new request waits for one row of
+        // a tile at most
+        if (latticePass->postedRequestNumber->load(std::memory_order_relaxed) !=
+            latticePass->requestNumber)
+            return;
+
+        MandelbrotView rowView = {};
+        GetLatticeRowView(view, lattice, row, &rowView);
+
+        uint16_t* frameRow = latticePass->iterations +
+                             (lattice->offsetY + row * lattice->stepY) * view->width;
+
+        MandelbrotStats tileStats = {};
+
+        // a row of the final pass is written in place, the others go through the scratch
+        // row of the thread
+        if (isContiguous)
+        {
+            latticePass->tileKernel(frameRow, &rowView, &tile, &tileStats);
+            continue;
+        }
+
+        uint16_t* rowIterations = latticePass->rowIterations + threadIndex * view->width;
+        latticePass->tileKernel(rowIterations, &rowView, &tile, &tileStats);
+
+        for (size_t x = tile.xBegin; x < tile.xEnd; ++x)
+            frameRow[lattice->offsetX + x * lattice->stepX] = rowIterations[x];
+    }
+}
+
+// Every pixel on the grid of the step is copied to its block, the pixels it overwrites are
+// not on the grid and are calculated by the next passes.
+static void FillBlocks(uint16_t* iterations, const size_t width, const size_t height,
+                       const size_t step)
+{
+    assert(iterations);
+    assert(step > 0);
+
+    for (size_t blockY = 0; blockY < height; blockY += step)
+    {
+        uint16_t* row = iterations + blockY * width;
+
+        for (size_t blockX = 0; blockX < width; blockX += step)
+        {
+            const size_t blockXEnd = blockX + step < width ? blockX + step : width;
+            for (size_t x = blockX + 1; x < blockXEnd; ++x)
+                row[x] = row[blockX];
+        }
+
+        const size_t blockYEnd = blockY + step < height ? blockY + step : height;
+        for (size_t y = blockY + 1; y < blockYEnd; ++y)
+            memcpy(iterations + y * width, row, width * sizeof(*iterations));
+    }
+}
+
+// Colorizes the frame and makes it the ready picture, unless it is a pass of a refinement
+// that is coarser than the picture of the same place already shown.
+static void PublishFrame(ProgressiveRenderer* renderer, RenderState* state, RenderJob* job,
+                         const size_t step, const bool isComplete)
+{
+    assert(renderer);
+    assert(state);
+    assert(job);
+
+    if (!isComplete && step > state->shownStep && IsSamePosition(job->view, &state->shownView))
+        return;
+
+    state->shownView = *job->view;
+    state->shownStep = step;
+
+    const uint64_t startTime = GetTimeStampCounter();
+    ColorizeMandelbrot(renderer->pixels[renderer->renderIndex], renderer->iterations,
+                       renderer->width * renderer->height, &state->palette);
+    const uint64_t colorizeTime = GetTimeStampCounter() - startTime;
+    job->colorizeTime += colorizeTime;
+
+    {
+        std::lock_guard<std::mutex> lock(renderer->mutex);
+
+        const size_t readyIndex = renderer->renderIndex;
+        renderer->renderIndex   = renderer->readyIndex;
+        renderer->readyIndex    = readyIndex;
+        renderer->isReadyNew    = true;
+
+        renderer->readyFrame.requestNumber = job->requestNumber;
+        renderer->readyFrame.step          = step;
+        renderer->readyFrame.isComplete    = isComplete;
+        renderer->readyFrame.computeTime   = GetTimeStampCounter() - job->startTime;
+        renderer->readyFrame.colorizeTime  = job->colorizeTime;
+
+        renderer->stats.colorizeTime += colorizeTime;
+        renderer->stats.numberOfColorizes++;
+    }
+    renderer->framePublished.notify_one();
+}
+
+// Pixels are at the same points, whatever the iteration cap is.
+static bool IsSamePosition(const MandelbrotView* view, const MandelbrotView* otherView)
+{
+    assert(view);
+    assert(otherView);
+
+    MandelbrotView samePositionView = *otherView;
+    samePositionView.maxNumberOfIterations = view->maxNumberOfIterations;
+
+    return memcmp(view, &samePositionView, sizeof(*view)) == 0;
+}
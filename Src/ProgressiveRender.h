@@ -0,0 +1,114 @@
+#ifndef PROGRESSIVE_RENDER_H
+#define PROGRESSIVE_RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "KernelDispatch.h"
+#include "Mandelbrot.h"
+#include "TileCache.h"
+
+// Picture of one pass of a frame. pixels stay valid until the next take.
+struct ProgressiveFrame
+{
+    const uint8_t* pixels;
+
+    size_t         requestNumber;
+    // 1 when every pixel is calculated, otherwise the picture is made of step x step blocks
+    size_t         step;
+    // the last pass of the request, the step is its final step
+    bool           isComplete;
+
+    // cycles from the start of the request on the render thread to this picture, the
+    // colorizes of its pictures included
+    uint64_t       computeTime;
+    uint64_t       colorizeTime;
+};
+
+struct ProgressiveRenderStats
+{
+    // cycles of the calculations, cancelled frames included
+    uint64_t computeTime;
+    uint64_t colorizeTime;
+
+    size_t   numberOfFrames;          // calculated to their final step
+    size_t   numberOfCancelledFrames;
+    size_t   numberOfColorizes;
+};
+
+// Renders frames on a thread of its own, so the window thread only posts views and takes
+// pictures. A frame is calculated in passes from coarse to fine, every pass calculates only
+// the pixels the passes before it haven't, and a new post cancels the frame between tiles.
+struct ProgressiveRenderer
+{
+    std::thread                 thread;
+
+    std::mutex                  mutex;
+    std::condition_variable     requestPosted;
+    std::condition_variable     framePublished;
+
+    // the last posted request. requestNumber is also read by the tiles without the mutex
+    // to find out that they are cancelled
+    MandelbrotView              view;
+    MandelbrotPaletteType       paletteType;
+    size_t                      finalStep;
+    std::atomic<size_t>         requestNumber;
+    bool                        shouldStop;
+
+    // one picture is colorized, one is the last published and one is shown, so neither
+    // thread waits for the other
+    uint8_t*                    pixels[3];
+    size_t                      renderIndex;
+    size_t                      readyIndex;
+    size_t                      shownIndex;
+    bool                        isReadyNew;
+    ProgressiveFrame            readyFrame;
+
+    ProgressiveRenderStats      stats;
+
+    // the rest is used by the render thread only
+    size_t                      width;
+    size_t                      height;
+
+    TileScheduler*              scheduler;
+    const MandelbrotKernelInfo* kernel;
+    bool                        useSubdivision;
+    TileCache*                  tileCache;
+
+    uint16_t*                   iterations;
+    // a row for every thread of the scheduler, pixels of the coarse passes are scattered
+    // from it to the frame
+    uint16_t*                   rowIterations;
+};
+
+// Frames are width x height. useSubdivision is for the strips uncovered by a pan, they are
+// too thin for the passes. With a tileCache every view is moved to the grid of its scale
+// level and full quality frames are made of its tiles, the missing ones are calculated and
+// added.
+// The cache is used by the render thread only, tileCache may be nullptr.
+void   ProgressiveRendererCtor     (ProgressiveRenderer* renderer,
+                                    const size_t width, const size_t height,
+                                    TileScheduler* scheduler, const MandelbrotKernelInfo* kernel,
+                                    const bool useSubdivision, TileCache* tileCache);
+void   ProgressiveRendererDtor     (ProgressiveRenderer* renderer);
+
+// Cancels the frame in progress and returns the number of the new request. The frame is
+// calculated to the grid of finalStep (a power of two), the rest is shown as blocks. A view
+// that is the previous one moved, calculated to a coarser step or with another palette
+// reuses its iterations.
+size_t ProgressiveRendererPost     (ProgressiveRenderer* renderer, const MandelbrotView* view,
+                                    const MandelbrotPaletteType paletteType,
+                                    const size_t finalStep);
+
+// Waits up to waitTimeNs for a picture newer than the last taken one, false if there is none.
+bool   ProgressiveRendererTakeFrame(ProgressiveRenderer* renderer, const uint64_t waitTimeNs,
+                                    ProgressiveFrame* outFrame);
+
+void   ProgressiveRendererGetStats (ProgressiveRenderer* renderer,
+                                    ProgressiveRenderStats* outStats);
+
+#endif
@@ -0,0 +1,218 @@
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "QualityGovernor.h"
+
+extern "C" uint64_t GetTimeStampCounter();
+
+// Every level drops either a half of the iteration cap or three quarters of the pixels.
+struct QualityLevel
+{
+    size_t step;
+    size_t iterationsDivider;
+};
+
+static const QualityLevel QualityLevels[]      = { { 1, 1 }, { 1, 2 }, { 2, 2 }, { 2, 4 },
+                                                   { 4, 4 }, { 4, 8 }, { 8, 8 } };
+static const size_t       NumberOfLevels       = sizeof(QualityLevels) / sizeof(*QualityLevels);
+
+// fewer iterations don't tell the set from its border even at a glance
+static const size_t       MinNumberOfIterations = 64;
+
+// weight of a new frame in the smoothed estimates
+static const double       EstimateWeight       = 0.5;
+// a finer level is taken only if it fits into this part of the budget, so the quality
+// doesn't flip on every frame at the border
+static const double       UpgradeHeadroom      = 0.75;
+
+static const uint64_t     CalibrationTimeNs    = 20000000;
+
+static void     GetLevelQuality (const QualityGovernor* governor, const size_t level,
+                                 FrameQuality* outQuality);
+static double   GetComputeShare (const QualityGovernor* governor, const FrameQuality* quality);
+static double   PredictTime     (const QualityGovernor* governor, const size_t level);
+static void     ChooseLevel     (QualityGovernor* governor, const FrameQuality* quality,
+                                 const uint64_t time, const char* frameKind);
+static uint64_t GetTimeNs       ();
+
+void QualityGovernorCtor(QualityGovernor* governor, const double budgetMs,
+                         const double cyclesPerMs, const size_t maxNumberOfIterations,
+                         const bool isLogged)
+{
+    assert(governor);
+    assert(budgetMs > 0 && cyclesPerMs > 0);
+    assert(maxNumberOfIterations > 0);
+
+    governor->budget                = (uint64_t)(budgetMs * cyclesPerMs);
+    governor->cyclesPerMs           = cyclesPerMs;
+    governor->maxNumberOfIterations = maxNumberOfIterations;
+    governor->level                 = 0;
+    governor->fullComputeTime       = 0;
+    governor->colorizeTime          = 0;
+    governor->isLogged              = isLogged;
+    governor->numberOfFrames        = 0;
+}
+
+void QualityGovernorGetQuality(const QualityGovernor* governor, FrameQuality* outQuality)
+{
+    assert(governor);
+    assert(outQuality);
+
+    GetLevelQuality(governor, governor->level, outQuality);
+}
+
+void QualityGovernorAddFrame(QualityGovernor* governor, const FrameQuality* quality,
+                             const uint64_t computeTime, const uint64_t colorizeTime)
+{
+    assert(governor);
+    assert(quality);
+    assert(colorizeTime <= computeTime);
+
+    const double fullComputeTime = (double)(computeTime - colorizeTime) /
+                                   GetComputeShare(governor, quality);
+
+    if (governor->numberOfFrames == 0)
+    {
+        governor->fullComputeTime = fullComputeTime;
+        governor->colorizeTime    = (double)colorizeTime;
+    }
+    else
+    {
+        governor->fullComputeTime += EstimateWeight * (fullComputeTime -
+                                                       governor->fullComputeTime);
+        governor->colorizeTime    += EstimateWeight * ((double)colorizeTime -
+                                                       governor->colorizeTime);
+    }
+    governor->numberOfFrames++;
+
+    ChooseLevel(governor, quality, computeTime, "shown");
+}
+
+void QualityGovernorAddCancelled(QualityGovernor* governor, const FrameQuality* quality,
+                                 const uint64_t waitTime)
+{
+    assert(governor);
+    assert(quality);
+
+    // a frame cancelled within the budget might have fitted into it
+    if (waitTime <= governor->budget)
+        return;
+
+    const double computeTime     = (double)waitTime - governor->colorizeTime;
+    const double fullComputeTime = (computeTime > 0 ? computeTime : 0) /
+                                   GetComputeShare(governor, quality);
+
+    // it is a lower bound, not a measurement, so it isn't smoothed
+    if (fullComputeTime > governor->fullComputeTime)
+        governor->fullComputeTime = fullComputeTime;
+
+    ChooseLevel(governor, quality, waitTime, "cancelled");
+}
+
+double MeasureCyclesPerMs()
+{
+    const uint64_t startTimeNs = GetTimeNs();
+    const uint64_t startCycles = GetTimeStampCounter();
+
+    uint64_t timeNs = startTimeNs;
+    while (timeNs - startTimeNs < CalibrationTimeNs)
+        timeNs = GetTimeNs();
+
+    const uint64_t cycles = GetTimeStampCounter() - startCycles;
+
+    return (double)cycles / ((double)(timeNs - startTimeNs) / 1e6);
+}
+
+static void GetLevelQuality(const QualityGovernor* governor, const size_t level,
+                            FrameQuality* outQuality)
+{
+    assert(governor);
+    assert(level < NumberOfLevels);
+    assert(outQuality);
+
+    size_t maxNumberOfIterations = governor->maxNumberOfIterations /
+                                   QualityLevels[level].iterationsDivider;
+    if (maxNumberOfIterations < MinNumberOfIterations)
+        maxNumberOfIterations = MinNumberOfIterations;
+    if (maxNumberOfIterations > governor->maxNumberOfIterations)
+        maxNumberOfIterations = governor->maxNumberOfIterations;
+
+    outQuality->level                 = level;
+    outQuality->step                  = QualityLevels[level].step;
+    outQuality->maxNumberOfIterations = maxNumberOfIterations;
+}
+
+// Part of the calculation of a full quality frame a frame of the quality does: its share of
+// the pixels and, at most, of the iterations.
+static double GetComputeShare(const QualityGovernor* governor, const FrameQuality* quality)
+{
+    assert(governor);
+    assert(quality);
+
+    return (double)quality->maxNumberOfIterations / (double)governor->maxNumberOfIterations /
+           (double)(quality->step * quality->step);
+}
+
+static double PredictTime(const QualityGovernor* governor, const size_t level)
+{
+    assert(governor);
+
+    FrameQuality quality = {};
+    GetLevelQuality(governor, level, &quality);
+
+    return governor->fullComputeTime * GetComputeShare(governor, &quality) +
+           governor->colorizeTime;
+}
+
+// The finest level predicted to fit into the budget. Quality drops at once to it, but rises
+// by one level a frame, so a single cheap frame doesn't bring back the full quality.
+static void ChooseLevel(QualityGovernor* governor, const FrameQuality* quality,
+                        const uint64_t time, const char* frameKind)
+{
+    assert(governor);
+    assert(quality);
+    assert(frameKind);
+
+    size_t fitLevel = NumberOfLevels - 1;
+    for (size_t level = 0; level < NumberOfLevels; ++level)
+    {
+        if (PredictTime(governor, level) <= (double)governor->budget)
+        {
+            fitLevel = level;
+            break;
+        }
+    }
+
+    if (fitLevel > governor->level)
+        governor->level = fitLevel;
+    else if (governor->level > 0 &&
+             PredictTime(governor, governor->level - 1) <= UpgradeHeadroom *
+                                                           (double)governor->budget)
+        governor->level--;
+
+    if (!governor->isLogged)
+        return;
+
+    FrameQuality nextQuality = {};
+    GetLevelQuality(governor, governor->level, &nextQuality);
+
+    const double cyclesPerMs = governor->cyclesPerMs;
+    printf("Governor: %s frame - %.2f ms at step %zu, %zu iterations; full quality - "
+           "%.2f ms, colorize - %.2f ms; next: level %zu, step %zu, %zu iterations, "
+           "%.2f ms predicted, budget - %.2f ms\n",
+           frameKind, (double)time / cyclesPerMs, quality->step, quality->maxNumberOfIterations,
+           (governor->fullComputeTime + governor->colorizeTime) / cyclesPerMs,
+           governor->colorizeTime / cyclesPerMs, nextQuality.level, nextQuality.step,
+           nextQuality.maxNumberOfIterations,
+           PredictTime(governor, governor->level) / cyclesPerMs,
+           (double)governor->budget / cyclesPerMs);
+}
+
+static uint64_t GetTimeNs()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
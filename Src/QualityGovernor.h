@@ -0,0 +1,56 @@
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Frame is calculated on the grid of step (the rest is shown as blocks) with an iteration
+// cap. Level 0 is the full quality, every next level is cheaper.
+struct FrameQuality
+{
+    size_t level;
+    size_t step;
+    size_t maxNumberOfIterations;
+};
+
+// Chooses the quality of the frames while the view is moving, so they take no more than
+// the budget. The cost of a frame is modelled as its colorize plus the calculation of a full
+// quality frame scaled by the share of pixels and of the iteration cap the level keeps,
+// both are estimated from the measured frames.
+struct QualityGovernor
+{
+    uint64_t budget;                 // cycles
+    double   cyclesPerMs;
+    size_t   maxNumberOfIterations;  // of the full quality
+
+    size_t   level;
+
+    // smoothed estimates in cycles, 0 until the first frame
+    double   fullComputeTime;
+    double   colorizeTime;
+
+    bool     isLogged;
+    size_t   numberOfFrames;
+};
+
+void   QualityGovernorCtor        (QualityGovernor* governor, const double budgetMs,
+                                   const double cyclesPerMs, const size_t maxNumberOfIterations,
+                                   const bool isLogged);
+
+// Quality of the next frame of a moving view.
+void   QualityGovernorGetQuality  (const QualityGovernor* governor, FrameQuality* outQuality);
+
+// Frame of the quality was shown after computeTime cycles, colorizeTime of them spent on
+// the colorizes. Chooses the level of the next frames.
+void   QualityGovernorAddFrame    (QualityGovernor* governor, const FrameQuality* quality,
+                                   const uint64_t computeTime, const uint64_t colorizeTime);
+
+// Frame of the quality was cancelled without a complete picture after waitTime cycles,
+// it would have taken at least as long.
+void   QualityGovernorAddCancelled(QualityGovernor* governor, const FrameQuality* quality,
+                                   const uint64_t waitTime);
+
+// Time stamp counter cycles per millisecond, measured against the monotonic clock.
+double MeasureCyclesPerMs         ();
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef SIMD_VECTOR_H
+#define SIMD_VECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) && !defined(SIMD_VECTOR_GENERIC)
+#include <immintrin.h>
+#endif
+
+// N lanes of T with the operations of the kernels written as operators. The generic version
+// is a GCC vector of N lanes, the compiler lowers its operations to the vector instructions of
+// whatever ISA it targets, or to scalar ones where there are none. Lanes are 32 bit, as the
+// masks of comparisons are int32_t. With -mavx2 the 8 lane float and int vectors are
+// specializations on __m256 / __m256i, so a kernel written with Vec compiles to the intrinsics
+// of the hand-written kernel. SIMD_VECTOR_GENERIC turns the specializations off to compare.
+template <typename T, size_t N>
+struct Vec
+{
+    static_assert(sizeof(T) == sizeof(int32_t), "Masks are int32_t");
+
+    typedef T Lanes __attribute__((vector_size(sizeof(T) * N)));
+
+    Lanes lanes;
+
+    static inline Vec Set1(const T value)
+    {
+        return { Lanes{} + value };
+    }
+
+    // 0, 1, ..., N - 1
+    static inline Vec GetLaneNumbers()
+    {
+        Vec result = {};
+        for (size_t i = 0; i < N; ++i) result.lanes[i] = (T)i;
+        return result;
+    }
+
+    inline void Store(T* destination) const
+    {
+        memcpy(destination, &lanes, sizeof(lanes));
+    }
+};
+
+// Result of a comparison: every lane is all ones or all zeros, like the masks of intrinsics.
+template <size_t N>
+struct VecMask
+{
+    typedef int32_t Lanes __attribute__((vector_size(sizeof(int32_t) * N)));
+
+    Lanes lanes;
+};
+
+template <typename T, size_t N>
+static inline Vec<T, N> operator+(const Vec<T, N> a, const Vec<T, N> b)
+{
+    return { a.lanes + b.lanes };
+}
+
+template <typename T, size_t N>
+static inline Vec<T, N> operator-(const Vec<T, N> a, const Vec<T, N> b)
+{
+    return { a.lanes - b.lanes };
+}
+
+template <typename T, size_t N>
+static inline Vec<T, N> operator*(const Vec<T, N> a, const Vec<T, N> b)
+{
+    return { a.lanes * b.lanes };
+}
+
+template <typename T, size_t N>
+static inline Vec<T, N> operator/(const Vec<T, N> a, const Vec<T, N> b)
+{
+    return { a.lanes / b.lanes };
+}
+
+template <typename T, size_t N>
+static inline VecMask<N> operator<(const Vec<T, N> a, const Vec<T, N> b)
+{
+    return { a.lanes < b.lanes };
+}
+
+template <typename T, size_t N>
+static inline VecMask<N> operator<=(const Vec<T, N> a, const Vec<T, N> b)
+{
+    return { a.lanes <= b.lanes };
+}
+
+// exact equality, as the cycle detection of the kernels needs
+template <typename T, size_t N>
+static inline VecMask<N> IsEqual(const Vec<T, N> a, const Vec<T, N> b)
+{
+    return { (a.lanes <= b.lanes) & (b.lanes <= a.lanes) };
+}
+
+template <size_t N>
+static inline Vec<float, N> ToFloat(const Vec<int32_t, N> a)
+{
+    return { __builtin_convertvector(a.lanes, typename Vec<float, N>::Lanes) };
+}
+
+template <size_t N>
+static inline VecMask<N> operator&(const VecMask<N> a, const VecMask<N> b)
+{
+    return { a.lanes & b.lanes };
+}
+
+template <size_t N>
+static inline VecMask<N> operator|(const VecMask<N> a, const VecMask<N> b)
+{
+    return { a.lanes | b.lanes };
+}
+
+// b and not a, the argument order of andnot
+template <size_t N>
+static inline VecMask<N> AndNot(const VecMask<N> a, const VecMask<N> b)
+{
+    return { ~a.lanes & b.lanes };
+}
+
+template <size_t N>
+static inline bool IsAnyActive(const VecMask<N> mask)
+{
+    int32_t isActive = 0;
+    for (size_t i = 0; i < N; ++i) isActive |= mask.lanes[i];
+    return isActive != 0;
+}
+
+// counts + 1 in the active lanes
+template <size_t N>
+static inline Vec<int32_t, N> CountActive(const Vec<int32_t, N> counts, const VecMask<N> mask)
+{
+    return { counts.lanes - mask.lanes };
+}
+
+// a in the active lanes, b in the others
+template <size_t N>
+static inline Vec<int32_t, N> Select(const VecMask<N> mask, const Vec<int32_t, N> a,
+                                     const Vec<int32_t, N> b)
+{
+    return { (a.lanes & mask.lanes) | (b.lanes & ~mask.lanes) };
+}
+
+#if defined(__AVX2__) && !defined(SIMD_VECTOR_GENERIC)
+
+template <>
+struct Vec<float, 8>
+{
+    __m256 value;
+
+    static inline Vec Set1(const float value)
+    {
+        return { _mm256_set1_ps(value) };
+    }
+
+    static inline Vec GetLaneNumbers()
+    {
+        return { _mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f) };
+    }
+
+    inline void Store(float* destination) const
+    {
+        _mm256_storeu_ps(destination, value);
+    }
+};
+
+template <>
+struct Vec<int32_t, 8>
+{
+    __m256i value;
+
+    static inline Vec Set1(const int32_t value)
+    {
+        return { _mm256_set1_epi32(value) };
+    }
+
+    static inline Vec GetLaneNumbers()
+    {
+        return { _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0) };
+    }
+
+    inline void Store(int32_t* destination) const
+    {
+        _mm256_storeu_si256((__m256i*)destination, value);
+    }
+};
+
+template <>
+struct VecMask<8>
+{
+    __m256 value;
+};
+
+typedef Vec<float, 8>   Vec8f;
+typedef Vec<int32_t, 8> Vec8i;
+typedef VecMask<8>      VecMask8;
+
+static inline Vec8f operator+(const Vec8f a, const Vec8f b)
+{
+    return { _mm256_add_ps(a.value, b.value) };
+}
+
+static inline Vec8f operator-(const Vec8f a, const Vec8f b)
+{
+    return { _mm256_sub_ps(a.value, b.value) };
+}
+
+static inline Vec8f operator*(const Vec8f a, const Vec8f b)
+{
+    return { _mm256_mul_ps(a.value, b.value) };
+}
+
+static inline Vec8f operator/(const Vec8f a, const Vec8f b)
+{
+    return { _mm256_div_ps(a.value, b.value) };
+}
+
+static inline Vec8i operator+(const Vec8i a, const Vec8i b)
+{
+    return { _mm256_add_epi32(a.value, b.value) };
+}
+
+static inline Vec8i operator-(const Vec8i a, const Vec8i b)
+{
+    return { _mm256_sub_epi32(a.value, b.value) };
+}
+
+static inline Vec8i operator*(const Vec8i a, const Vec8i b)
+{
+    return { _mm256_mullo_epi32(a.value, b.value) };
+}
+
+static inline VecMask8 operator<(const Vec8f a, const Vec8f b)
+{
+    return { _mm256_cmp_ps(a.value, b.value, _CMP_LT_OQ) };
+}
+
+static inline VecMask8 operator<=(const Vec8f a, const Vec8f b)
+{
+    return { _mm256_cmp_ps(a.value, b.value, _CMP_LE_OQ) };
+}
+
+static inline VecMask8 IsEqual(const Vec8f a, const Vec8f b)
+{
+    return { _mm256_cmp_ps(a.value, b.value, _CMP_EQ_OQ) };
+}
+
+static inline Vec8f ToFloat(const Vec8i a)
+{
+    return { _mm256_cvtepi32_ps(a.value) };
+}
+
+static inline VecMask8 operator&(const VecMask8 a, const VecMask8 b)
+{
+    return { _mm256_and_ps(a.value, b.value) };
+}
+
+static inline VecMask8 operator|(const VecMask8 a, const VecMask8 b)
+{
+    return { _mm256_or_ps(a.value, b.value) };
+}
+
+static inline VecMask8 AndNot(const VecMask8 a, const VecMask8 b)
+{
+    return { _mm256_andnot_ps(a.value, b.value) };
+}
+
+static inline bool IsAnyActive(const VecMask8 mask)
+{
+    return _mm256_movemask_ps(mask.value) != 0;
+}
+
+static inline Vec8i CountActive(const Vec8i counts, const VecMask8 mask)
+{
+    return { _mm256_sub_epi32(counts.value, _mm256_castps_si256(mask.value)) };
+}
+
+static inline Vec8i Select(const VecMask8 mask, const Vec8i a, const Vec8i b)
+{
+    return { _mm256_blendv_epi8(b.value, a.value, _mm256_castps_si256(mask.value)) };
+}
+
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+#include <assert.h>
+#include <immintrin.h>
+
+#include "Avx2Iterations.h"
+#include "Mandelbrot.h"
+
+// log2 of the escape radius square 100 of CalculateIterationsAvx2
+static const float InverseLog2RadiusSquare = 0.150514998f;
+
+static inline __m256 Log2Avx2            (const __m256 x);
+static inline __m256 GetSmoothIterations (const __m256i numberOfIterations,
+                                          const __m256 radiusSquare,
+                                          const size_t maxNumberOfIterations);
+
+// The avx2 kernel that keeps |z|^2 of every lane at its escape, a pixel that escaped at the
+// check n with |z|^2 = r gets n - log2(log2(r) / log2(100)). r is between 100 and about
+// 100^2, so the value is in (n - 1, n] and goes continuously from one count to the next.
+void CalculateMandelbrotTileAvx2Smooth(float* smoothIterations, const MandelbrotView* view,
+                                       const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    assert(smoothIterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    const size_t maxNumberOfIterations = view->maxNumberOfIterations;
+
+    // counters stay in registers, stats may be aliased by the iterations
+    MandelbrotStats tileStats = {};
+
+    const __m256i laneNumbers = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256  x0BeginAvx  = _mm256_set1_ps(view->x0Begin);
+    const __m256  dxAvx       = _mm256_set1_ps(view->dx);
+
+    for (size_t pixelY = tile->yBegin; pixelY < tile->yEnd; ++pixelY)
+    {
+        __m256 y0Avx = _mm256_set1_ps(view->y0Begin + (float)pixelY * view->dy);
+
+        for (size_t pixelX = tile->xBegin; pixelX < tile->xEnd; pixelX += 8)
+        {
+            __m256i pixelsX = _mm256_add_epi32(_mm256_set1_epi32((int)pixelX), laneNumbers);
+            __m256  x0Avx   = _mm256_add_ps(x0BeginAvx,
+                                            _mm256_mul_ps(_mm256_cvtepi32_ps(pixelsX), dxAvx));
+
+            __m256  radiusSquare       = _mm256_setzero_ps();
+            __m256i numberOfIterations = CalculateIterationsAvx2(x0Avx, y0Avx,
+                                                                 maxNumberOfIterations,
+                                                                 &tileStats, &radiusSquare);
+
+            __m256 smooth = GetSmoothIterations(numberOfIterations, radiusSquare,
+                                                maxNumberOfIterations);
+
+            float* smoothPos = smoothIterations + pixelX + pixelY * view->width;
+
+            // last group in a row may stick out of the image
+            if (tile->xEnd - pixelX >= 8)
+            {
+                _mm256_storeu_ps(smoothPos, smooth);
+            }
+            else
+            {
+                alignas(32) float smoothArray[8] = {};
+                _mm256_store_ps(smoothArray, smooth);
+
+                for (size_t i = 0; i < tile->xEnd - pixelX; ++i)
+                    smoothPos[i] = smoothArray[i];
+            }
+        }
+    }
+
+    stats->vectorIterations  += tileStats.vectorIterations;
+    stats->skippedIterations += tileStats.skippedIterations;
+}
+
+// Pixels that reached the limit or are inside the set keep maxNumberOfIterations.
+static inline __m256 GetSmoothIterations(const __m256i numberOfIterations,
+                                         const __m256 radiusSquare,
+                                         const size_t maxNumberOfIterations)
+{
+    const __m256i maxNumberOfIterationsAvx = _mm256_set1_epi32((int)maxNumberOfIterations);
+    const __m256  maxNumberOfIterationsPs  = _mm256_cvtepi32_ps(maxNumberOfIterationsAvx);
+
+    __m256 isInside = _mm256_castsi256_ps(_mm256_cmpeq_epi32(numberOfIterations,
+                                                             maxNumberOfIterationsAvx));
+
+    // most groups of the interior, no logs for them
+    if (_mm256_movemask_ps(isInside) == 0xff)
+        return maxNumberOfIterationsPs;
+
+    // log2(r) / log2(100) is at least 1, so the correction is in [0, 1)
+    const __m256 correction = Log2Avx2(_mm256_mul_ps(Log2Avx2(radiusSquare),
+                                                     _mm256_set1_ps(InverseLog2RadiusSquare)));
+
+    __m256 smooth = _mm256_sub_ps(_mm256_cvtepi32_ps(numberOfIterations), correction);
+    smooth = _mm256_max_ps(smooth, _mm256_setzero_ps());
+
+    return _mm256_blendv_ps(smooth, maxNumberOfIterationsPs, isInside);
+}
+
+// log2 of positive normal floats: the exponent plus a polynomial of the mantissa m in [1, 2),
+// (m - 1) * (c0 + c1 t + c2 t^2 + c3 t^3) with t = m - 1. Coefficients are fitted for the
+// least maximum error, 1.2e-4, with the ends exact, so the result is continuous where the
+// exponent changes. Lanes that are 0 or negative give garbage and are blended away.
+static inline __m256 Log2Avx2(const __m256 x)
+{
+    const __m256i bits     = _mm256_castps_si256(x);
+    const __m256  exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+                                                                 _mm256_set1_epi32(127)));
+    const __m256  mantissa = _mm256_castsi256_ps(
+                                 _mm256_or_si256(_mm256_and_si256(bits,
+                                                                  _mm256_set1_epi32(0x007fffff)),
+                                                 _mm256_set1_epi32(0x3f800000)));
+
+    const __m256 t = _mm256_sub_ps(mantissa, _mm256_set1_ps(1.f));
+
+    __m256 polynomial = _mm256_set1_ps(-0.0821305355f);
+    polynomial = _mm256_fmadd_ps(polynomial, t, _mm256_set1_ps( 0.3211885799f));
+    polynomial = _mm256_fmadd_ps(polynomial, t, _mm256_set1_ps(-0.6777837365f));
+    polynomial = _mm256_fmadd_ps(polynomial, t, _mm256_set1_ps( 1.4387256922f));
+
+    return _mm256_fmadd_ps(polynomial, t, exponent);
+}
@@ -0,0 +1,143 @@
+#include <assert.h>
+#include <emmintrin.h>
+
+#include "Mandelbrot.h"
+
+static inline __m128 IsInMainCardioidOrBulb(const __m128 x, const __m128 y);
+
+// Same as the AVX2 kernel on 4 lanes, runs on any x86-64 cpu.
+void CalculateMandelbrotTileSse2(uint16_t* iterations, const MandelbrotView* view,
+                                 const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    static const __m128 maxRadiusSquare = _mm_set1_ps(100.f);
+
+    const size_t  maxNumberOfIterations    = view->maxNumberOfIterations;
+    const __m128i maxNumberOfIterationsSse = _mm_set1_epi32((int)maxNumberOfIterations);
+
+    uint64_t vectorIterations  = 0;
+    uint64_t skippedIterations = 0;
+
+    const __m128i laneNumbers = _mm_set_epi32(3, 2, 1, 0);
+    const __m128  x0BeginSse  = _mm_set1_ps(view->x0Begin);
+    const __m128  dxSse       = _mm_set1_ps(view->dx);
+
+    for (size_t pixelY = tile->yBegin; pixelY < tile->yEnd; ++pixelY)
+    {
+        __m128 y0Sse = _mm_set1_ps(view->y0Begin + (float)pixelY * view->dy);
+
+        for (size_t pixelX = tile->xBegin; pixelX < tile->xEnd; pixelX += 4)
+        {
+            __m128i numberOfIterations = _mm_setzero_si128();
+
+            __m128i pixelsX = _mm_add_epi32(_mm_set1_epi32((int)pixelX), laneNumbers);
+            __m128  x0Sse   = _mm_add_ps(x0BeginSse, _mm_mul_ps(_mm_cvtepi32_ps(pixelsX), dxSse));
+
+            __m128 x = x0Sse;
+            __m128 y = y0Sse;
+
+            __m128 isInterior = IsInMainCardioidOrBulb(x0Sse, y0Sse);
+
+            __m128 savedX = x;
+            __m128 savedY = y;
+            size_t nextSaveIteration = 1;
+
+            size_t iterationNumber = 0;
+            for (iterationNumber = 0; iterationNumber < maxNumberOfIterations;
+                 ++iterationNumber)
+            {
+                __m128 xSquare = _mm_mul_ps(x, x);
+                __m128 ySquare = _mm_mul_ps(y, y);
+                __m128 xMulY   = _mm_mul_ps(x, y);
+
+                __m128 radiusSquare = _mm_add_ps(xSquare, ySquare);
+
+                __m128 cmpRadius = _mm_cmplt_ps(radiusSquare, maxRadiusSquare);
+                __m128 isCounted = _mm_andnot_ps(isInterior, cmpRadius);
+                int mask = _mm_movemask_ps(isCounted);
+
+                if (!mask) break;
+
+                numberOfIterations = _mm_sub_epi32(numberOfIterations,
+                                                   _mm_castps_si128(isCounted));
+
+                x = _mm_add_ps(_mm_sub_ps(xSquare, ySquare), x0Sse);
+                y = _mm_add_ps(_mm_add_ps(xMulY  , xMulY),   y0Sse);
+
+                __m128 isBack     = _mm_and_ps(_mm_cmpeq_ps(x, savedX), _mm_cmpeq_ps(y, savedY));
+                __m128 isPeriodic = _mm_and_ps(isBack, isCounted);
+                isInterior = _mm_or_ps(isInterior, isPeriodic);
+
+                if (iterationNumber + 1 == nextSaveIteration)
+                {
+                    savedX = x;
+                    savedY = y;
+                    nextSaveIteration *= 2;
+                }
+            }
+
+            if (_mm_movemask_ps(isInterior))
+            {
+                __m128i isInteriorInt = _mm_castps_si128(isInterior);
+
+                alignas(16) int skippedIterationsArray[4] = {};
+                _mm_store_si128((__m128i*)skippedIterationsArray,
+                                _mm_and_si128(isInteriorInt,
+                                              _mm_sub_epi32(maxNumberOfIterationsSse,
+                                                            numberOfIterations)));
+                for (size_t i = 0; i < 4; ++i)
+                    skippedIterations += (uint64_t)skippedIterationsArray[i];
+
+                // no blendv before SSE4.1
+                numberOfIterations = _mm_or_si128(_mm_and_si128   (isInteriorInt,
+                                                                    maxNumberOfIterationsSse),
+                                                  _mm_andnot_si128(isInteriorInt,
+                                                                   numberOfIterations));
+            }
+
+        #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+            alignas(16) int numberOfIterationsArray[4] = {};
+            _mm_store_si128((__m128i*)numberOfIterationsArray, numberOfIterations);
+
+            const size_t numberOfPixels = tile->xEnd - pixelX < 4 ? tile->xEnd - pixelX : 4;
+
+            // packus_epi32 is SSE4.1, 4 values are copied as they are
+            uint16_t* iterationsPos = iterations + pixelX + pixelY * view->width;
+            for (size_t i = 0; i < numberOfPixels; ++i)
+                iterationsPos[i] = (uint16_t)numberOfIterationsArray[i];
+        #endif
+
+            // the last check that broke the loop is executed too
+            vectorIterations += iterationNumber + (iterationNumber < maxNumberOfIterations);
+        }
+    }
+
+    stats->vectorIterations  += vectorIterations;
+    stats->skippedIterations += skippedIterations;
+}
+
+// Cardioid and period-2 bulb, formulas are in Avx2Iterations.h.
+static inline __m128 IsInMainCardioidOrBulb(const __m128 x, const __m128 y)
+{
+    const __m128 quarter   = _mm_set1_ps(0.25f);
+    const __m128 one       = _mm_set1_ps(1.f);
+    const __m128 sixteenth = _mm_set1_ps(1.f / 16);
+
+    __m128 ySquare = _mm_mul_ps(y, y);
+
+    __m128 xShifted = _mm_sub_ps(x, quarter);
+    __m128 q        = _mm_add_ps(_mm_mul_ps(xShifted, xShifted), ySquare);
+
+    __m128 isInCardioid = _mm_cmple_ps(_mm_mul_ps(q, _mm_add_ps(q, xShifted)),
+                                       _mm_mul_ps(ySquare, quarter));
+
+    __m128 xPlusOne = _mm_add_ps(x, one);
+    __m128 isInBulb = _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(xPlusOne, xPlusOne), ySquare),
+                                   sixteenth);
+
+    return _mm_or_ps(isInCardioid, isInBulb);
+}
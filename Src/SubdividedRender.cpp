@@ -0,0 +1,313 @@
+#include <assert.h>
+#include <immintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+
+#include "Avx2Iterations.h"
+#include "Mandelbrot.h"
+
+extern "C" uint64_t GetTimeStampCounter();
+
+// One block is one task of the scheduler and the largest rectangle of the subdivision.
+static const size_t BlockSize        = 64;
+// Rectangles with a side this short are not split anymore, their pixels are calculated.
+static const size_t MinRectangleSize = 6;
+
+static const int    NotCalculated    = -1;
+static const int    Queued           = -2;
+
+struct SubdividedBlock;
+
+struct SubdividedFrame
+{
+    uint16_t*             iterations;
+    const MandelbrotView* view;
+    MandelbrotTile        region;
+
+    size_t                numberOfBlocksX;
+    // scratch of every thread of the scheduler, a block is too big for the stack
+    SubdividedBlock*      blocks;
+
+    std::atomic<uint64_t> vectorIterations;
+    std::atomic<uint64_t> skippedIterations;
+    std::atomic<uint64_t> filledPixels;
+};
+
+// Iteration counts of a block and the pixels waiting to be calculated,
+// coordinates are relative to the block.
+struct SubdividedBlock
+{
+    const MandelbrotView* view;
+
+    size_t                xBegin;
+    size_t                yBegin;
+    size_t                width;
+    size_t                height;
+
+    int                   numberOfIterations[BlockSize * BlockSize];
+
+    int                   queueX[BlockSize * BlockSize];
+    int                   queueY[BlockSize * BlockSize];
+    size_t                queueSize;
+
+    MandelbrotStats       stats;
+};
+
+static void CalculateSubdividedBlock(size_t blockIndex, size_t threadIndex, void* context);
+static void SubdivideRectangle      (SubdividedBlock* block,
+                                     const size_t xBegin, const size_t yBegin,
+                                     const size_t xEnd,   const size_t yEnd);
+static void QueuePixel              (SubdividedBlock* block, const size_t x, const size_t y);
+static void CalculateQueuedPixels   (SubdividedBlock* block);
+
+uint64_t CalculateMandelbrotSetSubdivided(uint16_t* iterations, const MandelbrotView* view,
+                                          TileScheduler* scheduler, MandelbrotStats* stats)
+{
+    assert(view);
+
+    const MandelbrotTile region = { 0, 0, view->width, view->height };
+    return CalculateMandelbrotRegionSubdivided(iterations, view, &region, scheduler, stats);
+}
+
+uint64_t CalculateMandelbrotRegionSubdivided(uint16_t* iterations, const MandelbrotView* view,
+                                             const MandelbrotTile* region,
+                                             TileScheduler* scheduler, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(region);
+    assert(region->xEnd <= view->width && region->yEnd <= view->height);
+    assert(scheduler);
+
+#ifdef TIME_MEASURE
+    uint64_t startTime = GetTimeStampCounter();
+#endif
+
+    SubdividedFrame frame = {};
+    frame.iterations = iterations;
+    frame.view       = view;
+    frame.region     = *region;
+
+    const size_t regionWidth  = region->xEnd - region->xBegin;
+    const size_t regionHeight = region->yEnd - region->yBegin;
+
+    frame.numberOfBlocksX = (regionWidth  + BlockSize - 1) / BlockSize;
+    size_t numberOfBlocks = (regionHeight + BlockSize - 1) / BlockSize * frame.numberOfBlocksX;
+
+    frame.blocks = (SubdividedBlock*)calloc(scheduler->numberOfThreads, sizeof(SubdividedBlock));
+
+    TileSchedulerRun(scheduler, numberOfBlocks, CalculateSubdividedBlock, &frame);
+
+    free(frame.blocks);
+
+    if (stats)
+    {
+        stats->vectorIterations  = frame.vectorIterations;
+        stats->skippedIterations = frame.skippedIterations;
+        stats->filledPixels      = frame.filledPixels;
+    }
+
+#ifdef TIME_MEASURE
+    uint64_t timeSpent = GetTimeStampCounter() - startTime;
+    printf("vectorIterations - %llu\n", (unsigned long long)frame.vectorIterations.load());
+    printf("filledPixels - %llu\n", (unsigned long long)frame.filledPixels.load());
+    return timeSpent;
+#else
+    return 0;
+#endif
+}
+
+static void CalculateSubdividedBlock(size_t blockIndex, size_t threadIndex, void* context)
+{
+    assert(context);
+
+    SubdividedFrame*      frame  = (SubdividedFrame*)context;
+    const MandelbrotView* view   = frame->view;
+    const MandelbrotTile* region = &frame->region;
+    SubdividedBlock*      block  = &frame->blocks[threadIndex];
+
+    block->view   = view;
+    block->xBegin = region->xBegin + blockIndex % frame->numberOfBlocksX * BlockSize;
+    block->yBegin = region->yBegin + blockIndex / frame->numberOfBlocksX * BlockSize;
+    block->width  = region->xEnd - block->xBegin < BlockSize ? region->xEnd - block->xBegin :
+                                                               BlockSize;
+    block->height = region->yEnd - block->yBegin < BlockSize ? region->yEnd - block->yBegin :
+                                                               BlockSize;
+
+    block->queueSize = 0;
+    block->stats     = {};
+
+    for (size_t i = 0; i < block->width * block->height; ++i)
+        block->numberOfIterations[i] = NotCalculated;
+
+    SubdivideRectangle(block, 0, 0, block->width, block->height);
+
+    for (size_t y = 0; y < block->height; ++y)
+    {
+        uint16_t*  iterationsPos      = frame->iterations + block->xBegin +
+                                        (block->yBegin + y) * view->width;
+        const int* numberOfIterations = block->numberOfIterations + y * block->width;
+
+        for (size_t x = 0; x < block->width; ++x)
+            iterationsPos[x] = (uint16_t)numberOfIterations[x];
+    }
+
+    frame->vectorIterations  += block->stats.vectorIterations;
+    frame->skippedIterations += block->stats.skippedIterations;
+    frame->filledPixels      += block->stats.filledPixels;
+}
+
+// Mariani-Silver: if the whole border of a rectangle has the same number of iterations,
+// so has everything inside, as the set is connected. Otherwise the rectangle is split
+// in two halves sharing the middle line.
+static void SubdivideRectangle(SubdividedBlock* block,
+                               const size_t xBegin, const size_t yBegin,
+                               const size_t xEnd,   const size_t yEnd)
+{
+    assert(block);
+    assert(xBegin < xEnd && xEnd <= block->width);
+    assert(yBegin < yEnd && yEnd <= block->height);
+
+    const size_t width = block->width;
+
+    for (size_t x = xBegin; x < xEnd; ++x)
+    {
+        QueuePixel(block, x, yBegin);
+        QueuePixel(block, x, yEnd - 1);
+    }
+
+    for (size_t y = yBegin + 1; y + 1 < yEnd; ++y)
+    {
+        QueuePixel(block, xBegin,   y);
+        QueuePixel(block, xEnd - 1, y);
+    }
+
+    CalculateQueuedPixels(block);
+
+    if (xEnd - xBegin <= 2 || yEnd - yBegin <= 2)
+        return;
+
+    const int borderIterations = block->numberOfIterations[xBegin + yBegin * width];
+
+    bool isBorderSame = true;
+    for (size_t x = xBegin; x < xEnd && isBorderSame; ++x)
+    {
+        isBorderSame = block->numberOfIterations[x + yBegin * width]     == borderIterations &&
+                       block->numberOfIterations[x + (yEnd - 1) * width] == borderIterations;
+    }
+
+    for (size_t y = yBegin + 1; y + 1 < yEnd && isBorderSame; ++y)
+    {
+        isBorderSame = block->numberOfIterations[xBegin   + y * width] == borderIterations &&
+                       block->numberOfIterations[xEnd - 1 + y * width] == borderIterations;
+    }
+
+    if (isBorderSame)
+    {
+        for (size_t y = yBegin + 1; y + 1 < yEnd; ++y)
+        {
+            for (size_t x = xBegin + 1; x + 1 < xEnd; ++x)
+            {
+                int* numberOfIterations = &block->numberOfIterations[x + y * width];
+                if (*numberOfIterations != NotCalculated) continue;
+
+                *numberOfIterations = borderIterations;
+                block->stats.filledPixels++;
+            }
+        }
+
+        return;
+    }
+
+    if (xEnd - xBegin <= MinRectangleSize || yEnd - yBegin <= MinRectangleSize)
+    {
+        for (size_t y = yBegin + 1; y + 1 < yEnd; ++y)
+            for (size_t x = xBegin + 1; x + 1 < xEnd; ++x)
+                QueuePixel(block, x, y);
+
+        CalculateQueuedPixels(block);
+        return;
+    }
+
+    if (xEnd - xBegin >= yEnd - yBegin)
+    {
+        const size_t xMiddle = (xBegin + xEnd) / 2;
+        SubdivideRectangle(block, xBegin,  yBegin, xMiddle + 1, yEnd);
+        SubdivideRectangle(block, xMiddle, yBegin, xEnd,        yEnd);
+    }
+    else
+    {
+        const size_t yMiddle = (yBegin + yEnd) / 2;
+        SubdivideRectangle(block, xBegin, yBegin,  xEnd, yMiddle + 1);
+        SubdivideRectangle(block, xBegin, yMiddle, xEnd, yEnd);
+    }
+}
+
+static void QueuePixel(SubdividedBlock* block, const size_t x, const size_t y)
+{
+    assert(block);
+
+    int* numberOfIterations = &block->numberOfIterations[x + y * block->width];
+    if (*numberOfIterations != NotCalculated)
+        return;
+
+    *numberOfIterations = Queued;
+
+    block->queueX[block->queueSize] = (int)(block->xBegin + x);
+    block->queueY[block->queueSize] = (int)(block->yBegin + y);
+    block->queueSize++;
+}
+
+// Same coordinates and the same iteration loop as the AVX2 tile kernel, so a pixel that
+// is calculated here gets the same number of iterations.
+static void CalculateQueuedPixels(SubdividedBlock* block)
+{
+    assert(block);
+
+    const MandelbrotView* view = block->view;
+
+    const __m256 x0BeginAvx = _mm256_set1_ps(view->x0Begin);
+    const __m256 y0BeginAvx = _mm256_set1_ps(view->y0Begin);
+    const __m256 dxAvx      = _mm256_set1_ps(view->dx);
+    const __m256 dyAvx      = _mm256_set1_ps(view->dy);
+
+    for (size_t i = 0; i < block->queueSize; i += 8)
+    {
+        const size_t numberOfPixels = block->queueSize - i < 8 ? block->queueSize - i : 8;
+
+        // the last group is padded with its last pixel
+        alignas(32) int pixelsX[8] = {};
+        alignas(32) int pixelsY[8] = {};
+        for (size_t lane = 0; lane < 8; ++lane)
+        {
+            const size_t pixel = i + (lane < numberOfPixels ? lane : numberOfPixels - 1);
+            pixelsX[lane] = block->queueX[pixel];
+            pixelsY[lane] = block->queueY[pixel];
+        }
+
+        __m256 x0 = _mm256_add_ps(x0BeginAvx,
+                                  _mm256_mul_ps(_mm256_cvtepi32_ps(
+                                                    _mm256_load_si256((const __m256i*)pixelsX)),
+                                                dxAvx));
+        __m256 y0 = _mm256_add_ps(y0BeginAvx,
+                                  _mm256_mul_ps(_mm256_cvtepi32_ps(
+                                                    _mm256_load_si256((const __m256i*)pixelsY)),
+                                                dyAvx));
+
+        alignas(32) int numberOfIterationsArray[8] = {};
+        _mm256_store_si256((__m256i*)numberOfIterationsArray,
+                           CalculateIterationsAvx2(x0, y0, view->maxNumberOfIterations,
+                                                   &block->stats));
+
+        for (size_t lane = 0; lane < numberOfPixels; ++lane)
+        {
+            const size_t x = (size_t)pixelsX[lane] - block->xBegin;
+            const size_t y = (size_t)pixelsY[lane] - block->yBegin;
+
+            block->numberOfIterations[x + y * block->width] = numberOfIterationsArray[lane];
+        }
+    }
+
+    block->queueSize = 0;
+}
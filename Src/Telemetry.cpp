@@ -0,0 +1,211 @@
+#ifdef MANDELBROT_TELEMETRY
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "Telemetry.h"
+
+MandelbrotTelemetry* KernelTelemetry = nullptr;
+
+static size_t GetBucket     (const size_t numberOfIterations, const size_t maxNumberOfIterations);
+static double GetWastedShare(const TileTelemetry* tile);
+
+void MandelbrotTelemetryCtor(MandelbrotTelemetry* telemetry, const size_t width,
+                             const size_t height, const size_t maxNumberOfIterations)
+{
+    assert(telemetry);
+    assert(width > 0 && height > 0);
+    assert(maxNumberOfIterations > 0);
+
+    telemetry->width                 = width;
+    telemetry->height                = height;
+    telemetry->maxNumberOfIterations = maxNumberOfIterations;
+
+    telemetry->numberOfTilesX = (width  + TelemetryTileWidth  - 1) / TelemetryTileWidth;
+    telemetry->numberOfTilesY = (height + TelemetryTileHeight - 1) / TelemetryTileHeight;
+
+    // value initialized, so the counters start from 0
+    telemetry->tiles = new TileTelemetry[telemetry->numberOfTilesX * telemetry->numberOfTilesY]();
+
+    telemetry->groupsPerStep      = new std::atomic<uint64_t>[maxNumberOfIterations]();
+    telemetry->activeLanesPerStep = new std::atomic<uint64_t>[maxNumberOfIterations]();
+}
+
+void MandelbrotTelemetryDtor(MandelbrotTelemetry* telemetry)
+{
+    assert(telemetry);
+
+    if (KernelTelemetry == telemetry)
+        SetKernelTelemetry(nullptr);
+
+    delete[] telemetry->tiles;
+    delete[] telemetry->groupsPerStep;
+    delete[] telemetry->activeLanesPerStep;
+
+    telemetry->tiles              = nullptr;
+    telemetry->groupsPerStep      = nullptr;
+    telemetry->activeLanesPerStep = nullptr;
+}
+
+// Kernels of the worker threads see the new pointer at the next frame, the scheduler
+// synchronizes with them when it gives out the tiles.
+void SetKernelTelemetry(MandelbrotTelemetry* telemetry)
+{
+    KernelTelemetry = telemetry;
+}
+
+void TelemetryAddGroup(const size_t pixelX, const size_t pixelY, const int32_t* counts,
+                       const size_t numberOfPixels, const size_t numberOfLanes,
+                       const uint64_t vectorIterations, const uint64_t skippedIterations)
+{
+    assert(counts);
+    assert(numberOfPixels <= numberOfLanes);
+
+    MandelbrotTelemetry* telemetry = KernelTelemetry;
+    if (!telemetry || pixelX >= telemetry->width || pixelY >= telemetry->height)
+        return;
+
+    TileTelemetry* tile = &telemetry->tiles[pixelX / TelemetryTileWidth +
+                                            pixelY / TelemetryTileHeight *
+                                            telemetry->numberOfTilesX];
+
+    uint64_t laneIterations = 0;
+    for (size_t i = 0; i < numberOfLanes; ++i)
+        laneIterations += (uint64_t)counts[i];
+
+    for (size_t i = 0; i < numberOfPixels; ++i)
+    {
+        const size_t bucket = GetBucket((size_t)counts[i], telemetry->maxNumberOfIterations);
+        tile->histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    tile->vectorIterations.fetch_add(vectorIterations, std::memory_order_relaxed);
+    tile->laneIterations  .fetch_add(laneIterations - skippedIterations,
+                                     std::memory_order_relaxed);
+    tile->laneSlots       .fetch_add(vectorIterations * numberOfLanes,
+                                     std::memory_order_relaxed);
+}
+
+bool WriteTelemetryCsv(const MandelbrotTelemetry* telemetry, const char* tilesFileName,
+                       const char* stepsFileName)
+{
+    assert(telemetry);
+    assert(tilesFileName);
+    assert(stepsFileName);
+
+    FILE* tilesFile = fopen(tilesFileName, "w");
+    if (!tilesFile)
+        return false;
+
+    fprintf(tilesFile, "tileX,tileY,vectorIterations,laneIterations,wastedLaneIterations,"
+                       "laneOccupancy");
+    for (size_t i = 0; i < NumberOfTelemetryBuckets; ++i)
+        fprintf(tilesFile, ",h%zu", i);
+    fprintf(tilesFile, "\n");
+
+    for (size_t tileY = 0; tileY < telemetry->numberOfTilesY; ++tileY)
+    {
+        for (size_t tileX = 0; tileX < telemetry->numberOfTilesX; ++tileX)
+        {
+            const TileTelemetry* tile = &telemetry->tiles[tileX + tileY * telemetry->numberOfTilesX];
+
+            const uint64_t laneIterations = tile->laneIterations;
+            const uint64_t laneSlots      = tile->laneSlots;
+
+            fprintf(tilesFile, "%zu,%zu,%llu,%llu,%llu,%.4f", tileX, tileY,
+                    (unsigned long long)tile->vectorIterations.load(),
+                    (unsigned long long)laneIterations,
+                    (unsigned long long)(laneSlots - laneIterations),
+                    1 - GetWastedShare(tile));
+
+            for (size_t i = 0; i < NumberOfTelemetryBuckets; ++i)
+                fprintf(tilesFile, ",%llu", (unsigned long long)tile->histogram[i].load());
+            fprintf(tilesFile, "\n");
+        }
+    }
+
+    bool isWritten = fclose(tilesFile) == 0;
+
+    FILE* stepsFile = fopen(stepsFileName, "w");
+    if (!stepsFile)
+        return false;
+
+    fprintf(stepsFile, "step,groups,averageActiveLanes\n");
+    for (size_t step = 0; step < telemetry->maxNumberOfIterations; ++step)
+    {
+        const uint64_t groups = telemetry->groupsPerStep[step];
+        if (!groups) break;
+
+        fprintf(stepsFile, "%zu,%llu,%.4f\n", step, (unsigned long long)groups,
+                (double)telemetry->activeLanesPerStep[step] / (double)groups);
+    }
+
+    isWritten = fclose(stepsFile) == 0 && isWritten;
+
+    return isWritten;
+}
+
+bool WriteTelemetryHeatMap(const MandelbrotTelemetry* telemetry, const char* fileName)
+{
+    assert(telemetry);
+    assert(fileName);
+
+    FILE* file = fopen(fileName, "wb");
+    if (!file)
+        return false;
+
+    fprintf(file, "P6\n%zu %zu\n255\n", telemetry->width, telemetry->height);
+
+    // one row of tiles has the same colors in all its pixel rows
+    uint8_t* row = new uint8_t[telemetry->width * 3];
+
+    for (size_t pixelY = 0; pixelY < telemetry->height; ++pixelY)
+    {
+        if (pixelY % TelemetryTileHeight == 0)
+        {
+            const TileTelemetry* tiles = &telemetry->tiles[pixelY / TelemetryTileHeight *
+                                                           telemetry->numberOfTilesX];
+
+            for (size_t pixelX = 0; pixelX < telemetry->width; ++pixelX)
+            {
+                const double wastedShare = GetWastedShare(&tiles[pixelX / TelemetryTileWidth]);
+
+                row[pixelX * 3]     = (uint8_t)(255 * wastedShare);
+                row[pixelX * 3 + 1] = 0;
+                row[pixelX * 3 + 2] = (uint8_t)(255 * (1 - wastedShare));
+            }
+        }
+
+        fwrite(row, 3, telemetry->width, file);
+    }
+
+    delete[] row;
+
+    const bool isWritten = !ferror(file);
+    return fclose(file) == 0 && isWritten;
+}
+
+static size_t GetBucket(const size_t numberOfIterations, const size_t maxNumberOfIterations)
+{
+    if (numberOfIterations >= maxNumberOfIterations)
+        return NumberOfTelemetryBuckets - 1;
+
+    // floor(log2(numberOfIterations + 1))
+    const size_t bucket = 63 - (size_t)__builtin_clzll(numberOfIterations + 1);
+
+    return bucket < NumberOfTelemetryBuckets - 1 ? bucket : NumberOfTelemetryBuckets - 2;
+}
+
+// 0 for a tile that was not calculated
+static double GetWastedShare(const TileTelemetry* tile)
+{
+    assert(tile);
+
+    const uint64_t laneSlots = tile->laneSlots;
+    if (!laneSlots)
+        return 0;
+
+    return (double)(laneSlots - tile->laneIterations) / (double)laneSlots;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Where the lanes of the avx2 kernel go. Built only with -D MANDELBROT_TELEMETRY (make
+// TELEMETRY=1), otherwise there is nothing but the empty hooks at the end and the kernel is the
+// same as without them.
+
+#ifdef MANDELBROT_TELEMETRY
+
+#include <atomic>
+
+// same as the tiles of TiledRender.cpp
+static const size_t TelemetryTileWidth  = 64;
+static const size_t TelemetryTileHeight = 8;
+
+// Bucket i < 17 holds the pixels that escaped after [2^i - 1, 2^(i + 1) - 1) iterations, the
+// last one the pixels that reached the limit or turned out to be inside the set.
+static const size_t NumberOfTelemetryBuckets = 18;
+
+// Tiles of the frame may be calculated by other threads than their neighbours, so everything
+// is counted with relaxed atomics.
+struct TileTelemetry
+{
+    std::atomic<uint64_t> vectorIterations;
+    // executed by the lanes, the lanes sticking out of the frame included
+    std::atomic<uint64_t> laneIterations;
+    std::atomic<uint64_t> laneSlots;        // vectorIterations * lanes
+    std::atomic<uint64_t> histogram[NumberOfTelemetryBuckets];
+};
+
+// Counts of every frame calculated while the telemetry is set, for one frame size and one
+// iteration limit.
+struct MandelbrotTelemetry
+{
+    size_t                 width;
+    size_t                 height;
+    size_t                 maxNumberOfIterations;
+
+    size_t                 numberOfTilesX;
+    size_t                 numberOfTilesY;
+    TileTelemetry*         tiles;
+
+    // for every iteration step, summed over the groups that checked the escape at it
+    std::atomic<uint64_t>* groupsPerStep;
+    std::atomic<uint64_t>* activeLanesPerStep;
+};
+
+void MandelbrotTelemetryCtor(MandelbrotTelemetry* telemetry, const size_t width,
+                             const size_t height, const size_t maxNumberOfIterations);
+void MandelbrotTelemetryDtor(MandelbrotTelemetry* telemetry);
+
+// Kernels report to the telemetry from now on, nullptr stops them.
+void SetKernelTelemetry     (MandelbrotTelemetry* telemetry);
+
+// Per tile: position, vector and lane iterations, wasted lane-iterations, lane occupancy and
+// the histogram. Per step: groups that got to it and their average number of active lanes.
+bool WriteTelemetryCsv      (const MandelbrotTelemetry* telemetry, const char* tilesFileName,
+                             const char* stepsFileName);
+// PPM of the frame size, every tile is colored by its share of wasted lane-iterations, from
+// blue for none to red for all.
+bool WriteTelemetryHeatMap  (const MandelbrotTelemetry* telemetry, const char* fileName);
+
+// A finished group of numberOfLanes pixels from (pixelX, pixelY), numberOfPixels of them are
+// in the frame. skippedIterations are the ones counts has for lanes proven to be inside the set.
+void TelemetryAddGroup      (const size_t pixelX, const size_t pixelY, const int32_t* counts,
+                             const size_t numberOfPixels, const size_t numberOfLanes,
+                             const uint64_t vectorIterations, const uint64_t skippedIterations);
+
+extern MandelbrotTelemetry* KernelTelemetry;
+
+// One check of the escape radius by a group, activeLanesMask has a bit for every counted lane.
+static inline void TelemetryAddStep(const size_t step, const int activeLanesMask)
+{
+    MandelbrotTelemetry* telemetry = KernelTelemetry;
+    if (!telemetry || step >= telemetry->maxNumberOfIterations)
+        return;
+
+    const uint64_t activeLanes = (uint64_t)__builtin_popcount((unsigned)activeLanesMask);
+
+    telemetry->groupsPerStep     [step].fetch_add(1,           std::memory_order_relaxed);
+    telemetry->activeLanesPerStep[step].fetch_add(activeLanes, std::memory_order_relaxed);
+}
+
+#else
+
+static inline void TelemetryAddStep(const size_t, const int) {}
+
+#endif
+
+#endif
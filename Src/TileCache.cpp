@@ -0,0 +1,603 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "TileCache.h"
+
+static const size_t NoEntry           = SIZE_MAX;
+// rows of a tile calculated by one task, a cancel waits for one strip at most
+static const size_t CacheStripHeight  = 8;
+// grid coordinates are whole numbers in double up to this
+static const double MaxGridCoordinate = 4503599627370496.0; // 2^52
+
+// Tiles [firstTileX, firstTileX + numberOfTilesX) x [firstTileY, ...) cover the frame, its
+// pixel (0, 0) is the grid pixel (gridX, gridY).
+struct FrameGrid
+{
+    int64_t gridX;
+    int64_t gridY;
+
+    int64_t firstTileX;
+    int64_t firstTileY;
+    size_t  numberOfTilesX;
+    size_t  numberOfTilesY;
+};
+
+// Tiles of the cache entries that are calculated for a frame.
+struct CachedTilesJob
+{
+    const MandelbrotView*  view;
+    MandelbrotTileKernel   tileKernel;
+    TileCacheEntry*        entries;
+    const size_t*          entryIndices;
+    const TileCacheCancel* cancel;
+
+    std::atomic<uint64_t>  vectorIterations;
+    std::atomic<uint64_t>  skippedIterations;
+};
+
+static bool    GetGridOrigin      (const MandelbrotView* view, double* outGridX,
+                                   double* outGridY);
+static bool    GetFrameGrid       (const MandelbrotView* view, FrameGrid* outGrid);
+static void    GetTileKey         (const MandelbrotView* view, MandelbrotTileKernel tileKernel,
+                                   const int64_t tileX, const int64_t tileY,
+                                   TileCacheKey* outKey);
+static bool    GetTileOverlap     (const MandelbrotView* view, const FrameGrid* grid,
+                                   const TileCacheKey* key, MandelbrotTile* outFrameRect,
+                                   size_t* outTileXBegin, size_t* outTileYBegin);
+static void    CopyTileToFrame    (uint16_t* iterations, const MandelbrotView* view,
+                                   const FrameGrid* grid, const TileCacheEntry* entry);
+static bool    CalculateTiles     (TileCache* cache, const size_t* entryIndices,
+                                   const size_t numberOfEntries, const MandelbrotView* view,
+                                   TileScheduler* scheduler, MandelbrotTileKernel tileKernel,
+                                   const TileCacheCancel* cancel, MandelbrotStats* stats);
+static void    CalculateTileStrip (size_t taskIndex, size_t threadIndex, void* context);
+static bool    IsCancelled        (const TileCacheCancel* cancel);
+
+static size_t  FindEntry          (const TileCache* cache, const TileCacheKey* key);
+static size_t  AddEntry           (TileCache* cache, const TileCacheKey* key);
+static void    RemoveEntry        (TileCache* cache, const size_t index);
+static void    TouchEntry         (TileCache* cache, const size_t index);
+static void    LinkLruFirst       (TileCache* cache, const size_t index);
+static void    UnlinkLru          (TileCache* cache, const size_t index);
+static void    UnlinkHash         (TileCache* cache, const size_t index);
+static size_t  HashKey            (const TileCacheKey* key);
+static bool    IsSameKey          (const TileCacheKey* key, const TileCacheKey* otherKey);
+static int64_t FloorDivide        (const int64_t value, const int64_t divider);
+
+void TileCacheCtor(TileCache* cache, const size_t budgetBytes)
+{
+    assert(cache);
+    assert(budgetBytes >= CacheTileBytes);
+
+    cache->maxNumberOfTiles       = budgetBytes / CacheTileBytes;
+    cache->numberOfTiles          = 0;
+    cache->numberOfAllocatedTiles = 0;
+
+    cache->entries = (TileCacheEntry*)calloc(cache->maxNumberOfTiles, sizeof(*cache->entries));
+
+    // chains are 0.5 entries long on average when the cache is full
+    cache->numberOfBuckets = 1;
+    while (cache->numberOfBuckets < 2 * cache->maxNumberOfTiles)
+        cache->numberOfBuckets *= 2;
+
+    cache->buckets = (size_t*)calloc(cache->numberOfBuckets, sizeof(*cache->buckets));
+    for (size_t i = 0; i < cache->numberOfBuckets; ++i)
+        cache->buckets[i] = NoEntry;
+
+    for (size_t i = 0; i < cache->maxNumberOfTiles; ++i)
+        cache->entries[i].hashNext = i + 1 < cache->maxNumberOfTiles ? i + 1 : NoEntry;
+
+    cache->freeEntry = 0;
+    cache->lruFirst  = NoEntry;
+    cache->lruLast   = NoEntry;
+
+    cache->stats = {};
+    cache->stats.maxNumberOfTiles = cache->maxNumberOfTiles;
+    cache->stats.budgetBytes      = budgetBytes;
+}
+
+void TileCacheDtor(TileCache* cache)
+{
+    assert(cache);
+
+    for (size_t i = 0; i < cache->maxNumberOfTiles; ++i)
+        free(cache->entries[i].iterations);
+
+    free(cache->entries);
+    free(cache->buckets);
+
+    cache->entries = nullptr;
+    cache->buckets = nullptr;
+}
+
+void TileCacheGetStats(const TileCache* cache, TileCacheStats* outStats)
+{
+    assert(cache);
+    assert(outStats);
+
+    *outStats = cache->stats;
+    outStats->numberOfTiles = cache->numberOfTiles;
+    outStats->bytes         = cache->numberOfAllocatedTiles * CacheTileBytes;
+}
+
+bool SnapViewToTileGrid(MandelbrotView* view)
+{
+    assert(view);
+
+    double gridX = 0;
+    double gridY = 0;
+    if (!GetGridOrigin(view, &gridX, &gridY))
+        return false;
+
+    view->x0BeginDouble = gridX * view->dxDouble;
+    view->y0BeginDouble = gridY * view->dyDouble;
+
+    view->x0Begin = (float)view->x0BeginDouble;
+    view->y0Begin = (float)view->y0BeginDouble;
+
+    return true;
+}
+
+size_t TileCacheFindFrame(TileCache* cache, const MandelbrotView* view,
+                          MandelbrotTileKernel tileKernel, size_t* outNumberOfHits)
+{
+    assert(cache);
+    assert(view);
+    assert(tileKernel);
+    assert(outNumberOfHits);
+
+    *outNumberOfHits = 0;
+
+    FrameGrid grid = {};
+    if (!GetFrameGrid(view, &grid))
+        return 0;
+
+    for (size_t y = 0; y < grid.numberOfTilesY; ++y)
+    {
+        for (size_t x = 0; x < grid.numberOfTilesX; ++x)
+        {
+            TileCacheKey key = {};
+            GetTileKey(view, tileKernel, grid.firstTileX + (int64_t)x,
+                       grid.firstTileY + (int64_t)y, &key);
+
+            if (FindEntry(cache, &key) != NoEntry)
+                (*outNumberOfHits)++;
+        }
+    }
+
+    const size_t numberOfTiles = grid.numberOfTilesX * grid.numberOfTilesY;
+
+    cache->stats.lookups += numberOfTiles;
+    cache->stats.hits    += *outNumberOfHits;
+
+    return numberOfTiles;
+}
+
+bool CalculateMandelbrotSetCached(uint16_t* iterations, const MandelbrotView* view,
+                                  TileCache* cache, TileScheduler* scheduler,
+                                  MandelbrotTileKernel tileKernel, const TileCacheCancel* cancel,
+                                  MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(cache);
+    assert(scheduler);
+    assert(tileKernel);
+
+    FrameGrid grid = {};
+    if (!GetFrameGrid(view, &grid))
+        return false;
+
+    // then the tiles of the frame would evict each other
+    const size_t numberOfFrameTiles = grid.numberOfTilesX * grid.numberOfTilesY;
+    if (numberOfFrameTiles > cache->maxNumberOfTiles)
+        return false;
+
+    size_t* missingEntries = (size_t*)calloc(numberOfFrameTiles, sizeof(*missingEntries));
+    size_t  numberOfMissingTiles = 0;
+
+    // cached tiles are copied and become the most recent, so the missing ones evict only
+    // tiles of the other frames
+    for (size_t y = 0; y < grid.numberOfTilesY; ++y)
+    {
+        for (size_t x = 0; x < grid.numberOfTilesX; ++x)
+        {
+            TileCacheKey key = {};
+            GetTileKey(view, tileKernel, grid.firstTileX + (int64_t)x,
+                       grid.firstTileY + (int64_t)y, &key);
+
+            const size_t index = FindEntry(cache, &key);
+            if (index == NoEntry)
+            {
+                missingEntries[numberOfMissingTiles++] = y * grid.numberOfTilesX + x;
+                continue;
+            }
+
+            TouchEntry(cache, index);
+            CopyTileToFrame(iterations, view, &grid, &cache->entries[index]);
+        }
+    }
+
+    for (size_t i = 0; i < numberOfMissingTiles; ++i)
+    {
+        TileCacheKey key = {};
+        GetTileKey(view, tileKernel,
+                   grid.firstTileX + (int64_t)(missingEntries[i] % grid.numberOfTilesX),
+                   grid.firstTileY + (int64_t)(missingEntries[i] / grid.numberOfTilesX), &key);
+
+        missingEntries[i] = AddEntry(cache, &key);
+    }
+
+    const bool isCalculated = CalculateTiles(cache, missingEntries, numberOfMissingTiles, view,
+                                             scheduler, tileKernel, cancel, stats);
+
+    for (size_t i = 0; i < numberOfMissingTiles; ++i)
+    {
+        if (isCalculated)
+            CopyTileToFrame(iterations, view, &grid, &cache->entries[missingEntries[i]]);
+        else
+            RemoveEntry(cache, missingEntries[i]);
+    }
+
+    free(missingEntries);
+
+    return isCalculated;
+}
+
+// Grid pixel nearest to the origin of the view, false if the frame has grid coordinates
+// that are not exact in double.
+static bool GetGridOrigin(const MandelbrotView* view, double* outGridX, double* outGridY)
+{
+    assert(view);
+    assert(outGridX);
+    assert(outGridY);
+
+    *outGridX = round(view->x0BeginDouble / view->dxDouble);
+    *outGridY = round(view->y0BeginDouble / view->dyDouble);
+
+    return fabs(*outGridX) + (double)view->width  < MaxGridCoordinate &&
+           fabs(*outGridY) + (double)view->height < MaxGridCoordinate;
+}
+
+static bool GetFrameGrid(const MandelbrotView* view, FrameGrid* outGrid)
+{
+    assert(view);
+    assert(outGrid);
+
+    double gridX = 0;
+    double gridY = 0;
+    if (!GetGridOrigin(view, &gridX, &gridY))
+        return false;
+
+    const int64_t tileSize = (int64_t)CacheTileSize;
+
+    outGrid->gridX = (int64_t)gridX;
+    outGrid->gridY = (int64_t)gridY;
+
+    outGrid->firstTileX = FloorDivide(outGrid->gridX, tileSize);
+    outGrid->firstTileY = FloorDivide(outGrid->gridY, tileSize);
+
+    const int64_t lastTileX = FloorDivide(outGrid->gridX + (int64_t)view->width  - 1, tileSize);
+    const int64_t lastTileY = FloorDivide(outGrid->gridY + (int64_t)view->height - 1, tileSize);
+
+    outGrid->numberOfTilesX = (size_t)(lastTileX - outGrid->firstTileX + 1);
+    outGrid->numberOfTilesY = (size_t)(lastTileY - outGrid->firstTileY + 1);
+
+    return true;
+}
+
+static void GetTileKey(const MandelbrotView* view, MandelbrotTileKernel tileKernel,
+                       const int64_t tileX, const int64_t tileY, TileCacheKey* outKey)
+{
+    assert(view);
+    assert(outKey);
+
+    outKey->dx                    = view->dxDouble;
+    outKey->dy                    = view->dyDouble;
+    outKey->tileX                 = tileX;
+    outKey->tileY                 = tileY;
+    outKey->maxNumberOfIterations = view->maxNumberOfIterations;
+    outKey->tileKernel            = tileKernel;
+}
+
+// Part of the frame the tile covers and where it starts in the tile, false if none.
+static bool GetTileOverlap(const MandelbrotView* view, const FrameGrid* grid,
+                           const TileCacheKey* key, MandelbrotTile* outFrameRect,
+                           size_t* outTileXBegin, size_t* outTileYBegin)
+{
+    assert(view);
+    assert(grid);
+    assert(key);
+    assert(outFrameRect);
+    assert(outTileXBegin);
+    assert(outTileYBegin);
+
+    // in the frame pixels
+    const int64_t tileXBegin = key->tileX * (int64_t)CacheTileSize - grid->gridX;
+    const int64_t tileYBegin = key->tileY * (int64_t)CacheTileSize - grid->gridY;
+    const int64_t tileXEnd   = tileXBegin + (int64_t)CacheTileSize;
+    const int64_t tileYEnd   = tileYBegin + (int64_t)CacheTileSize;
+
+    const int64_t xBegin = tileXBegin > 0 ? tileXBegin : 0;
+    const int64_t yBegin = tileYBegin > 0 ? tileYBegin : 0;
+    const int64_t xEnd   = tileXEnd < (int64_t)view->width  ? tileXEnd : (int64_t)view->width;
+    const int64_t yEnd   = tileYEnd < (int64_t)view->height ? tileYEnd : (int64_t)view->height;
+
+    if (xBegin >= xEnd || yBegin >= yEnd)
+        return false;
+
+    *outFrameRect  = { (size_t)xBegin, (size_t)yBegin, (size_t)xEnd, (size_t)yEnd };
+    *outTileXBegin = (size_t)(xBegin - tileXBegin);
+    *outTileYBegin = (size_t)(yBegin - tileYBegin);
+
+    return true;
+}
+
+static void CopyTileToFrame(uint16_t* iterations, const MandelbrotView* view,
+                            const FrameGrid* grid, const TileCacheEntry* entry)
+{
+    assert(iterations);
+    assert(entry);
+    assert(entry->iterations);
+
+    MandelbrotTile frameRect  = {};
+    size_t         tileXBegin = 0;
+    size_t         tileYBegin = 0;
+    if (!GetTileOverlap(view, grid, &entry->key, &frameRect, &tileXBegin, &tileYBegin))
+        return;
+
+    const size_t rowSize = (frameRect.xEnd - frameRect.xBegin) * sizeof(*iterations);
+
+    for (size_t y = frameRect.yBegin; y < frameRect.yEnd; ++y)
+        memcpy(iterations + y * view->width + frameRect.xBegin,
+               entry->iterations + (tileYBegin + y - frameRect.yBegin) * CacheTileSize +
+               tileXBegin, rowSize);
+}
+
+// False if the job was cancelled, then some of the tiles are not complete.
+static bool CalculateTiles(TileCache* cache, const size_t* entryIndices,
+                           const size_t numberOfEntries, const MandelbrotView* view,
+                           TileScheduler* scheduler, MandelbrotTileKernel tileKernel,
+                           const TileCacheCancel* cancel, MandelbrotStats* stats)
+{
+    assert(cache);
+    assert(entryIndices);
+    assert(view);
+    assert(scheduler);
+    assert(tileKernel);
+
+    if (numberOfEntries == 0)
+        return true;
+
+    CachedTilesJob job = {};
+    job.view         = view;
+    job.tileKernel   = tileKernel;
+    job.entries      = cache->entries;
+    job.entryIndices = entryIndices;
+    job.cancel       = cancel;
+
+    TileSchedulerRun(scheduler, numberOfEntries * (CacheTileSize / CacheStripHeight),
+                     CalculateTileStrip, &job);
+
+    if (stats)
+    {
+        stats->vectorIterations  = job.vectorIterations;
+        stats->skippedIterations = job.skippedIterations;
+    }
+
+    return !IsCancelled(cancel);
+}
+
+static void CalculateTileStrip(size_t taskIndex, size_t threadIndex, void* context)
+{
+    assert(context);
+    (void)threadIndex;
+
+    CachedTilesJob* job = (CachedTilesJob*)context;
+
+    if (IsCancelled(job->cancel))
+        return;
+
+    const size_t          stripsPerTile = CacheTileSize / CacheStripHeight;
+    const TileCacheEntry* entry         = &job->entries[job->entryIndices[taskIndex /
+                                                                          stripsPerTile]];
+    const size_t          stripY        = taskIndex % stripsPerTile * CacheStripHeight;
+
+    // the tile is a frame of its own, its origin is on the grid as well
+    MandelbrotView tileView = *job->view;
+    tileView.width  = CacheTileSize;
+    tileView.height = CacheTileSize;
+
+    const int64_t tileSize = (int64_t)CacheTileSize;
+    tileView.x0BeginDouble = (double)(entry->key.tileX * tileSize) * tileView.dxDouble;
+    tileView.y0BeginDouble = (double)(entry->key.tileY * tileSize) * tileView.dyDouble;
+    tileView.x0Begin       = (float)tileView.x0BeginDouble;
+    tileView.y0Begin       = (float)tileView.y0BeginDouble;
+
+    const MandelbrotTile strip = { 0, stripY, CacheTileSize, stripY + CacheStripHeight };
+
+    MandelbrotStats stripStats = {};
+    job->tileKernel(entry->iterations, &tileView, &strip, &stripStats);
+
+    job->vectorIterations  += stripStats.vectorIterations;
+    job->skippedIterations += stripStats.skippedIterations;
+}
+
+static bool IsCancelled(const TileCacheCancel* cancel)
+{
+    return cancel && cancel->postedRequestNumber->load(std::memory_order_relaxed) !=
+                     cancel->requestNumber;
+}
+
+static size_t FindEntry(const TileCache* cache, const TileCacheKey* key)
+{
+    assert(cache);
+    assert(key);
+
+    size_t index = cache->buckets[HashKey(key) & (cache->numberOfBuckets - 1)];
+    while (index != NoEntry && !IsSameKey(&cache->entries[index].key, key))
+        index = cache->entries[index].hashNext;
+
+    return index;
+}
+
+// The entry is the most recently used one, its iterations are to be filled. A full cache
+// evicts the least recently used entry for it.
+static size_t AddEntry(TileCache* cache, const TileCacheKey* key)
+{
+    assert(cache);
+    assert(key);
+    assert(FindEntry(cache, key) == NoEntry);
+
+    if (cache->freeEntry == NoEntry)
+    {
+        assert(cache->lruLast != NoEntry);
+
+        RemoveEntry(cache, cache->lruLast);
+        cache->stats.evictions++;
+    }
+
+    const size_t    index = cache->freeEntry;
+    TileCacheEntry* entry = &cache->entries[index];
+    cache->freeEntry = entry->hashNext;
+
+    if (!entry->iterations)
+    {
+        entry->iterations = (uint16_t*)calloc(CacheTileSize * CacheTileSize,
+                                              sizeof(*entry->iterations));
+        cache->numberOfAllocatedTiles++;
+    }
+
+    entry->key = *key;
+
+    size_t* bucket = &cache->buckets[HashKey(key) & (cache->numberOfBuckets - 1)];
+    entry->hashNext = *bucket;
+    *bucket         = index;
+
+    LinkLruFirst(cache, index);
+    cache->numberOfTiles++;
+
+    return index;
+}
+
+// The buffer of the entry is kept for the next tile.
+static void RemoveEntry(TileCache* cache, const size_t index)
+{
+    assert(cache);
+    assert(index < cache->maxNumberOfTiles);
+
+    UnlinkHash(cache, index);
+    UnlinkLru (cache, index);
+
+    cache->entries[index].hashNext = cache->freeEntry;
+    cache->freeEntry = index;
+    cache->numberOfTiles--;
+}
+
+static void TouchEntry(TileCache* cache, const size_t index)
+{
+    assert(cache);
+
+    if (cache->lruFirst == index)
+        return;
+
+    UnlinkLru   (cache, index);
+    LinkLruFirst(cache, index);
+}
+
+static void LinkLruFirst(TileCache* cache, const size_t index)
+{
+    assert(cache);
+
+    TileCacheEntry* entry = &cache->entries[index];
+    entry->lruPrevious = NoEntry;
+    entry->lruNext     = cache->lruFirst;
+
+    if (cache->lruFirst != NoEntry)
+        cache->entries[cache->lruFirst].lruPrevious = index;
+    else
+        cache->lruLast = index;
+
+    cache->lruFirst = index;
+}
+
+static void UnlinkLru(TileCache* cache, const size_t index)
+{
+    assert(cache);
+
+    const TileCacheEntry* entry = &cache->entries[index];
+
+    if (entry->lruPrevious != NoEntry)
+        cache->entries[entry->lruPrevious].lruNext = entry->lruNext;
+    else
+        cache->lruFirst = entry->lruNext;
+
+    if (entry->lruNext != NoEntry)
+        cache->entries[entry->lruNext].lruPrevious = entry->lruPrevious;
+    else
+        cache->lruLast = entry->lruPrevious;
+}
+
+static void UnlinkHash(TileCache* cache, const size_t index)
+{
+    assert(cache);
+
+    size_t* link = &cache->buckets[HashKey(&cache->entries[index].key) &
+                                   (cache->numberOfBuckets - 1)];
+    while (*link != index)
+    {
+        assert(*link != NoEntry);
+        link = &cache->entries[*link].hashNext;
+    }
+
+    *link = cache->entries[index].hashNext;
+}
+
+// Fields are mixed with odd multipliers, then the bits are spread by the murmur3 finalizer.
+static size_t HashKey(const TileCacheKey* key)
+{
+    assert(key);
+
+    uint64_t dxBits = 0;
+    uint64_t dyBits = 0;
+    memcpy(&dxBits, &key->dx, sizeof(dxBits));
+    memcpy(&dyBits, &key->dy, sizeof(dyBits));
+
+    uint64_t hash = (uint64_t)key->tileX * 0x9e3779b97f4a7c15ull ^
+                    (uint64_t)key->tileY * 0xc2b2ae3d27d4eb4full ^
+                    dxBits               * 0x165667b19e3779f9ull ^
+                    dyBits               * 0x27d4eb2f165667c5ull ^
+                    (uint64_t)key->maxNumberOfIterations * 0x94d049bb133111ebull ^
+                    (uintptr_t)key->tileKernel;
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+// Steps are compared bit by bit, a level is the same only with exactly the same step.
+static bool IsSameKey(const TileCacheKey* key, const TileCacheKey* otherKey)
+{
+    assert(key);
+    assert(otherKey);
+
+    return key->tileX == otherKey->tileX && key->tileY == otherKey->tileY &&
+           key->maxNumberOfIterations == otherKey->maxNumberOfIterations &&
+           key->tileKernel == otherKey->tileKernel &&
+           memcmp(&key->dx, &otherKey->dx, sizeof(key->dx)) == 0 &&
+           memcmp(&key->dy, &otherKey->dy, sizeof(key->dy)) == 0;
+}
+
+static int64_t FloorDivide(const int64_t value, const int64_t divider)
+{
+    assert(divider > 0);
+
+    const int64_t quotient = value / divider;
+    return quotient * divider > value ? quotient - 1 : quotient;
+}
@@ -0,0 +1,108 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "Mandelbrot.h"
+
+// Tiles of the cache are squares of the grid of pixels of a scale level: the grid pixel
+// (gridX, gridY) is the point (gridX * dx, gridY * dy), so a tile is the same for every
+// view of the level that has its origin on the grid, wherever the frame is.
+static const size_t CacheTileSize  = 64;
+static const size_t CacheTileBytes = CacheTileSize * CacheTileSize * sizeof(uint16_t);
+
+// The scale level is the step of the grid, the viewer zooms by whole levels, so going
+// back to a level gives the same dx and dy. Tiles of different kernels differ in the
+// rounding, so the kernel is a part of the key too.
+struct TileCacheKey
+{
+    double               dx;
+    double               dy;
+    int64_t              tileX;
+    int64_t              tileY;
+    size_t               maxNumberOfIterations;
+    MandelbrotTileKernel tileKernel;
+};
+
+// Entries are linked in a hash chain and in the LRU list by their indices.
+struct TileCacheEntry
+{
+    TileCacheKey key;
+    uint16_t*    iterations;   // CacheTileSize x CacheTileSize, allocated at the first use
+
+    size_t       hashNext;
+    size_t       lruPrevious;  // more recently used
+    size_t       lruNext;
+};
+
+struct TileCacheStats
+{
+    // tiles of the full quality frames and those of them found in the cache
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t evictions;
+
+    size_t   numberOfTiles;
+    size_t   maxNumberOfTiles;
+    // tile buffers allocated, they are kept for reuse when tiles are evicted
+    size_t   bytes;
+    size_t   budgetBytes;
+};
+
+// Iterations of tiles within a memory budget, the least recently used tile goes first. Used
+// by one thread, the render workers only fill the tiles they are given.
+struct TileCache
+{
+    TileCacheEntry* entries;
+    size_t          maxNumberOfTiles;
+    size_t          numberOfTiles;
+    size_t          numberOfAllocatedTiles;
+
+    size_t*         buckets;
+    size_t          numberOfBuckets;   // power of two
+
+    size_t          freeEntry;         // chain of the free entries by hashNext
+    size_t          lruFirst;          // most recently used
+    size_t          lruLast;
+
+    TileCacheStats  stats;
+};
+
+// Cancels a calculation of tiles when the posted request number is not requestNumber
+// anymore, nullptr never cancels.
+struct TileCacheCancel
+{
+    const std::atomic<size_t>* postedRequestNumber;
+    size_t                     requestNumber;
+};
+
+// The budget is for the tile buffers, it has to hold at least one tile.
+void TileCacheCtor               (TileCache* cache, const size_t budgetBytes);
+void TileCacheDtor               (TileCache* cache);
+
+void TileCacheGetStats           (const TileCache* cache, TileCacheStats* outStats);
+
+// Moves the origin of the view to the nearest point of the grid of its scale level, by half
+// a pixel at most. False, and the view is not changed, if the grid coordinates of the view
+// are too large for the grid to be exact in double.
+bool SnapViewToTileGrid          (MandelbrotView* view);
+
+// Number of tiles the view covers and how many of them are cached. The view has to be on
+// the grid. Counts them in the stats as lookups and hits.
+size_t TileCacheFindFrame        (TileCache* cache, const MandelbrotView* view,
+                                  MandelbrotTileKernel tileKernel, size_t* outNumberOfHits);
+
+// Cached tiles of the frame are copied, the missing ones are calculated whole, added to
+// the cache and copied. The view has to be on the grid. Every tile is calculated from its
+// own origin on the grid, never copied from a frame, so a tile has the same iterations
+// whichever frame needed it first and a frame of the cache is the same at every visit.
+// False if the frame needs more tiles than the cache holds or it is cancelled, then the
+// frame is partly filled and the incomplete tiles are not kept. stats may be nullptr.
+bool CalculateMandelbrotSetCached(uint16_t* iterations, const MandelbrotView* view,
+                                  TileCache* cache, TileScheduler* scheduler,
+                                  MandelbrotTileKernel tileKernel, const TileCacheCancel* cancel,
+                                  MandelbrotStats* stats);
+
+#endif
@@ -0,0 +1,364 @@
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+
+// Load generator for the tile server: every client keeps one connection and sends a request
+// after the answer to the previous one, like the tile loader of a map viewer.
+static const size_t MaxConcurrencyLevels = 16;
+static const size_t MaxClients           = 1024;
+static const size_t ResponseBufferSize   = 1 << 20;
+
+static const int    DefaultPort          = 8080;
+static const size_t DefaultZoom          = 3;
+static const size_t DefaultRequests      = 512;
+
+struct TileLoadArgs
+{
+    int         port;
+    size_t      zoom;
+    size_t      numberOfRequests;
+    const char* format;
+    // all clients go through the tiles in the same order, so the same tiles are requested at
+    // about the same time, as when many viewers look at the same place
+    bool        isSameOrder;
+
+    size_t      concurrencyLevels[MaxConcurrencyLevels];
+    size_t      numberOfConcurrencyLevels;
+};
+
+struct TileLoadRun
+{
+    const TileLoadArgs*  args;
+
+    std::atomic<size_t>  nextRequest;
+    std::atomic<size_t>  numberOfErrors;
+    // of every request, in ns, 0 for the failed ones
+    uint64_t*            latencies;
+};
+
+static bool     ParseArgs         (int argc, char* argv[], TileLoadArgs* args);
+static bool     ParseConcurrency  (const char* text, TileLoadArgs* args);
+static void     PrintUsage        (const char* programName);
+
+static void     RunClient         (TileLoadRun* run);
+static int      Connect           (const int port);
+static bool     RequestTile       (int connectionSocket, const char* request, char* buffer);
+static bool     ReceiveAll        (int connectionSocket, char* data, const size_t size);
+static void     PrintLevel        (const size_t concurrency, uint64_t* latencies,
+                                   const size_t numberOfRequests, const size_t numberOfErrors,
+                                   const uint64_t timeNs);
+static int      CompareUint64     (const void* a, const void* b);
+static uint64_t GetTimeNs         ();
+
+int main(int argc, char* argv[])
+{
+    TileLoadArgs args = {};
+    if (!ParseArgs(argc, argv, &args))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    printf("%zu requests of %s tiles of zoom %zu per level, %s order\n", args.numberOfRequests,
+           args.format, args.zoom, args.isSameOrder ? "same" : "shared");
+    printf("%8s %10s %10s %10s %10s %8s\n", "clients", "tiles/s", "p50 ms", "p99 ms", "max ms",
+           "errors");
+
+    uint64_t* latencies = (uint64_t*)calloc(args.numberOfRequests, sizeof(*latencies));
+
+    for (size_t level = 0; level < args.numberOfConcurrencyLevels; ++level)
+    {
+        const size_t numberOfClients = args.concurrencyLevels[level];
+
+        TileLoadRun run = {};
+        run.args      = &args;
+        run.latencies = latencies;
+        memset(latencies, 0, args.numberOfRequests * sizeof(*latencies));
+
+        std::thread* clients = new std::thread[numberOfClients];
+
+        const uint64_t startTime = GetTimeNs();
+        for (size_t i = 0; i < numberOfClients; ++i)
+            clients[i] = std::thread(RunClient, &run);
+        for (size_t i = 0; i < numberOfClients; ++i)
+            clients[i].join();
+        const uint64_t timeNs = GetTimeNs() - startTime;
+
+        delete[] clients;
+
+        PrintLevel(numberOfClients, latencies, args.numberOfRequests, run.numberOfErrors, timeNs);
+
+        if (run.numberOfErrors == args.numberOfRequests)
+        {
+            printf("No tile was received, is the server running on port %d?\n", args.port);
+            free(latencies);
+            return 1;
+        }
+    }
+
+    free(latencies);
+    return 0;
+}
+
+static bool ParseArgs(int argc, char* argv[], TileLoadArgs* args)
+{
+    assert(argv);
+    assert(args);
+
+    args->port             = DefaultPort;
+    args->zoom             = DefaultZoom;
+    args->numberOfRequests = DefaultRequests;
+    args->format           = "png";
+    args->isSameOrder      = false;
+
+    if (!ParseConcurrency("1,2,4,8,16,32", args))
+        return false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        const char* option = argv[i];
+        const char* value  = argv[++i];
+
+        if      (strcmp(option, "--port")       == 0) args->port             = atoi(value);
+        else if (strcmp(option, "--zoom")       == 0) args->zoom             = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--requests")   == 0) args->numberOfRequests = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--format")     == 0) args->format           = value;
+        else if (strcmp(option, "--same-order") == 0) args->isSameOrder      = strcmp(value, "on") == 0;
+        else if (strcmp(option, "--concurrency") == 0)
+        {
+            if (!ParseConcurrency(value, args))
+                return false;
+        }
+        else
+            return false;
+    }
+
+    return args->port > 0 && args->port <= UINT16_MAX && args->zoom <= 30 &&
+           args->numberOfRequests > 0 &&
+           (strcmp(args->format, "png") == 0 || strcmp(args->format, "raw") == 0);
+}
+
+// Comma separated numbers of clients.
+static bool ParseConcurrency(const char* text, TileLoadArgs* args)
+{
+    assert(text);
+    assert(args);
+
+    args->numberOfConcurrencyLevels = 0;
+
+    while (*text)
+    {
+        if (args->numberOfConcurrencyLevels == MaxConcurrencyLevels)
+            return false;
+
+        char* end = nullptr;
+        const size_t numberOfClients = strtoul(text, &end, 10);
+        if (end == text || numberOfClients == 0 || numberOfClients > MaxClients ||
+            (*end != ',' && *end != '\0'))
+            return false;
+
+        args->concurrencyLevels[args->numberOfConcurrencyLevels++] = numberOfClients;
+        text = *end ? end + 1 : end;
+    }
+
+    return args->numberOfConcurrencyLevels > 0;
+}
+
+static void PrintUsage(const char* programName)
+{
+    fprintf(stderr,
+            "Usage: %s [--port N] [--zoom Z] [--requests N] [--format png|raw]\n"
+            "          [--concurrency N,N,...] [--same-order on|off]\n"
+            "Sends the requests to the tile server on 127.0.0.1 with every number of clients,\n"
+            "goes through the 2^Z x 2^Z tiles of the zoom level row by row. With --same-order\n"
+            "every client starts from the first tile, so the same tiles are asked at once.\n",
+            programName);
+}
+
+static void RunClient(TileLoadRun* run)
+{
+    assert(run);
+
+    const TileLoadArgs* args = run->args;
+    const uint64_t      side = 1ull << args->zoom;
+
+    char* buffer = (char*)malloc(ResponseBufferSize);
+
+    int    connectionSocket = Connect(args->port);
+    size_t nextTile         = 0;
+
+    for (;;)
+    {
+        const size_t request = run->nextRequest++;
+        if (request >= args->numberOfRequests)
+            break;
+
+        const size_t tile = args->isSameOrder ? nextTile++ : request;
+
+        char path[128] = {};
+        snprintf(path, sizeof(path),
+                 "GET /%zu/%llu/%llu.%s HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", args->zoom,
+                 (unsigned long long)(tile % side), (unsigned long long)(tile / side % side),
+                 args->format);
+
+        const uint64_t startTime = GetTimeNs();
+        const bool     isOk      = connectionSocket >= 0 &&
+                                   RequestTile(connectionSocket, path, buffer);
+        const uint64_t latency   = GetTimeNs() - startTime;
+
+        if (isOk)
+        {
+            run->latencies[request] = latency > 0 ? latency : 1;
+            continue;
+        }
+
+        run->numberOfErrors++;
+
+        // the next request goes through a new connection
+        if (connectionSocket >= 0)
+            close(connectionSocket);
+        connectionSocket = Connect(args->port);
+    }
+
+    if (connectionSocket >= 0)
+        close(connectionSocket);
+    free(buffer);
+}
+
+static int Connect(const int port)
+{
+    const int connectionSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (connectionSocket < 0)
+        return -1;
+
+    sockaddr_in address = {};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(connectionSocket, (const sockaddr*)&address, sizeof(address)) != 0)
+    {
+        close(connectionSocket);
+        return -1;
+    }
+
+    const int noDelay = 1;
+    setsockopt(connectionSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    return connectionSocket;
+}
+
+// True if the answer is 200 and the whole body is received. The connection is kept alive,
+// so the response is read up to its Content-Length and nothing after it.
+static bool RequestTile(int connectionSocket, const char* request, char* buffer)
+{
+    assert(request);
+    assert(buffer);
+
+    const size_t requestSize = strlen(request);
+    if (send(connectionSocket, request, requestSize, MSG_NOSIGNAL) != (ssize_t)requestSize)
+        return false;
+
+    size_t size      = 0;
+    char*  headerEnd = nullptr;
+    while (!headerEnd)
+    {
+        if (size == ResponseBufferSize - 1)
+            return false;
+
+        const ssize_t received = recv(connectionSocket, buffer + size,
+                                      ResponseBufferSize - 1 - size, 0);
+        if (received <= 0)
+            return false;
+
+        size += (size_t)received;
+        buffer[size] = '\0';
+        headerEnd = strstr(buffer, "\r\n\r\n");
+    }
+
+    const char* contentLength = strcasestr(buffer, "\r\nContent-Length:");
+    if (strncmp(buffer, "HTTP/1.1 200 ", 13) != 0 || !contentLength || contentLength > headerEnd)
+        return false;
+
+    const size_t bodySize     = strtoul(contentLength + 17, nullptr, 10);
+    const size_t responseSize = (size_t)(headerEnd - buffer) + 4 + bodySize;
+    if (responseSize > ResponseBufferSize)
+        return false;
+
+    return ReceiveAll(connectionSocket, buffer + size, responseSize - size);
+}
+
+static bool ReceiveAll(int connectionSocket, char* data, const size_t size)
+{
+    assert(data);
+
+    for (size_t received = 0; received < size; )
+    {
+        const ssize_t result = recv(connectionSocket, data + received, size - received, 0);
+        if (result <= 0)
+            return false;
+
+        received += (size_t)result;
+    }
+
+    return true;
+}
+
+// Percentiles are of the received tiles, by the nearest rank.
+static void PrintLevel(const size_t concurrency, uint64_t* latencies,
+                       const size_t numberOfRequests, const size_t numberOfErrors,
+                       const uint64_t timeNs)
+{
+    assert(latencies);
+
+    qsort(latencies, numberOfRequests, sizeof(*latencies), CompareUint64);
+
+    // the failed requests have 0 and go first
+    const uint64_t* received         = latencies + numberOfErrors;
+    const size_t    numberOfReceived = numberOfRequests - numberOfErrors;
+
+    if (!numberOfReceived)
+    {
+        printf("%8zu %10s %10s %10s %10s %8zu\n", concurrency, "-", "-", "-", "-",
+               numberOfErrors);
+        return;
+    }
+
+    const size_t p50Rank = (size_t)ceil(0.50 * (double)numberOfReceived);
+    const size_t p99Rank = (size_t)ceil(0.99 * (double)numberOfReceived);
+
+    printf("%8zu %10.1f %10.3f %10.3f %10.3f %8zu\n", concurrency,
+           (double)numberOfReceived / ((double)timeNs / 1e9),
+           (double)received[p50Rank - 1] / 1e6, (double)received[p99Rank - 1] / 1e6,
+           (double)received[numberOfReceived - 1] / 1e6, numberOfErrors);
+}
+
+static int CompareUint64(const void* a, const void* b)
+{
+    const uint64_t first  = *(const uint64_t*)a;
+    const uint64_t second = *(const uint64_t*)b;
+
+    return (first > second) - (first < second);
+}
+
+static uint64_t GetTimeNs()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
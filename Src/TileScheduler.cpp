@@ -0,0 +1,211 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "TileScheduler.h"
+
+static void WorkerThread (TileScheduler* scheduler, const size_t threadIndex);
+static void ProcessTiles (TileScheduler* scheduler, const size_t threadIndex);
+static bool PopTile      (TileRange* range, size_t* outTile);
+static bool StealTiles   (TileScheduler* scheduler, const size_t threadIndex);
+
+void TileSchedulerCtor(TileScheduler* scheduler, const size_t numberOfThreads)
+{
+    assert(scheduler);
+    assert(numberOfThreads > 0);
+
+    scheduler->numberOfThreads     = numberOfThreads;
+    scheduler->ranges              = new TileRange[numberOfThreads];
+    scheduler->jobNumber           = 0;
+    scheduler->numberOfBusyWorkers = 0;
+    scheduler->shouldStop          = false;
+    scheduler->function            = nullptr;
+    scheduler->context             = nullptr;
+
+    for (size_t i = 0; i < numberOfThreads; ++i)
+    {
+        scheduler->ranges[i].begin = 0;
+        scheduler->ranges[i].end   = 0;
+    }
+
+    // thread 0 is the caller of TileSchedulerRun, so only numberOfThreads - 1 workers are needed
+    scheduler->workers = new std::thread[numberOfThreads - 1];
+    for (size_t i = 1; i < numberOfThreads; ++i)
+        scheduler->workers[i - 1] = std::thread(WorkerThread, scheduler, i);
+}
+
+void TileSchedulerDtor(TileScheduler* scheduler)
+{
+    assert(scheduler);
+
+    {
+        std::lock_guard<std::mutex> lock(scheduler->jobMutex);
+        scheduler->shouldStop = true;
+    }
+    scheduler->jobStarted.notify_all();
+
+    for (size_t i = 1; i < scheduler->numberOfThreads; ++i)
+        scheduler->workers[i - 1].join();
+
+    delete[] scheduler->workers;
+    delete[] scheduler->ranges;
+
+    scheduler->workers         = nullptr;
+    scheduler->ranges          = nullptr;
+    scheduler->numberOfThreads = 0;
+}
+
+void TileSchedulerRun(TileScheduler* scheduler, const size_t numberOfTiles,
+                      TileFunction function, void* context)
+{
+    assert(scheduler);
+    assert(function);
+
+    if (numberOfTiles == 0)
+        return;
+
+    const size_t numberOfThreads = scheduler->numberOfThreads;
+
+    {
+        std::lock_guard<std::mutex> lock(scheduler->jobMutex);
+
+        scheduler->function = function;
+        scheduler->context  = context;
+
+        for (size_t i = 0; i < numberOfThreads; ++i)
+        {
+            std::lock_guard<std::mutex> rangeLock(scheduler->ranges[i].mutex);
+
+            scheduler->ranges[i].begin = numberOfTiles *  i      / numberOfThreads;
+            scheduler->ranges[i].end   = numberOfTiles * (i + 1) / numberOfThreads;
+        }
+
+        scheduler->numberOfBusyWorkers = numberOfThreads - 1;
+        scheduler->jobNumber++;
+    }
+    scheduler->jobStarted.notify_all();
+
+    ProcessTiles(scheduler, 0);
+
+    std::unique_lock<std::mutex> lock(scheduler->jobMutex);
+    scheduler->jobFinished.wait(lock, [scheduler] { return scheduler->numberOfBusyWorkers == 0; });
+}
+
+size_t GetDefaultNumberOfThreads()
+{
+    const char* envThreads = getenv("MANDELBROT_THREADS");
+    if (envThreads)
+    {
+        size_t numberOfThreads = strtoul(envThreads, nullptr, 10);
+        if (numberOfThreads > 0)
+            return numberOfThreads;
+    }
+
+    size_t numberOfThreads = std::thread::hardware_concurrency();
+
+    return numberOfThreads > 0 ? numberOfThreads : 1;
+}
+
+static void WorkerThread(TileScheduler* scheduler, const size_t threadIndex)
+{
+    assert(scheduler);
+
+    size_t lastJobNumber = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(scheduler->jobMutex);
+            scheduler->jobStarted.wait(lock, [scheduler, lastJobNumber]
+                                       {
+                                           return scheduler->shouldStop ||
+                                                  scheduler->jobNumber != lastJobNumber;
+                                       });
+
+            if (scheduler->shouldStop)
+                return;
+
+            lastJobNumber = scheduler->jobNumber;
+        }
+
+        ProcessTiles(scheduler, threadIndex);
+
+        bool isLastWorker = false;
+        {
+            std::lock_guard<std::mutex> lock(scheduler->jobMutex);
+            isLastWorker = --scheduler->numberOfBusyWorkers == 0;
+        }
+
+        if (isLastWorker)
+            scheduler->jobFinished.notify_one();
+    }
+}
+
+static void ProcessTiles(TileScheduler* scheduler, const size_t threadIndex)
+{
+    assert(scheduler);
+
+    TileRange* ownRange = &scheduler->ranges[threadIndex];
+
+    while (true)
+    {
+        size_t tile = 0;
+        if (PopTile(ownRange, &tile))
+        {
+            scheduler->function(tile, threadIndex, scheduler->context);
+            continue;
+        }
+
+        if (!StealTiles(scheduler, threadIndex))
+            break;
+    }
+}
+
+static bool PopTile(TileRange* range, size_t* outTile)
+{
+    assert(range);
+    assert(outTile);
+
+    std::lock_guard<std::mutex> lock(range->mutex);
+
+    if (range->begin == range->end)
+        return false;
+
+    *outTile = range->begin++;
+    return true;
+}
+
+static bool StealTiles(TileScheduler* scheduler, const size_t threadIndex)
+{
+    assert(scheduler);
+
+    const size_t numberOfThreads = scheduler->numberOfThreads;
+
+    for (size_t i = 1; i < numberOfThreads; ++i)
+    {
+        TileRange* victim = &scheduler->ranges[(threadIndex + i) % numberOfThreads];
+
+        size_t stolenBegin = 0;
+        size_t stolenEnd   = 0;
+        {
+            std::lock_guard<std::mutex> lock(victim->mutex);
+
+            size_t numberOfTiles = victim->end - victim->begin;
+            if (numberOfTiles == 0)
+                continue;
+
+            // the victim keeps the tiles closest to its current one
+            stolenEnd    = victim->end;
+            stolenBegin  = victim->end - (numberOfTiles + 1) / 2;
+            victim->end  = stolenBegin;
+        }
+
+        TileRange* ownRange = &scheduler->ranges[threadIndex];
+
+        std::lock_guard<std::mutex> lock(ownRange->mutex);
+        ownRange->begin = stolenBegin;
+        ownRange->end   = stolenEnd;
+
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,51 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Called for every tile of a job. threadIndex is in [0, numberOfThreads) and can be used
+// to index per-thread scratch data, thread 0 is the one that called TileSchedulerRun.
+typedef void (*TileFunction)(size_t tileIndex, size_t threadIndex, void* context);
+
+// Tiles of a job are split into contiguous ranges, one per thread. Owner takes tiles from the
+// front of its range, idle threads steal the back half of someone else's range.
+struct TileRange
+{
+    std::mutex mutex = {};
+
+    size_t begin = 0;
+    size_t end   = 0;
+};
+
+struct TileScheduler
+{
+    size_t       numberOfThreads;
+    std::thread* workers;
+    TileRange*   ranges;
+
+    std::mutex              jobMutex;
+    std::condition_variable jobStarted;
+    std::condition_variable jobFinished;
+
+    size_t jobNumber;
+    size_t numberOfBusyWorkers;
+    bool   shouldStop;
+
+    TileFunction function;
+    void*        context;
+};
+
+void   TileSchedulerCtor(TileScheduler* scheduler, const size_t numberOfThreads);
+void   TileSchedulerDtor(TileScheduler* scheduler);
+
+// Blocks until function was called for every tile in [0, numberOfTiles).
+void   TileSchedulerRun (TileScheduler* scheduler, const size_t numberOfTiles,
+                         TileFunction function, void* context);
+
+// MANDELBROT_THREADS environment variable if set, number of hardware threads otherwise.
+size_t GetDefaultNumberOfThreads();
+
+#endif
@@ -0,0 +1,889 @@
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "ImageWriter.h"
+#include "KernelDispatch.h"
+#include "Mandelbrot.h"
+
+// Tiles of the zoom level z split the square [WorldXBegin, WorldXBegin + WorldSize) x
+// [WorldYBegin, WorldYBegin + WorldSize) into 2^z x 2^z tiles of ServerTileSize pixels.
+static const size_t ServerTileSize       = 256;
+static const double WorldXBegin          = -2.75;
+static const double WorldYBegin          = -2;
+static const double WorldSize            = 4;
+// pixels are still a few double ulps apart, deeper the picture is made of blocks
+static const size_t MaxZoom              = 40;
+
+// tiles are given to the workers in strips of rows
+static const size_t StripHeight          = 8;
+static const size_t MaxBatchSize         = 64;
+
+static const size_t DefaultBatchSize     = 16;
+static const size_t DefaultMaxConnections = 256;
+static const int    DefaultPort          = 8080;
+
+static const size_t RequestBufferSize    = 4096;
+
+static const char* const PaletteNames[]  = { "green", "fire", "gray" };
+
+enum TileFormat
+{
+    TILE_FORMAT_PNG,
+    TILE_FORMAT_RAW,    // numbers of iterations, uint16_t little endian, row by row
+};
+
+enum TileJobState
+{
+    TILE_JOB_PENDING,
+    TILE_JOB_RENDERING,
+    TILE_JOB_RENDERED,
+};
+
+// A tile of the map, the same for every format it is asked in.
+struct TileKey
+{
+    size_t   zoom;
+    uint64_t tileX;
+    uint64_t tileY;
+};
+
+// A tile in flight, all requests for it that come before it is rendered wait for the same
+// job, whatever format they want. The last of them frees it.
+struct TileJob
+{
+    TileKey                 key             = {};
+    TileJobState            state           = TILE_JOB_PENDING;
+    size_t                  numberOfWaiters = 0;
+    // only the requests of this tile wake up
+    std::condition_variable rendered        = {};
+
+    // raw tiles are sent straight from the iterations
+    uint16_t*               iterations      = nullptr;
+
+    // encoded once if any request that came before the job was rendered wants png
+    bool                    isPngRequested  = false;
+    bool                    isPngFailed     = false;
+    char*                   pngBody         = nullptr;
+    size_t                  pngBodySize     = 0;
+
+    TileJob*                next            = nullptr;
+};
+
+struct TileServerArgs
+{
+    const char*           kernelName;
+    int                   port;
+    size_t                numberOfThreads;
+    size_t                batchSize;
+    size_t                maxConnections;
+    size_t                maxNumberOfIterations;
+    MandelbrotPaletteType paletteType;
+};
+
+struct TileServerStats
+{
+    uint64_t requests;
+    // requests that waited for a tile already in flight instead of rendering it again
+    uint64_t deduplicatedRequests;
+    uint64_t renderedTiles;
+    uint64_t batches;
+    uint64_t badRequests;
+};
+
+struct TileServer
+{
+    std::mutex              mutex;
+    std::condition_variable jobAdded;
+    std::condition_variable connectionClosed;
+
+    // jobs in flight in the order they came, pending ones are after the rendering ones
+    TileJob*                firstJob;
+    TileJob*                lastJob;
+    size_t                  numberOfPendingJobs;
+
+    // sockets of the open connections, -1 in the free slots
+    int*                    connectionSockets;
+    size_t                  maxConnections;
+    size_t                  numberOfConnections;
+    bool                    shouldStop;
+
+    TileServerStats         stats;
+
+    // set before the start, used by the render thread and its workers
+    TileScheduler*              scheduler;
+    const MandelbrotKernelInfo* kernel;
+    const MandelbrotPalette*    palette;
+    size_t                      maxNumberOfIterations;
+    size_t                      batchSize;
+};
+
+// Tiles of a batch are rendered by one job of the scheduler over the strips of all of them,
+// so the workers steal the strips of the slow tiles. The worker that finishes the last strip
+// of a tile encodes it and gives it to its requests, a tile doesn't wait for the whole batch.
+struct TileBatch
+{
+    TileJob*             jobs[MaxBatchSize];
+    MandelbrotView       views[MaxBatchSize];
+    MandelbrotTileKernel tileKernels[MaxBatchSize];
+    std::atomic<size_t>  numberOfStripsLeft[MaxBatchSize];
+    size_t               numberOfJobs;
+
+    TileServer*          server;
+};
+
+static bool   ParseArgs          (int argc, char* argv[], TileServerArgs* args);
+static void   PrintUsage         (const char* programName);
+
+static int    OpenListeningSocket(const int port);
+static void   WaitForStopSignal  (sigset_t signals, int listeningSocket);
+static void   ServeConnection    (TileServer* server, int connectionSocket, size_t slot);
+static bool   ServeRequest       (TileServer* server, int connectionSocket, const char* request,
+                                  bool* outKeepAlive);
+static int    ParseTileRequest   (const char* request, TileKey* outKey, TileFormat* outFormat,
+                                  bool* outKeepAlive);
+static bool   ParseNumber        (const char** text, uint64_t* outNumber);
+static bool   SendResponse       (int connectionSocket, const int status, const char* contentType,
+                                  const char* body, const size_t bodySize, const bool keepAlive);
+static bool   SendAll            (int connectionSocket, const char* data, const size_t size,
+                                  const int flags);
+
+static TileJob* GetTileJob       (TileServer* server, const TileKey* key, const TileFormat format);
+static void     ReleaseTileJob   (TileServer* server, TileJob* job);
+static bool     IsSameTile       (const TileKey* first, const TileKey* second);
+
+static void   RenderTiles        (TileServer* server);
+static void   RenderBatch        (TileServer* server, TileBatch* batch);
+static void   RenderStrip        (size_t stripIndex, size_t threadIndex, void* context);
+static void   EncodePngTile      (TileJob* job, const MandelbrotPalette* palette);
+static void   FinishTileJob      (TileServer* server, TileJob* job);
+static void   GetTileView        (const TileKey* key, const size_t maxNumberOfIterations,
+                                  MandelbrotView* outView);
+static const MandelbrotKernelInfo* GetLevelKernel(const MandelbrotKernelInfo* kernel,
+                                                  const size_t zoom,
+                                                  const size_t maxNumberOfIterations);
+static int    CompareTileJobs    (const void* a, const void* b);
+
+int main(int argc, char* argv[])
+{
+    TileServerArgs args = {};
+    if (!ParseArgs(argc, argv, &args))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const MandelbrotKernelInfo* kernel = SelectMandelbrotKernel(args.kernelName);
+    if (!kernel)
+        return 1;
+
+    // the signals are taken by the waiting thread only, so accept is not interrupted
+    // somewhere in the middle of a worker
+    sigset_t stopSignals = {};
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    const int listeningSocket = OpenListeningSocket(args.port);
+    if (listeningSocket < 0)
+    {
+        printf("Can't listen on port %d: %s\n", args.port, strerror(errno));
+        return 1;
+    }
+
+    TileScheduler scheduler = {};
+    TileSchedulerCtor(&scheduler, args.numberOfThreads);
+
+    MandelbrotPalette palette = {};
+    MandelbrotPaletteCtor(&palette, args.maxNumberOfIterations, args.paletteType);
+
+    TileServer server = {};
+    server.connectionSockets     = (int*)malloc(args.maxConnections * sizeof(int));
+    server.maxConnections        = args.maxConnections;
+    server.scheduler             = &scheduler;
+    server.kernel                = kernel;
+    server.palette               = &palette;
+    server.maxNumberOfIterations = args.maxNumberOfIterations;
+    server.batchSize             = args.batchSize;
+
+    for (size_t i = 0; i < args.maxConnections; ++i)
+        server.connectionSockets[i] = -1;
+
+    printf("Serving /z/x/y.png and /z/x/y.raw on http://127.0.0.1:%d, kernel - %s, "
+           "threads - %zu, batches of %zu tiles\n",
+           args.port, kernel->name, args.numberOfThreads, args.batchSize);
+    fflush(stdout);
+
+    std::thread renderThread(RenderTiles, &server);
+    std::thread signalThread(WaitForStopSignal, stopSignals, listeningSocket);
+
+    for (;;)
+    {
+        const int connectionSocket = accept(listeningSocket, nullptr, nullptr);
+        if (connectionSocket < 0)
+        {
+            // shut down by the signal thread
+            if (errno == EINVAL)
+                break;
+            continue;
+        }
+
+        const int noDelay = 1;
+        setsockopt(connectionSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        std::lock_guard<std::mutex> lock(server.mutex);
+
+        size_t slot = 0;
+        while (slot < server.maxConnections && server.connectionSockets[slot] >= 0)
+            slot++;
+
+        if (slot == server.maxConnections)
+        {
+            close(connectionSocket);
+            continue;
+        }
+
+        server.connectionSockets[slot] = connectionSocket;
+        server.numberOfConnections++;
+
+        std::thread(ServeConnection, &server, connectionSocket, slot).detach();
+    }
+
+    signalThread.join();
+    close(listeningSocket);
+
+    // connections finish the request they serve and see the end of the stream
+    {
+        std::unique_lock<std::mutex> lock(server.mutex);
+
+        for (size_t i = 0; i < server.maxConnections; ++i)
+        {
+            if (server.connectionSockets[i] >= 0)
+                shutdown(server.connectionSockets[i], SHUT_RD);
+        }
+
+        server.connectionClosed.wait(lock, [&server] { return server.numberOfConnections == 0; });
+
+        server.shouldStop = true;
+    }
+    server.jobAdded.notify_one();
+    renderThread.join();
+
+    const TileServerStats* stats = &server.stats;
+    printf("\nRequests - %llu, deduplicated - %llu, bad - %llu, tiles rendered - %llu "
+           "in %llu batches (%.1f tiles per batch)\n",
+           (unsigned long long)stats->requests, (unsigned long long)stats->deduplicatedRequests,
+           (unsigned long long)stats->badRequests, (unsigned long long)stats->renderedTiles,
+           (unsigned long long)stats->batches,
+           stats->batches ? (double)stats->renderedTiles / (double)stats->batches : 0.);
+
+    free(server.connectionSockets);
+    MandelbrotPaletteDtor(&palette);
+    TileSchedulerDtor(&scheduler);
+
+    return 0;
+}
+
+static bool ParseArgs(int argc, char* argv[], TileServerArgs* args)
+{
+    assert(argv);
+    assert(args);
+
+    args->kernelName            = nullptr;
+    args->port                  = DefaultPort;
+    args->numberOfThreads       = GetDefaultNumberOfThreads();
+    args->batchSize             = DefaultBatchSize;
+    args->maxConnections        = DefaultMaxConnections;
+    args->maxNumberOfIterations = DefaultMaxNumberOfIterations;
+    args->paletteType           = PALETTE_GREEN;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        const char* option = argv[i];
+        const char* value  = argv[++i];
+
+        if      (strcmp(option, "--kernel")          == 0) args->kernelName            = value;
+        else if (strcmp(option, "--port")            == 0) args->port                  = atoi(value);
+        else if (strcmp(option, "--threads")         == 0) args->numberOfThreads       = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--batch")           == 0) args->batchSize             = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--max-connections") == 0) args->maxConnections        = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--iterations")      == 0) args->maxNumberOfIterations = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--palette")         == 0)
+        {
+            args->paletteType = NUMBER_OF_PALETTES;
+            for (size_t palette = 0; palette < NUMBER_OF_PALETTES; ++palette)
+            {
+                if (strcmp(value, PaletteNames[palette]) == 0)
+                    args->paletteType = (MandelbrotPaletteType)palette;
+            }
+        }
+        else
+            return false;
+    }
+
+    return args->port > 0 && args->port <= UINT16_MAX && args->numberOfThreads > 0 &&
+           args->batchSize > 0 && args->batchSize <= MaxBatchSize && args->maxConnections > 0 &&
+           args->maxNumberOfIterations > 0 &&
+           args->maxNumberOfIterations <= MaxNumberOfIterationsLimit &&
+           args->paletteType != NUMBER_OF_PALETTES;
+}
+
+static void PrintUsage(const char* programName)
+{
+    fprintf(stderr,
+            "Usage: %s [--port N] [--threads N] [--batch N] [--max-connections N]\n"
+            "          [--iterations N] [--palette green|fire|gray] [--kernel name]\n"
+            "Answers GET /z/x/y.png and /z/x/y.raw on 127.0.0.1 with %zu x %zu tiles, raw is\n"
+            "uint16_t numbers of iterations. Zoom is at most %zu, a batch is at most %zu tiles.\n"
+            "Stops on SIGINT or SIGTERM.\n",
+            programName, ServerTileSize, ServerTileSize, MaxZoom, MaxBatchSize);
+}
+
+// The server is for a local viewer, so it listens on the loopback only.
+static int OpenListeningSocket(const int port)
+{
+    const int listeningSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listeningSocket < 0)
+        return -1;
+
+    const int reuseAddress = 1;
+    setsockopt(listeningSocket, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+
+    sockaddr_in address = {};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(listeningSocket, (const sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listeningSocket, SOMAXCONN) != 0)
+    {
+        const int error = errno;
+        close(listeningSocket);
+        errno = error;
+        return -1;
+    }
+
+    return listeningSocket;
+}
+
+// Shutting the listening socket down makes the blocked accept of the main thread fail.
+static void WaitForStopSignal(sigset_t signals, int listeningSocket)
+{
+    int signalNumber = 0;
+    sigwait(&signals, &signalNumber);
+
+    shutdown(listeningSocket, SHUT_RDWR);
+}
+
+// Requests of a connection are served one by one, a client may send the next ones before
+// it gets the answer.
+static void ServeConnection(TileServer* server, int connectionSocket, size_t slot)
+{
+    assert(server);
+
+    char   buffer[RequestBufferSize] = {};
+    size_t size      = 0;
+    bool   keepAlive = true;
+
+    while (keepAlive)
+    {
+        char* requestEnd = (char*)memmem(buffer, size, "\r\n\r\n", 4);
+        if (!requestEnd)
+        {
+            // the request line and headers of a tile request are much shorter
+            if (size == sizeof(buffer) - 1)
+            {
+                SendResponse(connectionSocket, 431, "text/plain", "Too long\n", 9, false);
+                break;
+            }
+
+            const ssize_t received = recv(connectionSocket, buffer + size,
+                                          sizeof(buffer) - 1 - size, 0);
+            if (received <= 0)
+                break;
+
+            size += (size_t)received;
+            continue;
+        }
+
+        *requestEnd = '\0';
+        if (!ServeRequest(server, connectionSocket, buffer, &keepAlive))
+            break;
+
+        const size_t requestSize = (size_t)(requestEnd - buffer) + 4;
+        memmove(buffer, buffer + requestSize, size - requestSize);
+        size -= requestSize;
+    }
+
+    close(connectionSocket);
+
+    std::lock_guard<std::mutex> lock(server->mutex);
+
+    server->connectionSockets[slot] = -1;
+    server->numberOfConnections--;
+    server->connectionClosed.notify_one();
+}
+
+// False if the connection is broken.
+static bool ServeRequest(TileServer* server, int connectionSocket, const char* request,
+                         bool* outKeepAlive)
+{
+    assert(server);
+    assert(request);
+    assert(outKeepAlive);
+
+    TileKey    key    = {};
+    TileFormat format = TILE_FORMAT_PNG;
+    const int  status = ParseTileRequest(request, &key, &format, outKeepAlive);
+
+    if (status != 200)
+    {
+        {
+            std::lock_guard<std::mutex> lock(server->mutex);
+            server->stats.badRequests++;
+        }
+
+        const char* message = status == 404 ? "Not found\n" :
+                              status == 405 ? "Method not allowed\n" : "Bad request\n";
+        return SendResponse(connectionSocket, status, "text/plain", message, strlen(message),
+                            *outKeepAlive);
+    }
+
+    TileJob* job = GetTileJob(server, &key, format);
+
+    bool isSent = false;
+    if (format == TILE_FORMAT_RAW)
+        isSent = SendResponse(connectionSocket, 200, "application/octet-stream",
+                              (const char*)job->iterations,
+                              ServerTileSize * ServerTileSize * sizeof(*job->iterations),
+                              *outKeepAlive);
+    else if (job->isPngFailed)
+        isSent = SendResponse(connectionSocket, 500, "text/plain", "Can't encode\n", 13,
+                              *outKeepAlive);
+    else
+        isSent = SendResponse(connectionSocket, 200, "image/png", job->pngBody,
+                              job->pngBodySize, *outKeepAlive);
+
+    ReleaseTileJob(server, job);
+
+    return isSent;
+}
+
+// Status of the answer: 200 for a tile request, the tile is in outKey and its format in
+// outFormat. Connections of HTTP/1.1 stay open unless the client asks to close them, the ones
+// of HTTP/1.0 are closed.
+static int ParseTileRequest(const char* request, TileKey* outKey, TileFormat* outFormat,
+                            bool* outKeepAlive)
+{
+    assert(request);
+    assert(outKey);
+    assert(outFormat);
+    assert(outKeepAlive);
+
+    const char* lineEnd = strstr(request, "\r\n");
+    if (!lineEnd)
+        lineEnd = request + strlen(request);
+
+    const size_t versionSize = strlen(" HTTP/1.x");
+    *outKeepAlive = false;
+
+    if ((size_t)(lineEnd - request) <= versionSize)
+        return 400;
+
+    const char* versionBegin = lineEnd - versionSize;
+    if (strncmp(versionBegin, " HTTP/1.", 8) != 0)
+        return 400;
+
+    *outKeepAlive = versionBegin[8] == '1' && !strcasestr(lineEnd, "Connection: close");
+
+    if (strncmp(request, "GET ", 4) != 0)
+        return 405;
+
+    const char* path = request + 4;
+    uint64_t    zoom = 0;
+
+    if (*path++ != '/' || !ParseNumber(&path, &zoom)        || *path++ != '/' ||
+                          !ParseNumber(&path, &outKey->tileX) || *path++ != '/' ||
+                          !ParseNumber(&path, &outKey->tileY))
+        return 404;
+
+    if (path == versionBegin || strncmp(path, ".png ", 5) == 0)
+        *outFormat = TILE_FORMAT_PNG;
+    else if (strncmp(path, ".raw ", 5) == 0)
+        *outFormat = TILE_FORMAT_RAW;
+    else
+        return 404;
+
+    if (zoom > MaxZoom || outKey->tileX >> zoom || outKey->tileY >> zoom)
+        return 404;
+
+    outKey->zoom = zoom;
+
+    return 200;
+}
+
+// Decimal number of at most 19 digits, text is moved past it.
+static bool ParseNumber(const char** text, uint64_t* outNumber)
+{
+    assert(text);
+    assert(outNumber);
+
+    const char* digit = *text;
+    uint64_t    number = 0;
+
+    while (*digit >= '0' && *digit <= '9' && digit - *text < 19)
+        number = number * 10 + (uint64_t)(*digit++ - '0');
+
+    if (digit == *text || (*digit >= '0' && *digit <= '9'))
+        return false;
+
+    *text      = digit;
+    *outNumber = number;
+
+    return true;
+}
+
+static bool SendResponse(int connectionSocket, const int status, const char* contentType,
+                         const char* body, const size_t bodySize, const bool keepAlive)
+{
+    assert(contentType);
+    assert(body);
+
+    const char* reason = status == 200 ? "OK"          : status == 404 ? "Not Found" :
+                         status == 405 ? "Method Not Allowed" :
+                         status == 431 ? "Request Header Fields Too Large" :
+                         status == 500 ? "Internal Server Error" : "Bad Request";
+
+    char header[256] = {};
+    const int headerSize = snprintf(header, sizeof(header),
+                                    "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n"
+                                    "Content-Length: %zu\r\nConnection: %s\r\n\r\n",
+                                    status, reason, contentType, bodySize,
+                                    keepAlive ? "keep-alive" : "close");
+
+    // the header waits for the body, so a small answer is one packet
+    return SendAll(connectionSocket, header, (size_t)headerSize, MSG_MORE) &&
+           SendAll(connectionSocket, body, bodySize, 0);
+}
+
+static bool SendAll(int connectionSocket, const char* data, const size_t size, const int flags)
+{
+    assert(data);
+
+    for (size_t sent = 0; sent < size; )
+    {
+        const ssize_t result = send(connectionSocket, data + sent, size - sent,
+                                    flags | MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+
+        sent += (size_t)result;
+    }
+
+    return true;
+}
+
+// Waits until the tile is rendered. A tile that is already in flight is not rendered again,
+// the request waits for the same job, a png request makes the job encode a png too.
+static TileJob* GetTileJob(TileServer* server, const TileKey* key, const TileFormat format)
+{
+    assert(server);
+    assert(key);
+
+    std::unique_lock<std::mutex> lock(server->mutex);
+
+    server->stats.requests++;
+
+    TileJob* job = server->firstJob;
+    while (job && !IsSameTile(&job->key, key))
+        job = job->next;
+
+    if (job)
+        server->stats.deduplicatedRequests++;
+    else
+    {
+        job = new TileJob{};
+        job->key = *key;
+
+        if (server->lastJob)
+            server->lastJob->next = job;
+        else
+            server->firstJob = job;
+        server->lastJob = job;
+
+        server->numberOfPendingJobs++;
+        server->jobAdded.notify_one();
+    }
+
+    job->isPngRequested = job->isPngRequested || format == TILE_FORMAT_PNG;
+
+    job->numberOfWaiters++;
+    job->rendered.wait(lock, [job] { return job->state == TILE_JOB_RENDERED; });
+
+    return job;
+}
+
+static void ReleaseTileJob(TileServer* server, TileJob* job)
+{
+    assert(server);
+    assert(job);
+
+    {
+        std::lock_guard<std::mutex> lock(server->mutex);
+        if (--job->numberOfWaiters > 0)
+            return;
+    }
+
+    free(job->pngBody);
+    free(job->iterations);
+    delete job;
+}
+
+static bool IsSameTile(const TileKey* first, const TileKey* second)
+{
+    assert(first);
+    assert(second);
+
+    return first->zoom == second->zoom && first->tileX == second->tileX &&
+           first->tileY == second->tileY;
+}
+
+// Takes up to batchSize pending tiles at once. Tiles that come while a batch is rendered
+// wait for the next one, so batches grow with the load without waiting for more requests.
+static void RenderTiles(TileServer* server)
+{
+    assert(server);
+
+    // the views of a whole batch don't fit the stack
+    TileBatch* batch = new TileBatch();
+    batch->server = server;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(server->mutex);
+            server->jobAdded.wait(lock, [server]
+                                  {
+                                      return server->numberOfPendingJobs > 0 ||
+                                             server->shouldStop;
+                                  });
+
+            if (!server->numberOfPendingJobs)
+                break;
+
+            batch->numberOfJobs = 0;
+            for (TileJob* job = server->firstJob;
+                 job && batch->numberOfJobs < server->batchSize; job = job->next)
+            {
+                if (job->state != TILE_JOB_PENDING)
+                    continue;
+
+                job->state = TILE_JOB_RENDERING;
+                batch->jobs[batch->numberOfJobs++] = job;
+            }
+
+            server->numberOfPendingJobs -= batch->numberOfJobs;
+        }
+
+        RenderBatch(server, batch);
+
+        std::lock_guard<std::mutex> lock(server->mutex);
+        server->stats.batches++;
+    }
+
+    delete batch;
+}
+
+static void RenderBatch(TileServer* server, TileBatch* batch)
+{
+    assert(server);
+    assert(batch);
+
+    // neighbouring tiles go one after another, so the strips a worker takes are close
+    qsort(batch->jobs, batch->numberOfJobs, sizeof(*batch->jobs), CompareTileJobs);
+
+    const size_t tilePixels = ServerTileSize * ServerTileSize;
+
+    for (size_t i = 0; i < batch->numberOfJobs; ++i)
+    {
+        TileJob* job = batch->jobs[i];
+
+        GetTileView(&job->key, server->maxNumberOfIterations, &batch->views[i]);
+        batch->tileKernels[i] = GetLevelKernel(server->kernel, job->key.zoom,
+                                               server->maxNumberOfIterations)->tileKernel;
+
+        job->iterations = (uint16_t*)malloc(tilePixels * sizeof(*job->iterations));
+    }
+
+    const size_t stripsPerTile = ServerTileSize / StripHeight;
+    for (size_t i = 0; i < batch->numberOfJobs; ++i)
+        batch->numberOfStripsLeft[i] = stripsPerTile;
+
+    TileSchedulerRun(server->scheduler, batch->numberOfJobs * stripsPerTile, RenderStrip, batch);
+}
+
+static void RenderStrip(size_t stripIndex, size_t threadIndex, void* context)
+{
+    assert(context);
+    (void)threadIndex;
+
+    TileBatch* batch = (TileBatch*)context;
+
+    const size_t stripsPerTile = ServerTileSize / StripHeight;
+    const size_t tileIndex     = stripIndex / stripsPerTile;
+
+    MandelbrotTile strip = {};
+    strip.xBegin = 0;
+    strip.yBegin = stripIndex % stripsPerTile * StripHeight;
+    strip.xEnd   = ServerTileSize;
+    strip.yEnd   = strip.yBegin + StripHeight;
+
+    TileJob* job = batch->jobs[tileIndex];
+
+    MandelbrotStats stats = {};
+    batch->tileKernels[tileIndex](job->iterations, &batch->views[tileIndex], &strip, &stats);
+
+    // the strips of the other workers are seen after the decrement
+    if (--batch->numberOfStripsLeft[tileIndex] > 0)
+        return;
+
+    FinishTileJob(batch->server, job);
+}
+
+// Colorizes the tile and encodes it, isPngFailed is set if it can't be encoded.
+static void EncodePngTile(TileJob* job, const MandelbrotPalette* palette)
+{
+    assert(job);
+    assert(palette);
+
+    const size_t tilePixels = ServerTileSize * ServerTileSize;
+
+    // the colorizer needs 32 bytes aligned pixels
+    uint8_t* pixels = (uint8_t*)aligned_alloc(32, tilePixels * 4);
+    ColorizeMandelbrot(pixels, job->iterations, tilePixels, palette);
+
+    ImageWriter writer = {};
+    bool isWritten = ImageWriterCtorMemory(&writer, &job->pngBody, &job->pngBodySize, IMAGE_PNG,
+                                           ServerTileSize, ServerTileSize);
+    if (isWritten)
+        ImageWriterWriteBand(&writer, pixels, ServerTileSize);
+    isWritten = ImageWriterDtor(&writer) && isWritten;
+
+    job->isPngFailed = !isWritten;
+
+    free(pixels);
+}
+
+// The rendered job leaves the list, its requests keep it until the tile is sent. The png is
+// encoded if a request wants it, the ones that come later find no job and render the tile
+// again.
+static void FinishTileJob(TileServer* server, TileJob* job)
+{
+    assert(server);
+    assert(job);
+
+    std::unique_lock<std::mutex> lock(server->mutex);
+
+    if (job->isPngRequested)
+    {
+        // requests of the tile that come meanwhile wait for the same job
+        lock.unlock();
+        EncodePngTile(job, server->palette);
+        lock.lock();
+    }
+
+    job->state = TILE_JOB_RENDERED;
+
+    TileJob* previousJob = nullptr;
+    for (TileJob* listJob = server->firstJob; listJob != job; listJob = listJob->next)
+        previousJob = listJob;
+
+    if (previousJob)
+        previousJob->next = job->next;
+    else
+        server->firstJob = job->next;
+
+    if (server->lastJob == job)
+        server->lastJob = previousJob;
+
+    server->stats.renderedTiles++;
+    job->rendered.notify_all();
+}
+
+static void GetTileView(const TileKey* key, const size_t maxNumberOfIterations,
+                        MandelbrotView* outView)
+{
+    assert(key);
+    assert(outView);
+
+    const double step = WorldSize / (double)((uint64_t)ServerTileSize << key->zoom);
+
+    outView->width  = ServerTileSize;
+    outView->height = ServerTileSize;
+
+    outView->dxDouble      = step;
+    outView->dyDouble      = step;
+    outView->x0BeginDouble = WorldXBegin + (double)(key->tileX * ServerTileSize) * step;
+    outView->y0BeginDouble = WorldYBegin + (double)(key->tileY * ServerTileSize) * step;
+
+    outView->dx      = (float)outView->dxDouble;
+    outView->dy      = (float)outView->dyDouble;
+    outView->x0Begin = (float)outView->x0BeginDouble;
+    outView->y0Begin = (float)outView->y0BeginDouble;
+
+    outView->maxNumberOfIterations = maxNumberOfIterations;
+}
+
+// The kernel is chosen for the whole zoom level, so neighbouring tiles of a level are not
+// calculated with different precision and have no seams between them.
+static const MandelbrotKernelInfo* GetLevelKernel(const MandelbrotKernelInfo* kernel,
+                                                  const size_t zoom,
+                                                  const size_t maxNumberOfIterations)
+{
+    assert(kernel);
+
+    TileKey levelKey = {};
+    levelKey.zoom = zoom;
+
+    MandelbrotView levelView = {};
+    GetTileView(&levelKey, maxNumberOfIterations, &levelView);
+
+    levelView.width  = ServerTileSize << zoom;
+    levelView.height = ServerTileSize << zoom;
+
+    return SelectMandelbrotKernelForView(kernel, &levelView);
+}
+
+static int CompareTileJobs(const void* a, const void* b)
+{
+    const TileKey* first  = &(*(TileJob* const*)a)->key;
+    const TileKey* second = &(*(TileJob* const*)b)->key;
+
+    if (first->zoom != second->zoom)
+        return first->zoom < second->zoom ? -1 : 1;
+    if (first->tileY != second->tileY)
+        return first->tileY < second->tileY ? -1 : 1;
+    if (first->tileX != second->tileX)
+        return first->tileX < second->tileX ? -1 : 1;
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "Mandelbrot.h"
+
+extern "C" uint64_t GetTimeStampCounter();
+
+static const size_t TileWidth  = 64; // has to be a multiple of the widest vector
+static const size_t TileHeight = 8;
+
+// Either iterations and tileKernel or smoothIterations and smoothKernel are set.
+struct MandelbrotFrame
+{
+    uint16_t*                  iterations;
+    float*                     smoothIterations;
+    const MandelbrotView*      view;
+    MandelbrotTile             region;
+    MandelbrotTileKernel       tileKernel;
+    MandelbrotSmoothTileKernel smoothKernel;
+
+    size_t                     numberOfTilesX;
+
+    std::atomic<uint64_t>      vectorIterations;
+    std::atomic<uint64_t>      skippedIterations;
+};
+
+static uint64_t RunMandelbrotFrame          (MandelbrotFrame* frame, TileScheduler* scheduler,
+                                             MandelbrotStats* stats);
+static void     CalculateMandelbrotFrameTile(size_t tileIndex, size_t threadIndex, void* context);
+
+uint64_t CalculateMandelbrotSetTiled(uint16_t* iterations, const MandelbrotView* view,
+                                     TileScheduler* scheduler, MandelbrotTileKernel tileKernel,
+                                     MandelbrotStats* stats)
+{
+    assert(view);
+
+    const MandelbrotTile region = { 0, 0, view->width, view->height };
+    return CalculateMandelbrotRegionTiled(iterations, view, &region, scheduler, tileKernel, stats);
+}
+
+uint64_t CalculateMandelbrotRegionTiled(uint16_t* iterations, const MandelbrotView* view,
+                                        const MandelbrotTile* region, TileScheduler* scheduler,
+                                        MandelbrotTileKernel tileKernel, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(region);
+    assert(region->xEnd <= view->width && region->yEnd <= view->height);
+    assert(scheduler);
+    assert(tileKernel);
+
+    MandelbrotFrame frame = {};
+    frame.iterations = iterations;
+    frame.view       = view;
+    frame.region     = *region;
+    frame.tileKernel = tileKernel;
+
+    return RunMandelbrotFrame(&frame, scheduler, stats);
+}
+
+uint64_t CalculateMandelbrotSetSmooth(float* smoothIterations, const MandelbrotView* view,
+                                      TileScheduler* scheduler, MandelbrotStats* stats)
+{
+    assert(smoothIterations);
+    assert(view);
+    assert(scheduler);
+
+    MandelbrotFrame frame = {};
+    frame.smoothIterations = smoothIterations;
+    frame.view             = view;
+    frame.region           = { 0, 0, view->width, view->height };
+    frame.smoothKernel     = CalculateMandelbrotTileAvx2Smooth;
+
+    return RunMandelbrotFrame(&frame, scheduler, stats);
+}
+
+static uint64_t RunMandelbrotFrame(MandelbrotFrame* frame, TileScheduler* scheduler,
+                                   MandelbrotStats* stats)
+{
+    assert(frame);
+    assert(scheduler);
+
+#ifdef TIME_MEASURE
+    uint64_t startTime = GetTimeStampCounter();
+#endif
+
+    const MandelbrotTile* region = &frame->region;
+
+    const size_t regionWidth  = region->xEnd - region->xBegin;
+    const size_t regionHeight = region->yEnd - region->yBegin;
+
+    frame->numberOfTilesX = (regionWidth  + TileWidth  - 1) / TileWidth;
+    size_t numberOfTiles  = (regionHeight + TileHeight - 1) / TileHeight * frame->numberOfTilesX;
+
+    TileSchedulerRun(scheduler, numberOfTiles, CalculateMandelbrotFrameTile, frame);
+
+    if (stats)
+    {
+        stats->vectorIterations  = frame->vectorIterations;
+        stats->skippedIterations = frame->skippedIterations;
+    }
+
+#ifdef TIME_MEASURE
+    uint64_t timeSpent = GetTimeStampCounter() - startTime;
+    printf("vectorIterations - %llu\n", (unsigned long long)frame->vectorIterations.load());
+    printf("skippedIterations - %llu\n", (unsigned long long)frame->skippedIterations.load());
+    return timeSpent;
+#else
+    return 0;
+#endif
+}
+
+static void CalculateMandelbrotFrameTile(size_t tileIndex, size_t threadIndex, void* context)
+{
+    assert(context);
+    (void)threadIndex;
+
+    MandelbrotFrame*      frame  = (MandelbrotFrame*)context;
+    const MandelbrotView* view   = frame->view;
+    const MandelbrotTile* region = &frame->region;
+
+    MandelbrotTile tile = {};
+    tile.xBegin = region->xBegin + tileIndex % frame->numberOfTilesX * TileWidth;
+    tile.yBegin = region->yBegin + tileIndex / frame->numberOfTilesX * TileHeight;
+    tile.xEnd   = tile.xBegin + TileWidth  < region->xEnd ? tile.xBegin + TileWidth  : region->xEnd;
+    tile.yEnd   = tile.yBegin + TileHeight < region->yEnd ? tile.yBegin + TileHeight : region->yEnd;
+
+    MandelbrotStats tileStats = {};
+    if (frame->smoothKernel)
+        frame->smoothKernel(frame->smoothIterations, view, &tile, &tileStats);
+    else
+        frame->tileKernel(frame->iterations, view, &tile, &tileStats);
+
+    frame->vectorIterations  += tileStats.vectorIterations;
+    frame->skippedIterations += tileStats.skippedIterations;
+}
@@ -0,0 +1,124 @@
+#include <assert.h>
+
+#include "Mandelbrot.h"
+#include "SimdVector.h"
+
+static const size_t NumberOfLanes = 8;
+
+typedef Vec<float,   NumberOfLanes> Floats;
+typedef Vec<int32_t, NumberOfLanes> Ints;
+typedef VecMask<NumberOfLanes>      Mask;
+
+static inline Mask IsInMainCardioidOrBulb(const Floats x, const Floats y);
+
+// The avx2 kernel written with Vec instead of intrinsics, the operations are the same and in
+// the same order, so the picture is the same as well.
+void CalculateMandelbrotTileVec(uint16_t* iterations, const MandelbrotView* view,
+                                const MandelbrotTile* tile, MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(tile);
+    assert(stats);
+
+    const size_t maxNumberOfIterations = view->maxNumberOfIterations;
+
+    const Floats maxRadiusSquare          = Floats::Set1(100.f);
+    const Ints   maxNumberOfIterationsVec = Ints::Set1((int32_t)maxNumberOfIterations);
+
+    const Ints   laneNumbers = Ints::GetLaneNumbers();
+    const Floats x0Begin     = Floats::Set1(view->x0Begin);
+    const Floats dx          = Floats::Set1(view->dx);
+
+    uint64_t vectorIterations  = 0;
+    uint64_t skippedIterations = 0;
+
+    for (size_t pixelY = tile->yBegin; pixelY < tile->yEnd; ++pixelY)
+    {
+        const Floats y0 = Floats::Set1(view->y0Begin + (float)pixelY * view->dy);
+
+        for (size_t pixelX = tile->xBegin; pixelX < tile->xEnd; pixelX += NumberOfLanes)
+        {
+            const Floats x0 = x0Begin + ToFloat(Ints::Set1((int32_t)pixelX) + laneNumbers) * dx;
+
+            Ints numberOfIterations = Ints::Set1(0);
+
+            Floats x = x0;
+            Floats y = y0;
+
+            Mask isInterior = IsInMainCardioidOrBulb(x0, y0);
+
+            Floats savedX            = x;
+            Floats savedY            = y;
+            size_t nextSaveIteration = 1;
+
+            size_t iterationNumber = 0;
+            for (iterationNumber = 0; iterationNumber < maxNumberOfIterations; ++iterationNumber)
+            {
+                const Floats xSquare = x * x;
+                const Floats ySquare = y * y;
+                const Floats xMulY   = x * y;
+
+                const Mask isCounted = AndNot(isInterior, xSquare + ySquare < maxRadiusSquare);
+                if (!IsAnyActive(isCounted)) break;
+
+                numberOfIterations = CountActive(numberOfIterations, isCounted);
+
+                x = xSquare - ySquare + x0;
+                y = xMulY   + xMulY   + y0;
+
+                isInterior = isInterior | (IsEqual(x, savedX) & IsEqual(y, savedY) & isCounted);
+
+                if (iterationNumber + 1 == nextSaveIteration)
+                {
+                    savedX = x;
+                    savedY = y;
+                    nextSaveIteration *= 2;
+                }
+            }
+
+            vectorIterations += iterationNumber + (iterationNumber < maxNumberOfIterations);
+
+            alignas(32) int32_t skippedIterationsArray[NumberOfLanes] = {};
+            Select(isInterior, maxNumberOfIterationsVec - numberOfIterations,
+                   Ints::Set1(0)).Store(skippedIterationsArray);
+            for (size_t i = 0; i < NumberOfLanes; ++i)
+                skippedIterations += (uint64_t)skippedIterationsArray[i];
+
+            numberOfIterations = Select(isInterior, maxNumberOfIterationsVec, numberOfIterations);
+
+        #if defined(TIME_MEASURE_PIXELS_SETTING) || !defined(TIME_MEASURE)
+            alignas(32) int32_t numberOfIterationsArray[NumberOfLanes] = {};
+            numberOfIterations.Store(numberOfIterationsArray);
+
+            // last group in a row may stick out of the image
+            const size_t numberOfPixels = tile->xEnd - pixelX < NumberOfLanes ?
+                                          tile->xEnd - pixelX : NumberOfLanes;
+
+            uint16_t* iterationsPos = iterations + pixelX + pixelY * view->width;
+            for (size_t i = 0; i < numberOfPixels; ++i)
+                iterationsPos[i] = (uint16_t)numberOfIterationsArray[i];
+        #endif
+        }
+    }
+
+    stats->vectorIterations  += vectorIterations;
+    stats->skippedIterations += skippedIterations;
+}
+
+// Main cardioid: q * (q + (x - 1/4)) <= y^2 / 4, where q = (x - 1/4)^2 + y^2.
+// Period-2 bulb: (x + 1)^2 + y^2 <= 1/16.
+static inline Mask IsInMainCardioidOrBulb(const Floats x, const Floats y)
+{
+    const Floats quarter   = Floats::Set1(0.25f);
+    const Floats one       = Floats::Set1(1.f);
+    const Floats sixteenth = Floats::Set1(1.f / 16);
+
+    const Floats ySquare  = y * y;
+    const Floats xShifted = x - quarter;
+    const Floats q        = xShifted * xShifted + ySquare;
+    const Floats xPlusOne = x + one;
+
+    return (q * (q + xShifted) <= ySquare * quarter) |
+           (xPlusOne * xPlusOne + ySquare <= sixteenth);
+}
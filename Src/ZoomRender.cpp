@@ -0,0 +1,209 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "Mandelbrot.h"
+
+extern "C" uint64_t GetTimeStampCounter();
+
+// One block is one task of the scheduler and the rectangle that is filled or calculated whole.
+static const size_t BlockSize = 64;
+
+struct ZoomedFrame
+{
+    uint16_t*             iterations;
+    const MandelbrotView* view;
+    const uint16_t*       previousIterations;
+    const MandelbrotView* previousView;
+    MandelbrotTileKernel  tileKernel;
+
+    size_t                numberOfBlocksX;
+
+    std::atomic<uint64_t> vectorIterations;
+    std::atomic<uint64_t> skippedIterations;
+    std::atomic<uint64_t> filledPixels;
+};
+
+static void CalculateZoomedBlock   (size_t blockIndex, size_t threadIndex, void* context);
+static bool IsInsideInPrevious     (const ZoomedFrame* frame, const MandelbrotTile* block);
+static bool IsBorderInside         (const uint16_t* iterations, const MandelbrotView* view,
+                                    const MandelbrotTile* block);
+
+uint64_t CalculateMandelbrotSetZoomed(uint16_t* iterations, const MandelbrotView* view,
+                                      const uint16_t* previousIterations,
+                                      const MandelbrotView* previousView,
+                                      TileScheduler* scheduler, MandelbrotTileKernel tileKernel,
+                                      MandelbrotStats* stats)
+{
+    assert(iterations);
+    assert(view);
+    assert(!previousIterations || previousView);
+    assert(scheduler);
+    assert(tileKernel);
+
+#ifdef TIME_MEASURE
+    uint64_t startTime = GetTimeStampCounter();
+#endif
+
+    ZoomedFrame frame = {};
+    frame.iterations         = iterations;
+    frame.view               = view;
+    frame.previousIterations = previousIterations;
+    frame.previousView       = previousView;
+    frame.tileKernel         = tileKernel;
+
+    frame.numberOfBlocksX = (view->width + BlockSize - 1) / BlockSize;
+    size_t numberOfBlocks = (view->height + BlockSize - 1) / BlockSize * frame.numberOfBlocksX;
+
+    TileSchedulerRun(scheduler, numberOfBlocks, CalculateZoomedBlock, &frame);
+
+    if (stats)
+    {
+        stats->vectorIterations  = frame.vectorIterations;
+        stats->skippedIterations = frame.skippedIterations;
+        stats->filledPixels      = frame.filledPixels;
+    }
+
+#ifdef TIME_MEASURE
+    uint64_t timeSpent = GetTimeStampCounter() - startTime;
+    printf("vectorIterations - %llu\n", (unsigned long long)frame.vectorIterations.load());
+    printf("filledPixels - %llu\n", (unsigned long long)frame.filledPixels.load());
+    return timeSpent;
+#else
+    return 0;
+#endif
+}
+
+// A block that was inside of the set in the previous frame gets its border calculated first.
+// If the whole border is inside too, so is everything within it, as in the subdivision
+// render, otherwise the rest of the block is calculated. Other blocks are calculated whole.
+static void CalculateZoomedBlock(size_t blockIndex, size_t threadIndex, void* context)
+{
+    assert(context);
+    (void)threadIndex;
+
+    ZoomedFrame*          frame = (ZoomedFrame*)context;
+    const MandelbrotView* view  = frame->view;
+
+    MandelbrotTile block = {};
+    block.xBegin = blockIndex % frame->numberOfBlocksX * BlockSize;
+    block.yBegin = blockIndex / frame->numberOfBlocksX * BlockSize;
+    block.xEnd   = block.xBegin + BlockSize < view->width  ? block.xBegin + BlockSize : view->width;
+    block.yEnd   = block.yBegin + BlockSize < view->height ? block.yBegin + BlockSize : view->height;
+
+    MandelbrotStats blockStats = {};
+
+    // a block without pixels inside of its border has nothing to fill
+    if (block.xEnd - block.xBegin <= 2 || block.yEnd - block.yBegin <= 2 ||
+        !IsInsideInPrevious(frame, &block))
+    {
+        frame->tileKernel(frame->iterations, view, &block, &blockStats);
+
+        frame->vectorIterations  += blockStats.vectorIterations;
+        frame->skippedIterations += blockStats.skippedIterations;
+        return;
+    }
+
+    const MandelbrotTile inner = { block.xBegin + 1, block.yBegin + 1,
+                                   block.xEnd   - 1, block.yEnd   - 1 };
+
+    const MandelbrotTile border[] =
+    {
+        { block.xBegin, block.yBegin, block.xEnd,   inner.yBegin },
+        { block.xBegin, inner.yEnd,   block.xEnd,   block.yEnd   },
+        { block.xBegin, inner.yBegin, inner.xBegin, inner.yEnd   },
+        { inner.xEnd,   inner.yBegin, block.xEnd,   inner.yEnd   },
+    };
+
+    for (size_t i = 0; i < sizeof(border) / sizeof(*border); ++i)
+        frame->tileKernel(frame->iterations, view, &border[i], &blockStats);
+
+    if (IsBorderInside(frame->iterations, view, &block))
+    {
+        const uint16_t maxNumberOfIterations = (uint16_t)view->maxNumberOfIterations;
+
+        for (size_t y = inner.yBegin; y < inner.yEnd; ++y)
+        {
+            uint16_t* iterationsPos = frame->iterations + y * view->width;
+            for (size_t x = inner.xBegin; x < inner.xEnd; ++x)
+                iterationsPos[x] = maxNumberOfIterations;
+        }
+
+        frame->filledPixels += (inner.xEnd - inner.xBegin) * (inner.yEnd - inner.yBegin);
+    }
+    else
+        frame->tileKernel(frame->iterations, view, &inner, &blockStats);
+
+    frame->vectorIterations  += blockStats.vectorIterations;
+    frame->skippedIterations += blockStats.skippedIterations;
+}
+
+// True if every pixel of the previous frame around the points of the block reached the
+// maximum number of iterations. The block has to be inside of the previous frame.
+static bool IsInsideInPrevious(const ZoomedFrame* frame, const MandelbrotTile* block)
+{
+    assert(frame);
+    assert(block);
+
+    const MandelbrotView* view         = frame->view;
+    const MandelbrotView* previousView = frame->previousView;
+
+    // with another maximum the pixels of the set are not the same
+    if (!frame->previousIterations ||
+        previousView->maxNumberOfIterations != view->maxNumberOfIterations)
+        return false;
+
+    // corner pixels of the block in the pixels of the previous frame, rounded outwards
+    const double xBegin = floor((view->x0BeginDouble + (double)block->xBegin * view->dxDouble -
+                                 previousView->x0BeginDouble) / previousView->dxDouble);
+    const double yBegin = floor((view->y0BeginDouble + (double)block->yBegin * view->dyDouble -
+                                 previousView->y0BeginDouble) / previousView->dyDouble);
+    const double xEnd   = ceil ((view->x0BeginDouble + (double)(block->xEnd - 1) * view->dxDouble -
+                                 previousView->x0BeginDouble) / previousView->dxDouble);
+    const double yEnd   = ceil ((view->y0BeginDouble + (double)(block->yEnd - 1) * view->dyDouble -
+                                 previousView->y0BeginDouble) / previousView->dyDouble);
+
+    if (xBegin < 0 || yBegin < 0 || xEnd >= (double)previousView->width ||
+        yEnd >= (double)previousView->height)
+        return false;
+
+    for (size_t y = (size_t)yBegin; y <= (size_t)yEnd; ++y)
+    {
+        const uint16_t* iterationsPos = frame->previousIterations + y * previousView->width;
+        for (size_t x = (size_t)xBegin; x <= (size_t)xEnd; ++x)
+        {
+            if (iterationsPos[x] != previousView->maxNumberOfIterations)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool IsBorderInside(const uint16_t* iterations, const MandelbrotView* view,
+                           const MandelbrotTile* block)
+{
+    assert(iterations);
+    assert(view);
+    assert(block);
+
+    const uint16_t* firstRow = iterations + block->yBegin * view->width;
+    const uint16_t* lastRow  = iterations + (block->yEnd - 1) * view->width;
+
+    for (size_t x = block->xBegin; x < block->xEnd; ++x)
+    {
+        if (firstRow[x] != view->maxNumberOfIterations || lastRow[x] != view->maxNumberOfIterations)
+            return false;
+    }
+
+    for (size_t y = block->yBegin + 1; y + 1 < block->yEnd; ++y)
+    {
+        const uint16_t* row = iterations + y * view->width;
+        if (row[block->xBegin]   != view->maxNumberOfIterations ||
+            row[block->xEnd - 1] != view->maxNumberOfIterations)
+            return false;
+    }
+
+    return true;
+}
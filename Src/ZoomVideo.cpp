@@ -0,0 +1,523 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "ImageWriter.h"
+#include "KernelDispatch.h"
+#include "Mandelbrot.h"
+
+// Frames of a zoom path go through three stages on threads of their own: calculation on the
+// scheduler, colorizing and writing. Frame f is in the buffers f % NumberOfFrameBuffers, so a
+// stage can be up to that many frames ahead of the next one.
+static const size_t   NumberOfFrameBuffers  = 3;
+static const size_t   MaxNumberOfKeyframes  = 256;
+static const size_t   DefaultNumberOfFrames = 300;
+static const size_t   DefaultIterations     = 1024;
+
+static const uint64_t ProgressPeriodNs      = 1000000000;
+
+static const char* const PaletteNames[]     = { "green", "fire", "gray" };
+static const char* const StageNames[]       = { "calculate", "colorize", "write" };
+
+enum ZoomStage
+{
+    STAGE_CALCULATE,
+    STAGE_COLORIZE,
+    STAGE_WRITE,
+
+    NUMBER_OF_STAGES,
+};
+
+struct Keyframe
+{
+    double centerX;
+    double centerY;
+    double scale;
+};
+
+// Zooms from the start view into the period-3 minibrot on the real axis, most of the end
+// of the path is inside of the set.
+static const Keyframe ReferencePath[] =
+{
+    { CenterX,    CenterY, 1  },
+    { -1.7548776, 0,       60 },
+};
+
+struct ZoomArgs
+{
+    const char*           kernelName;
+    const char*           pathFileName;
+    // frames are <outputPrefix>00000.<format>..., "-" writes them one after another to stdout
+    const char*           outputPrefix;
+    const char*           formatName;
+    ImageFormat           format;
+
+    size_t                width;
+    size_t                height;
+    size_t                numberOfFrames;
+
+    size_t                maxNumberOfIterations;
+    MandelbrotPaletteType paletteType;
+    size_t                numberOfThreads;
+    bool                  useReuse;
+    bool                  useSmoothColoring;
+};
+
+// A stage takes frame f when the stage before it is done with it and the stage after it is
+// done with frame f - NumberOfFrameBuffers, whose buffer it is going to overwrite.
+struct ZoomPipeline
+{
+    std::mutex                  mutex;
+    std::condition_variable     frameDone;
+
+    size_t                      numberOfDoneFrames[NUMBER_OF_STAGES];
+    // a frame is not written, every stage stops
+    bool                        isFailed;
+    uint64_t                    waitNs[NUMBER_OF_STAGES];
+    uint64_t                    busyNs[NUMBER_OF_STAGES];
+
+    uint16_t*                   iterations[NumberOfFrameBuffers];
+    // frames colored smoothly have no iterations to be reused by the next frame
+    float*                      smoothIterations[NumberOfFrameBuffers];
+    bool                        isSmooth[NumberOfFrameBuffers];
+    MandelbrotView              views[NumberOfFrameBuffers];
+    uint8_t*                    pixels[NumberOfFrameBuffers];
+
+    const ZoomArgs*             args;
+    const Keyframe*             keyframes;
+    size_t                      numberOfKeyframes;
+    const MandelbrotPalette*    palette;
+
+    // used by the calculation stage only
+    TileScheduler*              scheduler;
+    const MandelbrotKernelInfo* kernel;
+    uint64_t                    filledPixels;
+    size_t                      numberOfDoubleFrames;
+};
+
+static bool     ParseArgs      (int argc, char* argv[], ZoomArgs* args);
+static void     PrintUsage     (const char* programName);
+static size_t   ReadKeyframes  (const char* fileName, Keyframe* outKeyframes);
+
+static void     RunStage       (ZoomPipeline* pipeline, const ZoomStage stage);
+static bool     WaitForFrame   (ZoomPipeline* pipeline, const ZoomStage stage,
+                                const size_t frame);
+static void     CalculateFrame (ZoomPipeline* pipeline, const size_t frame);
+static bool     WriteFrame     (ZoomPipeline* pipeline, const size_t frame);
+static void     GetPathView    (const ZoomPipeline* pipeline, const size_t frame,
+                                MandelbrotView* outView);
+static uint64_t GetTimeNs      ();
+
+int main(int argc, char* argv[])
+{
+    ZoomArgs args = {};
+    if (!ParseArgs(argc, argv, &args))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    Keyframe keyframes[MaxNumberOfKeyframes] = {};
+    size_t   numberOfKeyframes = sizeof(ReferencePath) / sizeof(*ReferencePath);
+    memcpy(keyframes, ReferencePath, sizeof(ReferencePath));
+
+    if (args.pathFileName)
+    {
+        numberOfKeyframes = ReadKeyframes(args.pathFileName, keyframes);
+        if (numberOfKeyframes < 2)
+        {
+            fprintf(stderr, "Can't read at least 2 keyframes from %s\n", args.pathFileName);
+            return 1;
+        }
+    }
+
+    const MandelbrotKernelInfo* kernel = SelectMandelbrotKernel(args.kernelName);
+    if (!kernel)
+        return 1;
+
+    // stdout may be the stream of frames, so everything else goes to stderr
+    const MandelbrotKernelInfo* avx2Kernel = FindMandelbrotKernel("avx2");
+    if (args.useSmoothColoring && (!avx2Kernel || !IsKernelSupported(avx2Kernel)))
+    {
+        fprintf(stderr, "Smooth coloring needs the avx2 kernel, it is not supported by this cpu\n");
+        return 1;
+    }
+
+    fprintf(stderr, "%zu frames %zu x %zu along %zu keyframes to %s, kernel - %s, threads - %zu, "
+            "reuse - %s, smooth - %s\n", args.numberOfFrames, args.width, args.height,
+            numberOfKeyframes, strcmp(args.outputPrefix, "-") == 0 ? "stdout" : args.outputPrefix,
+            kernel->name, args.numberOfThreads, args.useReuse ? "on" : "off",
+            args.useSmoothColoring ? "on" : "off");
+
+    TileScheduler scheduler = {};
+    TileSchedulerCtor(&scheduler, args.numberOfThreads);
+
+    MandelbrotPalette palette = {};
+    MandelbrotPaletteCtor(&palette, args.maxNumberOfIterations, args.paletteType);
+
+    const size_t numberOfPixels = args.width * args.height;
+
+    ZoomPipeline pipeline = {};
+    for (size_t i = 0; i < NumberOfFrameBuffers; ++i)
+    {
+        pipeline.iterations[i] = (uint16_t*)calloc(numberOfPixels, sizeof(uint16_t));
+        if (args.useSmoothColoring)
+            pipeline.smoothIterations[i] = (float*)calloc(numberOfPixels, sizeof(float));
+        // the colorizer needs 32 bytes aligned pixels
+        pipeline.pixels[i]     = (uint8_t*)aligned_alloc(32, (numberOfPixels * 4 + 31) / 32 * 32);
+    }
+
+    pipeline.args              = &args;
+    pipeline.keyframes         = keyframes;
+    pipeline.numberOfKeyframes = numberOfKeyframes;
+    pipeline.palette           = &palette;
+    pipeline.scheduler         = &scheduler;
+    pipeline.kernel            = kernel;
+
+    const uint64_t startTime = GetTimeNs();
+
+    std::thread colorizeThread(RunStage, &pipeline, STAGE_COLORIZE);
+    std::thread writeThread   (RunStage, &pipeline, STAGE_WRITE);
+    RunStage(&pipeline, STAGE_CALCULATE);
+
+    colorizeThread.join();
+    writeThread.join();
+
+    const uint64_t timeNs = GetTimeNs() - startTime;
+    const size_t   numberOfWrittenFrames = pipeline.numberOfDoneFrames[STAGE_WRITE];
+
+    fprintf(stderr, "\n%zu frames in %.2f s, %.2f frames/s, %.1f%% of pixels filled from the "
+            "previous frames, %zu frames in double\n", numberOfWrittenFrames,
+            (double)timeNs / 1e9, (double)numberOfWrittenFrames / ((double)timeNs / 1e9),
+            100. * (double)pipeline.filledPixels /
+            (double)(numberOfPixels * args.numberOfFrames),
+            pipeline.numberOfDoubleFrames);
+
+    // the stage that waits the least is the bottleneck
+    for (size_t stage = 0; stage < NUMBER_OF_STAGES; ++stage)
+    {
+        fprintf(stderr, "%-10s %8.2f ms per frame, waited %.2f s\n", StageNames[stage],
+                (double)pipeline.busyNs[stage] / 1e6 / (double)args.numberOfFrames,
+                (double)pipeline.waitNs[stage] / 1e9);
+    }
+
+    for (size_t i = 0; i < NumberOfFrameBuffers; ++i)
+    {
+        free(pipeline.iterations[i]);
+        free(pipeline.smoothIterations[i]);
+        free(pipeline.pixels[i]);
+    }
+    MandelbrotPaletteDtor(&palette);
+    TileSchedulerDtor(&scheduler);
+
+    if (pipeline.isFailed)
+    {
+        fprintf(stderr, "Failed to write frame %zu\n", numberOfWrittenFrames);
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool ParseArgs(int argc, char* argv[], ZoomArgs* args)
+{
+    assert(argv);
+    assert(args);
+
+    args->kernelName     = nullptr;
+    args->pathFileName   = nullptr;
+    args->outputPrefix   = "frame";
+    args->formatName     = "ppm";
+
+    args->width          = 1280;
+    args->height         = 720;
+    args->numberOfFrames = DefaultNumberOfFrames;
+
+    args->maxNumberOfIterations = DefaultIterations;
+    args->paletteType           = PALETTE_GREEN;
+    args->numberOfThreads       = GetDefaultNumberOfThreads();
+    args->useReuse              = true;
+    args->useSmoothColoring     = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        const char* option = argv[i];
+        const char* value  = argv[++i];
+
+        if      (strcmp(option, "--kernel")     == 0) args->kernelName            = value;
+        else if (strcmp(option, "--path")       == 0) args->pathFileName          = value;
+        else if (strcmp(option, "--output")     == 0) args->outputPrefix          = value;
+        else if (strcmp(option, "--format")     == 0) args->formatName            = value;
+        else if (strcmp(option, "--width")      == 0) args->width                 = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--height")     == 0) args->height                = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--frames")     == 0) args->numberOfFrames        = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--iterations") == 0) args->maxNumberOfIterations = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--threads")    == 0) args->numberOfThreads       = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--reuse")      == 0) args->useReuse              = strcmp(value, "on") == 0;
+        else if (strcmp(option, "--smooth")     == 0) args->useSmoothColoring     = strcmp(value, "on") == 0;
+        else if (strcmp(option, "--palette")    == 0)
+        {
+            args->paletteType = NUMBER_OF_PALETTES;
+            for (size_t palette = 0; palette < NUMBER_OF_PALETTES; ++palette)
+            {
+                if (strcmp(value, PaletteNames[palette]) == 0)
+                    args->paletteType = (MandelbrotPaletteType)palette;
+            }
+        }
+        else
+            return false;
+    }
+
+    args->format = GetImageFormat(args->formatName);
+
+    return args->width > 0 && args->height > 0 && args->numberOfFrames > 0 &&
+           args->format != NUMBER_OF_IMAGE_FORMATS &&
+           args->paletteType != NUMBER_OF_PALETTES &&
+           args->maxNumberOfIterations > 0 &&
+           args->maxNumberOfIterations <= MaxNumberOfIterationsLimit &&
+           args->numberOfThreads > 0;
+}
+
+static void PrintUsage(const char* programName)
+{
+    fprintf(stderr,
+            "Usage: %s [--path file] [--frames N] [--output prefix|-] [--format ppm|png|raw]\n"
+            "          [--width N] [--height N] [--iterations N] [--palette green|fire|gray]\n"
+            "          [--kernel name] [--threads N] [--reuse on|off] [--smooth on|off]\n"
+            "Renders a zoom along the keyframes of the path file, a line \"x y scale\" for every\n"
+            "keyframe (%zu at most), or along the reference path. The keyframes are evenly\n"
+            "spaced in time, the scale changes at a constant rate between them. Frames are\n"
+            "written to prefix00000.ppm and so on, with - they go one after another to stdout.\n"
+            "Smooth frames are calculated whole by the avx2-smooth kernel, the ones too deep\n"
+            "for float are colored by the counts of the kernel.\n",
+            programName, MaxNumberOfKeyframes);
+}
+
+// Lines "x y scale", empty lines and lines starting with # are skipped. Returns the number
+// of keyframes, 0 if the file can't be read or has a wrong line.
+static size_t ReadKeyframes(const char* fileName, Keyframe* outKeyframes)
+{
+    assert(fileName);
+    assert(outKeyframes);
+
+    FILE* file = fopen(fileName, "r");
+    if (!file)
+        return 0;
+
+    size_t numberOfKeyframes = 0;
+    bool   isCorrect         = true;
+
+    char line[256] = {};
+    while (isCorrect && fgets(line, sizeof(line), file))
+    {
+        const char* text = line + strspn(line, " \t");
+        if (*text == '#' || *text == '\n' || *text == '\0')
+            continue;
+
+        Keyframe keyframe = {};
+        isCorrect = numberOfKeyframes < MaxNumberOfKeyframes &&
+                    sscanf(text, "%lf %lf %lf", &keyframe.centerX, &keyframe.centerY,
+                           &keyframe.scale) == 3 && keyframe.scale > 0;
+
+        outKeyframes[numberOfKeyframes++] = keyframe;
+    }
+
+    fclose(file);
+
+    return isCorrect ? numberOfKeyframes : 0;
+}
+
+static void RunStage(ZoomPipeline* pipeline, const ZoomStage stage)
+{
+    assert(pipeline);
+
+    const ZoomArgs* args = pipeline->args;
+
+    uint64_t lastProgressTime = GetTimeNs();
+    for (size_t frame = 0; frame < args->numberOfFrames; ++frame)
+    {
+        if (!WaitForFrame(pipeline, stage, frame))
+            break;
+
+        const size_t   buffer    = frame % NumberOfFrameBuffers;
+        const uint64_t startTime = GetTimeNs();
+        bool           isDone    = true;
+
+        switch (stage)
+        {
+            case STAGE_CALCULATE:
+                CalculateFrame(pipeline, frame);
+                break;
+
+            case STAGE_COLORIZE:
+                if (pipeline->isSmooth[buffer])
+                    ColorizeMandelbrotSmooth(pipeline->pixels[buffer],
+                                             pipeline->smoothIterations[buffer],
+                                             args->width * args->height, pipeline->palette);
+                else
+                    ColorizeMandelbrot(pipeline->pixels[buffer], pipeline->iterations[buffer],
+                                       args->width * args->height, pipeline->palette);
+                break;
+
+            case STAGE_WRITE:
+                isDone = WriteFrame(pipeline, frame);
+                break;
+
+            case NUMBER_OF_STAGES:
+            default:
+                assert(0 && "Unknown zoom stage");
+                break;
+        }
+
+        const uint64_t time = GetTimeNs();
+        {
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+
+            pipeline->busyNs[stage] += time - startTime;
+            pipeline->isFailed       = pipeline->isFailed || !isDone;
+            if (isDone)
+                pipeline->numberOfDoneFrames[stage] = frame + 1;
+        }
+        pipeline->frameDone.notify_all();
+
+        if (stage == STAGE_WRITE && time - lastProgressTime >= ProgressPeriodNs)
+        {
+            fprintf(stderr, "\rFrame %zu / %zu", frame + 1, args->numberOfFrames);
+            lastProgressTime = time;
+        }
+    }
+}
+
+// False if the pipeline has failed.
+static bool WaitForFrame(ZoomPipeline* pipeline, const ZoomStage stage, const size_t frame)
+{
+    assert(pipeline);
+
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+
+    const uint64_t waitStart = GetTimeNs();
+    pipeline->frameDone.wait(lock, [pipeline, stage, frame]
+                             {
+                                 const size_t* done = pipeline->numberOfDoneFrames;
+
+                                 return pipeline->isFailed ||
+                                        ((stage == 0 || done[stage - 1] > frame) &&
+                                         (stage + 1 == NUMBER_OF_STAGES ||
+                                          done[stage + 1] + NumberOfFrameBuffers > frame));
+                             });
+    pipeline->waitNs[stage] += GetTimeNs() - waitStart;
+
+    return !pipeline->isFailed;
+}
+
+// The previous frame of the path is still in its buffer, the colorizer only reads it.
+static void CalculateFrame(ZoomPipeline* pipeline, const size_t frame)
+{
+    assert(pipeline);
+
+    const size_t    buffer = frame % NumberOfFrameBuffers;
+    MandelbrotView* view   = &pipeline->views[buffer];
+    GetPathView(pipeline, frame, view);
+
+    pipeline->isSmooth[buffer] = pipeline->args->useSmoothColoring && IsFloatPrecisionEnough(view);
+    if (pipeline->isSmooth[buffer])
+    {
+        CalculateMandelbrotSetSmooth(pipeline->smoothIterations[buffer], view,
+                                     pipeline->scheduler, nullptr);
+        return;
+    }
+
+    // deep frames of the path go to a double precision kernel
+    const MandelbrotKernelInfo* kernel = SelectMandelbrotKernelForView(pipeline->kernel, view);
+    pipeline->numberOfDoubleFrames += kernel->isDoublePrecision;
+
+    const size_t    previousBuffer     = (frame + NumberOfFrameBuffers - 1) % NumberOfFrameBuffers;
+    const uint16_t* previousIterations = frame > 0 && pipeline->args->useReuse &&
+                                         !pipeline->isSmooth[previousBuffer] ?
+                                         pipeline->iterations[previousBuffer] : nullptr;
+
+    MandelbrotStats stats = {};
+    CalculateMandelbrotSetZoomed(pipeline->iterations[buffer], view, previousIterations,
+                                 &pipeline->views[previousBuffer], pipeline->scheduler,
+                                 kernel->tileKernel, &stats);
+
+    pipeline->filledPixels += stats.filledPixels;
+}
+
+static bool WriteFrame(ZoomPipeline* pipeline, const size_t frame)
+{
+    assert(pipeline);
+
+    const ZoomArgs* args = pipeline->args;
+
+    ImageWriter writer = {};
+    bool        isOpen = false;
+
+    if (strcmp(args->outputPrefix, "-") == 0)
+        isOpen = ImageWriterCtorStream(&writer, stdout, args->format, args->width, args->height);
+    else
+    {
+        char fileName[4096] = {};
+        snprintf(fileName, sizeof(fileName), "%s%05zu.%s", args->outputPrefix, frame,
+                 args->formatName);
+
+        isOpen = ImageWriterCtor(&writer, fileName, args->format, args->width, args->height,
+                                 false);
+    }
+
+    if (isOpen)
+        ImageWriterWriteBand(&writer, pipeline->pixels[frame % NumberOfFrameBuffers],
+                             args->height);
+
+    return ImageWriterDtor(&writer) && isOpen;
+}
+
+// Keyframes are evenly spaced in time. Between two of them the scale changes geometrically
+// and the center moves with the width of the view, so the zoom goes straight to a fixed
+// point of the screen instead of drifting to the end center.
+static void GetPathView(const ZoomPipeline* pipeline, const size_t frame,
+                        MandelbrotView* outView)
+{
+    assert(pipeline);
+    assert(outView);
+
+    const ZoomArgs* args = pipeline->args;
+
+    const double time    = args->numberOfFrames > 1 ?
+                           (double)frame / (double)(args->numberOfFrames - 1) *
+                           (double)(pipeline->numberOfKeyframes - 1) : 0;
+    const size_t segment = (size_t)time < pipeline->numberOfKeyframes - 1 ?
+                           (size_t)time : pipeline->numberOfKeyframes - 2;
+    const double part    = time - (double)segment;
+
+    const Keyframe* begin = &pipeline->keyframes[segment];
+    const Keyframe* end   = &pipeline->keyframes[segment + 1];
+
+    const double scale  = begin->scale * pow(end->scale / begin->scale, part);
+    const double weight = fabs(end->scale / begin->scale - 1) < 1e-12 ? part :
+                          (1 / begin->scale - 1 / scale) / (1 / begin->scale - 1 / end->scale);
+
+    const double centerX = begin->centerX + (end->centerX - begin->centerX) * weight;
+    const double centerY = begin->centerY + (end->centerY - begin->centerY) * weight;
+
+    const float dxPerPixel = 1.f / (float)args->width;
+    MandelbrotViewCtor(outView, args->width, args->height, centerX - CenterX, centerY - CenterY,
+                       scale, dxPerPixel, dxPerPixel, args->maxNumberOfIterations);
+}
+
+static uint64_t GetTimeNs()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}